@@ -0,0 +1,496 @@
+#include "benchmark.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+Benchmark::Benchmark(const BenchmarkConfig &config)
+    :config(config), random(config.seed), chainBlocks(0),
+      mempool(new vector<Transaction>), mempoolMutex(new recursive_mutex)
+{
+    virtualTime = EPOCH;
+    Clock::instance().setSource([this]() { return now() * 1000LL; });
+    //the generated chain is proven without waiting, like in the simulator
+    Config::instance().set("proof_provider", "software");
+    Config::instance().set("proof_max_wait_ms", "0");
+    Config::instance().set("proof_seed", to_string(config.seed));
+}
+
+Benchmark::~Benchmark()
+{
+    if (chain)
+    {
+        chain->closeDb();
+    }
+    chain.reset();
+    Clock::instance().setSource(nullptr);
+}
+
+time_t Benchmark::now()
+{
+    return virtualTime;
+}
+
+/**
+ * @brief Benchmark::run
+ * runs the selected benchmarks. the output of the chain code is suppressed
+ * @return false if a database could not be copied or the generated chain is invalid
+ */
+bool Benchmark::run()
+{
+    mkdir(config.directory.c_str(), 0755);
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout.setstate(ios::failbit);
+
+    benchmarkHashing();
+    benchmarkSignatures();
+    benchmarkSerialization();
+    bool success = benchmarkDatabase("valid105.db") && benchmarkDatabase("validDB428.db");
+    if (success && (selected("put_tx_in_block") || selected("verify_blockchain")))
+    {
+        success = createChain() && benchmarkMempool() && benchmarkReplay();
+    }
+
+    cout.clear();
+    cout.flags(flags);
+    cout.precision(precision);
+    return success;
+}
+
+bool Benchmark::selected(const string &name)
+{
+    return config.filter.empty() || name.find(config.filter) != string::npos;
+}
+
+/**
+ * @brief Benchmark::measure
+ * runs the operation once for warming up and then the given times.
+ * the setup is called before every run and is not measured
+ * @param operations calls of the operation per run, with the number of the call
+ */
+void Benchmark::measure(const string &name, const string &parameter, int runs, long operations,
+                        const function<void(long)> &operation, const function<void()> &setup)
+{
+    if (!selected(name))
+    {
+        return;
+    }
+    Result result;
+    result.name = name;
+    result.parameter = parameter;
+    result.operations = operations;
+    for (int run = -1; run < runs; run++)
+    {
+        if (setup)
+        {
+            setup();
+        }
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long i = 0; i < operations; i++)
+        {
+            operation(i);
+        }
+        long elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        if (run >= 0)
+        {
+            result.nanoseconds.push_back((double) elapsed / operations);
+        }
+    }
+    sort(result.nanoseconds.begin(), result.nanoseconds.end());
+    cerr << name << " " << parameter << ": " << fixed << setprecision(0)
+         << result.nanoseconds.at(result.nanoseconds.size() / 2) << " ns" << endl;
+    results.push_back(result);
+}
+
+void Benchmark::benchmarkHashing()
+{
+    const int payloadSizes[] = {64, 1024};
+    for (int size : payloadSizes)
+    {
+        string payload(size, 'x');
+        measure("sha1", "bytes=" + to_string(size), config.runs, 10000, [&payload](long)
+        {
+            SHA1 hash;
+            hash.update(payload);
+            hash.final();
+        });
+    }
+
+    const int treeSizes[] = {16, 256, 4096};
+    for (int size : treeSizes)
+    {
+        if (!selected("merkle_root"))
+        {
+            break;
+        }
+        vector<Transaction> transactions = createBlock("", 0, size).getTransaction();
+        measure("merkle_root", "transactions=" + to_string(size), config.runs, max(1, 4096 / size),
+                [&transactions](long)
+        {
+            MerkleTree(transactions).getMerkleHash();
+        });
+    }
+}
+
+void Benchmark::benchmarkSignatures()
+{
+    if (!selected("verify_signature"))
+    {
+        return;
+    }
+    vector<Transaction> transactions = createBlock("", 0, 1001).getTransaction();
+    transactions.pop_back();    //the miner reward is not signed
+    measure("verify_signature", "", config.runs, transactions.size(), [&transactions](long i)
+    {
+        Transaction &transaction = transactions.at(i);
+        verifySignature(transaction.getHash(), transaction.getSender(), transaction.getRecipient(),
+                        transaction.getValue(), transaction.getTimestamp());
+    });
+}
+
+void Benchmark::benchmarkSerialization()
+{
+    if (!selected("parse_block_to_string") && !selected("parse_string_to_block"))
+    {
+        return;
+    }
+    const int blockSizes[] = {10, 100, 1000};
+    for (int size : blockSizes)
+    {
+        Block block = createBlock("previous", 2, size);
+        string message = parseBlockToString(block, 0);
+        long operations = max(1, 1000 / size);
+        measure("parse_block_to_string", "transactions=" + to_string(size), config.runs, operations, [&block](long)
+        {
+            parseBlockToString(block, 0);
+        });
+        measure("parse_string_to_block", "transactions=" + to_string(size), config.runs, operations, [&message](long)
+        {
+            delete parseStringToBlock(message).block;
+        });
+    }
+}
+
+/**
+ * @brief Benchmark::benchmarkDatabase
+ * reads random blocks, balances and utxos of the participants from a copy of
+ * the sample database and appends new blocks to a fresh copy in every run
+ * @param sample file name in the samples directory
+ * @return false if the sample could not be copied
+ */
+bool Benchmark::benchmarkDatabase(const string &sample)
+{
+    if (!selected("db_get_block") && !selected("db_get_balance") && !selected("db_get_utxo") && !selected("db_append_block"))
+    {
+        return true;
+    }
+    string source = config.samples + "/" + sample;
+    string path = config.directory + "/" + sample;
+    string parameter = "database=" + sample.substr(0, sample.find('.'));
+    if (!copyFile(source, path))
+    {
+        cerr << "could not copy the sample database " << source << endl;
+        return false;
+    }
+    shared_ptr<recursive_mutex> dbMutex(new recursive_mutex);
+    unique_ptr<Database> db(new Database(dbMutex, shared_ptr<int>(new int(0)), path));
+    int height = db->getLastBlockIndex(0);
+    vector<string> participants = db->getAllParticipants("");
+    const long lookups = 100;
+    vector<int> blocks;
+    vector<string> keys;
+    for (long i = 0; i < lookups; i++)
+    {
+        blocks.push_back(uniform_int_distribution<int>(1, height)(random));
+        keys.push_back(participants.at(uniform_int_distribution<size_t>(0, participants.size() - 1)(random)));
+    }
+
+    measure("db_get_block", parameter, config.runs, lookups, [&db, &blocks](long i)
+    {
+        db->getBlock(blocks.at(i), 0);
+    });
+    measure("db_get_balance", parameter, config.runs, lookups, [&db, &keys, height](long i)
+    {
+        db->getBalance(height, keys.at(i), 0);
+    });
+    measure("db_get_utxo", parameter, config.runs, lookups, [&db, &keys, height](long i)
+    {
+        db->getUTXO(height, keys.at(i), 0);
+    });
+
+    vector<Block> appended;
+    string previousHash = db->getLatestBlock().getHash();
+    for (int i = 0; i < 100; i++)
+    {
+        appended.push_back(createBlock(previousHash, height + 1 + i, 10));
+        previousHash = appended.back().getHash();
+    }
+    bool copied = true;
+    measure("db_append_block", parameter, config.runs, appended.size(), [&db, &appended](long i)
+    {
+        db->appendBlock(appended.at(i));
+    }, [&]()
+    {
+        db->closeDb();
+        copied = copyFile(source, path) && copied;
+        db.reset(new Database(dbMutex, shared_ptr<int>(new int(0)), path));
+    });
+    db->closeDb();
+    remove(path.c_str());
+    if (!copied)
+    {
+        cerr << "could not copy the sample database " << source << endl;
+    }
+    return copied;
+}
+
+/**
+ * @brief Benchmark::benchmarkMempool
+ * builds a block on the generated chain from mempools of the configured sizes.
+ * the senders of the chain can pay every transaction, so none is dropped
+ * and every run fills the block from the same mempool
+ */
+bool Benchmark::benchmarkMempool()
+{
+    if (!selected("put_tx_in_block"))
+    {
+        return true;
+    }
+    int largest = *max_element(config.mempoolSizes.begin(), config.mempoolSizes.end());
+    vector<Transaction> transactions = createTransactions(largest);
+    Block latest = chain->getLatestBlock();
+    unique_ptr<Block> block;
+    for (int size : config.mempoolSizes)
+    {
+        measure("put_tx_in_block", "transactions=" + to_string(size), config.macroRuns, 1, [&](long)
+        {
+            block.reset(chain->buildNewBlock(keys.at(0).publicKey, latest));
+        }, [&]()
+        {
+            //through the chain, so its hashes and the values of the senders match the mempool
+            chain->clearMempool();
+            for (int i = 0; i < size; i++)
+            {
+                const Transaction &transaction = transactions.at(i);
+                chain->newTransaction(transaction.getSender(), transaction.getRecipient(), transaction.getHash(),
+                                      transaction.getValue(), transaction.getTimestamp());
+            }
+        });
+        if (block && (int) mempool->size() != size)
+        {
+            cerr << "put_tx_in_block dropped " << size - mempool->size() << " of " << size << " transactions" << endl;
+            return false;
+        }
+    }
+    chain->clearMempool();
+    return true;
+}
+
+/**
+ * @brief Benchmark::benchmarkReplay
+ * verifies every block of the generated chain.
+ * the sample databases are not replayed, their certificates come from an enclave
+ */
+bool Benchmark::benchmarkReplay()
+{
+    bool valid = true;
+    measure("verify_blockchain", "blocks=" + to_string(chainBlocks), config.macroRuns, 1, [this, &valid](long)
+    {
+        valid = chain->verifyBlockchain() && valid;
+    });
+    if (!valid)
+    {
+        cerr << "the generated chain in " << chainPath << " is invalid" << endl;
+    }
+    return valid;
+}
+
+/**
+ * @brief Benchmark::createChain
+ * mines the blocks of the senders, so they can pay the largest mempool
+ * with transactions of one coin. the chain is kept in the directory and
+ * reused by the next run with the same sizes and seed
+ * @return false if a block was not accepted
+ */
+bool Benchmark::createChain()
+{
+    int largest = *max_element(config.mempoolSizes.begin(), config.mempoolSizes.end());
+    int senders = min(largest, MAX_SENDERS);
+    int transactionsPerSender = (largest + senders - 1) / senders;
+    int blocksPerSender = (transactionsPerSender + MINER_REWARD - 1) / MINER_REWARD;
+    chainBlocks = senders * blocksPerSender;
+    chainPath = config.directory + "/chain_" + to_string(config.seed) + "_" + to_string(senders)
+            + "x" + to_string(blocksPerSender) + ".db";
+    keys.clear();
+    for (int i = 0; i < senders; i++)
+    {
+        keys.push_back(createKeypair(i));
+    }
+
+    struct stat info;
+    if (stat(chainPath.c_str(), &info) != 0)
+    {
+        //mined into another file first, an interrupted run leaves no incomplete chain
+        string path = chainPath + ".tmp";
+        remove(path.c_str());
+        cerr << "mining " << chainBlocks << " blocks for " << senders << " senders" << endl;
+        Blockchain generated(shared_ptr<recursive_mutex>(new recursive_mutex), mempool, mempoolMutex, path);
+        for (int i = 0; i < chainBlocks; i++)
+        {
+            virtualTime++;
+            Block previous = generated.getLatestBlock();
+            unique_ptr<Block> block(generated.buildNewBlock(keys.at(i % senders).publicKey, previous));
+            double luckyNumber;
+            string certificate;
+            ProofProvider::instance().addProof(block->getMerkleHash(), previous.getHash(), &luckyNumber, &certificate);
+            block->setLn(luckyNumber);
+            block->setCertificate(certificate);
+            block->makeHash();
+            int forkID = 0;
+            if (generated.handleBlock(*block, &forkID) != 0)
+            {
+                cerr << "the generated block " << block->getIndex() << " was not accepted" << endl;
+                generated.closeDb();
+                return false;
+            }
+        }
+        generated.closeDb();
+        if (rename(path.c_str(), chainPath.c_str()) != 0)
+        {
+            cerr << "could not move the generated chain to " << chainPath << endl;
+            return false;
+        }
+    }
+    chain.reset(new Blockchain(shared_ptr<recursive_mutex>(new recursive_mutex), mempool, mempoolMutex, chainPath));
+    virtualTime = max(virtualTime, chain->getLatestBlock().getTimestamp()) + 1;
+    return true;
+}
+
+bool Benchmark::copyFile(const string &from, const string &to)
+{
+    ifstream source(from, ios::binary);
+    ofstream destination(to, ios::binary | ios::trunc);
+    if (!source || !destination)
+    {
+        return false;
+    }
+    destination << source.rdbuf();
+    return (bool) destination;
+}
+
+/**
+ * @brief Benchmark::createKeypair
+ * derives the keypair from the seed and the index
+ */
+Benchmark::Keypair Benchmark::createKeypair(int index)
+{
+    Keypair keypair;
+    unsigned char publicKey[crypto_sign_PUBLICKEYBYTES];
+    unsigned char keySeed[crypto_sign_SEEDBYTES];
+    string seedString = to_string(config.seed) + ":" + to_string(index);
+    keypair.secretKey.resize(crypto_sign_SECRETKEYBYTES);
+    crypto_hash_sha256(keySeed, (const unsigned char*)seedString.data(), seedString.size());
+    crypto_sign_seed_keypair(publicKey, keypair.secretKey.data(), keySeed);
+    keypair.publicKey = base64_encode(publicKey, crypto_sign_PUBLICKEYBYTES);
+    return keypair;
+}
+
+Transaction Benchmark::createTransaction(const Keypair &sender, const string &recipient, int value, time_t timestamp)
+{
+    string hash = signMsg(recipient, sender.publicKey, value, timestamp, sender.secretKey.data());
+    return Transaction(sender.publicKey, recipient, value, hash, timestamp);
+}
+
+/**
+ * @brief Benchmark::createTransactions
+ * every sender of the generated chain pays one coin to the next sender in turn.
+ * the transactions of one round have an earlier timestamp, so no two are the same
+ */
+vector<Transaction> Benchmark::createTransactions(int count)
+{
+    vector<Transaction> transactions;
+    transactions.reserve(count);
+    int senders = keys.size();
+    for (int i = 0; i < count; i++)
+    {
+        transactions.push_back(createTransaction(keys.at(i % senders), keys.at((i + 1) % senders).publicKey,
+                                                 1, virtualTime - 1 - i / senders));
+    }
+    return transactions;
+}
+
+/**
+ * @brief Benchmark::createBlock
+ * a block with signed transactions between two keys, each with one input,
+ * and the miner reward. it is not proven and is only used for the database and the parser
+ */
+Block Benchmark::createBlock(const string &previousHash, int index, int transactions)
+{
+    Keypair sender = createKeypair(-1);
+    string recipient = createKeypair(-2).publicKey;
+    vector<Transaction> blockTransactions;
+    for (int i = 0; i < transactions - 1; i++)
+    {
+        Transaction transaction = createTransaction(sender, recipient, 1, EPOCH - index * 1000 - i);
+        transaction.add_Input(vector<string>(1, transaction.getHash()));
+        blockTransactions.push_back(transaction);
+    }
+    Transaction minerReward;
+    minerReward.setMinerTransaction(recipient, MINER_REWARD);
+    blockTransactions.push_back(minerReward);
+    MerkleTree merkle = MerkleTree(blockTransactions);
+    Block block(previousHash, "", merkle.getMerkleHash(), EPOCH + index, blockTransactions, index);
+    block.setLn(uniform_real_distribution<double>(0, 1)(random));
+    block.makeHash();
+    return block;
+}
+
+/**
+ * @brief Benchmark::writeResults
+ * writes the time per operation of every benchmark as json,
+ * with the minimum, median, mean and maximum of the runs
+ * @return false if the output file could not be written
+ */
+bool Benchmark::writeResults()
+{
+    ofstream file;
+    if (!config.output.empty())
+    {
+        file.open(config.output, ios::trunc);
+        if (!file)
+        {
+            cerr << "could not write " << config.output << endl;
+            return false;
+        }
+    }
+    ostream &out = config.output.empty() ? cout : file;
+    out << fixed << setprecision(1);
+    out << "{" << endl
+        << "  \"time\": " << time(nullptr) << "," << endl
+        << "  \"runs\": " << config.runs << "," << endl
+        << "  \"macro_runs\": " << config.macroRuns << "," << endl
+        << "  \"seed\": " << config.seed << "," << endl
+        << "  \"results\": [";
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const Result &result = results.at(i);
+        const vector<double> &values = result.nanoseconds;
+        double mean = 0;
+        for (double value : values)
+        {
+            mean += value / values.size();
+        }
+        double median = values.at(values.size() / 2);
+        out << (i == 0 ? "" : ",") << endl
+            << "    {\"name\": \"" << result.name << "\", \"parameter\": \"" << result.parameter << "\", "
+            << "\"operations\": " << result.operations << ", \"runs\": " << values.size() << ", "
+            << "\"ns_per_op\": {\"min\": " << values.front() << ", \"median\": " << median
+            << ", \"mean\": " << mean << ", \"max\": " << values.back() << "}, "
+            << "\"ops_per_second\": " << 1e9 / median << "}";
+    }
+    out << endl << "  ]" << endl << "}" << endl;
+    return (bool) out;
+}
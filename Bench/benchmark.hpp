@@ -0,0 +1,83 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <cstdint>
+#include <functional>
+#include "../Chain/blockchain.hpp"
+
+using namespace std;
+
+struct BenchmarkConfig {
+    int runs;                   //measured repetitions of the micro benchmarks
+    int macroRuns;              //measured repetitions of the mempool and replay benchmarks
+    vector<int> mempoolSizes;   //transactions in the mempool for putTxInBlock
+    string samples;             //directory of the sample databases
+    string directory;           //copied and generated databases
+    string filter;              //only the benchmarks whose name contains it
+    string output;              //file for the results, stdout if empty
+    uint64_t seed;
+};
+
+/**
+ * micro and macro benchmarks of the chain code.
+ * every benchmark runs once for warming up and then the configured times,
+ * each run repeats the operation and the time per operation is reported.
+ * the inputs are generated from the seed and the sample databases are
+ * copied before they are changed, so the runs are repeatable.
+ * the results are written as json, to compare them between revisions
+ */
+class Benchmark
+{
+public:
+    Benchmark(const BenchmarkConfig &config);
+    ~Benchmark();
+    bool run();
+    bool writeResults();
+
+private:
+    struct Result {
+        string name;
+        string parameter;
+        long operations;            //per run
+        vector<double> nanoseconds; //per operation, of every run
+    };
+    struct Keypair {
+        string publicKey;
+        vector<unsigned char> secretKey;
+    };
+    bool selected(const string &name);
+    void measure(const string &name, const string &parameter, int runs, long operations,
+                 const function<void(long)> &operation, const function<void()> &setup = nullptr);
+    void benchmarkHashing();
+    void benchmarkSignatures();
+    void benchmarkSerialization();
+    bool benchmarkDatabase(const string &sample);
+    bool benchmarkMempool();
+    bool benchmarkReplay();
+    bool createChain();
+    bool copyFile(const string &from, const string &to);
+    Keypair createKeypair(int index);
+    Transaction createTransaction(const Keypair &sender, const string &recipient, int value, time_t timestamp);
+    vector<Transaction> createTransactions(int count);
+    Block createBlock(const string &previousHash, int index, int transactions);
+    time_t now();
+
+    BenchmarkConfig config;
+    vector<Result> results;
+    mt19937_64 random;
+    time_t virtualTime;
+    vector<Keypair> keys;                   //the senders of the generated chain
+    string chainPath;
+    int chainBlocks;
+    shared_ptr<vector<Transaction> > mempool;
+    shared_ptr<recursive_mutex> mempoolMutex;
+    unique_ptr<Blockchain> chain;
+    const int MINER_REWARD = 50;
+    const int MAX_SENDERS = 1000;
+    const time_t EPOCH = 1600000000;        //virtual start time, after the genesis block
+};
+
+#endif // BENCHMARK_H
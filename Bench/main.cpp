@@ -0,0 +1,83 @@
+#include "benchmark.hpp"
+
+static void printUsage()
+{
+    cout << "usage: bench [--runs n] [--macro-runs n] [--mempool-sizes n,n,...] [--samples path]" << endl
+         << "             [--dir path] [--filter name] [--output file] [--seed n]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchmarkConfig config;
+    config.runs = 5;
+    config.macroRuns = 3;
+    config.mempoolSizes = {1000, 10000, 100000};
+    config.samples = "../tests";
+    config.directory = "bench_data";
+    config.seed = 1;
+
+    //stoull throws on a seed, that is not a number or out of range
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string option = argv[i];
+            if (i + 1 >= argc)
+            {
+                printUsage();
+                return 1;
+            }
+            string value = argv[++i];
+            if (option == "--runs")
+                config.runs = toInt(value);
+            else if (option == "--macro-runs")
+                config.macroRuns = toInt(value);
+            else if (option == "--mempool-sizes")
+            {
+                config.mempoolSizes.clear();
+                vector<string> sizes = split(value, ',');
+                for (unsigned int s = 0; s < sizes.size(); s++)
+                {
+                    config.mempoolSizes.push_back(toInt(sizes.at(s)));
+                }
+            }
+            else if (option == "--samples")
+                config.samples = value;
+            else if (option == "--dir")
+                config.directory = value;
+            else if (option == "--filter")
+                config.filter = value;
+            else if (option == "--output")
+                config.output = value;
+            else if (option == "--seed")
+                config.seed = stoull(value);
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+    }
+    catch (const exception &)
+    {
+        printUsage();
+        return 1;
+    }
+    bool validSizes = !config.mempoolSizes.empty();
+    for (unsigned int i = 0; i < config.mempoolSizes.size(); i++)
+    {
+        validSizes = validSizes && config.mempoolSizes.at(i) > 0;
+    }
+    if (config.runs < 1 || config.macroRuns < 1 || !validSizes)
+    {
+        printUsage();
+        return 1;
+    }
+
+    Benchmark benchmark(config);
+    if (!benchmark.run())
+    {
+        return 1;
+    }
+    return benchmark.writeResults() ? 0 : 1;
+}
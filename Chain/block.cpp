@@ -59,7 +59,7 @@ bool Block::verifyHash()
  */
 void Block::makeHash()
 {
-    this->timestamp = time(0);
+    this->timestamp = Clock::instance().now();
     this->hash = buildHash(this->ln);
 }
 
@@ -1,10 +1,21 @@
 #include "blockchain.hpp"
+
+static Counter &blocksValidated = Metrics::instance().counter("poluck_blocks_validated_total",
+                                                              "blocks of forks, that passed the verification");
+static Counter &blocksRejected = Metrics::instance().counter("poluck_blocks_rejected_total",
+                                                             "blocks with invalid transactions, hashes or certificates");
+static Counter &blocksApplied = Metrics::instance().counter("poluck_blocks_applied_total",
+                                                            "blocks, that became the tip");
+static Gauge &chainHeight = Metrics::instance().gauge("poluck_chain_height", "index of the latest block");
+static Gauge &mempoolSize = Metrics::instance().gauge("poluck_mempool_transactions", "transactions in the mempool");
+static Histogram &proofSeconds = Metrics::instance().histogram("poluck_proof_seconds",
+        "time from the proof request to the lucky number", {0.01, 0.1, 0.5, 1, 2, 5, 10, 20, 30, 60, 120});
 /**
  * @brief Blockchain::Blockchain
  * standard copy constructor + initialize chain
  */
 Blockchain::Blockchain()
-    :db()
+    :db(), proofStats(), nextListenerID(0), verifierRun(false), baseVerified(true), pruned(false)
 {
     initializeChain();
 }
@@ -17,11 +28,13 @@ Blockchain::Blockchain()
  * @param sharedMutex passed to database
  * @param sharedMempool
  * @param memMutex mutex for the mempool
+ * @param databasePath file of the database
  */
 Blockchain::Blockchain(const shared_ptr<recursive_mutex> &sharedMutex,
                        const shared_ptr<vector<Transaction> > &sharedMempool,
-                       const shared_ptr<recursive_mutex>& memMutex)
-    :db(sharedMutex, shared_ptr<int> (new int(0))), mempool(sharedMempool), mempoolMutex(memMutex)
+                       const shared_ptr<recursive_mutex>& memMutex, const string &databasePath)
+    :db(sharedMutex, shared_ptr<int> (new int(0)), databasePath), mempool(sharedMempool), mempoolMutex(memMutex), proofStats(),
+      nextListenerID(0), verifierRun(false), baseVerified(true), pruned(false)
 {
     cout << "starting init" << endl;
     initializeChain();
@@ -58,14 +71,45 @@ void Blockchain::initializeChain()
         genesisBlock.setCertificate("tKLoBwrOx/1ROWO77UduTA15mO/vml67tU5ifPv3hzF2URujdSFM8AVOoGSmESIQMoZeDRQaVpRxSOpGOlFfUT9n");
         db.appendBlock(genesisBlock);
     }
+    if (!db.isBaseVerified())
+    {
+        baseVerified = false;
+        startSnapshotVerification();
+    }
+    if (Config::instance().getBool("prune", false))
+    {
+        int keepBlocks = Config::instance().getInt("prune_keep_blocks", DEFAULT_PRUNE_KEEP);
+        //a fork has to find the transactions of the blocks it replaces
+        if (keepBlocks <= MAX_REORG_DEPTH)
+        {
+            cout << "prune_keep_blocks has to be above the max reorg depth of " << MAX_REORG_DEPTH << endl;
+            keepBlocks = MAX_REORG_DEPTH + 1;
+        }
+        cout << "pruned mode, keeping the transactions of the last " << keepBlocks << " blocks" << endl;
+        db.setPruning(keepBlocks);
+        pruned = true;
+    }
+    chainHeight.set(db.getLastBlockIndex(0));
+    loadChainLuck();
 //    cout << "init done " << endl;
 }
 
 bool Blockchain::closeDb()
 {
+    stopSnapshotVerification();
     return db.closeDb();
 }
 
+/**
+ * @brief Blockchain::flush
+ * waits until every handled block is written to the disk
+ * @return false if a write failed and blocks are still pending
+ */
+bool Blockchain::flush()
+{
+    return db.flush();
+}
+
 vector<Transaction> Blockchain::getMyTransactions()
 {
     return db.getMyTransactions();
@@ -76,24 +120,72 @@ int Blockchain::getLatestBlockIndex()
     return db.getLastBlockIndex(0);
 }
 
-int Blockchain::getMySendTransactionValueFromMempool()
+/**
+ * @brief Blockchain::getChainLuck
+ * is kept up to date with the tip, the network thread reads it for every new peer
+ * @return the sum of the lucky numbers of the main chain, the luckier chain wins
+ */
+double Blockchain::getChainLuck()
 {
-    int value = 0;
-    string pk = getPublicBkey();
-    mempoolMutex->lock();
-    for (unsigned int i = 0; i < mempool->size(); i++)
+    lock_guard<mutex> lock(luckMutex);
+    return chainLuck.empty() ? 0.0 : chainLuck.back();
+}
+
+/**
+ * @brief Blockchain::loadChainLuck
+ * sums the lucky numbers of the whole main chain, after it was replaced or cut
+ */
+void Blockchain::loadChainLuck()
+{
+    map<int, double> lns = db.getLNs();
+    vector<double> sums;
+    for (map<int, double>::iterator it = lns.begin(); it != lns.end(); ++it)
     {
-        if (mempool->at(i).getSender().compare(pk) == 0)
-        {
-            value += mempool->at(i).getValue();
-        }
+        sums.push_back((sums.empty() ? 0.0 : sums.back()) + it->second);
     }
-    mempoolMutex->unlock();
-    return value;
+    lock_guard<mutex> lock(luckMutex);
+    chainLuck.swap(sums);
+}
+
+/**
+ * @brief Blockchain::updateChainLuck
+ * replaces the sums from the first block of the fork on
+ * @param forkLNs lucky numbers of the applied blocks by their index
+ */
+void Blockchain::updateChainLuck(const map<int, double> &forkLNs)
+{
+    lock_guard<mutex> lock(luckMutex);
+    if (forkLNs.empty())
+    {
+        return;
+    }
+    chainLuck.resize(min((int)chainLuck.size(), forkLNs.begin()->first - 1));
+    for (map<int, double>::const_iterator it = forkLNs.begin(); it != forkLNs.end(); ++it)
+    {
+        chainLuck.push_back((chainLuck.empty() ? 0.0 : chainLuck.back()) + it->second);
+    }
+}
+
+/**
+ * @brief Blockchain::getTransactionBlock
+ * @param hash of the transaction
+ * @return index of the block of the main chain, that contains the transaction, -1 if none does
+ */
+int Blockchain::getTransactionBlock(string hash)
+{
+    return db.getTransactionBlock(hash);
+}
+
+int Blockchain::getMySendTransactionValueFromMempool()
+{
+    lock_guard<recursive_mutex> lock(*mempoolMutex);
+    unordered_map<string, int>::iterator spending = mempoolSpending.find(getPublicBkey());
+    return (spending == mempoolSpending.end()) ? 0 : spending->second;
 }
 
 void Blockchain::checkDatabase()
 {
+    lock_guard<recursive_mutex> lock(handleMutex);
     db.iterateOverBlocks(0);
     while (db.nextBlock())
     {
@@ -101,12 +193,173 @@ void Blockchain::checkDatabase()
         if (!verifyBlock(temp, 0))
         {
             db.cleanUpDBFromIndex(temp.getIndex());
+            loadChainLuck();
+            cancelStaleProof();
+            notify(CHAIN_TIP_CHANGED);
             break;
         }
     }
     db.stopBlockIterator();
 }
 
+/**
+ * @brief Blockchain::exportSnapshot
+ * writes the chain state at a certain height into a snapshot file
+ * @param file path of the snapshot
+ * @param height of the snapshot. 0 for the latest block
+ * @return true if successful
+ */
+bool Blockchain::exportSnapshot(string file, int height)
+{
+    Snapshot snapshot;
+    {
+        //no fork may be applied while the state is collected
+        lock_guard<recursive_mutex> lock(handleMutex);
+        if (!db.exportSnapshot(snapshot, height))
+        {
+            return false;
+        }
+    }
+    if (!snapshot.save(file))
+    {
+        return false;
+    }
+    cout << "exported snapshot at height " << snapshot.height << " with " << snapshot.outputs.size()
+         << " unspent outputs and " << snapshot.balances.size() << " participants" << endl;
+    cout << "state hash " << snapshot.stateHash() << ", publish it together with the snapshot" << endl;
+    return true;
+}
+
+/**
+ * @brief Blockchain::importSnapshot
+ * replaces the local chain with a snapshot, that is higher than it.
+ * the state of the snapshot has to match a trusted state hash,
+ * the hashes and links of the headers are checked before the import.
+ * the certificates are verified in the background afterwards,
+ * no block is accepted on top of the snapshot until then
+ * @param file path of the snapshot
+ * @param trustedState state hash from a trusted source, snapshot_state_hash of the config if empty
+ * @return true if successful
+ */
+bool Blockchain::importSnapshot(string file, string trustedState)
+{
+    Snapshot snapshot;
+    if (!snapshot.load(file))
+    {
+        return false;
+    }
+    if (trustedState.empty())
+    {
+        trustedState = Config::instance().get("snapshot_state_hash", "");
+    }
+    if (trustedState.empty())
+    {
+        cout << "the state of the snapshot can't be checked without a trusted state hash" << endl;
+        return false;
+    }
+    if (snapshot.stateHash().compare(trustedState) != 0)
+    {
+        cout << "the state of the snapshot doesn't match the trusted state hash" << endl;
+        return false;
+    }
+    if (snapshot.headers.at(0).getHash().compare(getBlock(1, 0).getHash()) != 0)
+    {
+        cout << "the snapshot has a different genesis block" << endl;
+        return false;
+    }
+    for (unsigned int i = 1; i < snapshot.headers.size(); i++)
+    {
+        Block &header = snapshot.headers.at(i);
+        if (header.getIndex() != (int)i + 1
+                || header.getPreviousHash().compare(snapshot.headers.at(i - 1).getHash()) != 0
+                || !header.verifyHash())
+        {
+            cout << "header " << i + 1 << " of the snapshot is invalid" << endl;
+            return false;
+        }
+    }
+    //the verifier of a previous snapshot may need the handleMutex to stop
+    stopSnapshotVerification();
+    {
+        lock_guard<recursive_mutex> lock(handleMutex);
+        if (snapshot.height <= db.getLastBlockIndex(0))
+        {
+            cout << "the local chain is already at height " << db.getLastBlockIndex(0) << endl;
+            return false;
+        }
+        if (!db.importSnapshot(snapshot))
+        {
+            return false;
+        }
+        baseVerified = false;
+        loadChainLuck();
+    }
+    cancelStaleProof();
+    chainHeight.set(snapshot.height);
+    notify(CHAIN_TIP_CHANGED);
+    cout << "imported snapshot at height " << snapshot.height << endl;
+    startSnapshotVerification();
+    return true;
+}
+
+int Blockchain::getBaseHeight()
+{
+    return db.getBaseHeight();
+}
+
+void Blockchain::startSnapshotVerification()
+{
+    stopSnapshotVerification();
+    verifierRun = true;
+    snapshotVerifier = thread(&Blockchain::verifySnapshotHeaders, this);
+}
+
+void Blockchain::stopSnapshotVerification()
+{
+    verifierRun = false;
+    if (snapshotVerifier.joinable())
+    {
+        snapshotVerifier.join();
+    }
+}
+
+/**
+ * @brief Blockchain::verifySnapshotHeaders
+ * runs in the background after a snapshot import and
+ * verifies the certificate of every imported header.
+ * drops the snapshot if one of them is invalid, nothing
+ * was built on top of it, so only the genesis block is left
+ */
+void Blockchain::verifySnapshotHeaders()
+{
+    int baseHeight = db.getBaseHeight();
+    for (int i = 2; i <= baseHeight && verifierRun; i++)
+    {
+        if (!proofCertificate(db.getBlock(i, 0)))
+        {
+            cout << "snapshot block " << i << " has a false certificate" << endl;
+            {
+                lock_guard<recursive_mutex> lock(handleMutex);
+                db.cleanUpDBFromIndex(i);
+                loadChainLuck();
+                baseVerified = true;
+            }
+            chainHeight.set(db.getLastBlockIndex(0));
+            cancelStaleProof();
+            notify(CHAIN_TIP_CHANGED);
+            notify(CHAIN_BASE_CHECKED);
+            return;
+        }
+    }
+    if (verifierRun)
+    {
+        db.setBaseVerified();
+        baseVerified = true;
+        cout << "verified all " << baseHeight << " headers of the snapshot" << endl;
+        notify(CHAIN_BASE_CHECKED);
+    }
+}
+
 /**
  * @brief Blockchain::verifyBlock
  * verifies if a block is valid.
@@ -123,11 +376,13 @@ bool Blockchain::verifyBlock(Block block, int forkID)
     vector<string> input;
     bool multInput;
     string merkleHash = merkle.getMerkleHash();
-    if(block.getMerkleHash().compare(merkleHash) != 0)
+    //blocks of an imported snapshot are stored without their transactions
+    bool headerOnly = block.getIndex() <= db.getBaseHeight();
+    if(!headerOnly && block.getMerkleHash().compare(merkleHash) != 0)
     {
-        cout << "Wrong merkle hash in block " << block.getIndex() << endl;
-        cout << "should be " << merkleHash << " but is " << block.getMerkleHash() << endl;
-        cout << block.print();
+        LOG(LOG_WARNING) << "Wrong merkle hash in block " << block.getIndex() << endl;
+        LOG(LOG_WARNING) << "should be " << merkleHash << " but is " << block.getMerkleHash() << endl;
+        LOG(LOG_WARNING) << block.print();
         return false;
     }
 
@@ -143,23 +398,34 @@ bool Blockchain::verifyBlock(Block block, int forkID)
     if (block.getIndex() > 1 &&
         block.getPreviousHash().compare(getBlock(block.getIndex() - 1, previousCompareForkID).getHash()) != 0)
     {
-        cout << "wrong previous hash at block " << block.getIndex() << endl;
-        cout << " is " << block.getPreviousHash() << " but must be " << getBlock(block.getIndex() - 1, previousCompareForkID).getHash() << endl;
+        LOG(LOG_WARNING) << "wrong previous hash at block " << block.getIndex() << endl;
+        LOG(LOG_WARNING) << " is " << block.getPreviousHash() << " but must be " << getBlock(block.getIndex() - 1, previousCompareForkID).getHash() << endl;
         return false;
     }
-    if (block.getTimestamp() <= getBlock(block.getIndex() - 1, previousCompareForkID).getTimestamp()
-            || block.getTimestamp() > time(0))
+    //the order of the timestamps is checked from block 2 on like the previous hash,
+    //there is no block 0 and the empty Block of getBlock(0) has no timestamp set
+    if (block.getIndex() > 1 &&
+        block.getTimestamp() <= getBlock(block.getIndex() - 1, previousCompareForkID).getTimestamp())
+    {
+        LOG(LOG_WARNING) << "wrong timestamp, block " << block.getIndex() << " is not newer than its previous block" << endl;
+        return false;
+    }
+    if (block.getTimestamp() > Clock::instance().now())
     {
-        cout << "wrong timestamp" << endl;
+        LOG(LOG_WARNING) << "wrong timestamp, block " << block.getIndex() << " is from the future" << endl;
         return false;
     }
 
     if(!block.verifyHash())
     {
-        cout << "Hash " << block.buildHash(block.getLn()) << " of Block " << block.getIndex() << " << not valid!" << endl;
-        cout << "It is " << block.getHash() << endl;
+        LOG(LOG_WARNING) << "Hash " << block.buildHash(block.getLn()) << " of Block " << block.getIndex() << " << not valid!" << endl;
+        LOG(LOG_WARNING) << "It is " << block.getHash() << endl;
         return false;
     }
+    if (headerOnly)
+    {
+        return proofCertificate(block);
+    }
     for (int i = 0; i < (signed int)block.getTransaction().size(); i++)
     {
         if (db.existsTransaction(block.getTransaction().at(i).getHash(), block.getIndex(), forkID))
@@ -171,7 +437,7 @@ bool Blockchain::verifyBlock(Block block, int forkID)
             //check if it is the coinbase Tx
             if (!(block.getTransaction().at(i).getInput().size() == 0) || block.getTransaction().at(i).getValue() > MINER_REWARD)
             {
-                cout << "Transaction " << block.getTransaction().at(i).print() << " not valid" << endl;
+                LOG(LOG_WARNING) << "Transaction " << block.getTransaction().at(i).print() << " not valid" << endl;
                 return false;
             }
             coinbase++;
@@ -180,20 +446,20 @@ bool Blockchain::verifyBlock(Block block, int forkID)
             //check if more then one coinbase tx
             if (coinbase > 1)
             {
-                cout << "more then 1 coinbase transaction" << endl;
+                LOG(LOG_WARNING) << "more then 1 coinbase transaction" << endl;
                 return false;
             }
         } else {
             if (getBalance(block.getTransaction().at(i).getSender(), block.getIndex() - 1, forkID) < block.getTransaction().at(i).getValue())
             {
                 block.getTransaction().at(i).print();
-                cout << "invalid transaction in Block " << block.getIndex() << " in fork " << forkID << ". Sender has not enough Coins" << endl;
-                cout << "Has Balance " << getBalance(block.getTransaction().at(i).getSender(), block.getIndex() - 1, forkID) << " sends " << block.getTransaction().at(i).getValue() << endl;
+                LOG(LOG_WARNING) << "invalid transaction in Block " << block.getIndex() << " in fork " << forkID << ". Sender has not enough Coins" << endl;
+                LOG(LOG_WARNING) << "Has Balance " << getBalance(block.getTransaction().at(i).getSender(), block.getIndex() - 1, forkID) << " sends " << block.getTransaction().at(i).getValue() << endl;
                 return false;
             }
             if (block.getTransaction().at(i).getValue() <= 0)
             {
-                cout << "invalid Transaction in Block. Value is not positiv" << endl;
+                LOG(LOG_WARNING) << "invalid Transaction in Block. Value is not positiv" << endl;
                 return false;
             }
         }
@@ -204,30 +470,187 @@ bool Blockchain::verifyBlock(Block block, int forkID)
     in = db.getInputSumOfBlock(block.getIndex(), forkID);
     if (in + minerTransactionValue !=  out)
     {
-        cout << "Block " << block.print() << " is invalid because: in + reward = " << in + minerTransactionValue << " out = " << out << endl;
+        LOG(LOG_WARNING) << "Block " << block.print() << " is invalid because: in + reward = " << in + minerTransactionValue << " out = " << out << endl;
         return false;
     }
     //cout << "cert" << endl;
 
     if (!proofCertificate(block))
     {
-        cout << "Block has false certificate" << endl;
+        LOG(LOG_WARNING) << "Block has false certificate" << endl;
         return false;
     }
     return true;
 }
 
-void Blockchain::ProofOfLuck(Block& block)
+/**
+ * @brief Blockchain::requestProof
+ * requests the lucky number for the block. only one proof runs at a time,
+ * a running proof is cancelled. the request is cancelled as well,
+ * as soon as another block replaces the previous block as the tip
+ * @param block to be proven
+ * @param callback called with the result on the thread of the provider
+ * @return token of the request, needed by finishProof
+ */
+shared_ptr<ProofCancel> Blockchain::requestProof(const Block &block, function<void(const ProofResult&)> callback)
+{
+    shared_ptr<ProofCancel> cancel(new ProofCancel());
+    proofMutex.lock();
+    if (currentProof)
+    {
+        abandonProof();
+    }
+    currentProof = cancel;
+    currentProofParent = block.getPreviousHash();
+    currentProofStart = chrono::steady_clock::now();
+    proofStats.started++;
+    proofMutex.unlock();
+
+    //the enclave can't be interrupted, a cancelled request is left behind
+    ProofProvider::instance().addProofAsync(block.getMerkleHash(), block.getPreviousHash(), cancel, callback);
+    return cancel;
+}
+
+/**
+ * @brief Blockchain::finishProof
+ * adds the result of a proof request to the block
+ * @param block, that was proven
+ * @param cancel token returned by requestProof
+ * @param result of the request
+ * @return false if the request was cancelled or failed
+ */
+bool Blockchain::finishProof(Block &block, const shared_ptr<ProofCancel> &cancel, const ProofResult &result)
 {
-    double ln;
-    string cert;
-    addProof(block.getMerkleHash(), block.getPreviousHash(), &ln, &cert);
-    cout.precision(dbl::max_digits10);
-    cout << "LN: " << fixed << ln << endl;
-    block.setLn(ln);
-    block.setCertificate(cert);
+    string tip = getLatestBlock().getHash();
+    lock_guard<mutex> lock(proofMutex);
+    if (cancel->isCancelled() || result.cancelled)
+    {
+        //counted, when it was cancelled
+        return false;
+    }
+    long duration = 0;
+    if (currentProof == cancel)
+    {
+        duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - currentProofStart).count();
+        currentProof.reset();
+    }
+    if (!result.valid)
+    {
+        return false;
+    }
+    proofSeconds.observe(duration / 1000.0);
+    proofStats.completed++;
+    if (block.getPreviousHash() != tip)
+    {
+        proofStats.stale++;
+        proofStats.wastedMs += duration;
+    }
+    if (Log::isEnabled(LOG_DEBUG))
+    {
+        cout.precision(dbl::max_digits10);
+        cout << "LN: " << fixed << result.luckyNumber << endl;
+    }
+    block.setLn(result.luckyNumber);
+    block.setCertificate(result.certificate);
     block.makeHash();
-        //appendBlock(block);
+    return true;
+}
+
+/**
+ * @brief Blockchain::cancelProof
+ * cancels the running proof request, e.g. when mining stops
+ */
+void Blockchain::cancelProof()
+{
+    lock_guard<mutex> lock(proofMutex);
+    if (currentProof)
+    {
+        abandonProof();
+    }
+}
+
+/**
+ * @brief Blockchain::cancelStaleProof
+ * cancels the running proof request, if its previous block is not the tip anymore
+ */
+void Blockchain::cancelStaleProof()
+{
+    string tip = getLatestBlock().getHash();
+    lock_guard<mutex> lock(proofMutex);
+    if (currentProof && currentProofParent != tip)
+    {
+        abandonProof();
+    }
+}
+
+/**
+ * @brief Blockchain::abandonProof
+ * cancels the running proof request. the proofMutex has to be locked
+ */
+void Blockchain::abandonProof()
+{
+    proofStats.cancelled++;
+    proofStats.wastedMs += chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - currentProofStart).count();
+    currentProof->cancel();
+    currentProof.reset();
+    LOG(LOG_DEBUG) << "proof on top of block " << currentProofParent.substr(0, 8) << " cancelled" << endl;
+}
+
+/**
+ * @brief Blockchain::addEventListener
+ * the listeners are called, when the tip changes or a transaction is added to
+ * or dropped from the mempool. they are called while the chain is locked and may not block
+ * @param listener gets the event and the hash of the transaction, the hash is empty for a new tip
+ * @return id to remove the listener
+ */
+int Blockchain::addEventListener(ChainListener listener)
+{
+    lock_guard<mutex> lock(listenerMutex);
+    eventListeners[nextListenerID] = listener;
+    return nextListenerID++;
+}
+
+void Blockchain::removeEventListener(int id)
+{
+    lock_guard<mutex> lock(listenerMutex);
+    eventListeners.erase(id);
+}
+
+void Blockchain::notify(ChainEvent event, const string &hash)
+{
+    lock_guard<mutex> lock(listenerMutex);
+    for (map<int, ChainListener>::iterator listener = eventListeners.begin(); listener != eventListeners.end(); ++listener)
+    {
+        listener->second(event, hash);
+    }
+}
+
+ProofStats Blockchain::getProofStats()
+{
+    lock_guard<mutex> lock(proofMutex);
+    return proofStats;
+}
+
+/**
+ * @brief Blockchain::printProofStats
+ * prints how many proofs were wasted on replaced previous blocks
+ * and the duration of the phases of the last proof
+ */
+void Blockchain::printProofStats()
+{
+    ProofStats stats = getProofStats();
+    cout << "proofs started:   " << stats.started << endl;
+    cout << "proofs completed: " << stats.completed << endl;
+    cout << "proofs cancelled: " << stats.cancelled << endl;
+    cout << "stale proofs:     " << stats.stale << endl;
+    cout << "wasted time:      " << stats.wastedMs << " ms" << endl;
+    ProofTiming timing;
+    if (ProofProvider::instance().getTiming(timing))
+    {
+        cout << "last proof in us: session " << timing.session << ", unseal " << timing.unseal
+             << ", counter " << timing.counter << ", random " << timing.random
+             << ", wait " << timing.wait << ", sign " << timing.sign << endl;
+    }
 }
 
 /**
@@ -257,7 +680,7 @@ Block* Blockchain::buildNewBlock(string pk, Block prev)
     blockTransactions = putTxInBlock();
     blockTransactions.push_back(minerReward);
     MerkleTree merkle = MerkleTree(blockTransactions);
-    Block* tempBlock = new Block(prev.getHash(), "", merkle.getMerkleHash(), time(NULL), blockTransactions, prev.getIndex() + 1);
+    Block* tempBlock = new Block(prev.getHash(), "", merkle.getMerkleHash(), Clock::instance().now(), blockTransactions, prev.getIndex() + 1);
     return tempBlock;
 }
 
@@ -269,12 +692,15 @@ Block* Blockchain::buildNewBlock(string pk, Block prev)
  */
 bool proofCertificate(Block block)
 {
-    cout.precision(dbl::max_digits10);
-    cout << "LN: " << fixed << block.getLn() << endl;
+    if (Log::isEnabled(LOG_DEBUG))
+    {
+        cout.precision(dbl::max_digits10);
+        cout << "LN: " << fixed << block.getLn() << endl;
+    }
     if (block.getPreviousHash() != "" && block.getIndex() != 1) {
-        return verifyProof(block.getMerkleHash(), block.getPreviousHash(), block.getLn(), block.getCertificate());
+        return ProofProvider::instance().verifyProof(block.getMerkleHash(), block.getPreviousHash(), block.getLn(), block.getCertificate());
     }
-    return TRUE;
+    return true;
 }
 
 /**
@@ -287,6 +713,7 @@ bool proofCertificate(Block block)
 int Blockchain::checkTempChain(int forkID)
 {
 
+    TraceSpan span("check temp chain");
     db.iterateOverForkBlocks(forkID);
     double forkLN = 0.0;
     Block temp;
@@ -298,15 +725,20 @@ int Blockchain::checkTempChain(int forkID)
         {
             firstForkBlockIndex = temp.getIndex();
         }
+        TraceSpan verifySpan("verify block", temp.getIndex());
         if (!verifyBlock(temp, forkID))
         {
-            cout << "invalid Block returned from checkTempChain" << endl;
+            LOG(LOG_WARNING) << "invalid Block returned from checkTempChain" << endl;
+            blocksRejected.inc();
             db.stopForkBlockIterator();
             return -2;
         }
+        blocksValidated.inc();
         forkLN += temp.getLn();
     }
     db.stopForkBlockIterator();
+    span.setBlock(temp.getIndex());
+    TraceSpan luckSpan("is luckier chain", temp.getIndex());
     return db.isLuckierChain(firstForkBlockIndex, db.getLastBlockIndex(0), forkLN, forkID) - 1;
 }
 /**
@@ -334,46 +766,87 @@ Block Blockchain::getBlock(int index, int forkID)
  */
 int Blockchain::handleBlock(Block& block, int* forkID)
 {
+    TraceSpan span("handle block", block.getIndex());
+    lock_guard<recursive_mutex> lock(handleMutex);
     int retVal = -1;
+    if (block.getIndex() <= db.getBaseHeight())
+    {
+        //the state below the base is condensed, a fork there can't be validated
+        LOG(LOG_INFO) << "block " << block.getIndex() << " is below the base height " << db.getBaseHeight() << endl;
+        *forkID ? db.deleteFork(*forkID) : false;
+        return retVal;
+    }
+    if (!baseVerified)
+    {
+        //a false header of the snapshot would drop everything built on it
+        LOG(LOG_INFO) << "block " << block.getIndex() << " waits for the verification of the snapshot headers" << endl;
+        *forkID ? db.deleteFork(*forkID) : false;
+        return retVal;
+    }
+    if (pruned && block.getIndex() <= db.getLastBlockIndex(0) - MAX_REORG_DEPTH)
+    {
+        LOG(LOG_INFO) << "block " << block.getIndex() << " would replace more than " << MAX_REORG_DEPTH << " blocks" << endl;
+        *forkID ? db.deleteFork(*forkID) : false;
+        return retVal;
+    }
     if ((block.getIndex() - 1 <= db.getLastBlockIndex(0)) &&
          block.getPreviousHash().compare(this->getBlock(block.getIndex() - 1, 0).getHash()) == 0)
     {
-        cout << "appending block" << endl;
+        LOG(LOG_DEBUG) << "appending block" << endl;
         if (*forkID == 0)
         {
+            TraceSpan forkSpan("create fork", block.getIndex());
             *forkID = db.createFork();
-            cout << "created fork" << *forkID << endl;
+            LOG(LOG_DEBUG) << "created fork" << *forkID << endl;
+        }
+        {
+            TraceSpan addSpan("add to fork", block.getIndex());
+            db.addToFork(block, *forkID);
         }
-        db.addToFork(block, *forkID);
         retVal = checkTempChain(*forkID);
         if (retVal == 0)
         {
-            cout << "temp chain valid-> applying fork now with index " << block.getIndex() << endl;
-            mempoolUpdate(*forkID);
+            LOG(LOG_DEBUG) << "temp chain valid-> applying fork now with index " << block.getIndex() << endl;
+            {
+                TraceSpan updateSpan("mempool update", block.getIndex());
+                mempoolUpdate(*forkID);
+            }
+            //the fork table is dropped, once the block writer persisted it
+            map<int, double> forkLNs = db.getLNs(*forkID);
+            //only queues the fork, the block writer persists it
+            TraceSpan applySpan("apply fork", block.getIndex());
             db.applyFork(*forkID);
+            updateChainLuck(forkLNs);
+            blocksApplied.inc();
+            chainHeight.set(block.getIndex());
+            cancelStaleProof();
+            notify(CHAIN_TIP_CHANGED);
             return 0;
         }
     }
     else
     {
-        cout << "missing block" << endl;
+        LOG(LOG_DEBUG) << "missing block" << endl;
         if (proofCertificate(block))
         {
             if (*forkID == 0)
             {
+                TraceSpan forkSpan("create fork", block.getIndex());
                 *forkID = db.createFork();
-                cout << "created fork " << *forkID << endl;
+                LOG(LOG_DEBUG) << "created fork " << *forkID << endl;
             }
+            TraceSpan addSpan("add to fork", block.getIndex());
             db.addToFork(block, *forkID);
             return block.getIndex() - 1;
         }
         else
         {
-cout << "wrong certificate" << endl;
+LOG(LOG_WARNING) << "wrong certificate" << endl;
+            blocksRejected.inc();
             retVal = -2;    //send Reset DB
         }
     }
-    cout << "invalid block " << block.getIndex() << " returned from handleBlock with returnValue " << retVal << endl;
+    LOG(LOG_INFO) << "invalid block " << block.getIndex() << " returned from handleBlock with returnValue " << retVal << endl;
 //    block.print(); // invalid Block might return error
     *forkID ? db.deleteFork(*forkID) : false;
     return retVal;  //not a valid chain
@@ -381,7 +854,7 @@ cout << "wrong certificate" << endl;
 
 bool Blockchain::verifyBlockchain()
 {
-
+    lock_guard<recursive_mutex> lock(handleMutex);
     db.iterateOverBlocks(0);
     while(db.nextBlock())
     {
@@ -417,13 +890,54 @@ void Blockchain::newTransaction(string send, string rec, string hash, int val, t
     if(checkDuplicateTransition(hash))
     {
         mempoolMutex->lock();
-        mempool->push_back(temp);
+        addToMempool(temp);
+        mempoolSize.set(mempool->size());
         mempoolMutex->unlock();
-
+        notify(CHAIN_TRANSACTION_ADDED, hash);
     }
     //cout << "new Transacion " << endl << temp.print();
 }
 
+/**
+ * @brief Blockchain::admitTransaction
+ * adds a transaction with a checked signature to the mempool, if the balance of
+ * the sender at the tip covers it and its other transactions in the mempool.
+ * the check and the insert happen under the mempool lock, so parallel callers can not overspend
+ * @param transaction received from a peer
+ * @return ADMITTED or the reason, why it was rejected
+ */
+AdmissionResult Blockchain::admitTransaction(const Transaction &transaction)
+{
+    if (transaction.getValue() <= 0)
+    {
+        return ADMIT_INVALID_VALUE;
+    }
+    if (db.getTransactionValueByHash(transaction.getHash(), 0) != 0)
+    {
+        return ADMIT_IN_CHAIN;
+    }
+    mempoolMutex->lock();
+    if (mempoolHashes.count(transaction.getHash()))
+    {
+        mempoolMutex->unlock();
+        return ADMIT_DUPLICATE;
+    }
+    //read under the lock, so the balance and the pending value belong to the same mempool
+    int balance = getBalance(transaction.getSender());
+    unordered_map<string, int>::iterator spending = mempoolSpending.find(transaction.getSender());
+    int pending = (spending == mempoolSpending.end()) ? 0 : spending->second;
+    if (pending + transaction.getValue() > balance)
+    {
+        mempoolMutex->unlock();
+        return ADMIT_NO_FUNDS;
+    }
+    addToMempool(transaction);
+    mempoolSize.set(mempool->size());
+    mempoolMutex->unlock();
+    notify(CHAIN_TRANSACTION_ADDED, transaction.getHash());
+    return ADMITTED;
+}
+
 
 
 
@@ -442,6 +956,7 @@ vector<Transaction> Blockchain::putTxInBlock()
     vector<Utxo_change> changes;
     vector<string> used_transactions;
     vector<string> input;
+    vector<string> dropped;
     int changeNum;      //defines if some changeinputs are used, if not -1, else elementnumber of the changesvector
     int sum;
     mempoolMutex->lock();
@@ -494,8 +1009,9 @@ vector<Transaction> Blockchain::putTxInBlock()
             if(sum < mempool->at(i).getValue())
             {
                 input.clear();
-                cout << "sender " << mempool->at(i).getSender() << " has not enough money. sends " << mempool->at(i).getValue() << " has " << sum << endl;
-                mempool->erase(mempool->begin()+i);
+                LOG(LOG_DEBUG) << "sender " << mempool->at(i).getSender() << " has not enough money. sends " << mempool->at(i).getValue() << " has " << sum << endl;
+                dropped.push_back(mempool->at(i).getHash());
+                eraseFromMempool(i);
                 i--;
                 continue;
             }
@@ -522,18 +1038,25 @@ vector<Transaction> Blockchain::putTxInBlock()
                     changes.push_back(tempChange);
                 }
             } else {
-                cout << "couldnt verify the transaction with sender " << mempool->at(i).getSender() << endl;
-                mempool->erase(mempool->begin() + i);
+                LOG(LOG_DEBUG) << "couldnt verify the transaction with sender " << mempool->at(i).getSender() << endl;
+                dropped.push_back(mempool->at(i).getHash());
+                eraseFromMempool(i);
             }
             input.clear();
         }
         else
         {
-            cout << "cant put into block  " << endl;
-            mempool->erase(mempool->begin() + i);
+            LOG(LOG_DEBUG) << "cant put into block  " << endl;
+            dropped.push_back(mempool->at(i).getHash());
+            eraseFromMempool(i);
         }
     }
+    mempoolSize.set(mempool->size());
     mempoolMutex->unlock();
+    for (unsigned int i = 0; i < dropped.size(); i++)
+    {
+        notify(CHAIN_TRANSACTION_DROPPED, dropped.at(i));
+    }
 
     for(unsigned int i = 0; i < changes.size(); i++)
     {
@@ -542,8 +1065,7 @@ vector<Transaction> Blockchain::putTxInBlock()
         temp.setRecipient(changes.at(i).key);
         temp.setSender(changes.at(i).key);
         temp.setValue(changes.at(i).change);
-        time_t curTime;
-        time(&curTime);
+        time_t curTime = Clock::instance().now();
         char buff[20];
         SHA1 transHash;                             //TODO: There needs to be a special hash, to sign the coinbase tx
         strftime(buff, 20, "%Y-%m-%d %H:%M:%S", localtime(&curTime));
@@ -584,6 +1106,10 @@ int Blockchain::getBalance(string key, int blockIndex, int forkID)
 
 int Blockchain::getBalance(string key, int forkID)
 {
+    if (forkID == 0)
+    {
+        return db.getBalance(key);
+    }
     return getBalance(key, db.getLastBlockIndex(0), forkID);
 }
 
@@ -613,6 +1139,27 @@ void Blockchain::printMempool()
 
 }
 
+/**
+ * @brief Blockchain::fillFromMempool
+ * rebuilds a compact block from the transactions of the mempool
+ * @param compact received block
+ * @return the number of transactions, that are not in the mempool
+ */
+int Blockchain::fillFromMempool(CompactBlock &compact)
+{
+    lock_guard<recursive_mutex> lock(*mempoolMutex);
+    return compact.reconstruct(*mempool);
+}
+
+/**
+ * @brief Blockchain::printTxIndex
+ * prints the size, memory usage and false positive rate of the transaction index
+ */
+void Blockchain::printTxIndex()
+{
+    cout << db.getTxIndexStats();
+}
+
 
 
 
@@ -624,9 +1171,9 @@ void Blockchain::printMempool()
  * ...
  * block j:...
  */
-QString Blockchain::printChain(bool detailed)
+string Blockchain::printChain(bool detailed)
 {
-    cout << "LN sum is " << db.getLNSum() << endl;
+    cout << "LN sum is " << getChainLuck() << endl;
     return db.getStringFromBlockchain(detailed);
 }
 
@@ -638,17 +1185,8 @@ QString Blockchain::printChain(bool detailed)
  */
 bool Blockchain::checkDuplicateTransition(string hash)
 {
-    mempoolMutex->lock();
-    for (unsigned int i = 0; i < mempool->size(); i++)
-    {
-        if(mempool->at(i).getHash().compare(hash) == 0)
-        {
-            mempoolMutex->unlock();
-            return false;
-        }
-    }
-    mempoolMutex->unlock();
-    return true;
+    lock_guard<recursive_mutex> lock(*mempoolMutex);
+    return mempoolHashes.count(hash) == 0;
 }
 
 /**
@@ -675,14 +1213,61 @@ void Blockchain::mempoolUpdate(int forkID)
         {
             if (transToDelete.at(t).getHash().compare(mempool->at(m).getHash()) == 0)
             {
-                mempool->erase(mempool->begin() + m);
+                eraseFromMempool(m);
                 break;
             }
         }
+        mempoolSize.set(mempool->size());
         mempoolMutex->unlock();
     }
 }
 
+/**
+ * @brief Blockchain::clearMempool
+ * removes every transaction from the mempool, with its hashes and the values of the senders
+ */
+void Blockchain::clearMempool()
+{
+    lock_guard<recursive_mutex> lock(*mempoolMutex);
+    mempool->clear();
+    mempoolHashes.clear();
+    mempoolSpending.clear();
+    mempoolSize.set(0);
+}
+
+/**
+ * @brief Blockchain::addToMempool
+ * appends the transaction and adds it to the hashes and the value of its sender.
+ * the caller holds the mempool lock
+ */
+void Blockchain::addToMempool(const Transaction &transaction)
+{
+    mempool->push_back(transaction);
+    mempoolHashes.insert(transaction.getHash());
+    mempoolSpending[transaction.getSender()] += transaction.getValue();
+}
+
+/**
+ * @brief Blockchain::eraseFromMempool
+ * the caller holds the mempool lock
+ * @param position of the transaction in the mempool
+ */
+void Blockchain::eraseFromMempool(unsigned int position)
+{
+    const Transaction &transaction = mempool->at(position);
+    mempoolHashes.erase(transaction.getHash());
+    unordered_map<string, int>::iterator spending = mempoolSpending.find(transaction.getSender());
+    if (spending != mempoolSpending.end())
+    {
+        spending->second -= transaction.getValue();
+        if (spending->second <= 0)
+        {
+            mempoolSpending.erase(spending);
+        }
+    }
+    mempool->erase(mempool->begin() + position);
+}
+
 void Blockchain::gdb()
 {
     cout << "gdb helper" << endl;
@@ -6,6 +6,11 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
 #include <unistd.h>
 #include <limits>
 #include <time.h>       /* time_t, struct tm, difftime, time, mktime */
@@ -16,10 +21,38 @@
 #include "block.hpp"
 #include "../Database/database.hpp"
 #include "../helperfunctions.h"
-#include "../Enclave/App.h"
+#include "../config.h"
+#include "../clock.h"
+#include "../trace.h"
+#include "../metrics.h"
+#include "../log.h"
+#include "proofprovider.hpp"
+#include "compactblock.hpp"
 using namespace std;
 using namespace HelperFunctions;
 typedef std::numeric_limits< double > dbl;
+
+struct ProofStats {
+    int started;
+    int completed;
+    int cancelled;      //abandoned, because the previous block was replaced
+    int stale;          //completed after the previous block was replaced
+    long wastedMs;      //time spent on cancelled and stale proofs
+};
+enum ChainEvent {
+    CHAIN_TIP_CHANGED,
+    CHAIN_TRANSACTION_ADDED,
+    CHAIN_TRANSACTION_DROPPED,  //removed from the mempool without being included
+    CHAIN_BASE_CHECKED          //the headers of an imported snapshot are verified or the snapshot is dropped
+};
+typedef function<void(ChainEvent, const string&)> ChainListener;
+enum AdmissionResult {
+    ADMITTED,
+    ADMIT_DUPLICATE,            //already in the mempool
+    ADMIT_IN_CHAIN,
+    ADMIT_INVALID_VALUE,
+    ADMIT_NO_FUNDS              //the balance at the tip does not cover the mempool transactions of the sender
+};
 //#define DATABASE "database.db"
 
 
@@ -30,17 +63,28 @@ public:
     Blockchain();
     Blockchain(const shared_ptr<recursive_mutex> &shared_mutex,
                const shared_ptr<vector<Transaction> >&sharedMempool,
-               const shared_ptr<recursive_mutex> &memMutex);
+               const shared_ptr<recursive_mutex> &memMutex,
+               const string &databasePath = DATABASE_PATH);
     void initializeChain();
     void newTransaction(string send, string rec, string hash, int val, time_t timestamp);
-    void ProofOfLuck(Block&);
+    AdmissionResult admitTransaction(const Transaction &transaction);
+    shared_ptr<ProofCancel> requestProof(const Block &block, function<void(const ProofResult&)> callback);
+    bool finishProof(Block &block, const shared_ptr<ProofCancel> &cancel, const ProofResult &result);
+    void cancelProof();
+    int addEventListener(ChainListener listener);
+    void removeEventListener(int id);
+    ProofStats getProofStats();
+    void printProofStats();
     Block getLatestBlock();
     int getBalance(string, int BlockIndex, int forkID);
     int getBalance(string, int forkID = 0);
     bool verifyBlock(Block, int);
-    QString printChain(bool detailed);
+    string printChain(bool detailed);
     void printLatestBlock();
     void printMempool();
+    void clearMempool();
+    int fillFromMempool(CompactBlock &compact);
+    void printTxIndex();
     void printHistory(string);
     Block getBlock(int index, int forkID);
     void appendBlock(Block);
@@ -52,10 +96,16 @@ public:
     bool verifyBlockchain();
     vector<string> getAllParticipants();
     bool closeDb();
+    bool flush();
     vector<Transaction> getMyTransactions();
     int getLatestBlockIndex();
+    double getChainLuck();
+    int getTransactionBlock(string hash);
     int getMySendTransactionValueFromMempool();
     void checkDatabase();
+    bool exportSnapshot(string file, int height);
+    bool importSnapshot(string file, string trustedState);
+    int getBaseHeight();
 
 private:
     vector<Transaction> putTxInBlock();
@@ -63,13 +113,42 @@ private:
     int checkTempChain(int);
     bool checkDuplicateTransition(string);
     void mempoolUpdate(int forkID);
+    void addToMempool(const Transaction &transaction);
+    void eraseFromMempool(unsigned int position);
     void rollbackDB(int blockIndex, int forkID);
+    void cancelStaleProof();
+    void loadChainLuck();
+    void updateChainLuck(const map<int, double> &forkLNs);
+    void abandonProof();
+    void notify(ChainEvent event, const string &hash = "");
+    void startSnapshotVerification();
+    void stopSnapshotVerification();
+    void verifySnapshotHeaders();
     void gdb();
     Database db;
     shared_ptr<vector<Transaction>> mempool;
     shared_ptr<recursive_mutex> mempoolMutex;
+    unordered_set<string> mempoolHashes;            //of the mempool, changed with it under its lock
+    unordered_map<string, int> mempoolSpending;     //value of the mempool transactions per sender
+    recursive_mutex handleMutex;    //only one thread at a time may change the main chain
+    mutex proofMutex;
+    shared_ptr<ProofCancel> currentProof;
+    string currentProofParent;      //hash of the previous block of the running proof
+    chrono::steady_clock::time_point currentProofStart;
+    ProofStats proofStats;
+    mutex luckMutex;
+    vector<double> chainLuck;       //lucky numbers of the main chain summed up to every block, [0] is block 1
+    mutex listenerMutex;
+    map<int, ChainListener> eventListeners;
+    int nextListenerID;
+    thread snapshotVerifier;
+    bool verifierRun;
+    atomic<bool> baseVerified;      //no block is accepted on top of an unverified snapshot
+    bool pruned;                    //the depth of a reorg is limited, the older transactions are gone
     const int MINER_REWARD = 50;
     const int TEMP_CLEAN_NUM = 10;
+    const int MAX_REORG_DEPTH = 100;    //forks of a pruned node may not replace more blocks
+    const int DEFAULT_PRUNE_KEEP = 200;
 };
 bool proofCertificate(Block);
 
@@ -0,0 +1,411 @@
+#include "compactblock.hpp"
+
+CompactBlock::CompactBlock()
+{
+}
+
+/**
+ * @brief CompactBlock::CompactBlock
+ * replaces the transactions, that the peers know from their mempool, by short ids
+ * @param block to be relayed
+ */
+CompactBlock::CompactBlock(const Block &block)
+    :header(block)
+{
+    header.setTransaction({});
+    unordered_map<string, int> positions;
+    vector<Transaction> transactions = block.getTransaction();
+    for (unsigned int i = 0; i < transactions.size(); i++)
+    {
+        Entry entry = Entry();
+        entry.known = true;
+        entry.transaction = transactions.at(i);
+        vector<string> inputs = entry.transaction.getInput();
+        for (unsigned int j = 0; j < inputs.size(); j++)
+        {
+            auto found = positions.find(inputs.at(j));
+            if (found == positions.end())
+            {
+                found = positions.emplace(inputs.at(j), inputTable.size()).first;
+                inputTable.push_back(inputs.at(j));
+            }
+            entry.inputs.push_back(found->second);
+        }
+        entry.transaction.setInput({});
+        //miner and change transactions are built by the miner
+        if (!entry.transaction.getSender().empty()
+                && entry.transaction.getSender() != entry.transaction.getRecipient())
+        {
+            entry.shortID = shortID(entry.transaction.getHash());
+        }
+        entries.push_back(entry);
+    }
+}
+
+/**
+ * @brief CompactBlock::shortID
+ * a collision only costs a round trip, the merkle hash of the rebuilt block does not match then
+ * @param hash of the transaction
+ * @return the first characters of the sha1 of the hash
+ */
+string CompactBlock::shortID(const string &hash)
+{
+    SHA1 checksum;
+    checksum.update(hash);
+    return checksum.final().substr(0, SHORT_ID_LENGTH);
+}
+
+/**
+ * @brief CompactBlock::toString
+ * serializes the compact block for the network
+ * @param forkID of the receiving peer
+ */
+string CompactBlock::toString(int forkID) const
+{
+    string compactAsString = header.getPreviousHash() + ","
+            + header.getMerkleHash() + ","
+            + header.getHash() + ","
+            + to_string(header.getIndex()) + ",";
+    double ln = header.getLn();
+    compactAsString += base64_encode((unsigned char*)&ln, sizeof(double)) + ",";
+    compactAsString += to_string(header.getTimestamp()) + ",";
+    compactAsString += header.getCertificate() + ",";
+    compactAsString += to_string(forkID) + ",";
+
+    for (unsigned int i = 0; i < inputTable.size(); i++)
+    {
+        compactAsString += inputTable.at(i) + "-";
+    }
+    compactAsString += ",";
+
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+        const Entry &entry = entries.at(i);
+        if (entry.shortID.empty())
+        {
+            compactAsString += "f_" + transactionToString(entry.transaction);
+        }
+        else
+        {
+            compactAsString += "s_" + entry.shortID + "_";
+        }
+        compactAsString += positionsToString(entry.inputs) + ";";
+    }
+    compactAsString += ",";
+    return compactAsString;
+}
+
+/**
+ * @brief CompactBlock::fromString
+ * parses the format of toString, the transactions of the mempool are still missing
+ * @param message comma separated fields of the compact block
+ * @param compact is overwritten
+ * @param forkID of the sender
+ * @return false if the message is malformed
+ */
+bool CompactBlock::fromString(const string &message, CompactBlock &compact, int &forkID)
+{
+    vector<string> paramsList = split(message, ',');
+    if (paramsList.size() < 10)
+    {
+        return false;
+    }
+    compact = CompactBlock();
+    compact.header.setPreviousHash(paramsList.at(0));
+    compact.header.setMerkleHash(paramsList.at(1));
+    compact.header.setHash(paramsList.at(2));
+    compact.header.setIndex(toInt(paramsList.at(3)));
+    vector<unsigned char> lnBytes = base64_decode(paramsList.at(4));
+    if (lnBytes.size() < sizeof(double))
+    {
+        return false;
+    }
+    double ln;
+    memcpy(&ln, lnBytes.data(), sizeof(double));
+    compact.header.setLn(ln);
+    compact.header.setTimestamp(toInt(paramsList.at(5)));
+    compact.header.setCertificate(paramsList.at(6));
+    forkID = toInt(paramsList.at(7));
+
+    compact.inputTable = split(paramsList.at(8), '-');
+    compact.inputTable.pop_back();
+
+    vector<string> transactions = split(paramsList.at(9), ';');
+    for (unsigned int i = 0; i + 1 < transactions.size(); i++)
+    {
+        vector<string> fields = split(transactions.at(i), '_');
+        Entry entry = Entry();
+        if (fields.size() == 3 && fields.at(0) == "s" && fields.at(1).size() == SHORT_ID_LENGTH)
+        {
+            entry.known = false;
+            entry.shortID = fields.at(1);
+        }
+        else if (fields.size() == 7 && fields.at(0) == "f")
+        {
+            entry.known = transactionFromString(fields, 1, entry.transaction);
+        }
+        if (!entry.known && entry.shortID.empty())
+        {
+            return false;
+        }
+        entry.inputs = positionsFromString(fields.back());
+        for (unsigned int j = 0; j < entry.inputs.size(); j++)
+        {
+            if (entry.inputs.at(j) < 0 || entry.inputs.at(j) >= (int) compact.inputTable.size())
+            {
+                return false;
+            }
+        }
+        compact.entries.push_back(entry);
+    }
+    return !compact.entries.empty();
+}
+
+/**
+ * @brief CompactBlock::reconstruct
+ * fills the missing transactions from the mempool.
+ * short ids, that match more than one transaction, stay missing
+ * @param mempool of the receiver
+ * @return the number of missing transactions
+ */
+int CompactBlock::reconstruct(const vector<Transaction> &mempool)
+{
+    unordered_map<string, int> wanted;
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+        if (!entries.at(i).known)
+        {
+            wanted.emplace(entries.at(i).shortID, -1);
+        }
+    }
+    if (wanted.empty())
+    {
+        return 0;
+    }
+    for (unsigned int i = 0; i < mempool.size(); i++)
+    {
+        auto found = wanted.find(shortID(mempool.at(i).getHash()));
+        if (found != wanted.end())
+        {
+            //-2 marks an ambiguous short id
+            found->second = (found->second == -1) ? (int) i : -2;
+        }
+    }
+    int missing = 0;
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+        Entry &entry = entries.at(i);
+        if (entry.known)
+        {
+            continue;
+        }
+        int position = wanted.at(entry.shortID);
+        if (position < 0)
+        {
+            missing++;
+            continue;
+        }
+        entry.transaction = mempool.at(position);
+        entry.transaction.setInput({});
+        entry.known = true;
+    }
+    return missing;
+}
+
+/**
+ * @brief CompactBlock::getMissing
+ * @return the positions of the transactions, that are not known yet
+ */
+vector<int> CompactBlock::getMissing() const
+{
+    vector<int> missing;
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+        if (!entries.at(i).known)
+        {
+            missing.push_back(i);
+        }
+    }
+    return missing;
+}
+
+/**
+ * @brief CompactBlock::getMissingRequest
+ * @return the request for the missing transactions: hash,index,positions,
+ */
+string CompactBlock::getMissingRequest() const
+{
+    return header.getHash() + "," + to_string(header.getIndex()) + "," + positionsToString(getMissing()) + ",";
+}
+
+/**
+ * @brief CompactBlock::parseMissingRequest
+ * parses the format of getMissingRequest
+ * @return false if the request is malformed
+ */
+bool CompactBlock::parseMissingRequest(const string &request, string &hash, int &index, vector<int> &positions)
+{
+    vector<string> paramsList = split(request, ',');
+    if (paramsList.size() < 3)
+    {
+        return false;
+    }
+    hash = paramsList.at(0);
+    index = toInt(paramsList.at(1));
+    positions = positionsFromString(paramsList.at(2));
+    return index > 0 && !positions.empty();
+}
+
+/**
+ * @brief CompactBlock::transactionsResponse
+ * answers a request for missing transactions: hash,index,transactions,
+ * the transactions are left out, if the block does not have the requested hash
+ * or a position is out of range. the peer requests the whole block then
+ * @param block at the requested index
+ * @param hash requested
+ * @param positions of the transactions
+ */
+string CompactBlock::transactionsResponse(const Block &block, const string &hash, const vector<int> &positions)
+{
+    string response = hash + "," + to_string(block.getIndex()) + ",";
+    vector<Transaction> transactions = block.getTransaction();
+    string transactionsAsString;
+    for (unsigned int i = 0; i < positions.size(); i++)
+    {
+        if (block.getHash() != hash || positions.at(i) < 0 || positions.at(i) >= (int) transactions.size())
+        {
+            transactionsAsString.clear();
+            break;
+        }
+        transactionsAsString += transactionToString(transactions.at(positions.at(i))) + ";";
+    }
+    return response + transactionsAsString + ",";
+}
+
+/**
+ * @brief CompactBlock::addTransactions
+ * fills the missing transactions with the answer of the sender
+ * @param response in the format of transactionsResponse
+ * @return false if it does not contain all missing transactions
+ */
+bool CompactBlock::addTransactions(const string &response)
+{
+    vector<string> paramsList = split(response, ',');
+    if (paramsList.size() < 3 || paramsList.at(0) != header.getHash())
+    {
+        return false;
+    }
+    vector<string> transactions = split(paramsList.at(2), ';');
+    vector<int> missing = getMissing();
+    if (transactions.size() != missing.size() + 1)
+    {
+        return false;
+    }
+    for (unsigned int i = 0; i < missing.size(); i++)
+    {
+        Entry &entry = entries.at(missing.at(i));
+        vector<string> fields = split(transactions.at(i), '_');
+        if (fields.size() != 6 || !transactionFromString(fields, 0, entry.transaction)
+                || shortID(entry.transaction.getHash()) != entry.shortID)
+        {
+            return false;
+        }
+        entry.known = true;
+    }
+    return true;
+}
+
+bool CompactBlock::isComplete() const
+{
+    return getMissing().empty();
+}
+
+/**
+ * @brief CompactBlock::getBlock
+ * builds the block with the inputs of the table
+ * @param block is overwritten
+ * @return false if a transaction is missing or the merkle hash does not match
+ */
+bool CompactBlock::getBlock(Block &block) const
+{
+    if (!isComplete())
+    {
+        return false;
+    }
+    vector<Transaction> transactions;
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+        Transaction transaction = entries.at(i).transaction;
+        vector<string> inputs;
+        for (unsigned int j = 0; j < entries.at(i).inputs.size(); j++)
+        {
+            inputs.push_back(inputTable.at(entries.at(i).inputs.at(j)));
+        }
+        transaction.setInput(inputs);
+        transactions.push_back(transaction);
+    }
+    block = header;
+    block.setTransaction(transactions);
+    block.setNumTrans(transactions.size());
+    MerkleTree tree(transactions);
+    return tree.getMerkleHash() == header.getMerkleHash();
+}
+
+string CompactBlock::getHash() const
+{
+    return header.getHash();
+}
+
+int CompactBlock::getIndex() const
+{
+    return header.getIndex();
+}
+
+int CompactBlock::getTransactionCount() const
+{
+    return entries.size();
+}
+
+string CompactBlock::transactionToString(const Transaction &transaction)
+{
+    return transaction.getSender() + "_"
+            + transaction.getRecipient() + "_"
+            + to_string(transaction.getValue()) + "_"
+            + transaction.getHash() + "_"
+            + to_string(transaction.getTimestamp()) + "_";
+}
+
+bool CompactBlock::transactionFromString(const vector<string> &fields, size_t first, Transaction &transaction)
+{
+    if (fields.size() < first + 5 || fields.at(first + 3).empty())
+    {
+        return false;
+    }
+    transaction = Transaction(fields.at(first),
+                              fields.at(first + 1),
+                              toInt(fields.at(first + 2)),
+                              fields.at(first + 3),
+                              toInt(fields.at(first + 4)));
+    return true;
+}
+
+string CompactBlock::positionsToString(const vector<int> &positions)
+{
+    string positionsAsString;
+    for (unsigned int i = 0; i < positions.size(); i++)
+    {
+        positionsAsString += to_string(positions.at(i)) + "-";
+    }
+    return positionsAsString;
+}
+
+vector<int> CompactBlock::positionsFromString(const string &positions)
+{
+    vector<int> parsed;
+    vector<string> parts = split(positions, '-');
+    for (unsigned int i = 0; i + 1 < parts.size(); i++)
+    {
+        parsed.push_back(parts.at(i).empty() ? -1 : toInt(parts.at(i)));
+    }
+    return parsed;
+}
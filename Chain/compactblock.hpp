@@ -0,0 +1,68 @@
+#ifndef COMPACTBLOCK_H
+#define COMPACTBLOCK_H
+#include <string>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include "block.hpp"
+#include "merkletree.hpp"
+#include "../libs/sha1.hpp"
+#include "../helperfunctions.h"
+
+using namespace std;
+using namespace HelperFunctions;
+
+/**
+ * a block for the relay, in which the transactions of the mempool are replaced
+ * by short ids. the peers already received them, so they rebuild the block from
+ * their own mempool and only ask the sender for the missing transactions.
+ * the mempool does not know the inputs, they are sent once per block in a table
+ * and the transactions point into it, because the change and the following
+ * transactions of a sender repeat the same inputs.
+ * change and miner transactions are never in a mempool and sent in full.
+ *
+ * format: prev,merkle,hash,index,LN,timestamp,certificate,forkID,inputs,transactions,
+ * inputs:        hash-hash-
+ * transactions:  s_shortID_inputs; for mempool transactions
+ *                f_sender_recipient_value_hash_timestamp_inputs; for the others
+ * inputs of a transaction are positions in the table: 0-3-
+ */
+class CompactBlock
+{
+public:
+    CompactBlock();
+    CompactBlock(const Block &block);
+    static string shortID(const string &hash);
+    string toString(int forkID) const;
+    static bool fromString(const string &message, CompactBlock &compact, int &forkID);
+    int reconstruct(const vector<Transaction> &mempool);
+    vector<int> getMissing() const;
+    string getMissingRequest() const;
+    static bool parseMissingRequest(const string &request, string &hash, int &index, vector<int> &positions);
+    static string transactionsResponse(const Block &block, const string &hash, const vector<int> &positions);
+    bool addTransactions(const string &response);
+    bool isComplete() const;
+    bool getBlock(Block &block) const;
+    string getHash() const;
+    int getIndex() const;
+    int getTransactionCount() const;
+
+    static const unsigned int SHORT_ID_LENGTH = 12;    //hex characters, 48 bit
+
+private:
+    struct Entry {
+        string shortID;             //empty, if the transaction was sent in full
+        bool known;
+        Transaction transaction;    //without the inputs
+        vector<int> inputs;         //positions in the input table
+    };
+    static string transactionToString(const Transaction &transaction);
+    static bool transactionFromString(const vector<string> &fields, size_t first, Transaction &transaction);
+    static string positionsToString(const vector<int> &positions);
+    static vector<int> positionsFromString(const string &positions);
+    Block header;                   //the block without transactions
+    vector<string> inputTable;
+    vector<Entry> entries;
+};
+
+#endif // COMPACTBLOCK_H
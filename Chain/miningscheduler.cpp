@@ -0,0 +1,373 @@
+#include "miningscheduler.hpp"
+
+/**
+ * @brief MiningScheduler::MiningScheduler
+ * listens to the events of the chain. mining starts with start
+ * @param chain to mine on
+ */
+MiningScheduler::MiningScheduler(Blockchain &chain)
+    :chain(chain), proofID(0), pendingTransactions(0), transactionThreshold(0), roundEnd(0),
+      stats(), queue(new EventQueue()), running(false)
+{
+    listenerID = chain.addEventListener([this](ChainEvent event, const string &) { notify(event); });
+}
+
+MiningScheduler::~MiningScheduler()
+{
+    chain.removeEventListener(listenerID);
+    stop();
+    if (miner.joinable())
+    {
+        miner.join();
+    }
+}
+
+/**
+ * @brief MiningScheduler::start
+ * starts the miner thread
+ * @param key public key, that receives the miner reward
+ * @return false if the miner is already running
+ */
+bool MiningScheduler::start(const string &key)
+{
+    lock_guard<mutex> lock(stateMutex);
+    if (running)
+    {
+        return false;
+    }
+    //the previous miner may still handle its stop event
+    if (miner.joinable())
+    {
+        miner.join();
+    }
+    queue->clear();
+    this->key = key;
+    transactionThreshold = Config::instance().getInt("mining_tx_threshold", DEFAULT_TRANSACTION_THRESHOLD);
+    running = true;
+    miner = thread(&MiningScheduler::run, this);
+    return true;
+}
+
+/**
+ * @brief MiningScheduler::begin
+ * starts mining without the miner thread. the caller hands over the
+ * events with processEvents, e.g. the simulator on its virtual clock
+ * @param key public key, that receives the miner reward
+ * @return false if the miner is already running
+ */
+bool MiningScheduler::begin(const string &key)
+{
+    {
+        lock_guard<mutex> lock(stateMutex);
+        if (running || miner.joinable())
+        {
+            return false;
+        }
+        queue->clear();
+        this->key = key;
+        transactionThreshold = Config::instance().getInt("mining_tx_threshold", DEFAULT_TRANSACTION_THRESHOLD);
+        running = true;
+    }
+    startProof();
+    return true;
+}
+
+/**
+ * @brief MiningScheduler::processEvents
+ * handles the queued events without waiting, like the miner thread.
+ * an idle miner starts a new proof, when its round has ended
+ */
+void MiningScheduler::processEvents()
+{
+    MiningEvent event;
+    while (queue->pop(event, 0))
+    {
+        if (handleEvent(event))
+        {
+            currentProof.reset();
+            blockTemplate.reset();
+            return;
+        }
+    }
+    if (isRunning() && !currentProof && Clock::instance().nowMs() >= roundEnd)
+    {
+        startProof();
+    }
+}
+
+/**
+ * @brief MiningScheduler::stop
+ * cancels the running proof and stops the miner thread.
+ * does not wait for the thread
+ */
+void MiningScheduler::stop()
+{
+    lock_guard<mutex> lock(stateMutex);
+    if (!running)
+    {
+        return;
+    }
+    running = false;
+    MiningEvent event = MiningEvent();
+    event.type = MINING_STOP;
+    queue->push(event);
+    chain.cancelProof();
+}
+
+/**
+ * @brief MiningScheduler::wait
+ * waits until a stopped miner thread has finished its last block
+ */
+void MiningScheduler::wait()
+{
+    lock_guard<mutex> lock(stateMutex);
+    if (!running && miner.joinable())
+    {
+        miner.join();
+    }
+}
+
+bool MiningScheduler::isRunning()
+{
+    lock_guard<mutex> lock(stateMutex);
+    return running;
+}
+
+/**
+ * @brief MiningScheduler::notify
+ * queues an event of the chain for the miner thread.
+ * dropped transactions and the check of a snapshot don't change the next block
+ */
+void MiningScheduler::notify(ChainEvent event)
+{
+    if (event == CHAIN_TRANSACTION_DROPPED || event == CHAIN_BASE_CHECKED)
+    {
+        return;
+    }
+    MiningEvent miningEvent = MiningEvent();
+    miningEvent.type = event == CHAIN_TIP_CHANGED ? MINING_TIP_CHANGED : MINING_TRANSACTION_ADDED;
+    queue->push(miningEvent);
+}
+
+MiningStats MiningScheduler::getStats()
+{
+    lock_guard<mutex> lock(statsMutex);
+    return stats;
+}
+
+/**
+ * @brief MiningScheduler::getRoundEnd
+ * @return time of the Clock in milliseconds, when an idle miner builds the next block
+ */
+long long MiningScheduler::getRoundEnd()
+{
+    return roundEnd;
+}
+
+/**
+ * @brief MiningScheduler::printStats
+ * prints the number of blocks and proofs and how fast a new tip is mined on
+ */
+void MiningScheduler::printStats()
+{
+    MiningStats current = getStats();
+    cout << "blocks built:     " << current.templates << endl;
+    cout << "own blocks:       " << current.found << endl;
+    cout << "not lucky:        " << current.notLucky << endl;
+    cout << "tip response:     " << current.lastTipResponseUs << " us (max " << current.maxTipResponseUs << " us)" << endl;
+}
+
+void MiningScheduler::run()
+{
+    setlocale(LC_NUMERIC, "en_US.UTF-8");
+    startProof();
+    bool stopped = false;
+    while (!stopped)
+    {
+        MiningEvent event;
+        //an idle miner sleeps until the round ends, a busy one until its proof finishes
+        if (!queue->pop(event, currentProof ? LLONG_MAX : roundEnd))
+        {
+            startProof();
+            continue;
+        }
+        stopped = handleEvent(event);
+    }
+    currentProof.reset();
+    blockTemplate.reset();
+    cout << "thread terminated" << endl;
+    if (onStopped)
+    {
+        onStopped();
+    }
+}
+
+/**
+ * @brief MiningScheduler::handleEvent
+ * @return true for the stop event
+ */
+bool MiningScheduler::handleEvent(const MiningEvent &event)
+{
+    switch (event.type)
+    {
+    case MINING_TIP_CHANGED:
+        if (chain.getLatestBlock().getHash() != parent.getHash())
+        {
+            startProof();
+            recordTipResponse(event.queued);
+        }
+        break;
+    case MINING_TRANSACTION_ADDED:
+        pendingTransactions++;
+        if (!currentProof && pendingTransactions >= transactionThreshold)
+        {
+            LOG(LOG_DEBUG) << pendingTransactions << " new transactions, creating a new block" << endl;
+            startProof();
+        }
+        break;
+    case MINING_PROOF_FINISHED:
+        handleProof(event);
+        break;
+    case MINING_STOP:
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief MiningScheduler::startProof
+ * builds a new block on top of the tip and requests its proof.
+ * a running proof is cancelled by the chain or the requester
+ */
+void MiningScheduler::startProof()
+{
+    parent = chain.getLatestBlock();
+    if (parent.getTimestamp() >= Clock::instance().now())
+    {
+        //the timestamps have to increase, the block is built in the next second
+        currentProof.reset();
+        proofID++;
+        roundEnd = (Clock::instance().nowMs() / 1000 + 1) * 1000;
+        return;
+    }
+    blockTemplate.reset(chain.buildNewBlock(key, parent));
+    pendingTransactions = 0;
+    unsigned long id = ++proofID;
+    shared_ptr<EventQueue> events = queue;
+    //the queue is shared, an abandoned proof of the enclave may finish after the scheduler is gone
+    function<void(const ProofResult&)> callback = [events, id](const ProofResult &result)
+    {
+        MiningEvent event = MiningEvent();
+        event.type = MINING_PROOF_FINISHED;
+        event.proofID = id;
+        event.result = result;
+        events->push(event);
+    };
+    currentProof = requestProof ? requestProof(*blockTemplate, callback) : chain.requestProof(*blockTemplate, callback);
+    roundEnd = Clock::instance().nowMs() + ROUND_TIME * 1000LL;
+    LOG(LOG_DEBUG) << "creating new Block with index " << blockTemplate->getIndex() << endl;
+
+    lock_guard<mutex> lock(statsMutex);
+    stats.templates++;
+}
+
+/**
+ * @brief MiningScheduler::recordTipResponse
+ * @param changed time, when the new tip was announced
+ */
+void MiningScheduler::recordTipResponse(chrono::steady_clock::time_point changed)
+{
+    lock_guard<mutex> lock(statsMutex);
+    stats.lastTipResponseUs = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - changed).count();
+    stats.maxTipResponseUs = max(stats.maxTipResponseUs, stats.lastTipResponseUs);
+}
+
+/**
+ * @brief MiningScheduler::handleProof
+ * appends the proven block, if it is luckier than the main chain.
+ * results of cancelled or replaced requests are dropped
+ */
+void MiningScheduler::handleProof(const MiningEvent &event)
+{
+    if (event.proofID != proofID || !currentProof)
+    {
+        return;
+    }
+    shared_ptr<ProofCancel> cancel = currentProof;
+    currentProof.reset();
+    if (!chain.finishProof(*blockTemplate, cancel, event.result))
+    {
+        return;
+    }
+    LOG(LOG_DEBUG) << "hash from the new block: " << blockTemplate->getHash() << endl;
+    if (onLuckyNumber)
+    {
+        onLuckyNumber(blockTemplate->getLn());
+    }
+    if (!chain.isLuckierBlock(*blockTemplate))
+    {
+        LOG(LOG_DEBUG) << "not lucky " << blockTemplate->getLn() << endl;
+        lock_guard<mutex> lock(statsMutex);
+        stats.notLucky++;
+        return;
+    }
+    int forkID = 0;
+    int requestedBlock = chain.handleBlock(*blockTemplate, &forkID);
+    if (requestedBlock > 0)
+    {
+        chain.handleBlock(parent, &forkID);
+    }
+    if (requestedBlock == 0)
+    {
+        statsMutex.lock();
+        stats.found++;
+        statsMutex.unlock();
+        if (onBlockFound)
+        {
+            onBlockFound(*blockTemplate);
+        }
+    }
+}
+
+void MiningScheduler::EventQueue::push(const MiningEvent &event)
+{
+    MiningEvent queued = event;
+    queued.queued = chrono::steady_clock::now();
+    eventMutex.lock();
+    events.push_back(queued);
+    eventMutex.unlock();
+    eventAdded.notify_one();
+}
+
+/**
+ * @brief MiningScheduler::EventQueue::pop
+ * waits for the next event
+ * @param event returns the event
+ * @param until latest time of the Clock in milliseconds to return, LLONG_MAX waits for the next event
+ * @return false if no event was queued until then
+ */
+bool MiningScheduler::EventQueue::pop(MiningEvent &event, long long until)
+{
+    unique_lock<mutex> lock(eventMutex);
+    if (until == LLONG_MAX)
+    {
+        eventAdded.wait(lock, [this] { return !events.empty(); });
+    }
+    else if (events.empty())
+    {
+        long long remaining = until - Clock::instance().nowMs();
+        if (remaining <= 0 || !eventAdded.wait_for(lock, chrono::milliseconds(remaining), [this] { return !events.empty(); }))
+        {
+            return false;
+        }
+    }
+    event = events.front();
+    events.pop_front();
+    return true;
+}
+
+void MiningScheduler::EventQueue::clear()
+{
+    lock_guard<mutex> lock(eventMutex);
+    events.clear();
+}
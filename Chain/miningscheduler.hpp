@@ -0,0 +1,108 @@
+#ifndef MININGSCHEDULER_H
+#define MININGSCHEDULER_H
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <functional>
+#include <condition_variable>
+#include "blockchain.hpp"
+
+using namespace std;
+
+enum MiningEventType {
+    MINING_TIP_CHANGED,
+    MINING_TRANSACTION_ADDED,
+    MINING_PROOF_FINISHED,
+    MINING_STOP
+};
+
+struct MiningEvent {
+    MiningEventType type;
+    unsigned long proofID;      //request, that finished
+    ProofResult result;
+    chrono::steady_clock::time_point queued;
+};
+
+struct MiningStats {
+    int templates;              //blocks built
+    int found;                  //own blocks appended to the main chain
+    int notLucky;               //own blocks, that were not luckier than the tip
+    long lastTipResponseUs;     //from the new tip to the proof on top of it or its delay
+    long maxTipResponseUs;
+};
+
+typedef function<shared_ptr<ProofCancel>(const Block&, function<void(const ProofResult&)>)> ProofRequester;
+
+/**
+ * mines on the tip of the chain.
+ * the miner thread sleeps on an event queue and only wakes up for
+ * a new tip, new transactions, a finished proof or the end of the round.
+ * only one proof runs at a time and every tip is proven once per round:
+ * - a new tip cancels the running proof and starts one on top of it
+ * - transactions are added to the next block. if no proof runs and
+ *   enough of them are waiting, a proof starts before the round ends
+ * - at the end of a round without a new tip a new block is built
+ * the rounds follow the Clock. without the miner thread, begin and
+ * processEvents run the same policy on the thread of the caller
+ */
+class MiningScheduler
+{
+public:
+    MiningScheduler(Blockchain &chain);
+    ~MiningScheduler();
+    bool start(const string &key);
+    bool begin(const string &key);
+    void processEvents();
+    void stop();
+    void wait();
+    bool isRunning();
+    void notify(ChainEvent event);
+    MiningStats getStats();
+    long long getRoundEnd();
+    void printStats();
+    ProofRequester requestProof;                   //proves the blocks instead of the chain, e.g. in the simulator
+    function<void(const Block&)> onBlockFound;     //an own block was appended to the main chain
+    function<void(double)> onLuckyNumber;
+    function<void()> onStopped;
+
+private:
+    class EventQueue
+    {
+    public:
+        void push(const MiningEvent &event);
+        bool pop(MiningEvent &event, long long until);
+        void clear();
+
+    private:
+        deque<MiningEvent> events;
+        mutex eventMutex;
+        condition_variable eventAdded;
+    };
+    void run();
+    bool handleEvent(const MiningEvent &event);
+    void startProof();
+    void recordTipResponse(chrono::steady_clock::time_point changed);
+    void handleProof(const MiningEvent &event);
+    Blockchain &chain;
+    int listenerID;
+    string key;
+    Block parent;
+    unique_ptr<Block> blockTemplate;    //block of the running or last proof
+    shared_ptr<ProofCancel> currentProof;
+    unsigned long proofID;
+    int pendingTransactions;            //added after the template was built
+    int transactionThreshold;
+    long long roundEnd;                 //time of the Clock in milliseconds
+    MiningStats stats;
+    shared_ptr<EventQueue> queue;
+    mutex statsMutex;
+    mutex stateMutex;
+    bool running;
+    thread miner;
+    const int DEFAULT_TRANSACTION_THRESHOLD = 10;
+};
+
+#endif // MININGSCHEDULER_H
@@ -0,0 +1,328 @@
+#include "proofprovider.hpp"
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <sodiumpp/sodiumpp.h>
+#include <sodiumpp/base64.h>
+
+static uint64_t elapsedMicroseconds(chrono::steady_clock::time_point start)
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief ProofProvider::instance
+ * creates the provider on first use.
+ * config keys: proof_provider (sgx or software), proof_seed and
+ * proof_max_wait_ms for the software provider
+ * @return the proof provider of this node
+ */
+ProofProvider& ProofProvider::instance()
+{
+    static unique_ptr<ProofProvider> provider;
+    static once_flag created;
+    call_once(created, []()
+    {
+        Config &config = Config::instance();
+#ifdef WITH_SGX
+        string name = config.get("proof_provider", "sgx");
+#else
+        string name = config.get("proof_provider", "software");
+#endif
+        if (name == "software")
+        {
+            uint64_t seed = config.get("proof_seed").empty() ? random_device()() : stoull(config.get("proof_seed"));
+            provider.reset(new SoftwareProofProvider(seed, config.getInt("proof_max_wait_ms", 30000)));
+        }
+#ifdef WITH_SGX
+        else
+        {
+            provider.reset(new SgxProofProvider());
+        }
+#else
+        else
+        {
+            cout << "proof provider " << name << " is not available, using the software provider" << endl;
+            provider.reset(new SoftwareProofProvider(random_device()(), config.getInt("proof_max_wait_ms", 30000)));
+        }
+#endif
+        cout << "using the " << provider->getName() << " proof of luck" << endl;
+    });
+    return *provider;
+}
+
+ProofCancel::ProofCancel()
+    :isSet(false)
+{
+
+}
+
+void ProofCancel::cancel()
+{
+    lock_guard<mutex> lock(cancelMutex);
+    isSet = true;
+    cancelled.notify_all();
+}
+
+bool ProofCancel::isCancelled()
+{
+    lock_guard<mutex> lock(cancelMutex);
+    return isSet;
+}
+
+/**
+ * @brief ProofCancel::waitFor
+ * waits until the duration passed or the request was cancelled
+ * @return true if cancelled
+ */
+bool ProofCancel::waitFor(chrono::milliseconds duration)
+{
+    unique_lock<mutex> lock(cancelMutex);
+    return cancelled.wait_for(lock, duration, [this]() { return isSet; });
+}
+
+/**
+ * @brief ProofProvider::addProof
+ * providers, that can't be interrupted, ignore the cancellation
+ */
+int ProofProvider::addProof(string merkle, string prev, double *luckyNumber, string *cert, const shared_ptr<ProofCancel> &)
+{
+    return addProof(merkle, prev, luckyNumber, cert);
+}
+
+/**
+ * @brief ProofProvider::addProofAsync
+ * creates the proof on its own thread.
+ * a cancelled request of a provider, that can't be interrupted, keeps running
+ * in the background, but its result is marked as cancelled
+ * @param merkle hash of the merkle tree
+ * @param prev hash of the previous block
+ * @param cancel token to cancel the request
+ * @param callback called with the result, may be empty
+ * @return future of the result
+ */
+future<ProofResult> ProofProvider::addProofAsync(string merkle, string prev, const shared_ptr<ProofCancel> &cancel,
+                                                 function<void(const ProofResult&)> callback)
+{
+    shared_ptr<promise<ProofResult> > result(new promise<ProofResult>());
+    future<ProofResult> proof = result->get_future();
+    thread([this, merkle, prev, cancel, callback, result]()
+    {
+        ProofResult proofResult;
+        proofResult.luckyNumber = 0;
+        int ret = addProof(merkle, prev, &proofResult.luckyNumber, &proofResult.certificate, cancel);
+        proofResult.cancelled = cancel && cancel->isCancelled();
+        proofResult.valid = ret == 0 && !proofResult.cancelled;
+        if (callback)
+        {
+            callback(proofResult);
+        }
+        result->set_value(proofResult);
+    }).detach();
+    return proof;
+}
+
+SoftwareProofProvider::SoftwareProofProvider(uint64_t seed, int maxWaitingTime, const string &keysPath)
+    :publicKey(crypto_sign_PUBLICKEYBYTES), secretKey(crypto_sign_SECRETKEYBYTES),
+      keysPath(keysPath), random(seed), maxWaitingTime(maxWaitingTime), lastTiming()
+{
+    if (sodium_init() < 0)
+    {
+        cout << "libsodium could not be initialized" << endl;
+    }
+    unsigned char keySeed[crypto_sign_SEEDBYTES];
+    string seedString = to_string(seed);
+    crypto_hash_sha256(keySeed, (const unsigned char*)seedString.data(), seedString.size());
+    crypto_sign_seed_keypair(publicKey.data(), secretKey.data(), keySeed);
+
+    //the own key is shared like the enclave key in keys.txt
+    loadTrustedKeys();
+    string ownKey = getPublicKey();
+    bool known = false;
+    for (unsigned int i = 0; i < trustedKeys.size(); i++)
+    {
+        known = known || trustedKeys.at(i) == publicKey;
+    }
+    if (!known)
+    {
+        ofstream file(keysPath, ios::app);
+        file << ownKey << endl;
+        trustedKeys.push_back(publicKey);
+    }
+}
+
+int SoftwareProofProvider::addProof(string merkle, string prev, double *luckyNumber, string *cert)
+{
+    return addProof(merkle, prev, luckyNumber, cert, nullptr);
+}
+
+/**
+ * @brief SoftwareProofProvider::addProof
+ * draws the lucky number, waits and signs the header.
+ * the waiting period ends early, if the request is cancelled
+ * @param merkle hash of the merkle tree
+ * @param prev hash of the previous block
+ * @param luckyNumber returns the lucky number
+ * @param cert returns the signature in base64
+ * @param cancel token to cancel the request, may be empty
+ * @return 0 if successful, -1 if cancelled
+ */
+int SoftwareProofProvider::addProof(string merkle, string prev, double *luckyNumber, string *cert, const shared_ptr<ProofCancel> &cancel)
+{
+    ProofTiming timing = ProofTiming();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    providerMutex.lock();
+    *luckyNumber = (double) random() / UINT64_MAX;
+    providerMutex.unlock();
+    timing.random = elapsedMicroseconds(start);
+
+    start = chrono::steady_clock::now();
+    int waitingPeriod = round(maxWaitingTime - *luckyNumber * maxWaitingTime);
+    if (cancel && cancel->waitFor(chrono::milliseconds(max(waitingPeriod, 0))))
+    {
+        return -1;
+    }
+    else if (!cancel && waitingPeriod > 0)
+    {
+        this_thread::sleep_for(chrono::milliseconds(waitingPeriod));
+    }
+    timing.wait = elapsedMicroseconds(start);
+
+    start = chrono::steady_clock::now();
+    ProofHeader header;
+    fillHeader(header, merkle, prev, *luckyNumber);
+    unsigned char hash[crypto_hash_sha256_BYTES];
+    unsigned char signature[crypto_sign_BYTES];
+    crypto_hash_sha256(hash, (const unsigned char*)&header, sizeof(ProofHeader));
+    crypto_sign_detached(signature, NULL, hash, sizeof(hash), secretKey.data());
+    *cert = base64_encode(signature, crypto_sign_BYTES);
+    timing.sign = elapsedMicroseconds(start);
+
+    lock_guard<mutex> lock(providerMutex);
+    lastTiming = timing;
+    return 0;
+}
+
+/**
+ * @brief SoftwareProofProvider::verifyProof
+ * checks the signature against all trusted keys.
+ * the key file is read again, if no key matches
+ * @return true if a trusted key signed the header
+ */
+bool SoftwareProofProvider::verifyProof(string merkle, string prevBlock, double luckyNumber, string certificate)
+{
+    vector<unsigned char> signature = base64_decode(certificate);
+    if (signature.size() < crypto_sign_BYTES)
+    {
+        return false;
+    }
+    ProofHeader header;
+    fillHeader(header, merkle, prevBlock, luckyNumber);
+    unsigned char hash[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256(hash, (const unsigned char*)&header, sizeof(ProofHeader));
+
+    lock_guard<mutex> lock(providerMutex);
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        for (unsigned int i = 0; i < trustedKeys.size(); i++)
+        {
+            if (crypto_sign_verify_detached(signature.data(), hash, sizeof(hash), trustedKeys.at(i).data()) == 0)
+            {
+                return true;
+            }
+        }
+        if (attempt == 0 && !loadTrustedKeys())
+        {
+            break;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief SoftwareProofProvider::getTiming
+ * the emulator has no session, sealed keys or counter,
+ * only the random number, waiting and signing phases are measured
+ */
+bool SoftwareProofProvider::getTiming(ProofTiming &timing)
+{
+    lock_guard<mutex> lock(providerMutex);
+    timing = lastTiming;
+    return true;
+}
+
+string SoftwareProofProvider::getName() const
+{
+    return "software";
+}
+
+/**
+ * @brief SoftwareProofProvider::getPublicKey
+ * @return the public key in base64 format
+ */
+string SoftwareProofProvider::getPublicKey() const
+{
+    return base64_encode(publicKey.data(), publicKey.size());
+}
+
+/**
+ * @brief SoftwareProofProvider::addTrustedKey
+ * trusts the proofs of another node without writing the key file
+ * @param key public key in base64 format
+ */
+void SoftwareProofProvider::addTrustedKey(const string &key)
+{
+    vector<unsigned char> decoded = base64_decode(key);
+    if (decoded.size() < crypto_sign_PUBLICKEYBYTES)
+    {
+        return;
+    }
+    decoded.resize(crypto_sign_PUBLICKEYBYTES);
+    lock_guard<mutex> lock(providerMutex);
+    trustedKeys.push_back(decoded);
+}
+
+void SoftwareProofProvider::fillHeader(ProofHeader &header, const string &merkle, const string &prev, double luckyNumber)
+{
+    memset(&header, 0, sizeof(ProofHeader));
+    memcpy(header.merkleTree, merkle.c_str(), min(merkle.size(), sizeof(header.merkleTree)));
+    memcpy(header.prevBlock, prev.c_str(), min(prev.size(), sizeof(header.prevBlock)));
+    header.luckyNumber = luckyNumber;
+}
+
+/**
+ * @brief SoftwareProofProvider::loadTrustedKeys
+ * reads the keys file, one base64 key per line
+ * @return false if the file can not be read
+ */
+bool SoftwareProofProvider::loadTrustedKeys()
+{
+    ifstream file(keysPath);
+    if (!file.good())
+    {
+        return false;
+    }
+    string line;
+    while (getline(file, line))
+    {
+        vector<unsigned char> decoded = base64_decode(line);
+        if (decoded.size() < crypto_sign_PUBLICKEYBYTES)
+        {
+            continue;
+        }
+        decoded.resize(crypto_sign_PUBLICKEYBYTES);
+        bool known = false;
+        for (unsigned int i = 0; i < trustedKeys.size(); i++)
+        {
+            known = known || trustedKeys.at(i) == decoded;
+        }
+        if (!known)
+        {
+            trustedKeys.push_back(decoded);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,133 @@
+#ifndef PROOFPROVIDER_H
+#define PROOFPROVIDER_H
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <cstdint>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+#include "../config.h"
+
+using namespace std;
+
+const string SOFTWARE_KEYS_PATH = "softwareKeys.txt";
+
+/**
+ * data, that is signed for a proof of luck.
+ * same layout as blockHeader of the enclave
+ */
+struct ProofHeader {
+    uint8_t prevBlock[40]; //hash size 20byte / 40 chars in hex
+    uint8_t merkleTree[40];
+    double luckyNumber;
+};
+
+/**
+ * cancels a running proof request, e.g. when its previous block is not the tip anymore
+ */
+class ProofCancel
+{
+public:
+    ProofCancel();
+    void cancel();
+    bool isCancelled();
+    bool waitFor(chrono::milliseconds duration);
+
+private:
+    mutex cancelMutex;
+    condition_variable cancelled;
+    bool isSet;
+};
+
+/**
+ * duration of the phases of the last proof in microseconds
+ */
+struct ProofTiming {
+    uint64_t session;
+    uint64_t unseal;
+    uint64_t counter;
+    uint64_t random;
+    uint64_t wait;
+    uint64_t sign;
+};
+
+struct ProofResult {
+    bool valid;         //false if the request failed or was cancelled
+    bool cancelled;
+    double luckyNumber;
+    string certificate;
+};
+
+/**
+ * creates and verifies the lucky number of a block.
+ * the provider is chosen once with the config key proof_provider
+ */
+class ProofProvider
+{
+public:
+    virtual ~ProofProvider() {}
+    virtual int addProof(string merkle, string prev, double *luckyNumber, string *cert) = 0;
+    virtual int addProof(string merkle, string prev, double *luckyNumber, string *cert, const shared_ptr<ProofCancel> &cancel);
+    virtual bool verifyProof(string merkle, string prevBlock, double luckyNumber, string certificate) = 0;
+    virtual string getName() const = 0;
+    virtual bool getTiming(ProofTiming &timing) = 0;
+    future<ProofResult> addProofAsync(string merkle, string prev, const shared_ptr<ProofCancel> &cancel,
+                                      function<void(const ProofResult&)> callback = nullptr);
+    static ProofProvider& instance();
+};
+
+#ifdef WITH_SGX
+/**
+ * proof of luck of the SGX enclave in libapp
+ */
+class SgxProofProvider : public ProofProvider
+{
+public:
+    int addProof(string merkle, string prev, double *luckyNumber, string *cert) override;
+    bool verifyProof(string merkle, string prevBlock, double luckyNumber, string certificate) override;
+    string getName() const override;
+    bool getTiming(ProofTiming &timing) override;
+
+private:
+    mutex enclaveMutex;     //an abandoned request has to finish before the next one starts
+};
+#endif
+
+/**
+ * emulates the enclave without SGX hardware.
+ * the lucky numbers come from a seeded random generator and are signed
+ * with a key derived from the seed, so runs can be repeated.
+ * the waiting period is linear to the lucky number like in the enclave
+ * and can be shortened, switched off or cancelled
+ */
+class SoftwareProofProvider : public ProofProvider
+{
+public:
+    SoftwareProofProvider(uint64_t seed, int maxWaitingTime, const string &keysPath = SOFTWARE_KEYS_PATH);
+    int addProof(string merkle, string prev, double *luckyNumber, string *cert) override;
+    int addProof(string merkle, string prev, double *luckyNumber, string *cert, const shared_ptr<ProofCancel> &cancel) override;
+    bool verifyProof(string merkle, string prevBlock, double luckyNumber, string certificate) override;
+    string getName() const override;
+    bool getTiming(ProofTiming &timing) override;
+    string getPublicKey() const;
+    void addTrustedKey(const string &publicKey);
+
+private:
+    void fillHeader(ProofHeader &header, const string &merkle, const string &prev, double luckyNumber);
+    bool loadTrustedKeys();
+    vector<unsigned char> publicKey;
+    vector<unsigned char> secretKey;
+    vector<vector<unsigned char> > trustedKeys;
+    string keysPath;
+    mt19937_64 random;
+    int maxWaitingTime;     //in milliseconds, 0 for no waiting period
+    ProofTiming lastTiming;
+    mutex providerMutex;
+};
+
+#endif // PROOFPROVIDER_H
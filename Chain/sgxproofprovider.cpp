@@ -0,0 +1,40 @@
+#include "proofprovider.hpp"
+#include "../Enclave/App.h"
+
+int SgxProofProvider::addProof(string merkle, string prev, double *luckyNumber, string *cert)
+{
+    lock_guard<mutex> lock(enclaveMutex);
+    return ::addProof(merkle, prev, luckyNumber, cert);
+}
+
+bool SgxProofProvider::verifyProof(string merkle, string prevBlock, double luckyNumber, string certificate)
+{
+    return ::verifyProof(merkle, prevBlock, luckyNumber, certificate);
+}
+
+/**
+ * @brief SgxProofProvider::getTiming
+ * the enclave measures the session, unsealing, counter, random number,
+ * waiting and signing phases of the last proof
+ * @return false if there was no proof yet
+ */
+bool SgxProofProvider::getTiming(ProofTiming &timing)
+{
+    proofTiming enclaveTiming;
+    if (!getProofTiming(&enclaveTiming))
+    {
+        return false;
+    }
+    timing.session = enclaveTiming.session;
+    timing.unseal = enclaveTiming.unseal;
+    timing.counter = enclaveTiming.counter;
+    timing.random = enclaveTiming.random;
+    timing.wait = enclaveTiming.wait;
+    timing.sign = enclaveTiming.sign;
+    return true;
+}
+
+string SgxProofProvider::getName() const
+{
+    return "SGX";
+}
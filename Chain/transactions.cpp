@@ -27,7 +27,7 @@ Transaction::Transaction(string sender, string receiver, int value, string hash,
  */
 void Transaction::setMinerTransaction(string key, const int MINER_REWARD)
 {
-    time_t now = time(NULL);
+    time_t now = Clock::instance().now();
     SHA1 transHash;
     transHash.update(to_string(now));
     transHash.update(key);
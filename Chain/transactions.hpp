@@ -6,6 +6,7 @@
 #include <stddef.h>
 #include <iostream>
 #include "../sodiumpp/crypt.h"
+#include "../clock.h"
 using namespace std;
 
 class Transaction {
@@ -0,0 +1,104 @@
+#include "daemon.h"
+#include <QCoreApplication>
+#include <sys/socket.h>
+#include <signal.h>
+#include <unistd.h>
+
+int Daemon::signalSockets[2];
+
+Daemon::Daemon(bool interactive, QObject *parent)
+    :QObject(parent), keyboard(nullptr), stopping(false)
+{
+    consoleHandler = new ConsoleHandler();
+    signalNotifier = new QSocketNotifier(signalSockets[1], QSocketNotifier::Read, this);
+    connect(signalNotifier, SIGNAL(activated(int)), this, SLOT(handleSignal()));
+    if (interactive)
+    {
+        keyboard = new Console();
+        connect(keyboard, SIGNAL(KeyPressed(char)), consoleHandler, SLOT(OnKeyPressed(char)));
+        keyboard->start();
+    }
+}
+
+Daemon::~Daemon()
+{
+    //the keyboard thread waits in getchar and ends with the process
+    delete consoleHandler;
+}
+
+/**
+ * @brief Daemon::installSignalHandlers
+ * creates the socket pair and installs the handler for SIGINT and SIGTERM.
+ * has to be called before the daemon is created
+ * @return false if the socket pair or a handler could not be created
+ */
+bool Daemon::installSignalHandlers()
+{
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, signalSockets) != 0)
+    {
+        cout << "could not create the signal sockets" << endl;
+        return false;
+    }
+    struct sigaction action;
+    action.sa_handler = Daemon::signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGINT, &action, 0) != 0 || sigaction(SIGTERM, &action, 0) != 0)
+    {
+        cout << "could not install the signal handlers" << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Daemon::start
+ * starts the miner and the load generator, if the config asks for them
+ */
+void Daemon::start()
+{
+    Client &client = consoleHandler->client;
+    cout << "node started without gui, public key " << getPublicBkey() << endl;
+    if (Config::instance().getBool("daemon_mine", false))
+    {
+        client.startMiningThread();
+    }
+    if (Config::instance().getBool("daemon_load", false))
+    {
+        client.startLoadGenerator();
+    }
+}
+
+/**
+ * @brief Daemon::signalHandler
+ * only writes to the socket, everything else is done on the event loop
+ */
+void Daemon::signalHandler(int)
+{
+    char signal = 1;
+    ssize_t written = ::write(signalSockets[0], &signal, sizeof(signal));
+    (void) written;
+}
+
+/**
+ * @brief Daemon::handleSignal
+ * shuts the node down and leaves the event loop
+ */
+void Daemon::handleSignal()
+{
+    signalNotifier->setEnabled(false);
+    char signal;
+    ssize_t received = ::read(signalSockets[1], &signal, sizeof(signal));
+    (void) received;
+    if (!stopping)
+    {
+        stopping = true;
+        cout << "shutting down, writing the pending blocks" << endl;
+        if (!consoleHandler->client.shutdown())
+        {
+            cout << "the database was not closed cleanly" << endl;
+        }
+        QCoreApplication::quit();
+    }
+    signalNotifier->setEnabled(true);
+}
@@ -0,0 +1,40 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <QObject>
+#include <QSocketNotifier>
+#include "../Interface/consolehandler.h"
+#include "../Interface/console.h"
+
+/**
+ * runs the node without the gui on a QCoreApplication.
+ * SIGINT and SIGTERM are written to a socket pair by the signal handler
+ * and handled on the event loop, where the miner is stopped and the
+ * pending blocks are written before the database is closed.
+ * the console commands are read from stdin, if it is a terminal.
+ * config keys: daemon_mine and daemon_load start the miner and the
+ * load generator after the start
+ */
+class Daemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    Daemon(bool interactive, QObject *parent = 0);
+    ~Daemon();
+    static bool installSignalHandlers();
+    void start();
+
+private slots:
+    void handleSignal();
+
+private:
+    static void signalHandler(int signal);
+    static int signalSockets[2];
+    ConsoleHandler *consoleHandler;
+    Console *keyboard;
+    QSocketNotifier *signalNotifier;
+    bool stopping;
+};
+
+#endif // DAEMON_H
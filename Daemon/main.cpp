@@ -0,0 +1,63 @@
+#include "daemon.h"
+#include <QCoreApplication>
+#include <unistd.h>
+
+static void printUsage()
+{
+    cout << "usage: IBR_COIN_daemon [--config file] [--set key=value] [--mine] [--load]" << endl
+         << "    --config reads another config file after " << CONFIG_PATH << endl
+         << "    --set overrides a config value, the options are applied in order" << endl
+         << "    --mine and --load are the same as --set daemon_mine=1 and --set daemon_load=1" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    Config &config = Config::instance();
+
+    for (int i = 1; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option == "--mine")
+        {
+            config.set("daemon_mine", "1");
+            continue;
+        }
+        if (option == "--load")
+        {
+            config.set("daemon_load", "1");
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            printUsage();
+            return 1;
+        }
+        string value = argv[++i];
+        if (option == "--config")
+        {
+            if (!config.load(value))
+            {
+                cout << "could not read the config file " << value << endl;
+                return 1;
+            }
+        }
+        else if (option == "--set" && value.find('=') != string::npos)
+        {
+            config.set(value.substr(0, value.find('=')), value.substr(value.find('=') + 1));
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (!Daemon::installSignalHandlers())
+    {
+        return 1;
+    }
+    Daemon daemon(isatty(STDIN_FILENO));
+    daemon.start();
+    return app.exec();
+}
@@ -0,0 +1,230 @@
+#include "balanceindex.hpp"
+
+BalanceIndex::BalanceIndex()
+{
+
+}
+
+void BalanceIndex::clear()
+{
+    lock_guard<mutex> lock(indexMutex);
+    entries.clear();
+    addressesByHeight.clear();
+}
+
+/**
+ * @brief BalanceIndex::replaceBlocks
+ * sets the balance changes of blocks, that were appended
+ * to the main chain or replaced blocks of it
+ * @param blocks new blocks of the main chain
+ */
+void BalanceIndex::replaceBlocks(const vector<Block> &blocks)
+{
+    map<int, map<string, int> > deltas;
+    for (unsigned int b = 0; b < blocks.size(); b++)
+    {
+        map<string, int> &blockDeltas = deltas[blocks.at(b).getIndex()];
+        vector<Transaction> transactions = blocks.at(b).getTransaction();
+        for (unsigned int t = 0; t < transactions.size(); t++)
+        {
+            Transaction &transaction = transactions.at(t);
+            //change goes back to the sender and does not count
+            if (transaction.getSender().compare(transaction.getRecipient()) == 0)
+            {
+                continue;
+            }
+            blockDeltas[transaction.getRecipient()] += transaction.getValue();
+            if (!transaction.getSender().empty())
+            {
+                blockDeltas[transaction.getSender()] -= transaction.getValue();
+            }
+        }
+    }
+    replaceHeights(deltas);
+}
+
+/**
+ * @brief BalanceIndex::replaceHeights
+ * replaces the balance changes at the given heights.
+ * the balances after the first replaced height are calculated again
+ * @param deltas balance change per address for each height
+ */
+void BalanceIndex::replaceHeights(const map<int, map<string, int> > &deltas)
+{
+    if (deltas.empty())
+    {
+        return;
+    }
+    lock_guard<mutex> lock(indexMutex);
+    int firstHeight = deltas.begin()->first;
+    //only the addresses with a change at the first replaced height or later are touched
+    set<string> affected;
+    for (map<int, map<string, int> >::const_iterator height = deltas.begin(); height != deltas.end(); height++)
+    {
+        for (map<string, int>::const_iterator delta = height->second.begin(); delta != height->second.end(); delta++)
+        {
+            affected.insert(delta->first);
+        }
+    }
+    for (map<int, set<string> >::iterator height = addressesByHeight.lower_bound(firstHeight); height != addressesByHeight.end(); height++)
+    {
+        affected.insert(height->second.begin(), height->second.end());
+    }
+
+    for (set<string>::iterator address = affected.begin(); address != affected.end(); address++)
+    {
+        vector<Entry> &history = entries[*address];
+        vector<Entry>::iterator start = lower_bound(history.begin(), history.end(), firstHeight,
+                                                    [](const Entry &entry, int height) { return entry.height < height; });
+        //the heights, that are not replaced, are kept
+        vector<pair<int, int> > changes;
+        for (vector<Entry>::iterator entry = start; entry != history.end(); entry++)
+        {
+            if (deltas.find(entry->height) == deltas.end())
+            {
+                changes.push_back(make_pair(entry->height, entry->delta));
+            }
+            unlink(*address, entry->height);
+        }
+        for (map<int, map<string, int> >::const_iterator height = deltas.begin(); height != deltas.end(); height++)
+        {
+            map<string, int>::const_iterator delta = height->second.find(*address);
+            if (delta != height->second.end() && delta->second != 0)
+            {
+                changes.push_back(make_pair(height->first, delta->second));
+            }
+        }
+        sort(changes.begin(), changes.end());
+
+        history.erase(start, history.end());
+        int balance = history.empty() ? 0 : history.back().balance;
+        for (unsigned int i = 0; i < changes.size(); i++)
+        {
+            balance += changes.at(i).second;
+            Entry entry = { changes.at(i).first, changes.at(i).second, balance };
+            history.push_back(entry);
+            addressesByHeight[entry.height].insert(*address);
+        }
+
+        if (history.empty())
+        {
+            entries.erase(*address);
+        }
+    }
+}
+
+/**
+ * @brief BalanceIndex::truncate
+ * removes the balance changes of the height and all later heights
+ * @param height first height to remove
+ */
+void BalanceIndex::truncate(int height)
+{
+    lock_guard<mutex> lock(indexMutex);
+    set<string> affected;
+    for (map<int, set<string> >::iterator changed = addressesByHeight.lower_bound(height); changed != addressesByHeight.end(); )
+    {
+        affected.insert(changed->second.begin(), changed->second.end());
+        changed = addressesByHeight.erase(changed);
+    }
+    for (set<string>::iterator address = affected.begin(); address != affected.end(); address++)
+    {
+        vector<Entry> &history = entries[*address];
+        while (!history.empty() && history.back().height >= height)
+        {
+            history.pop_back();
+        }
+        if (history.empty())
+        {
+            entries.erase(*address);
+        }
+    }
+}
+
+/**
+ * @brief BalanceIndex::collapse
+ * merges all balance changes up to a height into one.
+ * used after pruning, the history below it is not needed anymore
+ * @param height up to which the changes are merged
+ */
+void BalanceIndex::collapse(int height)
+{
+    lock_guard<mutex> lock(indexMutex);
+    set<string> affected;
+    for (map<int, set<string> >::iterator changed = addressesByHeight.begin();
+         changed != addressesByHeight.end() && changed->first <= height; changed++)
+    {
+        affected.insert(changed->second.begin(), changed->second.end());
+    }
+    for (set<string>::iterator address = affected.begin(); address != affected.end(); address++)
+    {
+        vector<Entry> &history = entries[*address];
+        vector<Entry>::iterator end = upper_bound(history.begin(), history.end(), height,
+                                                  [](int height, const Entry &entry) { return height < entry.height; });
+        if (end - history.begin() <= 1)
+        {
+            continue;
+        }
+        Entry merged = { height, (end - 1)->balance, (end - 1)->balance };
+        for (vector<Entry>::iterator entry = history.begin(); entry != end; entry++)
+        {
+            unlink(*address, entry->height);
+        }
+        history.erase(history.begin(), end);
+        history.insert(history.begin(), merged);
+        addressesByHeight[height].insert(*address);
+    }
+}
+
+void BalanceIndex::unlink(const string &address, int height)
+{
+    map<int, set<string> >::iterator changed = addressesByHeight.find(height);
+    if (changed == addressesByHeight.end())
+    {
+        return;
+    }
+    changed->second.erase(address);
+    if (changed->second.empty())
+    {
+        addressesByHeight.erase(changed);
+    }
+}
+
+/**
+ * @brief BalanceIndex::getBalance
+ * @param address public key
+ * @param height of the block
+ * @return balance of the address after the block
+ */
+int BalanceIndex::getBalance(const string &address, int height)
+{
+    lock_guard<mutex> lock(indexMutex);
+    unordered_map<string, vector<Entry> >::iterator history = entries.find(address);
+    if (history == entries.end())
+    {
+        return 0;
+    }
+    vector<Entry>::iterator next = upper_bound(history->second.begin(), history->second.end(), height,
+                                               [](int height, const Entry &entry) { return height < entry.height; });
+    if (next == history->second.begin())
+    {
+        return 0;
+    }
+    return (next - 1)->balance;
+}
+
+/**
+ * @brief BalanceIndex::getBalance
+ * @param address public key
+ * @return balance of the address at the latest block
+ */
+int BalanceIndex::getBalance(const string &address)
+{
+    lock_guard<mutex> lock(indexMutex);
+    unordered_map<string, vector<Entry> >::iterator history = entries.find(address);
+    if (history == entries.end())
+    {
+        return 0;
+    }
+    return history->second.back().balance;
+}
@@ -0,0 +1,46 @@
+#ifndef BALANCEINDEX_H
+#define BALANCEINDEX_H
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include "../Chain/block.hpp"
+
+using namespace std;
+
+/**
+ * balance history of every address on the main chain.
+ * per address the heights, at which the balance changed, are stored
+ * in ascending order together with the balance after that height.
+ * the balance at a height is a binary search, the current balance
+ * is the last entry. the addresses are also kept by height, so a
+ * replaced block only touches the addresses with later changes
+ */
+class BalanceIndex
+{
+public:
+    BalanceIndex();
+    void clear();
+    void replaceBlocks(const vector<Block> &blocks);
+    void replaceHeights(const map<int, map<string, int> > &deltas);
+    void truncate(int height);
+    void collapse(int height);
+    int getBalance(const string &address, int height);
+    int getBalance(const string &address);
+
+private:
+    struct Entry {
+        int height;
+        int delta;
+        int balance;
+    };
+    void unlink(const string &address, int height);
+    unordered_map<string, vector<Entry> > entries;
+    map<int, set<string> > addressesByHeight;     //addresses with a change at the height
+    mutex indexMutex;
+};
+
+#endif // BALANCEINDEX_H
@@ -0,0 +1,134 @@
+#include "blockwriter.hpp"
+
+static const int RETRY_DELAY_MS = 100;          //after a failed batch, doubled up to the max
+static const int MAX_RETRY_DELAY_MS = 5000;
+
+/**
+ * @brief BlockWriter::BlockWriter
+ * starts the persistence worker.
+ * the worker takes everything that is queued at once
+ * and hands it to the commit function as one batch
+ * @param commit function, that writes a batch durable to the disk
+ * @param capacity max number of queued forks. push blocks if it is reached
+ */
+BlockWriter::BlockWriter(const function<bool(vector<PendingFork>&)> &commit, unsigned int capacity)
+    :commit(commit), capacity(capacity), busy(false), failed(false), running(true)
+{
+    worker = thread(&BlockWriter::run, this);
+}
+
+BlockWriter::~BlockWriter()
+{
+    stop();
+}
+
+/**
+ * @brief BlockWriter::push
+ * queues a fork for writing. if the queue is full
+ * the caller waits until the worker took the queued forks
+ * @param fork to be written
+ */
+void BlockWriter::push(const PendingFork &fork)
+{
+    unique_lock<mutex> lock(queueMutex);
+    notFull.wait(lock, [this] { return queue.size() < capacity || !running; });
+    if (!running)
+    {
+        cout << "block writer already stopped, fork " << fork.forkID << " is not written" << endl;
+        return;
+    }
+    queue.push_back(fork);
+    notEmpty.notify_one();
+}
+
+/**
+ * @brief BlockWriter::flush
+ * barrier. returns after every fork, that was queued
+ * before the call, is written to the disk or a write failed
+ * @return false if forks are not written yet
+ */
+bool BlockWriter::flush()
+{
+    unique_lock<mutex> lock(queueMutex);
+    drained.wait(lock, [this] { return (queue.empty() && !busy) || failed || !running; });
+    return queue.empty() && !busy;
+}
+
+/**
+ * @brief BlockWriter::stop
+ * writes the remaining forks and stops the worker.
+ * forks, that can not be written, stay in the queue
+ */
+void BlockWriter::stop()
+{
+    queueMutex.lock();
+    running = false;
+    queueMutex.unlock();
+    notEmpty.notify_all();
+    notFull.notify_all();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+    drained.notify_all();
+}
+
+bool BlockWriter::isIdle()
+{
+    lock_guard<mutex> lock(queueMutex);
+    return queue.empty() && !busy;
+}
+
+/**
+ * @brief BlockWriter::run
+ * writes the queued forks. a failed batch goes back to the front of the queue,
+ * before the later forks, which may replace its blocks, and is tried again after a delay
+ */
+void BlockWriter::run()
+{
+    vector<PendingFork> batch;
+    int retryDelay = RETRY_DELAY_MS;
+    while (true)
+    {
+        unique_lock<mutex> lock(queueMutex);
+        notEmpty.wait(lock, [this] { return !queue.empty() || !running; });
+        if (queue.empty())
+        {
+            //only reached if stopped and everything is written
+            break;
+        }
+        batch.assign(queue.begin(), queue.end());
+        queue.clear();
+        busy = true;
+        notFull.notify_all();
+        lock.unlock();
+
+        bool written = commit(batch);
+
+        lock.lock();
+        busy = false;
+        if (written)
+        {
+            failed = false;
+            retryDelay = RETRY_DELAY_MS;
+            if (queue.empty())
+            {
+                drained.notify_all();
+            }
+            batch.clear();
+            continue;
+        }
+        queue.insert(queue.begin(), batch.begin(), batch.end());
+        failed = true;
+        drained.notify_all();
+        if (!running)
+        {
+            cout << "writing " << batch.size() << " forks failed, they are not written" << endl;
+            break;
+        }
+        cout << "writing " << batch.size() << " forks failed, retrying in " << retryDelay << " ms" << endl;
+        batch.clear();
+        notEmpty.wait_for(lock, chrono::milliseconds(retryDelay), [this] { return !running; });
+        retryDelay = min(retryDelay * 2, MAX_RETRY_DELAY_MS);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef BLOCKWRITER_H
+#define BLOCKWRITER_H
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include "../Chain/block.hpp"
+
+using namespace std;
+
+/**
+ * a validated fork, that has to be written into the main chain
+ */
+struct PendingFork {
+    int forkID;
+    vector<Block> blocks;
+};
+
+class BlockWriter
+{
+public:
+    BlockWriter(const function<bool(vector<PendingFork>&)> &commit, unsigned int capacity = 16);
+    ~BlockWriter();
+    void push(const PendingFork &fork);
+    bool flush();
+    void stop();
+    bool isIdle();
+
+private:
+    void run();
+    function<bool(vector<PendingFork>&)> commit;
+    unsigned int capacity;
+    deque<PendingFork> queue;
+    mutex queueMutex;
+    condition_variable notEmpty;
+    condition_variable notFull;
+    condition_variable drained;
+    bool busy;
+    bool failed;        //the last batch was not written, it is retried
+    bool running;
+    thread worker;
+};
+
+#endif // BLOCKWRITER_H
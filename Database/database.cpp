@@ -1,6 +1,46 @@
 #include "database.hpp"
+#include "../config.h"
 #include <clocale>
-#define DATABASE "database.db"
+#include <cctype>
+#include <chrono>
+
+/**
+ * @brief sqlSeconds
+ * the time in sqlite per exec, prepare and step call by the type of the statement
+ * @param sql the statement
+ */
+static Histogram& sqlSeconds(const char *sql)
+{
+    static Histogram *histograms[] = {
+        &Metrics::instance().histogram("poluck_sql_seconds", "time in sqlite per call", Metrics::secondBuckets(), "type=\"select\""),
+        &Metrics::instance().histogram("poluck_sql_seconds", "time in sqlite per call", Metrics::secondBuckets(), "type=\"insert\""),
+        &Metrics::instance().histogram("poluck_sql_seconds", "time in sqlite per call", Metrics::secondBuckets(), "type=\"update\""),
+        &Metrics::instance().histogram("poluck_sql_seconds", "time in sqlite per call", Metrics::secondBuckets(), "type=\"delete\""),
+        &Metrics::instance().histogram("poluck_sql_seconds", "time in sqlite per call", Metrics::secondBuckets(), "type=\"other\"")
+    };
+    while (sql && isspace(*sql))
+    {
+        sql++;
+    }
+    switch (sql ? toupper(*sql) : 0)
+    {
+    case 'S':
+        return *histograms[0];
+    case 'I':
+        return *histograms[1];
+    case 'U':
+        return *histograms[2];
+    case 'D':
+        return *histograms[3];
+    default:
+        return *histograms[4];
+    }
+}
+
+static double secondsSince(chrono::steady_clock::time_point started)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - started).count();
+}
 
 /**
  * @brief Database::Database()
@@ -8,16 +48,25 @@
  */
 
 Database::Database()
+    :path(DATABASE_PATH), baseHeight(0), pruneKeep(0)
 {
     openDb();
     initializeTables();
+    loadBase();
+    loadBalanceIndex();
+    loadTxIndex();
+    writer.reset(new BlockWriter([this](vector<PendingFork>& batch) { return commitForks(batch); }));
 }
 
-Database::Database(const shared_ptr<recursive_mutex> &sharedMutex, const shared_ptr<int> &queries)
-    :dbMutex(sharedMutex), activeQuerys(queries)
+Database::Database(const shared_ptr<recursive_mutex> &sharedMutex, const shared_ptr<int> &queries, const string &path)
+    :path(path), dbMutex(sharedMutex), activeQuerys(queries), baseHeight(0), pruneKeep(0)
 {
     openDb();
     initializeTables();
+    loadBase();
+    loadBalanceIndex();
+    loadTxIndex();
+    writer.reset(new BlockWriter([this](vector<PendingFork>& batch) { return commitForks(batch); }));
 }
 
 /**
@@ -28,6 +77,7 @@ Database::Database(const shared_ptr<recursive_mutex> &sharedMutex, const shared_
  */
 bool Database::blockchainInitialized() 
 {
+    flush();
     bool isInitialized = false;
     sqlite3_stmt *result;
 
@@ -85,6 +135,8 @@ bool Database::appendBlock(Block block)
     {
         saveTransaction(block.getTransaction().at(i), to_string(block.getIndex()));
     }
+    balanceIndex.replaceBlocks(vector<Block>(1, block));
+    txIndex.replaceBlocks(vector<Block>(1, block));
 
     return true;
 }
@@ -148,6 +200,8 @@ bool Database::replaceBlock(Block block)
  */
 int Database::createFork()
 {
+    //the row id is read afterwards, the writer may not insert meanwhile
+    lock_guard<recursive_mutex> lock(*dbMutex);
     string sql = "INSERT INTO FORKS(ID) VALUES(NULL);";
 
     if(!executeSql(sql)) 
@@ -289,24 +343,190 @@ bool Database::applyFork(int forkId)
 
     finalizeQuery(&result);
 
+    //the blocks are visible from now on, the writer persists them in the background
+    pendingMutex.lock();
     for(unsigned int i = 0; i < fork.size(); i++)
-    {   
+    {
+        pendingBlocks[fork.at(i).getIndex()] = fork.at(i);
+    }
+    pendingMutex.unlock();
+    balanceIndex.replaceBlocks(fork);
+    txIndex.replaceBlocks(fork);
+
+    PendingFork pending;
+    pending.forkID = forkId;
+    pending.blocks = fork;
+    writer->push(pending);
+
+    return true;
+}
 
-        if(!replaceBlock(fork.at(i))) 
+/**
+ * @brief Database::commitForks
+ * called from the block writer. writes a batch of applied forks
+ * into the main chain within one sql transaction
+ * and removes them from the pending blocks afterwards.
+ * if a block can not be written, the transaction is rolled back
+ * and the blocks stay pending for the next try of the writer
+ * @param batch forks to write
+ * @return true if successful
+ */
+bool Database::commitForks(vector<PendingFork>& batch)
+{
+    bool successful = true;
+    dbMutex->lock();
+    if (!executeSql("BEGIN TRANSACTION;"))
+    {
+        dbMutex->unlock();
+        return false;
+    }
+    for (unsigned int f = 0; f < batch.size() && successful; f++)
+    {
+        for (unsigned int i = 0; i < batch.at(f).blocks.size() && successful; i++)
         {
-            return false;
+            successful = replaceBlock(batch.at(f).blocks.at(i));
+            if (!successful)
+            {
+                cout << "couldn't write block " << batch.at(f).blocks.at(i).getIndex() << endl;
+            }
         }
     }
+    if (!successful || !executeSql("COMMIT;"))
+    {
+        cout << "writing the forks failed, their blocks stay pending" << endl;
+        executeSql("ROLLBACK;");
+        dbMutex->unlock();
+        return false;
+    }
+    //the batch is on the disk, the tables of its forks can go
+    for (unsigned int f = 0; f < batch.size(); f++)
+    {
+        writtenForks.push_back(batch.at(f).forkID);
+    }
+    dropWrittenForks();
 
+    //pruning runs here as well, the readers hold the dbMutex meanwhile
+    int pruneHeight = getLastBlockIndex(0) - pruneKeep;
+    if (pruneKeep > 0 && pruneHeight - baseHeight >= PRUNE_INTERVAL)
+    {
+        pruneChain(pruneHeight);
+    }
 
-    if(!deleteFork(forkId)) 
+    //a later fork might have replaced the block again, it stays pending then
+    pendingMutex.lock();
+    for (unsigned int f = 0; f < batch.size(); f++)
     {
-        return false;
+        for (unsigned int i = 0; i < batch.at(f).blocks.size(); i++)
+        {
+            Block &written = batch.at(f).blocks.at(i);
+            map<int, Block>::iterator pending = pendingBlocks.find(written.getIndex());
+            if (pending != pendingBlocks.end() && pending->second.getHash().compare(written.getHash()) == 0)
+            {
+                pendingBlocks.erase(pending);
+            }
+        }
+    }
+    pendingMutex.unlock();
+    dbMutex->unlock();
+    return true;
+}
+
+/**
+ * @brief Database::dropWrittenForks
+ * drops the tables of the forks, that were written into the main chain.
+ * sqlite refuses to drop a table, while a query of another thread steps through
+ * its rows, the tables are dropped with the next batch then.
+ * the dbMutex has to be locked
+ */
+void Database::dropWrittenForks()
+{
+    vector<int> remaining;
+    for (unsigned int i = 0; i < writtenForks.size(); i++)
+    {
+        string id = to_string(writtenForks.at(i));
+        string sql = "DROP TABLE IF EXISTS FORK" + id + ";"
+                    + "DROP TABLE IF EXISTS FORK" + id + "_TRANSACTIONS;"
+                    + "DROP TABLE IF EXISTS FORK" + id + "_INPUT;";
+        int rc = sqlite3_exec(db, sql.c_str(), NULL, 0, NULL);
+        if (rc == SQLITE_LOCKED)
+        {
+            remaining.push_back(writtenForks.at(i));
+        }
+        else if (rc != SQLITE_OK)
+        {
+            cout << "couldn't drop fork " << id << ": " << sqlite3_errmsg(db) << endl;
+        }
     }
+    writtenForks = remaining;
+}
+
+/**
+ * @brief Database::flush
+ * waits until all applied forks are written to the disk.
+ * the queries of the validation read the pending blocks instead,
+ * only the rare queries (export, printing, the wallet) call it first.
+ * must not be called while the dbMutex is held
+ * @return false if a write failed and blocks are still pending
+ */
+bool Database::flush()
+{
+    return writer->flush();
+}
 
+bool Database::getPendingBlock(int index, Block& block)
+{
+    lock_guard<mutex> lock(pendingMutex);
+    map<int, Block>::iterator pending = pendingBlocks.find(index);
+    if (pending == pendingBlocks.end())
+    {
+        return false;
+    }
+    block = pending->second;
     return true;
 }
 
+/**
+ * @brief Database::getPendingBlocks
+ * the caller holds the dbMutex, so that no pending block
+ * is written between this copy and its sql query
+ * @return copy of the applied, but not yet written blocks
+ */
+map<int, Block> Database::getPendingBlocks()
+{
+    lock_guard<mutex> lock(pendingMutex);
+    return pendingBlocks;
+}
+
+/**
+ * @brief Database::excludePending
+ * @param pending blocks from getPendingBlocks
+ * @param column with the block index
+ * @return condition, that skips the rows of the pending blocks on the disk
+ */
+string Database::excludePending(const map<int, Block>& pending, string column)
+{
+    if (pending.empty())
+    {
+        return "";
+    }
+    string sql = " AND CAST(" + column + " AS INT) NOT IN (";
+    for (map<int, Block>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+    {
+        sql += (it == pending.begin() ? "" : ",") + to_string(it->first);
+    }
+    return sql + ")";
+}
+
+int Database::getLastPendingBlockIndex()
+{
+    lock_guard<mutex> lock(pendingMutex);
+    if (pendingBlocks.empty())
+    {
+        return 0;
+    }
+    return pendingBlocks.rbegin()->first;
+}
+
 /**
  * @brief Blockchain::deleteFork
  * deletes a fork
@@ -326,87 +546,421 @@ bool Database::deleteFork(int forkId)
     return true;
 }
 
-double Database::getLNSum()
+/**
+ * @brief Database::getLNs
+ * @param forkID 0 for the main chain
+ * @return the lucky number of every block of the chain or the fork by its index
+ */
+map<int, double> Database::getLNs(int forkID)
 {
-    string sql = "SELECT LN FROM BLOCKCHAIN;";
+    lock_guard<recursive_mutex> lock(*dbMutex);
+    map<int, Block> pending;
+    string sql;
+    if (forkID != 0)
+    {
+        sql = "SELECT BLOCK_INDEX, LN FROM FORK" + to_string(forkID) + ";";
+    }
+    else
+    {
+        pending = getPendingBlocks();
+        sql = "SELECT BLOCK_INDEX, LN FROM BLOCKCHAIN WHERE 1" + excludePending(pending, "BLOCK_INDEX") + ";";
+    }
     sqlite3_stmt *result;
-    double ln, lnSum = 0.0;
+    map<int, double> lns;
+    double ln;
     vector<unsigned char> ln_copy;
 
     if(!executeQuery(sql, &result))
     {
-        return false;
+        return lns;
     }
 
     while (nextRow(result))
     {
-        ln_copy = base64_decode(getRow(result, 1).at(0));
+        vector<string> row = getRow(result, 2);
+        ln_copy = base64_decode(row.at(1));
         memcpy(&ln, ln_copy.data(), sizeof(double));
-        lnSum += ln;
+        lns[stoi(row.at(0))] = ln;
     }
     finalizeQuery(&result);
-    return lnSum;
+    for (map<int, Block>::iterator it = pending.begin(); it != pending.end(); ++it)
+    {
+        lns[it->first] = it->second.getLn();
+    }
+    return lns;
 }
 
 bool Database::cleanUpDBFromIndex(int index)
 {
-    string sql = "DELETE FROM BLOCKCHAIN WHERE CAST(BLOCK_INDEX AS INT) >=" + to_string(index) + ";"
+    flush();
+    string sql = "";
+    if (index <= baseHeight)
+    {
+        //the snapshot itself is invalid, only the genesis block can be kept
+        cout << "dropping the snapshot base at height " << baseHeight << endl;
+        index = 2;
+        baseHeight = 0;
+        sql = "DELETE FROM CHAIN_BASE; DELETE FROM BASE_BALANCE; DELETE FROM BASE_TRANSACTIONS;";
+    }
+    sql += "DELETE FROM BLOCKCHAIN WHERE CAST(BLOCK_INDEX AS INT) >=" + to_string(index) + ";"
                 + "DELETE FROM TRANSACTIONS WHERE CAST(BLOCK AS INT) >=" + to_string(index) + ";"
                 + "DELETE FROM INPUT WHERE CAST(BLOCK AS INT) >=" + to_string(index) + ";"
     ;
-    return executeSql(sql);
+    if (!executeSql(sql))
+    {
+        return false;
+    }
+    if (baseHeight == 0 && index == 2)
+    {
+        return loadBalanceIndex() && loadTxIndex();
+    }
+    balanceIndex.truncate(index);
+    txIndex.truncate(index);
+    return true;
 }
 
-bool Database::existsTransaction(string hash, int index, int forkID)
+/**
+ * @brief Database::exportSnapshot
+ * collects the chain state at a certain height:
+ * all block headers, the unspent outputs, the hashes of the spent
+ * transactions and the balance of every participant
+ * @param snapshot to be filled
+ * @param height of the snapshot. 0 for the latest block
+ * @return true if successful
+ */
+bool Database::exportSnapshot(Snapshot &snapshot, int height)
 {
-    string sql;
+    flush();
+    lock_guard<recursive_mutex> lock(*dbMutex);
     sqlite3_stmt *result;
-    if (forkID == 0)
+    vector<unsigned char> ln_copy;
+    int lastBlockIndex = getLastBlockIndex(0);
+    if (height <= 0 || height > lastBlockIndex)
     {
-        sql = string("select exists (select * from transactions where hash like '") + hash + "'" +
-                     " and cast(block as int) < " + to_string(index) + ");";
+        height = lastBlockIndex;
     }
-    else
+    if (height < baseHeight)
     {
-        sql = string("select exists (select * from transactions where hash like '") + hash + "'" +
-                     " and cast(block as int) < cast((select min(cast(block_index as int)) from fork" + to_string(forkID) + ") as int)" +
-                     " union select * from fork" + to_string(forkID) + "_transactions where hash like '" + hash + "'" +
-                     " and cast(block as int) <" + to_string(index) + ");";
+        cout << "the chain is only stored from height " << baseHeight << " on" << endl;
+        return false;
     }
-    if(!executeQuery(sql, &result))
+    string h = to_string(height);
+    snapshot = Snapshot();
+    snapshot.height = height;
+
+    string sql = "SELECT * FROM BLOCKCHAIN WHERE BLOCK_INDEX <= " + h + " ORDER BY BLOCK_INDEX;";
+    if (!executeQuery(sql, &result))
+    {
+        return false;
+    }
+    while (nextRow(result))
+    {
+        vector<string> row = getRow(result, 8);
+        double ln;
+        ln_copy = base64_decode(row.at(4));
+        memcpy(&ln, ln_copy.data(), sizeof(double));
+        Block block(row.at(2), row.at(1), row.at(3), stoi(row.at(5)), {}, stoi(row.at(0)));
+        block.setLn(ln);
+        block.setNumTrans(stoi(row.at(6)));
+        block.setCertificate(row.at(7));
+        snapshot.headers.push_back(block);
+    }
+    finalizeQuery(&result);
+
+    sql = string("SELECT t.BLOCK, t.HASH, t.SENDER, t.RECIPIENT, t.VALUE, t.NUM_OF_INPUTS, t.TIMESTAMP") +
+                 " FROM TRANSACTIONS AS t" +
+                 " WHERE CAST(t.BLOCK AS INT) <= " + h +
+                 " AND NOT EXISTS (SELECT i.HASH FROM INPUT AS i" +
+                 "      WHERE t.HASH LIKE i.HASH AND CAST(i.BLOCK AS INT) <= " + h + ");";
+    if (!executeQuery(sql, &result))
+    {
+        return false;
+    }
+    while (nextRow(result))
+    {
+        vector<string> row = getRow(result, 7);
+        SnapshotOutput output;
+        output.block = stoi(row.at(0));
+        output.transaction = Transaction(row.at(2), row.at(3), stoi(row.at(4)), row.at(1), stoi(row.at(6)));
+        output.transaction.setNumOfInputs(stoi(row.at(5)));
+        snapshot.outputs.push_back(output);
+    }
+    finalizeQuery(&result);
+
+    sql = string("SELECT t.HASH, t.VALUE FROM TRANSACTIONS AS t") +
+                 " WHERE CAST(t.BLOCK AS INT) <= " + h +
+                 " AND EXISTS (SELECT i.HASH FROM INPUT AS i" +
+                 "      WHERE t.HASH LIKE i.HASH AND CAST(i.BLOCK AS INT) <= " + h + ")" +
+                 " UNION SELECT HASH, VALUE FROM BASE_TRANSACTIONS;";
+    if (!executeQuery(sql, &result))
+    {
+        return false;
+    }
+    while (nextRow(result))
+    {
+        vector<string> row = getRow(result, 2);
+        SnapshotTransaction transaction;
+        transaction.hash = row.at(0);
+        transaction.value = stoi(row.at(1));
+        snapshot.spent.push_back(transaction);
+    }
+    finalizeQuery(&result);
+
+    //same calculation as getBalance, but for all participants at once
+    sql = string("with tr as (select sender, recipient, value from transactions") +
+                 "      where cast(block as int) <= " + h +
+                 "      and cast(block as int) > " + to_string(baseHeight) +
+                 "      and sender not like recipient)," +
+                 " addr as (select sender as address from transactions where cast(block as int) <= " + h +
+                 "      union select recipient from transactions where cast(block as int) <= " + h +
+                 "      union select address from base_balance)" +
+                 " select a.address," +
+                 "      coalesce((select sum(balance) from base_balance where address like a.address), 0)" +
+                 "      + coalesce((select sum(value) from tr where recipient like a.address), 0)" +
+                 "      - coalesce((select sum(value) from tr where sender like a.address), 0)" +
+                 " from addr as a where a.address not like '';";
+    if (!executeQuery(sql, &result))
+    {
+        return false;
+    }
+    while (nextRow(result))
+    {
+        vector<string> row = getRow(result, 2);
+        SnapshotBalance balance;
+        balance.address = row.at(0);
+        balance.balance = stoi(row.at(1));
+        snapshot.balances.push_back(balance);
+    }
+    finalizeQuery(&result);
+
+    return (int)snapshot.headers.size() == height;
+}
+
+/**
+ * @brief Database::importSnapshot
+ * replaces the stored chain with the state of a snapshot.
+ * the blocks up to the snapshot height are only stored as headers,
+ * the balances and spent transactions below it are kept in the base tables
+ * @param snapshot to be imported
+ * @return true if successful
+ */
+bool Database::importSnapshot(const Snapshot &snapshot)
+{
+    flush();
+    lock_guard<recursive_mutex> lock(*dbMutex);
+    if (!executeSql("BEGIN TRANSACTION;"))
+    {
+        return false;
+    }
+    bool successful = executeSql(string("DELETE FROM BLOCKCHAIN; DELETE FROM TRANSACTIONS; DELETE FROM INPUT;") +
+                                 " DELETE FROM CHAIN_BASE; DELETE FROM BASE_BALANCE; DELETE FROM BASE_TRANSACTIONS;");
+
+    for (unsigned int i = 0; i < snapshot.headers.size() && successful; i++)
+    {
+        successful = replaceBlock(snapshot.headers.at(i));
+    }
+    for (unsigned int i = 0; i < snapshot.outputs.size() && successful; i++)
+    {
+        successful = saveTransaction(snapshot.outputs.at(i).transaction, to_string(snapshot.outputs.at(i).block));
+    }
+    for (unsigned int i = 0; i < snapshot.spent.size() && successful; i++)
+    {
+        successful = executeSql("INSERT OR REPLACE INTO BASE_TRANSACTIONS(HASH, VALUE) VALUES ('"
+                                + snapshot.spent.at(i).hash + "'," + to_string(snapshot.spent.at(i).value) + ");");
+    }
+    for (unsigned int i = 0; i < snapshot.balances.size() && successful; i++)
+    {
+        successful = executeSql("INSERT OR REPLACE INTO BASE_BALANCE(ADDRESS, BALANCE) VALUES ('"
+                                + snapshot.balances.at(i).address + "'," + to_string(snapshot.balances.at(i).balance) + ");");
+    }
+    if (successful)
+    {
+        successful = executeSql("INSERT INTO CHAIN_BASE(HEIGHT, VERIFIED) VALUES (" + to_string(snapshot.height) + ", 0);");
+    }
+
+    if (!successful || !executeSql("COMMIT;"))
+    {
+        cout << "importing the snapshot failed, keeping the old chain" << endl;
+        executeSql("ROLLBACK;");
+        return false;
+    }
+    baseHeight = snapshot.height;
+    return loadBalanceIndex() && loadTxIndex();
+}
+
+/**
+ * @brief Database::getBaseHeight
+ * @return height of the imported snapshot, 0 if the chain is complete
+ */
+int Database::getBaseHeight()
+{
+    return baseHeight;
+}
+
+/**
+ * @brief Database::isBaseVerified
+ * @return true if the headers of the snapshot are verified or there is no snapshot
+ */
+bool Database::isBaseVerified()
+{
+    sqlite3_stmt *result;
+    bool verified = true;
+    if (!executeQuery("SELECT VERIFIED FROM CHAIN_BASE;", &result))
+    {
+        return false;
+    }
+    if (nextRow(result))
+    {
+        verified = stoi(getRow(result, 1).at(0)) != 0;
+    }
+    finalizeQuery(&result);
+    return verified;
+}
+
+bool Database::setBaseVerified()
+{
+    return executeSql("UPDATE CHAIN_BASE SET VERIFIED = 1;");
+}
+
+bool Database::loadBase()
+{
+    sqlite3_stmt *result;
+    baseHeight = 0;
+    if (!executeQuery("SELECT COALESCE(MAX(HEIGHT), 0) FROM CHAIN_BASE;", &result))
+    {
+        return false;
+    }
+    if (nextRow(result))
+    {
+        baseHeight = stoi(getRow(result, 1).at(0));
+    }
+    finalizeQuery(&result);
+    return true;
+}
+
+/**
+ * @brief Database::setPruning
+ * enables the pruned mode. only the transactions of the
+ * last blocks are kept, older blocks are folded into the base.
+ * switches the database to incremental vacuum, so the freed pages
+ * are given back to the file system
+ * @param keepBlocks number of blocks with transactions, 0 to disable pruning
+ * @return true if successful
+ */
+bool Database::setPruning(int keepBlocks)
+{
+    pruneKeep = keepBlocks;
+    if (keepBlocks <= 0)
     {
-        gdb();
         return true;
     }
+    sqlite3_stmt *result;
+    int vacuumMode = 0;
+    if (!executeQuery("PRAGMA auto_vacuum;", &result))
+    {
+        return false;
+    }
     if (nextRow(result))
     {
-        int retVal;
-        retVal = stoi(getRow(result,1).at(0));
-        finalizeQuery(&result);
-        return retVal;
+        vacuumMode = stoi(getRow(result, 1).at(0));
     }
     finalizeQuery(&result);
+    if (vacuumMode != 2)
+    {
+        //the mode of an existing database only changes with a full vacuum
+        cout << "switching the database to incremental vacuum" << endl;
+        return executeSql("PRAGMA auto_vacuum = INCREMENTAL; VACUUM;");
+    }
     return true;
+}
 
+/**
+ * @brief Database::pruneChain
+ * folds all blocks up to a height into the base:
+ * the balances are added to BASE_BALANCE, spent transactions
+ * are only kept as hashes and their inputs are deleted.
+ * headers, lucky numbers and unspent outputs stay.
+ * called by the block writer while it holds the dbMutex
+ * @param height of the last block to prune
+ * @return true if successful
+ */
+bool Database::pruneChain(int height)
+{
+    string base = to_string(baseHeight);
+    string h = to_string(height);
+    string sql = string("with tr as (select sender, recipient, value from transactions") +
+                        "      where cast(block as int) > " + base + " and cast(block as int) <= " + h +
+                        "      and sender not like recipient)," +
+                        " addr as (select sender as address from transactions" +
+                        "      where cast(block as int) > " + base + " and cast(block as int) <= " + h +
+                        "      union select recipient from transactions" +
+                        "      where cast(block as int) > " + base + " and cast(block as int) <= " + h + ")" +
+                        " insert or replace into base_balance(address, balance)" +
+                        " select a.address," +
+                        "      coalesce((select sum(balance) from base_balance where address like a.address), 0)" +
+                        "      + coalesce((select sum(value) from tr where recipient like a.address), 0)" +
+                        "      - coalesce((select sum(value) from tr where sender like a.address), 0)" +
+                        " from addr as a where a.address not like '';" +
+
+                        "insert or replace into base_transactions(hash, value)" +
+                        " select t.hash, t.value from transactions as t where cast(t.block as int) <= " + h +
+                        " and exists (select i.hash from input as i" +
+                        "      where t.hash like i.hash and cast(i.block as int) <= " + h + ");" +
+
+                        "delete from transactions where cast(block as int) <= " + h +
+                        " and exists (select i.hash from input as i" +
+                        "      where transactions.hash like i.hash and cast(i.block as int) <= " + h + ");" +
+
+                        "delete from input where cast(block as int) <= " + h + ";";
+    if (baseHeight == 0)
+    {
+        sql += "insert into chain_base(height, verified) values (" + h + ", 1);";
+    }
+    else
+    {
+        sql += "update chain_base set height = " + h + ";";
+    }
+
+    if (!executeSql("BEGIN TRANSACTION;"))
+    {
+        return false;
+    }
+    if (!executeSql(sql) || !executeSql("COMMIT;"))
+    {
+        cout << "pruning up to block " << height << " failed" << endl;
+        executeSql("ROLLBACK;");
+        return false;
+    }
+    baseHeight = height;
+    balanceIndex.collapse(height);
+    cout << "pruned the chain up to block " << height << endl;
+    return executeSql("PRAGMA incremental_vacuum;");
 }
 
-int Database::getInputSumOfBlock(int index, int forkID)
+/**
+ * @brief Database::existsTransaction
+ * the transactions of the main chain are looked up in the transaction index,
+ * only the transactions of a fork need a query
+ * @param hash of the transaction
+ * @param index of the block, only earlier blocks are searched
+ * @param forkID id of the fork, 0 for the main chain
+ * @return true if the transaction is already in the chain
+ */
+bool Database::existsTransaction(string hash, int index, int forkID)
 {
-    string sql;
     sqlite3_stmt *result;
-    if (forkID == 0)
+    int block, value;
+    int end = (forkID == 0) ? index : getFirstForkBlockIndex(forkID);
+    if (txIndex.find(hash, block, value) && block < end)
     {
-        sql = string("select coalesce(sum(value), 0) from (select distinct t.hash, t.value from input") +
-                     " join transactions as t on t.hash like input.hash where input.block = " + to_string(index) + ");";
+        return true;
     }
-    else
+    if (forkID == 0)
     {
-        sql = string("with tr as (select * from transactions where cast(block as int) < (select min(cast(block_index as int)) from fork") + to_string(forkID) + ")" +
-                     "          union select * from fork" + to_string(forkID) + "_transactions)" +
-                     " select coalesce(sum(value), 0) from (select distinct t.hash, t.value from fork" + to_string(forkID) + "_input as i" +
-                     " join tr as t on t.hash like i.hash where i.block = " + to_string(index) + ");";
+        return false;
     }
-    //cout << "***********" << sql << endl;
+    string sql = string("select exists (select * from fork") + to_string(forkID) + "_transactions where hash like '" + hash + "'" +
+                        " and cast(block as int) < " + to_string(index) + ");";
     if(!executeQuery(sql, &result))
     {
         gdb();
@@ -424,6 +978,74 @@ int Database::getInputSumOfBlock(int index, int forkID)
 
 }
 
+/**
+ * @brief Database::getInputSumOfBlock
+ * @param index of the block
+ * @param forkID id of the fork, 0 for the main chain
+ * @return sum of the values of the transactions, that are spent in the block
+ */
+int Database::getInputSumOfBlock(int index, int forkID)
+{
+    lock_guard<recursive_mutex> lock(*dbMutex);
+    sqlite3_stmt *result;
+    map<string, int> inputs;    //hash -> value from the fork, -1 if it is one of the main chain
+    Block pending;
+    if (forkID == 0 && getPendingBlock(index, pending))
+    {
+        vector<Transaction> transactions = pending.getTransaction();
+        for (unsigned int t = 0; t < transactions.size(); t++)
+        {
+            vector<string> input = transactions.at(t).getInput();
+            for (unsigned int i = 0; i < input.size(); i++)
+            {
+                inputs[input.at(i)] = -1;
+            }
+        }
+    }
+    else
+    {
+        string sql;
+        if (forkID == 0)
+        {
+            sql = "SELECT DISTINCT HASH, -1 FROM INPUT WHERE BLOCK = " + to_string(index) + ";";
+        }
+        else
+        {
+            sql = string("select distinct i.hash, coalesce(t.value, -1) from fork") + to_string(forkID) + "_input as i" +
+                         " left join fork" + to_string(forkID) + "_transactions as t on t.hash like i.hash" +
+                         " where i.block = " + to_string(index) + ";";
+        }
+        if(!executeQuery(sql, &result))
+        {
+            gdb();
+            return true;
+        }
+        while (nextRow(result))
+        {
+            vector<string> row = getRow(result, 2);
+            inputs[row.at(0)] = stoi(row.at(1));
+        }
+        finalizeQuery(&result);
+    }
+
+    //the transactions of the main chain, pending ones included, are in the tx index
+    int end = (forkID == 0) ? index : getFirstForkBlockIndex(forkID);
+    int sum = 0;
+    for (map<string, int>::iterator it = inputs.begin(); it != inputs.end(); ++it)
+    {
+        int block, value;
+        if (it->second >= 0)
+        {
+            sum += it->second;
+        }
+        else if (txIndex.find(it->first, block, value) && (forkID == 0 || block < end))
+        {
+            sum += value;
+        }
+    }
+    return sum;
+}
+
 /**
  * @brief Blockchain::iterateOverBlocks
  * starts an iteration over the blocks saved in the database
@@ -434,6 +1056,7 @@ int Database::getInputSumOfBlock(int index, int forkID)
 
 bool Database::iterateOverBlocks(int forkId)
 {
+    flush();
     /*if (!dbMutex->try_lock())
         gdb();*/
     dbMutex->lock();
@@ -655,6 +1278,11 @@ Block Database::getBlock(int blockID, int forkID)
     }
     else
     {
+        Block pending;
+        if (getPendingBlock(blockID, pending))
+        {
+            return pending;
+        }
         sql = "SELECT * FROM BLOCKCHAIN WHERE BLOCK_INDEX=" + to_string(blockID) + ";";
     }
 
@@ -728,6 +1356,8 @@ int Database::getLastBlockIndex(int forkID)
     int lastBlockIndex = 0;
     sqlite3_stmt *result;
     string sql;
+    //the pending blocks are read first, the writer removes them only after they are written
+    int lastPendingIndex = (forkID == 0) ? getLastPendingBlockIndex() : 0;
     if (forkID == 0)
     {
         sql = "SELECT COALESCE(MAX(BLOCK_INDEX),0) FROM BLOCKCHAIN;";
@@ -751,14 +1381,20 @@ int Database::getLastBlockIndex(int forkID)
 
     finalizeQuery(&result);
 
-    return lastBlockIndex;
+    return max(lastBlockIndex, lastPendingIndex);
 }
 
 Block Database::getLatestBlock()
 {
     vector<unsigned char> ln_copy;
     sqlite3_stmt *result;
-    string sql = string("SELECT * FROM  BLOCKCHAIN WHERE BLOCK_INDEX=") + to_string(getLastBlockIndex(0)) + ";";
+    int lastBlockIndex = getLastBlockIndex(0);
+    Block pending;
+    if (getPendingBlock(lastBlockIndex, pending))
+    {
+        return pending;
+    }
+    string sql = string("SELECT * FROM  BLOCKCHAIN WHERE BLOCK_INDEX=") + to_string(lastBlockIndex) + ";";
     //cout << sql << endl;
     if(!executeQuery(sql, &result))
     {
@@ -830,13 +1466,18 @@ bool Database::openDb()
 {
     int rc;
 
-	rc = sqlite3_open(DATABASE, &db);
+	rc = sqlite3_open(path.c_str(), &db);
 
     if (rc)
     {
         cout << "couldnt open. rc = " << rc << endl;
         return false;
     }
+    //the databases of the simulator are thrown away, they skip the sync to the disk
+    if (!Config::instance().getBool("db_sync", true))
+    {
+        executeSql("PRAGMA synchronous = OFF;");
+    }
 
     return true;
 }
@@ -844,11 +1485,21 @@ bool Database::openDb()
 /**
  * @brief Database::closeDb
  * closes the database
+ * @return false if blocks could not be written or the database not be closed
  */
 bool Database::closeDb()
 {
     int rc;
-    
+
+    writer->stop();
+    bool written = writer->isIdle();
+    if (!written)
+    {
+        cout << "closing the database, but the last blocks are not written" << endl;
+    }
+    dbMutex->lock();
+    dropWrittenForks();
+    dbMutex->unlock();
 	rc = sqlite3_close(db);
     if(rc)
     {
@@ -857,106 +1508,193 @@ bool Database::closeDb()
     }
 
     
-    return true;
+    return written;
 }
 
+/**
+ * @brief Database::getBalance
+ * the balance on the main chain comes from the balance index.
+ * for a fork the transactions of the fork are added to the
+ * balance before the first fork block
+ * @param block index of the block
+ * @param pk public key
+ * @param forkID id of the fork, 0 for the main chain
+ * @return balance after the block
+ */
 int Database::getBalance(int block, string pk, int forkID)
 {
-    sqlite3_stmt *result;
-    string sql;
     if (forkID == 0)
     {
-        sql = string("with inc as(SELECT COALESCE(sum( VALUE ),0) as received") +
-                            " FROM TRANSACTIONS" +
-                            " WHERE CAST(BLOCK AS INT) <= " + to_string(block) +
-                                " AND RECIPIENT LIKE '" + pk +
-                                "' AND SENDER NOT LIKE RECIPIENT)," +
-                      "outp as (SELECT COALESCE(sum( VALUE ),0) as spent" +
-                             " FROM TRANSACTIONS" +
-                             " WHERE CAST(BLOCK AS INT) <= " + to_string(block) +
-                             " AND SENDER LIKE '" + pk +
-                             "' AND SENDER NOT LIKE RECIPIENT)" +
-                 " select inc.received - outp.spent from inc, outp;";
+        return balanceIndex.getBalance(pk, block);
     }
-    else
+    sqlite3_stmt *result;
+    int forkStart = getFirstForkBlockIndex(forkID);
+    string sql = string("SELECT COALESCE(SUM(CASE WHEN RECIPIENT = '") + pk + "' THEN VALUE ELSE 0 END), 0)" +
+                        " - COALESCE(SUM(CASE WHEN SENDER = '" + pk + "' THEN VALUE ELSE 0 END), 0)" +
+                        " FROM FORK" + to_string(forkID) + "_TRANSACTIONS" +
+                        " WHERE CAST(BLOCK AS INT) <= " + to_string(block) +
+                        " AND SENDER != RECIPIENT;";
+    if(!executeQuery(sql, &result))
     {
-        sql = string("with tr as (select sender, block, recipient, value from transactions") +
-                     "      where cast(block as int) < (select min (cast(block as int) ) as minID from  fork" + to_string(forkID) + "_transactions) union" +
-                     "      select sender, block, recipient, value from fork" + to_string(forkID) + "_transactions" +
-                     "      where cast(block as int) >= (select min (cast(block as int) ) as minID from  fork" + to_string(forkID) + "_transactions))," +
-                     " inc as (SELECT COALESCE(sum( t.VALUE ),0) as received  FROM tr AS t" +
-                     "      WHERE CAST(t.BLOCK AS INT) <= " + to_string(block) +
-                     "      AND t.RECIPIENT LIKE '" + pk + "'" +
-                     "      AND t.SENDER NOT LIKE  t.recipient)," +
-                     "      outp as (SELECT COALESCE(sum( t.VALUE ),0) as spent  FROM tr AS t" +
-                     "      WHERE CAST(t.BLOCK AS INT) <= " + to_string(block) +
-                     "      AND t.sender LIKE '" + pk + "'" +
-                     "      AND t.RECIPIENT NOT LIKE t.sender)" +
-
-                     " select inc.received - outp.spent from inc, outp;";
+        return false;
     }
-    //cout << "***********" << endl << sql << endl;
-    if(!executeQuery(sql, &result))
+    int forkBalance = 0;
+    if (nextRow(result))
+    {
+        forkBalance = stoi(getRow(result, 1).at(0));
+    }
+    finalizeQuery(&result);
+    return balanceIndex.getBalance(pk, min(block, forkStart - 1)) + forkBalance;
+}
+
+/**
+ * @brief Database::getBalance
+ * @param pk public key
+ * @return balance at the latest block of the main chain
+ */
+int Database::getBalance(string pk)
+{
+    return balanceIndex.getBalance(pk);
+}
+
+/**
+ * @brief Database::loadBalanceIndex
+ * builds the balance index from the stored transactions
+ * and the balances of the base
+ * @return true if successful
+ */
+bool Database::loadBalanceIndex()
+{
+    sqlite3_stmt *result;
+    map<int, map<string, int> > deltas;
+    string base = to_string(baseHeight);
+    if (!executeQuery("SELECT ADDRESS, BALANCE FROM BASE_BALANCE;", &result))
     {
         return false;
     }
+    while (nextRow(result))
+    {
+        vector<string> row = getRow(result, 2);
+        deltas[baseHeight][row.at(0)] += stoi(row.at(1));
+    }
+    finalizeQuery(&result);
 
-    if (nextRow(result))
+    string sql = string("SELECT CAST(BLOCK AS INT), RECIPIENT, SUM(VALUE) FROM TRANSACTIONS") +
+                        " WHERE CAST(BLOCK AS INT) > " + base + " AND SENDER != RECIPIENT GROUP BY 1, 2" +
+                        " UNION ALL SELECT CAST(BLOCK AS INT), SENDER, -SUM(VALUE) FROM TRANSACTIONS" +
+                        " WHERE CAST(BLOCK AS INT) > " + base + " AND SENDER != RECIPIENT AND SENDER != '' GROUP BY 1, 2;";
+    if (!executeQuery(sql, &result))
     {
-        int retVal = stoi(getRow(result, 1).at(0));
-        finalizeQuery(&result);
-	if (retVal < 0)
-		gdb();
-        return retVal;
+        return false;
+    }
+    while (nextRow(result))
+    {
+        vector<string> row = getRow(result, 3);
+        deltas[stoi(row.at(0))][row.at(1)] += stoi(row.at(2));
     }
-    gdb();
-    cout << __FUNCTION__ << endl;
+    finalizeQuery(&result);
 
-    return -1;
+    balanceIndex.clear();
+    balanceIndex.replaceHeights(deltas);
+    return true;
+}
 
+/**
+ * @brief Database::loadTxIndex
+ * builds the transaction index from the stored transactions.
+ * the spent transactions of the base have no block anymore
+ * @return true if successful
+ */
+bool Database::loadTxIndex()
+{
+    sqlite3_stmt *result;
+    string sql = string("SELECT HASH, CAST(BLOCK AS INT), VALUE FROM TRANSACTIONS") +
+                        " UNION ALL SELECT HASH, -1, VALUE FROM BASE_TRANSACTIONS;";
+    if (!executeQuery(sql, &result))
+    {
+        return false;
+    }
+    txIndex.clear();
+    while (nextRow(result))
+    {
+        vector<string> row = getRow(result, 3);
+        txIndex.add(row.at(0), stoi(row.at(1)), stoi(row.at(2)));
+    }
+    finalizeQuery(&result);
+    return true;
 }
 
+/**
+ * @brief Database::getTxIndexStats
+ * @return size, memory usage and false positive rate of the transaction index
+ */
+string Database::getTxIndexStats()
+{
+    return txIndex.getStats();
+}
+
+/**
+ * @brief Database::getUTXO
+ * the rows of the pending blocks on the disk are skipped
+ * and the pending blocks are read from the memory instead
+ * @param block index of the last block, that is taken into account
+ * @param pk public key of the recipient
+ * @param forkID id of the fork, 0 for the main chain
+ * @return unspent outputs of the key
+ */
 vector<Utxo_help> Database::getUTXO(int block, string pk, int forkID)
 {
+    lock_guard<recursive_mutex> lock(*dbMutex);
     vector<Utxo_help> retValue;
-    //string bcTable = "BLOCKCHAIN";
-    string trTable = "TRANSACTIONS";
-    string inTable = "INPUT";
-    if (forkID != 0)
+    map<int, Block> pending = getPendingBlocks();
+    string trFilter = excludePending(pending, "BLOCK");
+    string inFilter = excludePending(pending, "BLOCK");
+
+    //outputs and spends of the pending blocks up to the block
+    vector<Utxo_help> pendingOutputs;
+    set<string> pendingSpent;
+    for (map<int, Block>::iterator it = pending.begin(); it != pending.end() && it->first <= block; ++it)
     {
-       // bcTable = "FORK" + forkID;
-        trTable = "FORK" + to_string(forkID) + "_TRANSACTIONS";
-        inTable = "FORK" + to_string(forkID) + "_INPUT";
+        vector<Transaction> transactions = it->second.getTransaction();
+        for (unsigned int t = 0; t < transactions.size(); t++)
+        {
+            Transaction &transaction = transactions.at(t);
+            if (transaction.getRecipient().compare(pk) == 0)
+            {
+                Utxo_help output;
+                output.hash = transaction.getHash();
+                output.value = transaction.getValue();
+                pendingOutputs.push_back(output);
+            }
+            vector<string> input = transaction.getInput();
+            pendingSpent.insert(input.begin(), input.end());
+        }
     }
 
     sqlite3_stmt *result;
     string sql;
+    string inp, tr;
     if (forkID == 0)
     {
-        sql = string("SELECT distinct t.Hash, t.Value ") +
-                        "FROM " + trTable + " AS t" +
+        inp = "(select hash, block from input where 1" + inFilter + ")";
+        tr = "(select hash, block, recipient, value from transactions where 1" + trFilter + ")";
+    }
+    else
+    {
+        inp = "(select hash, block from input where 1" + inFilter + " union" +
+              " select hash, block from fork" + to_string(forkID) + "_input)";
+        tr = "(select hash, block, recipient, value from transactions where 1" + trFilter + " union" +
+             " select hash, block, recipient, value from fork" + to_string(forkID) + "_transactions)";
+    }
+    sql = string("with inp as ") + inp + ", tr as " + tr +
+                 " SELECT distinct t.Hash, t.Value " +
+                 " FROM tr AS t" +
                  " WHERE CAST(t.BLOCK AS INT) <= " + to_string(block) +
                      " AND t.RECIPIENT LIKE '" + pk +
                      "' AND NOT EXISTS " +
-                         " ( SELECT  i.HASH FROM " + inTable + " AS i" +
+                         " ( SELECT  i.HASH FROM inp AS i" +
                          " where t.HASH LIKE i.HASH" +
                          " and CAST(i.BLOCK AS INT) <= " + to_string(block) + ");";
-    }
-    else
-    {
-        sql = string("with inp as(select hash, block from input union") +
-                     " select hash, block from fork" + to_string(forkID) + "_input)," +
-                     " tr as (select hash, block, recipient, value from transactions union" +
-                     " select hash, block, recipient, value from fork" + to_string(forkID) + "_transactions)" +
-                     " SELECT distinct t.Hash, t.Value " +
-                     " FROM tr AS t" +
-                     " WHERE CAST(t.BLOCK AS INT) <= " + to_string(block) +
-                         " AND t.RECIPIENT LIKE '" + pk +
-                         "' AND NOT EXISTS " +
-                             " ( SELECT  i.HASH FROM inp AS i" +
-                             " where t.HASH LIKE i.HASH" +
-                             " and CAST(i.BLOCK AS INT) <= " + to_string(block) + ");";
-    }
     //cout << "***********" << endl << sql << endl;
     if(!executeQuery(sql, &result))
     {
@@ -969,50 +1707,99 @@ vector<Utxo_help> Database::getUTXO(int block, string pk, int forkID)
     {
         temp.hash = getRow(result, 2).at(0);
         temp.value = stoi(getRow(result, 2).at(1));
-        retValue.push_back(temp);
+        if (pendingSpent.count(temp.hash) == 0)
+        {
+            retValue.push_back(temp);
+        }
     }
     finalizeQuery(&result);
+
+    //a pending output can still be spent by a block of the fork
+    for (unsigned int o = 0; o < pendingOutputs.size(); o++)
+    {
+        Utxo_help &output = pendingOutputs.at(o);
+        if (pendingSpent.count(output.hash) != 0)
+        {
+            continue;
+        }
+        if (forkID != 0)
+        {
+            sql = string("select exists (select * from fork") + to_string(forkID) + "_input where hash like '" + output.hash + "'" +
+                         " and cast(block as int) <= " + to_string(block) + ");";
+            if(!executeQuery(sql, &result))
+            {
+                continue;
+            }
+            bool spent = nextRow(result) && stoi(getRow(result, 1).at(0));
+            finalizeQuery(&result);
+            if (spent)
+            {
+                continue;
+            }
+        }
+        retValue.push_back(output);
+    }
     return retValue;
 }
 
+/**
+ * @brief Database::getTransactionBlock
+ * @param hash of the transaction
+ * @return index of the block of the main chain, -1 if it is unknown
+ */
+int Database::getTransactionBlock(string hash)
+{
+    int block, value;
+    if (txIndex.find(hash, block, value))
+    {
+        return block;
+    }
+    return -1;
+}
+
+/**
+ * @brief Database::getTransactionValueByHash
+ * @param hash of the transaction
+ * @param forkID id of the fork, 0 for the main chain
+ * @return value of the transaction, 0 if it is unknown
+ */
 int Database::getTransactionValueByHash(string hash, int forkID)
 {
     sqlite3_stmt *result;
-    string sql;
-
+    int block, value;
+    if (txIndex.find(hash, block, value))
+    {
+        return value;
+    }
     if (forkID == 0)
     {
-        sql = string("SELECT VALUE FROM TRANSACTIONS WHERE HASH LIKE '") + hash + "';";
-    } else {
-        sql = string("SELECT VALUE FROM TRANSACTIONS WHERE HASH LIKE '") + hash + "' UNION" +
-        " SELECT VALUE FROM FORK" + to_string(forkID) + "_TRANSACTIONS WHERE HASH LIKE '" + hash + "';";
+        return 0;
     }
+    string sql = "SELECT VALUE FROM FORK" + to_string(forkID) + "_TRANSACTIONS WHERE HASH LIKE '" + hash + "';";
     if(!executeQuery(sql, &result))
     {
         return 0;
     }
-    int retVal[2] = {0, 0};
-    int i =0;
-    while (nextRow(result))
+    int retVal = 0;
+    if (nextRow(result))
     {
-        retVal[i] = stoi(getRow(result, 1).at(0));
-        i++;
+        retVal = stoi(getRow(result, 1).at(0));
     }
     finalizeQuery(&result);
-    if (i > 1 && retVal[0] != retVal[1])
-        gdb();
-
-    return retVal[0];
+    return retVal;
 }
 
 bool Database::isLuckierChain(int start, int end, double ln, int forkID)
 {
+    lock_guard<recursive_mutex> lock(*dbMutex);
+    map<int, Block> pending = getPendingBlocks();
     sqlite3_stmt *result;
     string sql;
     double tempLN, sumLN = 0;
     vector<unsigned char> ln_copy;
     sql = string("SELECT b.LN FROM BLOCKCHAIN as b") +
-                 " WHERE b.BLOCK_INDEX BETWEEN " + to_string(start) + " AND " + to_string(end) + ";";
+                 " WHERE b.BLOCK_INDEX BETWEEN " + to_string(start) + " AND " + to_string(end) +
+                 excludePending(pending, "b.BLOCK_INDEX") + ";";
     if(!executeQuery(sql, &result))
     {
         return 0;
@@ -1025,40 +1812,46 @@ bool Database::isLuckierChain(int start, int end, double ln, int forkID)
     }
 
     finalizeQuery(&result);
-    cout << "mainchainLN: " << sumLN << " forkLN " << ln << endl;
+    for (map<int, Block>::iterator it = pending.lower_bound(start); it != pending.end() && it->first <= end; ++it)
+    {
+        sumLN += it->second.getLn();
+    }
+    LOG(LOG_DEBUG) << "mainchainLN: " << sumLN << " forkLN " << ln << endl;
     if (sumLN == ln)
     {
         if (forkID == 0)
         {
             return 0;
         }
-        cout << "Lucky numbers where the same, proofing for lexicographically order now." << endl;
-        sql = string("select b.hash < f.hash from blockchain as b, fork") + to_string(forkID) + " as f where b.block_index = "
-                + to_string(start) + " and f.block_index = " + to_string(start) + ";";
+        LOG(LOG_DEBUG) << "Lucky numbers where the same, proofing for lexicographically order now." << endl;
+        sql = "select hash from fork" + to_string(forkID) + " where block_index = " + to_string(start) + ";";
         if(!executeQuery(sql, &result))
         {
             return 0;
         }
         if (nextRow(result))
         {
-            int retVal = stoi(getRow(result, 1).at(0));
+            string forkHash = getRow(result, 1).at(0);
             finalizeQuery(&result);
 
-            return retVal;
+            return getBlock(start, 0).getHash() < forkHash;
         }
+        finalizeQuery(&result);
     }
     return sumLN<ln;
 }
 
 vector<string> Database::getAllParticipants(string pk)
 {
+    flush();
     vector<string> parts;
     parts.push_back(getPublicBkey());
     sqlite3_stmt *result;
     string sql;
 
     sql = string("select distinct sender  from (select sender from transactions") +
-                 " union select recipient as sender from transactions)" +
+                 " union select recipient as sender from transactions" +
+                 " union select address as sender from base_balance)" +
                  " where sender not like 'GenesisMiner' AND sender NOT LIKE '' AND sender NOT LIKE '" + pk + "';";
     if(!executeQuery(sql, &result))
     {
@@ -1074,6 +1867,7 @@ vector<string> Database::getAllParticipants(string pk)
 
 vector<Transaction> Database::getMyTransactions()
 {
+    flush();
     vector<Transaction> transactions;
     transactions = {};
     sqlite3_stmt *result;
@@ -1107,14 +1901,22 @@ vector<Transaction> Database::getMyTransactions()
     return transactions;
 }
 
+/**
+ * @brief Database::getTransactionsFromChain
+ * @param forkID id of the fork
+ * @return transactions of the main chain from the first block of the fork on, pending blocks included
+ */
 vector<Transaction> Database::getTransactionsFromChain(int forkID)
 {
+    lock_guard<recursive_mutex> lock(*dbMutex);
+    map<int, Block> pending = getPendingBlocks();
     vector<Transaction> transactions;
     transactions = {};
     sqlite3_stmt *result;
+    int forkStart = getFirstForkBlockIndex(forkID);
 
-    string sql = string("SELECT * FROM TRANSACTIONS WHERE CAST(BLOCK AS INT) >= ") +
-                        "(SELECT MIN(CAST(BLOCK_INDEX AS INT)) FROM FORK" + to_string(forkID) + ");";
+    string sql = string("SELECT * FROM TRANSACTIONS WHERE CAST(BLOCK AS INT) >= ") + to_string(forkStart) +
+                        excludePending(pending, "BLOCK") + ";";
     if(!executeQuery(sql, &result))
     {
         //gdb();
@@ -1140,6 +1942,11 @@ vector<Transaction> Database::getTransactionsFromChain(int forkID)
         transactions.push_back(transaction);
     }
     finalizeQuery(&result);
+    for (map<int, Block>::iterator it = pending.lower_bound(forkStart); it != pending.end(); ++it)
+    {
+        vector<Transaction> blockTransactions = it->second.getTransaction();
+        transactions.insert(transactions.end(), blockTransactions.begin(), blockTransactions.end());
+    }
     return transactions;
 }
 
@@ -1178,9 +1985,10 @@ vector<Transaction> Database::getTransactionsFromFork(int forkID)
     return transactions;
 }
 
-QString Database::getStringFromBlockchain(bool detailed)
+string Database::getStringFromBlockchain(bool detailed)
 {
-    QString bc, transactions;
+    flush();
+    string bc, transactions;
     sqlite3_stmt *result;
 
     string sql = string("SELECT b.*,t.*,coalesce(i.id, -1), coalesce(i.hash, -1), coalesce(i.trans, -1), coalesce(i.block, -1)") +
@@ -1232,7 +2040,7 @@ QString Database::getStringFromBlockchain(bool detailed)
             {
                 if (detailed)
                 {
-                    transactions.append(QString::fromStdString("\t\t\t " + input + "\n"));
+                    transactions.append("\t\t\t " + input + "\n");
                 }
             }
             else {
@@ -1246,22 +2054,22 @@ QString Database::getStringFromBlockchain(bool detailed)
 
                 if (detailed)
                 {
-                    transactions.append(QString::fromStdString("\n\t\tTransaction: \t" + t_hash +"\n"));
+                    transactions.append("\n\t\tTransaction: \t" + t_hash +"\n");
                 }
-                transactions.append(QString::fromStdString("\t\tSender: \t" + t_sender + "\n"));
-                transactions.append(QString::fromStdString("\t\tRecipient: \t" + t_recipient + "\n"));
-                transactions.append(QString::fromStdString("\t\tValue: \t\t" + t_value + "\n"));
+                transactions.append("\t\tSender: \t" + t_sender + "\n");
+                transactions.append("\t\tRecipient: \t" + t_recipient + "\n");
+                transactions.append("\t\tValue: \t\t" + t_value + "\n");
                 if (detailed)
                 {
                     strftime(buff, 20, "%Y-%m-%d %H:%M:%S", localtime(&t_timestamp));
-                    transactions.append(QString::fromStdString("\t\tTime: \t\t" + string(buff) + "\n"));
-                    transactions.append(QString::fromStdString("\t\tInputs:\n"));
+                    transactions.append("\t\tTime: \t\t" + string(buff) + "\n");
+                    transactions.append("\t\tInputs:\n");
                     if (input.compare("-1") != 0)
-                        transactions.append(QString::fromStdString("\t\t\t " + input + "\n"));
+                        transactions.append("\t\t\t " + input + "\n");
                 }
                 if (t_sender.compare("") == 0)
                 {
-                    bc.append(QString::fromStdString("Miner: \t\t" + t_recipient + "\n"));
+                    bc.append("Miner: \t\t" + t_recipient + "\n");
 //                    bc.append("\n");
                     if (detailed)
                     {
@@ -1286,21 +2094,21 @@ QString Database::getStringFromBlockchain(bool detailed)
             b_numOfTrans = stoi(row.at(6));
             b_certificate = row.at(7);
 
-            bc.append(QString::fromStdString("-----------------------------------------------\n"));
-            bc.append(QString::fromStdString("Block: \t\t" + to_string(b_id) + " has " +to_string(b_numOfTrans) + " transactions:\n"));
-            bc.append(QString::fromStdString("Blockhash: \t" + b_hash + "\n"));
-            bc.append(QString::fromStdString("Merklehash: \t" + b_merkle + "\n"));
-            bc.append(QString::fromStdString("Lucky Number: \t" + to_string(b_ln) + "\n"));
-            bc.append(QString::fromStdString("Certificate: \t" + b_certificate + "\n"));
+            bc.append("-----------------------------------------------\n");
+            bc.append("Block: \t\t" + to_string(b_id) + " has " +to_string(b_numOfTrans) + " transactions:\n");
+            bc.append("Blockhash: \t" + b_hash + "\n");
+            bc.append("Merklehash: \t" + b_merkle + "\n");
+            bc.append("Lucky Number: \t" + to_string(b_ln) + "\n");
+            bc.append("Certificate: \t" + b_certificate + "\n");
             strftime(buff, 20, "%Y-%m-%d %H:%M:%S", localtime(&b_timestamp));
-            bc.append(QString::fromStdString("Time: \t\t"+ string(buff) + "\n"));
-//            bc.append(QString::fromStdString("Miner: \t\t" + t_recipient + "\n"));
+            bc.append("Time: \t\t"+ string(buff) + "\n");
+//            bc.append("Miner: \t\t" + t_recipient + "\n");
 
             if (curTransIndex == stoi(row.at(8)))
             {
                 if (detailed)
                 {
-                    bc.append(QString::fromStdString("\t\t\t " + input + "\n"));
+                    bc.append("\t\t\t " + input + "\n");
                 }
             }
             else {
@@ -1314,22 +2122,22 @@ QString Database::getStringFromBlockchain(bool detailed)
 
                 if (detailed)
                 {
-                    transactions.append(QString::fromStdString("\n\t\tTransaction: \t" + t_hash +"\n"));
+                    transactions.append("\n\t\tTransaction: \t" + t_hash +"\n");
                 }
-                transactions.append(QString::fromStdString("\t\tSender: \t" + t_sender + "\n"));
-                transactions.append(QString::fromStdString("\t\tRecipient: \t" + t_recipient + "\n"));
-                transactions.append(QString::fromStdString("\t\tValue: \t\t" + t_value + "\n"));
+                transactions.append("\t\tSender: \t" + t_sender + "\n");
+                transactions.append("\t\tRecipient: \t" + t_recipient + "\n");
+                transactions.append("\t\tValue: \t\t" + t_value + "\n");
                 if (detailed)
                 {
                     strftime(buff, 20, "%Y-%m-%d %H:%M:%S", localtime(&t_timestamp));
-                    transactions.append(QString::fromStdString("\t\tTime: \t\t" + string(buff) + "\n"));
-                    transactions.append(QString::fromStdString("\t\tInputs:\n"));
+                    transactions.append("\t\tTime: \t\t" + string(buff) + "\n");
+                    transactions.append("\t\tInputs:\n");
                     if (input.compare("-1") != 0)
-                        transactions.append(QString::fromStdString("\t\t\t " + input + "\n"));
+                        transactions.append("\t\t\t " + input + "\n");
                 }
                 if (t_sender.compare("") == 0)
                 {
-                    bc.append(QString::fromStdString("Miner: \t\t" + t_recipient + "\n"));
+                    bc.append("Miner: \t\t" + t_recipient + "\n");
 //                    bc.append("\n");
                     if (detailed)
                     {
@@ -1562,7 +2370,20 @@ bool Database::initializeTables()
             + "BLOCK          TEXT      NOT NULL);"
 
             + "CREATE TABLE IF NOT EXISTS FORKS("
-            + "ID             INTEGER   PRIMARY KEY);";
+            + "ID             INTEGER   PRIMARY KEY);"
+
+            //state below the base height, if the chain was imported from a snapshot
+            + "CREATE TABLE IF NOT EXISTS CHAIN_BASE("
+            + "HEIGHT         INTEGER   NOT NULL,"
+            + "VERIFIED       INTEGER   NOT NULL);"
+
+            + "CREATE TABLE IF NOT EXISTS BASE_BALANCE("
+            + "ADDRESS        TEXT      PRIMARY KEY,"
+            + "BALANCE        INTEGER   NOT NULL);"
+
+            + "CREATE TABLE IF NOT EXISTS BASE_TRANSACTIONS("
+            + "HASH           TEXT      PRIMARY KEY,"
+            + "VALUE          INTEGER   NOT NULL);";
 
     return executeSql(sql);
 }
@@ -1579,7 +2400,9 @@ bool Database::executeSql(string sqlString)
     char *zErrMsg = 0;
     char const *sql = sqlString.c_str();
     dbMutex->lock();
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
     rc = sqlite3_exec(db, sql, NULL, 0, &zErrMsg);
+    sqlSeconds(sql).observe(secondsSince(started));
     dbMutex->unlock();
     if(rc != SQLITE_OK)
     {
@@ -1607,7 +2430,9 @@ bool Database::executeQuery(string sqlString, sqlite3_stmt **result)
     char const *sql = sqlString.c_str();
     *activeQuerys += 1;
     dbMutex->lock();
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
     rc = sqlite3_prepare_v2(db, sql, -1, result, NULL);
+    sqlSeconds(sql).observe(secondsSince(started));
     dbMutex->unlock();
     if (rc != SQLITE_OK) 
     {
@@ -1628,7 +2453,10 @@ bool Database::executeQuery(string sqlString, sqlite3_stmt **result)
  */
 bool Database::nextRow(sqlite3_stmt* &result)
 {
-    return sqlite3_step(result) == SQLITE_ROW;
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    bool row = sqlite3_step(result) == SQLITE_ROW;
+    sqlSeconds(sqlite3_sql(result)).observe(secondsSince(started));
+    return row;
 }
 
 /**
@@ -1699,6 +2527,7 @@ bool Database::removeInput(string index)
  */
 bool Database::saveTransaction(Transaction transaction, string block) 
 {
+    lock_guard<recursive_mutex> lock(*dbMutex);
     string HASH =          transaction.getHash();
     string BLOCK =         block;
     string SENDER =        transaction.getSender();
@@ -1735,6 +2564,7 @@ bool Database::saveTransaction(Transaction transaction, string block)
  */
 bool Database::saveTransactionForFork(Transaction transaction, string block, int forkId)
 {
+    lock_guard<recursive_mutex> lock(*dbMutex);
     string HASH =          transaction.getHash();
     string BLOCK =         block;
     string SENDER =        transaction.getSender();
@@ -10,25 +10,35 @@
 #include <time.h>
 #include <memory>
 #include <stdio.h>
-#include <QString>
 #include <thread>
+#include <map>
+#include <set>
 #include "../Chain/transactions.hpp"
 #include "../Chain/merkletree.hpp"
 #include "../Chain/block.hpp"
 #include "../libs/sqlite3.h"
 #include "../sodiumpp/include/sodiumpp/base64.h"
 #include "../helperfunctions.h"
+#include "../metrics.h"
+#include "../log.h"
+#include "blockwriter.hpp"
+#include "snapshot.hpp"
+#include "balanceindex.hpp"
+#include "txindex.hpp"
 #undef FunctionName
 
 using namespace std;
 using namespace HelperFunctions;
 
+const string DATABASE_PATH = "database.db";
+
 class Database
 {
 
 public:
     Database();
-    Database(const shared_ptr<recursive_mutex>& sharedMutex, const shared_ptr<int>& queries);
+    Database(const shared_ptr<recursive_mutex>& sharedMutex, const shared_ptr<int>& queries,
+             const string &path = DATABASE_PATH);
 	bool blockchainInitialized();
 	bool appendBlock(Block);
 	bool replaceBlock(Block);
@@ -47,23 +57,34 @@ public:
     int getFirstForkBlockIndex(int forkID = 0);
     bool closeDb();
     int getBalance(int block, string pk, int forkID);
+    int getBalance(string pk);
     vector<Utxo_help> getUTXO(int block, string pk, int forkID);
     int getTransactionValueByHash(string hash, int forkID);
+    int getTransactionBlock(string hash);
     bool isLuckierChain(int start, int end, double ln, int forkID);
     vector<string> getAllParticipants(string pk);
     vector<Transaction> getMyTransactions();
     vector<Transaction> getTransactionsFromChain(int forkID);
     vector<Transaction> getTransactionsFromFork(int forkID);
-    QString getStringFromBlockchain(bool detailed);
+    string getStringFromBlockchain(bool detailed);
     bool deleteFork(int);
-    double getLNSum();
+    map<int, double> getLNs(int forkID = 0);
     bool cleanUpDBFromIndex(int index);
     bool existsTransaction(string hash, int index, int forkID);
     int getInputSumOfBlock(int index, int forkID);
+    bool flush();
+    bool exportSnapshot(Snapshot &snapshot, int height);
+    bool importSnapshot(const Snapshot &snapshot);
+    int getBaseHeight();
+    bool isBaseVerified();
+    bool setBaseVerified();
+    bool setPruning(int keepBlocks);
+    string getTxIndexStats();
 
 
 private:
 	sqlite3 *db;
+    string path;
     sqlite3_stmt *blockIterator;
     sqlite3_stmt *forkIterator;
     bool forkSpecified;
@@ -92,6 +113,25 @@ private:
     vector<string> loadInputForFork(int, int);
     std::shared_ptr<recursive_mutex> dbMutex;
     Block createBlockFromRow(bool);
+    bool commitForks(vector<PendingFork>& batch);
+    void dropWrittenForks();
+    vector<int> writtenForks;       //forks in the main chain, whose tables are not dropped yet
+    bool getPendingBlock(int index, Block& block);
+    int getLastPendingBlockIndex();
+    map<int, Block> getPendingBlocks();
+    string excludePending(const map<int, Block>& pending, string column);
+    unique_ptr<BlockWriter> writer;
+    mutex pendingMutex;
+    map<int, Block> pendingBlocks;  //applied, but not yet written blocks of the main chain
+    int baseHeight;                 //blocks up to this index are only stored as headers
+    int pruneKeep;                  //number of blocks with transactions, 0 if pruning is off
+    bool loadBase();
+    BalanceIndex balanceIndex;      //balances of the main chain per address and height
+    bool loadBalanceIndex();
+    TxIndex txIndex;                //transactions of the main chain by hash
+    bool loadTxIndex();
+    bool pruneChain(int height);
+    const int PRUNE_INTERVAL = 10;
     void gdb();
 };
 
@@ -0,0 +1,276 @@
+#include "snapshot.hpp"
+
+#define SNAPSHOT_MAGIC "POLUCK_SNAPSHOT 2"
+
+Snapshot::Snapshot()
+    :height(0)
+{
+
+}
+
+/**
+ * @brief Snapshot::save
+ * writes the snapshot line by line into a file.
+ * the state hash follows the sections,
+ * the last line contains the checksum of all previous lines
+ * @param file path of the snapshot file
+ * @return true if successful
+ */
+bool Snapshot::save(string file)
+{
+    ofstream out(file.c_str(), ios::out | ios::trunc);
+    if (!out.is_open())
+    {
+        cout << "couldn't open snapshot file " << file << endl;
+        return false;
+    }
+    SHA1 checksum;
+    string line;
+
+    line = string(SNAPSHOT_MAGIC) + "\n";
+    checksum.update(line);
+    out << line;
+    line = "HEIGHT " + to_string(height) + "\n";
+    checksum.update(line);
+    out << line;
+
+    for (unsigned int i = 0; i < headers.size(); i++)
+    {
+        Block &block = headers.at(i);
+        double ln = block.getLn();
+        line = "HEADER " + to_string(block.getIndex()) + ";"
+                + block.getHash() + ";"
+                + block.getPreviousHash() + ";"
+                + block.getMerkleHash() + ";"
+                + base64_encode((unsigned char*)&ln, sizeof(double)) + ";"
+                + to_string(block.getTimestamp()) + ";"
+                + to_string(block.getNumTrans()) + ";"
+                + block.getCertificate() + "\n";
+        checksum.update(line);
+        out << line;
+    }
+    for (unsigned int i = 0; i < outputs.size(); i++)
+    {
+        line = outputLine(outputs.at(i));
+        checksum.update(line);
+        out << line;
+    }
+    for (unsigned int i = 0; i < spent.size(); i++)
+    {
+        line = spentLine(spent.at(i));
+        checksum.update(line);
+        out << line;
+    }
+    for (unsigned int i = 0; i < balances.size(); i++)
+    {
+        line = balanceLine(balances.at(i));
+        checksum.update(line);
+        out << line;
+    }
+    line = "STATE " + stateHash() + "\n";
+    checksum.update(line);
+    out << line;
+    out << "CHECKSUM " << checksum.final() << "\n";
+    out.close();
+    return !out.fail();
+}
+
+/**
+ * @brief Snapshot::load
+ * reads a snapshot file. the file is only accepted,
+ * if the checksum matches the content and the state hash matches the sections.
+ * whether the state itself can be trusted is up to the caller
+ * @param file path of the snapshot file
+ * @return true if the snapshot is complete and intact
+ */
+bool Snapshot::load(string file)
+{
+    ifstream in(file.c_str());
+    if (!in.is_open())
+    {
+        cout << "couldn't open snapshot file " << file << endl;
+        return false;
+    }
+    SHA1 checksum;
+    string line;
+    vector<string> lines;
+    string expectedChecksum;
+    while (getline(in, line))
+    {
+        if (line.compare(0, 9, "CHECKSUM ") == 0)
+        {
+            expectedChecksum = line.substr(9);
+            break;
+        }
+        checksum.update(line + "\n");
+        lines.push_back(line);
+    }
+    if (expectedChecksum.empty() || checksum.final().compare(expectedChecksum) != 0)
+    {
+        cout << "snapshot " << file << " is incomplete or corrupted" << endl;
+        return false;
+    }
+    if (lines.empty() || lines.at(0).compare(SNAPSHOT_MAGIC) != 0)
+    {
+        cout << file << " is not a snapshot of this version" << endl;
+        return false;
+    }
+
+    headers.clear();
+    outputs.clear();
+    spent.clear();
+    balances.clear();
+    height = 0;
+    string state;
+    for (unsigned int i = 1; i < lines.size(); i++)
+    {
+        if (lines.at(i).compare(0, 6, "STATE ") == 0)
+        {
+            state = lines.at(i).substr(6);
+            continue;
+        }
+        size_t space = lines.at(i).find(' ');
+        if (space == string::npos)
+        {
+            cout << "invalid snapshot line " << i + 1 << endl;
+            return false;
+        }
+        string type = lines.at(i).substr(0, space);
+        try
+        {
+            if (!parseLine(type, split(lines.at(i).substr(space + 1))))
+            {
+                cout << "invalid snapshot line " << i + 1 << endl;
+                return false;
+            }
+        }
+        catch (const exception &e)
+        {
+            cout << "invalid snapshot line " << i + 1 << ": " << e.what() << endl;
+            return false;
+        }
+    }
+    if (height == 0 || (int)headers.size() != height)
+    {
+        cout << "snapshot has " << headers.size() << " headers, but height " << height << endl;
+        return false;
+    }
+    if (state.compare(stateHash()) != 0)
+    {
+        cout << "the state hash of snapshot " << file << " doesn't match its content" << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Snapshot::stateHash
+ * hash over the height, the hash of the last header, the unspent outputs,
+ * the spent transactions and the balances. it is published together with
+ * the snapshot and has to be compared with a trusted value on the import
+ * @return SHA1 of the state
+ */
+string Snapshot::stateHash() const
+{
+    SHA1 state;
+    state.update("HEIGHT " + to_string(height) + "\n");
+    state.update("TIP " + (headers.empty() ? string("") : headers.back().getHash()) + "\n");
+    for (unsigned int i = 0; i < outputs.size(); i++)
+    {
+        state.update(outputLine(outputs.at(i)));
+    }
+    for (unsigned int i = 0; i < spent.size(); i++)
+    {
+        state.update(spentLine(spent.at(i)));
+    }
+    for (unsigned int i = 0; i < balances.size(); i++)
+    {
+        state.update(balanceLine(balances.at(i)));
+    }
+    return state.final();
+}
+
+string Snapshot::outputLine(const SnapshotOutput &output) const
+{
+    const Transaction &transaction = output.transaction;
+    return "OUTPUT " + to_string(output.block) + ";"
+            + transaction.getHash() + ";"
+            + transaction.getSender() + ";"
+            + transaction.getRecipient() + ";"
+            + to_string(transaction.getValue()) + ";"
+            + to_string(transaction.getNumOfInputs()) + ";"
+            + to_string(transaction.getTimestamp()) + "\n";
+}
+
+string Snapshot::spentLine(const SnapshotTransaction &transaction) const
+{
+    return "SPENT " + transaction.hash + ";" + to_string(transaction.value) + "\n";
+}
+
+string Snapshot::balanceLine(const SnapshotBalance &balance) const
+{
+    return "BALANCE " + balance.address + ";" + to_string(balance.balance) + "\n";
+}
+
+vector<string> Snapshot::split(const string &line)
+{
+    vector<string> fields;
+    size_t start = 0, end;
+    while ((end = line.find(';', start)) != string::npos)
+    {
+        fields.push_back(line.substr(start, end - start));
+        start = end + 1;
+    }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+bool Snapshot::parseLine(const string &type, const vector<string> &fields)
+{
+    if (type == "HEIGHT" && fields.size() == 1)
+    {
+        height = stoi(fields.at(0));
+    }
+    else if (type == "HEADER" && fields.size() == 8)
+    {
+        double ln;
+        vector<unsigned char> ln_copy = base64_decode(fields.at(4));
+        if (ln_copy.size() < sizeof(double))
+        {
+            return false;
+        }
+        memcpy(&ln, ln_copy.data(), sizeof(double));
+        Block block(fields.at(2), fields.at(1), fields.at(3), stol(fields.at(5)), {}, stoi(fields.at(0)));
+        block.setLn(ln);
+        block.setNumTrans(stoi(fields.at(6)));
+        block.setCertificate(fields.at(7));
+        headers.push_back(block);
+    }
+    else if (type == "OUTPUT" && fields.size() == 7)
+    {
+        SnapshotOutput output;
+        output.block = stoi(fields.at(0));
+        output.transaction = Transaction(fields.at(2), fields.at(3), stoi(fields.at(4)), fields.at(1), stol(fields.at(6)));
+        output.transaction.setNumOfInputs(stoi(fields.at(5)));
+        outputs.push_back(output);
+    }
+    else if (type == "SPENT" && fields.size() == 2)
+    {
+        SnapshotTransaction transaction;
+        transaction.hash = fields.at(0);
+        transaction.value = stoi(fields.at(1));
+        spent.push_back(transaction);
+    }
+    else if (type == "BALANCE" && fields.size() == 2)
+    {
+        SnapshotBalance balance;
+        balance.address = fields.at(0);
+        balance.balance = stoi(fields.at(1));
+        balances.push_back(balance);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
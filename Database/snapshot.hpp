@@ -0,0 +1,67 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include "../Chain/block.hpp"
+#include "../Chain/transactions.hpp"
+#include "../libs/sha1.hpp"
+#include "../sodiumpp/include/sodiumpp/base64.h"
+
+using namespace std;
+
+/**
+ * an unspent transaction output at the snapshot height
+ * together with the index of the block, that contains it
+ */
+struct SnapshotOutput {
+    int block;
+    Transaction transaction;
+};
+
+/**
+ * a transaction below the snapshot height, that is already spent.
+ * only its hash is kept, so replays can still be detected
+ */
+struct SnapshotTransaction {
+    string hash;
+    int value;
+};
+
+struct SnapshotBalance {
+    string address;
+    int balance;
+};
+
+/**
+ * the chain state at a certain height: the block headers,
+ * the UTXO set and the balance of every participant.
+ * the STATE line commits to the height, the last header and the state sections,
+ * the importer compares it with a trusted value. the file ends with a
+ * SHA1 checksum over all previous lines, that only detects corruption
+ */
+class Snapshot
+{
+public:
+    Snapshot();
+    bool save(string file);
+    bool load(string file);
+    string stateHash() const;
+
+    int height;
+    vector<Block> headers;
+    vector<SnapshotOutput> outputs;
+    vector<SnapshotTransaction> spent;
+    vector<SnapshotBalance> balances;
+
+private:
+    vector<string> split(const string &line);
+    string outputLine(const SnapshotOutput &output) const;
+    string spentLine(const SnapshotTransaction &transaction) const;
+    string balanceLine(const SnapshotBalance &balance) const;
+    bool parseLine(const string &type, const vector<string> &fields);
+};
+
+#endif // SNAPSHOT_H
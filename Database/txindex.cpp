@@ -0,0 +1,263 @@
+#include "txindex.hpp"
+
+TxIndex::TxIndex()
+    :capacity(0), removed(0), lookups(0), filterNegatives(0), falsePositives(0)
+{
+    rebuildFilter();
+}
+
+/**
+ * @brief TxIndex::TxIdHash::operator ()
+ * the id is a sha1 hash already, so its first bytes are used directly
+ */
+size_t TxIndex::TxIdHash::operator()(const TxId &id) const
+{
+    size_t hash;
+    memcpy(&hash, id.data() + 12, sizeof(size_t));
+    return hash;
+}
+
+void TxIndex::clear()
+{
+    lock_guard<mutex> lock(indexMutex);
+    transactions.clear();
+    blocks.clear();
+    removed = 0;
+    rebuildFilter();
+}
+
+/**
+ * @brief TxIndex::toId
+ * converts the hash of a transaction to 20 bytes.
+ * the hashes of miner transactions are hex encoded sha1 hashes,
+ * the signed hashes of other transactions are hashed with sha1 first
+ * @param hash of the transaction
+ * @param id binary id
+ */
+void TxIndex::toId(const string &hash, TxId &id)
+{
+    string hex = hash;
+    if (hex.size() != 2 * id.size() || hex.find_first_not_of("0123456789abcdef") != string::npos)
+    {
+        SHA1 idHash;
+        idHash.update(hash);
+        hex = idHash.final();
+    }
+    for (unsigned int i = 0; i < id.size(); i++)
+    {
+        id[i] = stoi(hex.substr(2 * i, 2), nullptr, 16);
+    }
+}
+
+/**
+ * @brief TxIndex::add
+ * adds a transaction of the main chain
+ * @param hash of the transaction
+ * @param block index of the block, -1 for transactions of the pruned base
+ * @param value of the transaction
+ */
+void TxIndex::add(const string &hash, int block, int value)
+{
+    TxId id;
+    toId(hash, id);
+    lock_guard<mutex> lock(indexMutex);
+    insert(id, block, value);
+}
+
+/**
+ * @brief TxIndex::replaceBlocks
+ * sets the transactions of blocks, that were appended
+ * to the main chain or replaced blocks of it
+ * @param newBlocks new blocks of the main chain
+ */
+void TxIndex::replaceBlocks(const vector<Block> &newBlocks)
+{
+    lock_guard<mutex> lock(indexMutex);
+    for (unsigned int b = 0; b < newBlocks.size(); b++)
+    {
+        remove(newBlocks.at(b).getIndex());
+    }
+    for (unsigned int b = 0; b < newBlocks.size(); b++)
+    {
+        vector<Transaction> blockTransactions = newBlocks.at(b).getTransaction();
+        for (unsigned int t = 0; t < blockTransactions.size(); t++)
+        {
+            TxId id;
+            toId(blockTransactions.at(t).getHash(), id);
+            insert(id, newBlocks.at(b).getIndex(), blockTransactions.at(t).getValue());
+        }
+    }
+}
+
+/**
+ * @brief TxIndex::truncate
+ * removes the transactions of the block and all later blocks
+ * @param height first block to remove
+ */
+void TxIndex::truncate(int height)
+{
+    lock_guard<mutex> lock(indexMutex);
+    while (!blocks.empty() && blocks.rbegin()->first >= height)
+    {
+        remove(blocks.rbegin()->first);
+    }
+}
+
+/**
+ * @brief TxIndex::find
+ * @param hash of the transaction
+ * @param block index of the block containing the transaction, -1 for the pruned base
+ * @param value of the transaction
+ * @return true if the transaction is on the main chain
+ */
+bool TxIndex::find(const string &hash, int &block, int &value)
+{
+    TxId id;
+    toId(hash, id);
+    lock_guard<mutex> lock(indexMutex);
+    lookups++;
+    if (!mayContain(id))
+    {
+        filterNegatives++;
+        return false;
+    }
+    unordered_map<TxId, Entry, TxIdHash>::iterator entry = transactions.find(id);
+    if (entry == transactions.end())
+    {
+        falsePositives++;
+        return false;
+    }
+    block = entry->second.block;
+    value = entry->second.value;
+    return true;
+}
+
+/**
+ * @brief TxIndex::getStats
+ * @return size, memory usage and false positive rate of the index
+ */
+string TxIndex::getStats()
+{
+    lock_guard<mutex> lock(indexMutex);
+    size_t filterBytes = filter.size() * sizeof(uint64_t);
+    size_t setBytes = transactions.size() * (sizeof(TxId) + sizeof(Entry) + 2 * sizeof(void*))
+            + transactions.bucket_count() * sizeof(void*);
+    size_t blockBytes = blocks.size() * (sizeof(int) + sizeof(vector<TxId>) + 4 * sizeof(void*))
+            + transactions.size() * sizeof(TxId);
+
+    double bits = filter.size() * 64;
+    double stored = transactions.size() + removed;
+    double expected = pow(1 - exp(-BITS_PER_BLOCK_ID * stored / bits), BITS_PER_BLOCK_ID);
+    uint64_t misses = filterNegatives + falsePositives;
+    double observed = misses == 0 ? 0 : (double)falsePositives / misses;
+
+    stringstream stats;
+    stats << "transactions:        " << transactions.size() << endl
+          << "lookups:             " << lookups << endl
+          << "rejected by filter:  " << filterNegatives << endl
+          << "false positives:     " << falsePositives << endl
+          << "false positive rate: " << observed * 100 << "% (expected " << expected * 100 << "%)" << endl
+          << "filter memory:       " << filterBytes << " bytes" << endl
+          << "set memory:          " << setBytes + blockBytes << " bytes" << endl;
+    return stats.str();
+}
+
+void TxIndex::insert(const TxId &id, int block, int value)
+{
+    Entry entry = { block, value };
+    if (!transactions.insert(make_pair(id, entry)).second)
+    {
+        //the transaction is already known, only its block changes
+        vector<TxId> &ids = blocks[transactions[id].block];
+        for (unsigned int i = 0; i < ids.size(); i++)
+        {
+            if (ids.at(i) == id)
+            {
+                ids.erase(ids.begin() + i);
+                break;
+            }
+        }
+        transactions[id] = entry;
+    }
+    blocks[block].push_back(id);
+    if (transactions.size() + removed > capacity)
+    {
+        rebuildFilter();
+    }
+    else
+    {
+        insertFilter(id);
+    }
+}
+
+void TxIndex::remove(int height)
+{
+    map<int, vector<TxId> >::iterator block = blocks.find(height);
+    if (block == blocks.end())
+    {
+        return;
+    }
+    for (unsigned int i = 0; i < block->second.size(); i++)
+    {
+        transactions.erase(block->second.at(i));
+    }
+    //the bits of removed ids stay set until the filter is built again
+    removed += block->second.size();
+    blocks.erase(block);
+    if (removed > capacity / 4)
+    {
+        rebuildFilter();
+    }
+}
+
+/**
+ * @brief TxIndex::insertFilter
+ * the first 8 bytes of the id select the block of the filter,
+ * the following bytes are split into 9 bit positions inside the block
+ */
+void TxIndex::insertFilter(const TxId &id)
+{
+    uint64_t start;
+    memcpy(&start, id.data(), sizeof(uint64_t));
+    uint64_t *block = filter.data() + (start % (filter.size() / WORDS_PER_BLOCK)) * WORDS_PER_BLOCK;
+    for (int i = 0; i < BITS_PER_BLOCK_ID; i++)
+    {
+        int bit = i * 9;
+        int position = ((id[8 + bit / 8] << 8 | id[9 + bit / 8]) >> (7 - bit % 8)) & 511;
+        block[position / 64] |= (uint64_t)1 << (position % 64);
+    }
+}
+
+bool TxIndex::mayContain(const TxId &id) const
+{
+    uint64_t start;
+    memcpy(&start, id.data(), sizeof(uint64_t));
+    const uint64_t *block = filter.data() + (start % (filter.size() / WORDS_PER_BLOCK)) * WORDS_PER_BLOCK;
+    for (int i = 0; i < BITS_PER_BLOCK_ID; i++)
+    {
+        int bit = i * 9;
+        int position = ((id[8 + bit / 8] << 8 | id[9 + bit / 8]) >> (7 - bit % 8)) & 511;
+        if (!(block[position / 64] & ((uint64_t)1 << (position % 64))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief TxIndex::rebuildFilter
+ * sizes the filter for twice the stored ids and inserts them again.
+ * this also clears the bits of removed ids
+ */
+void TxIndex::rebuildFilter()
+{
+    capacity = max(MIN_CAPACITY, 2 * transactions.size());
+    size_t numBlocks = (capacity * BITS_PER_ID + 511) / 512;
+    filter.assign(numBlocks * WORDS_PER_BLOCK, 0);
+    removed = 0;
+    for (unordered_map<TxId, Entry, TxIdHash>::iterator entry = transactions.begin(); entry != transactions.end(); entry++)
+    {
+        insertFilter(entry->first);
+    }
+}
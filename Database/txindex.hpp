@@ -0,0 +1,67 @@
+#ifndef TXINDEX_H
+#define TXINDEX_H
+#include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <sstream>
+#include "../Chain/block.hpp"
+#include "../libs/sha1.hpp"
+
+using namespace std;
+
+/**
+ * transactions of the main chain by their id.
+ * the ids are stored as 20 byte binary sha1 hashes in an exact set.
+ * a blocked bloom filter is checked first, so most lookups of
+ * unknown transactions are answered without touching the set.
+ * every id sets its bits inside one 512 bit block of the filter,
+ * which keeps a lookup inside a single cache line
+ */
+class TxIndex
+{
+public:
+    TxIndex();
+    void clear();
+    void add(const string &hash, int block, int value);
+    void replaceBlocks(const vector<Block> &blocks);
+    void truncate(int height);
+    bool find(const string &hash, int &block, int &value);
+    string getStats();
+
+private:
+    typedef array<unsigned char, 20> TxId;
+    struct TxIdHash {
+        size_t operator()(const TxId &id) const;
+    };
+    struct Entry {
+        int block;
+        int value;
+    };
+    static void toId(const string &hash, TxId &id);
+    void insert(const TxId &id, int block, int value);
+    void remove(int height);
+    void insertFilter(const TxId &id);
+    bool mayContain(const TxId &id) const;
+    void rebuildFilter();
+    unordered_map<TxId, Entry, TxIdHash> transactions;
+    map<int, vector<TxId> > blocks;     //ids per block, needed to disconnect blocks
+    vector<uint64_t> filter;
+    size_t capacity;                    //number of ids the filter is sized for
+    size_t removed;                     //ids removed from the set, but not from the filter
+    uint64_t lookups;
+    uint64_t filterNegatives;
+    uint64_t falsePositives;
+    mutex indexMutex;
+    const size_t MIN_CAPACITY = 1024;
+    const size_t BITS_PER_ID = 16;
+    const int WORDS_PER_BLOCK = 8;      //512 bit
+    const int BITS_PER_BLOCK_ID = 8;    //bits set per id, k
+};
+
+#endif // TXINDEX_H
@@ -342,11 +342,22 @@ typedef struct blockHeader {
 		double luckyNumber;
 } blockHeader;
 
+/*duration of the phases of a proof in microseconds*/
+typedef struct proofTiming {
+		uint64_t session;
+		uint64_t unseal;
+		uint64_t counter;
+		uint64_t random;
+		uint64_t wait;
+		uint64_t sign;
+} proofTiming;
+
 
 
 #ifdef __cplusplus
 int addProof(std::string merkle, std::string prev, double *luckyNumber, std::string *cert);
 bool verifyProof(std::string merkle, std::string prevBlock, double luckyNumber, std::string certificate);
+bool getProofTiming(proofTiming *timing);
 #endif
 
 #if defined(__cplusplus)
@@ -34,6 +34,14 @@
 
 #include <unistd.h>
 #include <pwd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <chrono>
 
 #include "sgx_urts.h"
 #include "App.h"
@@ -46,6 +54,11 @@ using namespace std;
 /*Global EID shared by multiple threads*/
 sgx_enclave_id_t global_eid = 0;
 
+const char *KEYS_FILENAME = "keys.txt"; //public keys of all trusted enclaves
+const char KEY_ID_SEPARATOR = ':'; //separates the signature and the key id in a certificate
+const int KEY_ID_SIZE = 4; //bytes of the key hash used as key id
+const size_t VERIFIED_CACHE_SIZE = 4096; //number of verified proofs that are remembered
+
 extern "C" {
 
     void *memset_s(void *s, int c, size_t n) {
@@ -141,70 +154,244 @@ int SGX_CDECL main(int argc, char *argv[]) {
     return 0;
 }
 
-bool verifyProof(string merkle, string prevBlock, double luckyNumber, string certificate) {
+/*
+  Trusted keys from keys.txt. The file is read once and read again
+  when its modification time or size changes.
+*/
+typedef struct trustedKey {
+    sgx_ec256_public_t key;
+    string id;
+} trustedKey;
+
+static vector<trustedKey> trustedKeys;
+static time_t keysModified = 0;
+static off_t keysSize = -1;
+static mutex keysMutex;
+
+/*
+  Already verified (header hash, certificate) pairs, the most recent first.
+*/
+static list<string> verifiedOrder;
+static unordered_map<string, list<string>::iterator> verifiedProofs;
+static mutex verifiedMutex;
+
+/*ECC context of the calling thread, opened once and closed when the thread ends*/
+class EccContext {
+public:
+    EccContext() : handle(NULL), opened(false) {}
+    ~EccContext() {
+        if (opened) {
+            sgx_ecc256_close_context(handle);
+        }
+    }
+    sgx_ecc_state_handle_t get() {
+        if (!opened) {
+            opened = sgx_ecc256_open_context(&handle) == SGX_SUCCESS;
+        }
+        return opened ? handle : NULL;
+    }
+private:
+    sgx_ecc_state_handle_t handle;
+    bool opened;
+};
 
-    blockHeader *header = (blockHeader *) malloc(sizeof(blockHeader));
-    memcpy(header->merkleTree, merkle.c_str(), 40);
-    memcpy(header->prevBlock, prevBlock.c_str(), 40);
-    header->luckyNumber = luckyNumber;
+static thread_local EccContext eccContext;
 
-    uint8_t result;
-    sgx_ecc_state_handle_t eccHandle;
-    sgx_ec256_public_t *publicKey = (sgx_ec256_public_t *) malloc(sizeof(sgx_ec256_public_t));
-    sgx_sha256_hash_t *hash = (sgx_sha256_hash_t *) malloc(sizeof(sgx_sha256_hash_t));
+/*Prepares the next proof in the enclave while the node handles the last one*/
+static thread preparer;
 
-    sgx_ec256_signature_t *signature = (sgx_ec256_signature_t *) malloc(sizeof(sgx_ec256_signature_t));
-    vector<unsigned char> data = base64_decode(certificate);
-    /*if (data.size() != sizeof(sgx_ec256_signature_t)) {
-      return SGX_ERROR_UNEXPECTED;
-    }*/
-    memcpy(signature, data.data(), sizeof(sgx_ec256_signature_t));
+/*Key id: the first bytes of the sha256 hash of the public key in hex*/
+string getKeyId(const sgx_ec256_public_t *publicKey) {
 
-    sgx_status_t status = sgx_sha256_msg((uint8_t *) header, sizeof(blockHeader), hash);
-    if (status != SGX_SUCCESS) {
+    sgx_sha256_hash_t hash;
+    if (sgx_sha256_msg((const uint8_t *) publicKey, sizeof(sgx_ec256_public_t), &hash) != SGX_SUCCESS) {
+        return "";
+    }
+    char id[2 * KEY_ID_SIZE + 1];
+    for (int i = 0; i < KEY_ID_SIZE; i++) {
+        snprintf(id + 2 * i, 3, "%02x", hash[i]);
+    }
+    return string(id);
+}
+
+/*Reads keys.txt again if it changed since the last call*/
+bool loadTrustedKeys() {
+
+    struct stat keysStat;
+    if (stat(KEYS_FILENAME, &keysStat) != 0) {
         return FALSE;
     }
+    if (keysStat.st_mtime == keysModified && keysStat.st_size == keysSize) {
+        return TRUE;
+    }
 
-    status = sgx_ecc256_open_context(&eccHandle);
-    if (status != SGX_SUCCESS) {
+    ifstream f(KEYS_FILENAME);
+    if (!f.good()) {
         return FALSE;
     }
+    vector<trustedKey> keys;
+    string publicKeyBase64;
+    while (getline(f, publicKeyBase64)) {
+        vector<unsigned char> publicKeyVector = base64_decode(publicKeyBase64);
+        if (publicKeyVector.size() < sizeof(sgx_ec256_public_t)) {
+            continue;
+        }
+        trustedKey key;
+        memcpy(&key.key, publicKeyVector.data(), sizeof(sgx_ec256_public_t));
+        key.id = getKeyId(&key.key);
+        keys.push_back(key);
+    }
+    trustedKeys = keys;
+    keysModified = keysStat.st_mtime;
+    keysSize = keysStat.st_size;
+    return TRUE;
+}
 
-    FILE *f = fopen("keys.txt", "r");
-    if (f == NULL) {
+bool isVerified(const string &proof) {
+
+    lock_guard<mutex> lock(verifiedMutex);
+    unordered_map<string, list<string>::iterator>::iterator entry = verifiedProofs.find(proof);
+    if (entry == verifiedProofs.end()) {
         return FALSE;
     }
+    verifiedOrder.splice(verifiedOrder.begin(), verifiedOrder, entry->second);
+    return TRUE;
+}
 
-    char c;
-    c = fgetc(f);
-    while (c != EOF) {
-        string publicKeyBase64 = "";
-        while (c != '\n' && c != EOF) {
-            publicKeyBase64 += c;
-            c = fgetc(f);
-        }
-        c = fgetc(f);
+void addVerified(const string &proof) {
+
+    lock_guard<mutex> lock(verifiedMutex);
+    if (verifiedProofs.find(proof) != verifiedProofs.end()) {
+        return;
+    }
+    verifiedOrder.push_front(proof);
+    verifiedProofs[proof] = verifiedOrder.begin();
+    if (verifiedOrder.size() > VERIFIED_CACHE_SIZE) {
+        verifiedProofs.erase(verifiedOrder.back());
+        verifiedOrder.pop_back();
+    }
+}
 
+/*
+  Creates the lucky number and the certificate for a block.
+  The certificate is the base64 signature followed by the id of the signing key.
+*/
+int addProof(string merkle, string prev, double *luckyNumber, string *cert) {
+
+    blockHeader header;
+    memset(&header, 0, sizeof(blockHeader));
+    memcpy(header.merkleTree, merkle.c_str(), 40);
+    memcpy(header.prevBlock, prev.c_str(), 40);
+
+    if (global_eid == 0 && initialize_enclave() < 0) {
+        return -1;
+    }
+    if (preparer.joinable()) {
+        preparer.join();
+    }
+
+    sgx_status_t status;
+    sgx_ec256_signature_t signature;
+    sgx_status_t ret = ecall_get_proof(global_eid, &status, &header, sizeof(blockHeader), (uint8_t *) &signature);
+    if (ret != SGX_SUCCESS || status != SGX_SUCCESS) {
+        print_error_message(ret != SGX_SUCCESS ? ret : status);
+        return -1;
+    }
+    preparer = thread([]() {
+        sgx_status_t prepareStatus;
+        ecall_prepare_proof(global_eid, &prepareStatus);
+    });
+    *luckyNumber = header.luckyNumber;
+    *cert = base64_encode((const unsigned char*) &signature, sizeof(sgx_ec256_signature_t));
+
+    //the own key was written to publicKey.txt by the enclave
+    ifstream f("publicKey.txt");
+    string publicKeyBase64;
+    if (getline(f, publicKeyBase64)) {
         vector<unsigned char> publicKeyVector = base64_decode(publicKeyBase64);
-        memcpy(publicKey, publicKeyVector.data(), sizeof(sgx_ec256_public_t));
+        if (publicKeyVector.size() >= sizeof(sgx_ec256_public_t)) {
+            *cert += KEY_ID_SEPARATOR + getKeyId((const sgx_ec256_public_t *) publicKeyVector.data());
+        }
+    }
+    return 0;
+}
+
+/*Returns the duration of the phases of the last proof*/
+bool getProofTiming(proofTiming *timing) {
+
+    if (global_eid == 0) {
+        return FALSE;
+    }
+    sgx_status_t status;
+    sgx_status_t ret = ecall_get_timing(global_eid, &status, timing, sizeof(proofTiming));
+    return ret == SGX_SUCCESS && status == SGX_SUCCESS;
+}
+
+/*
+  Verifies the certificate of a block. With a key id in the certificate only
+  the matching key is checked, otherwise every trusted key is tried.
+*/
+bool verifyProof(string merkle, string prevBlock, double luckyNumber, string certificate) {
+
+    blockHeader header;
+    memset(&header, 0, sizeof(blockHeader));
+    memcpy(header.merkleTree, merkle.c_str(), 40);
+    memcpy(header.prevBlock, prevBlock.c_str(), 40);
+    header.luckyNumber = luckyNumber;
+
+    sgx_sha256_hash_t hash;
+    sgx_status_t status = sgx_sha256_msg((uint8_t *) &header, sizeof(blockHeader), &hash);
+    if (status != SGX_SUCCESS) {
+        return FALSE;
+    }
+    string proof = string((const char *) hash, sizeof(sgx_sha256_hash_t)) + certificate;
+    if (isVerified(proof)) {
+        return TRUE;
+    }
 
-        status = sgx_ecdsa_verify((uint8_t *) hash, sizeof(sgx_sha256_hash_t), publicKey, signature, &result, eccHandle);
+    string keyId = "";
+    size_t separator = certificate.find(KEY_ID_SEPARATOR);
+    if (separator != string::npos) {
+        keyId = certificate.substr(separator + 1);
+        certificate = certificate.substr(0, separator);
+    }
+    vector<unsigned char> data = base64_decode(certificate);
+    if (data.size() < sizeof(sgx_ec256_signature_t)) {
+        return FALSE;
+    }
+    sgx_ec256_signature_t signature;
+    memcpy(&signature, data.data(), sizeof(sgx_ec256_signature_t));
+
+    sgx_ecc_state_handle_t eccHandle = eccContext.get();
+    if (eccHandle == NULL) {
+        return FALSE;
+    }
+
+    //only the keys matching the key id are checked
+    vector<sgx_ec256_public_t> candidates;
+    keysMutex.lock();
+    if (!loadTrustedKeys()) {
+        keysMutex.unlock();
+        return FALSE;
+    }
+    for (size_t i = 0; i < trustedKeys.size(); i++) {
+        if (keyId.empty() || trustedKeys[i].id == keyId) {
+            candidates.push_back(trustedKeys[i].key);
+        }
+    }
+    keysMutex.unlock();
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        uint8_t result;
+        status = sgx_ecdsa_verify((uint8_t *) &hash, sizeof(sgx_sha256_hash_t), &candidates[i], &signature, &result, eccHandle);
         if (status != SGX_SUCCESS) {
             return FALSE;
         }
         if (result == SGX_EC_VALID) {
-            status = sgx_ecc256_close_context(eccHandle);
-            if (status != SGX_SUCCESS) {
-                return FALSE;
-            }
+            addVerified(proof);
             return TRUE;
         }
     }
-    fclose(f);
-    status = sgx_ecc256_close_context(eccHandle);
-    if (status != SGX_SUCCESS) {
-        return FALSE;
-    }
     return FALSE;
 }
 
@@ -223,6 +410,12 @@ void ocall_sleep(unsigned int time) {
     sleep(time);
 }
 
+/*OCall returns the time in microseconds for the timing of the enclave*/
+void ocall_get_time(uint64_t *time) {
+
+    *time = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 /*OCall writes data to a file*/
 int ocall_save_in_file(const char *filename, uint8_t *data, uint32_t sealedDataSize) {
 
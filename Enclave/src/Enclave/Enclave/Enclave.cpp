@@ -11,130 +11,228 @@
 #include "Enclave.h"
 #include "Enclave_t.h"  /* print_string */
 
-/*Returns a random number between 0 and 1 */
-sgx_status_t ecall_get_proof(blockHeader *header, uint32_t headerSize, uint8_t *certificate) {
+proofTiming timing; //duration of the phases of the last proof
 
-    uint32_t mcValue, mcValueOld;
-    unsigned int waitingPeriod;
-    double luckyNumber = 0;
+/*
+  Prepares the next proof: opens the PSE session and unseals the keys if they are
+  not resident yet and increments the monotonic counter. The app calls it while
+  it is busy with other work, so the next ecall_get_proof starts with the lucky number.
+*/
+sgx_status_t ecall_prepare_proof() {
 
-    do {
-        status = sgx_create_pse_session();
-        if (status == SGX_ERROR_BUSY) {
-            ocall_sleep(10); //if the service is busy we wait 10 seconds before retrying
-        } else if (status != SGX_SUCCESS && status != SGX_ERROR_BUSY) {
-            return status;
-        }
-    } while(status == SGX_ERROR_BUSY);
+    uint64_t start;
 
-    if (loadData() != SGX_SUCCESS) {
-        //create monotonic counter to prevent concurrency
-        do {
-            status = sgx_create_monotonic_counter(&keys.mc, &mcValue);
-            if (status == SGX_ERROR_BUSY) {
-                ocall_sleep(10); //if the service is busy we wait 10 seconds before retrying
-            } else if (status != SGX_SUCCESS && status != SGX_ERROR_BUSY) {
-                return status;
-            }
-        } while(status == SGX_ERROR_BUSY);
-        /*
-          Generates public and private Key for signing blocks.
-          If the keys will be new generated and not known to the
-          network the block wont be accepted. This supports preventing
-          concurrency. The keys will be new generated if and only if
-          the file with the keys does not exist.
-        */
-        status = createKeys();
+    if (prepared) {
+        return SGX_SUCCESS;
+    }
+
+    start = now();
+    status = openSession();
+    if (status != SGX_SUCCESS) {
+        return status;
+    }
+    timing.session = now() - start;
+
+    start = now();
+    status = ensureKeys();
+    if (status != SGX_SUCCESS) {
+        return status;
+    }
+    timing.unseal = now() - start;
+
+    start = now();
+    status = retryBusy(INCREMENT_COUNTER, &mcValueOld);
+    if (status == SGX_ERROR_AE_SESSION_INVALID) {
+        //the session expired, it is opened again once
+        sessionOpen = 0;
+        status = openSession();
         if (status != SGX_SUCCESS) {
             return status;
         }
-        int ret;
-        ocall_save_public_key(&ret, (uint8_t *) &keys.publicKey, sizeof(sgx_ec256_public_t));
-        if (ret < 0) {
-          return SGX_ERROR_UNEXPECTED;
-        }
+        status = retryBusy(INCREMENT_COUNTER, &mcValueOld);
+    }
+    if (status != SGX_SUCCESS) {
+        return status;
     }
+    timing.counter = now() - start;
 
-    do {
-        status = sgx_increment_monotonic_counter(&keys.mc, &mcValueOld);
-        if (status == SGX_ERROR_BUSY) {
-            ocall_sleep(10); //if the service is busy we wait 10 seconds before retrying
-        } else if (status != SGX_SUCCESS && status != SGX_ERROR_BUSY) {
+    prepared = 1;
+    return SGX_SUCCESS;
+}
+
+/*Returns the duration of the phases of the last proof in microseconds*/
+sgx_status_t ecall_get_timing(proofTiming *lastTiming, uint32_t timingSize) {
+
+    if (timingSize != sizeof(proofTiming)) {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    memcpy(lastTiming, &timing, sizeof(proofTiming));
+    return SGX_SUCCESS;
+}
+
+/*Returns a random number between 0 and 1 */
+sgx_status_t ecall_get_proof(blockHeader *header, uint32_t headerSize, uint8_t *certificate) {
+
+    uint32_t mcValue;
+    unsigned int waitingPeriod;
+    double luckyNumber = 0;
+    uint64_t start;
+
+    if (!prepared) {
+        timing.session = timing.unseal = timing.counter = 0;
+        status = ecall_prepare_proof();
+        if (status != SGX_SUCCESS) {
             return status;
         }
-    } while(status == SGX_ERROR_BUSY);
-
-    status = saveData();
-    if (status != SGX_SUCCESS) {
-      return status;
     }
+    //the counter value of a preparation is used for one proof only
+    prepared = 0;
 
+    start = now();
     status = getLuckyNumber(&luckyNumber);
     if (status != SGX_SUCCESS) {
         return status;
     }
+    timing.random = now() - start;
     ocall_print_string("(Enclave) Lucky number generated!\n");
 
     //calculate waiting period
     waitingPeriod = round(MAX_WAITING_TIME - luckyNumber * MAX_WAITING_TIME);
 
     //waiting a time linear to the lucky number before returning the value
+    start = now();
     status = wait(waitingPeriod);
     if (status != SGX_SUCCESS) {
         return status;
     }
+    timing.wait = now() - start;
     ocall_print_string("(Enclave) Waiting period expired!\n");
 
-    status = loadData();
-    if (status != SGX_SUCCESS) {
-      return status;
-    }
-
-    status =  sgx_read_monotonic_counter(&keys.mc, &mcValue);
-    if (status != SGX_SUCCESS) {
-    return status;
+    start = now();
+    status = retryBusy(READ_COUNTER, &mcValue);
+    if (status == SGX_ERROR_AE_SESSION_INVALID) {
+        sessionOpen = 0;
+        status = openSession();
+        if (status != SGX_SUCCESS) {
+            return status;
+        }
+        status = retryBusy(READ_COUNTER, &mcValue);
     }
-
-    status = sgx_close_pse_session();
     if (status != SGX_SUCCESS) {
         return status;
     }
+    timing.counter += now() - start;
 
     //checks if another enclave is running
     if (mcValue != mcValueOld) {
         return SGX_ERROR_MC_NOT_FOUND;
     } else {
 
+        start = now();
         header->luckyNumber = luckyNumber;
 
-        sgx_sha256_hash_t *hash = (sgx_sha256_hash_t *) malloc(sizeof(sgx_sha256_hash_t));
-        uint8_t *signature = (uint8_t *) malloc(sizeof(sgx_ec256_signature_t));
+        sgx_sha256_hash_t hash;
+        sgx_ec256_signature_t signature;
 
-        status = sgx_sha256_msg((uint8_t *) header, headerSize, hash);
+        status = sgx_sha256_msg((uint8_t *) header, headerSize, &hash);
         if (status != SGX_SUCCESS) {
             return status;
         }
 
-        status = sign((uint8_t *) hash, sizeof(sgx_sha256_hash_t), signature);
+        status = sign((uint8_t *) &hash, sizeof(sgx_sha256_hash_t), (uint8_t *) &signature);
         if (status != SGX_SUCCESS) {
             return status;
         }
 
-        memcpy(certificate, signature, sizeof(sgx_ec256_signature_t));
+        memcpy(certificate, &signature, sizeof(sgx_ec256_signature_t));
+        timing.sign = now() - start;
 
-        /*sgx_report_data_t reportData = {0};
-        memcpy(reportData.d, signature, sizeof(sgx_ec256_signature_t));
-        sgx_report_t *report = (sgx_report_t *) malloc(sizeof(sgx_report_t));
-        status = sgx_create_report(NULL, &reportData, report);
-        if (status != SGX_SUCCESS) {
+        return SGX_SUCCESS;
+    }
+}
+
+/*Opens the PSE session, if it is not open yet. The session stays open between proofs.*/
+sgx_status_t openSession() {
+
+    if (sessionOpen) {
+        return SGX_SUCCESS;
+    }
+    do {
+        status = sgx_create_pse_session();
+        if (status == SGX_ERROR_BUSY) {
+            ocall_sleep(10); //if the service is busy we wait 10 seconds before retrying
+        } else if (status != SGX_SUCCESS && status != SGX_ERROR_BUSY) {
             return status;
-        }*/
+        }
+    } while(status == SGX_ERROR_BUSY);
+    sessionOpen = 1;
+    return SGX_SUCCESS;
+}
+
+/*Unseals the keys, if they are not in the enclave yet. New keys are created if there is no sealed file.*/
+sgx_status_t ensureKeys() {
 
-        free(hash);
-        free(signature);
+    uint32_t mcValue;
 
+    if (keysLoaded) {
         return SGX_SUCCESS;
     }
+    if (loadData() != SGX_SUCCESS) {
+        //create monotonic counter to prevent concurrency
+        status = retryBusy(CREATE_COUNTER, &mcValue);
+        if (status != SGX_SUCCESS) {
+            return status;
+        }
+        /*
+          Generates public and private Key for signing blocks.
+          If the keys will be new generated and not known to the
+          network the block wont be accepted. This supports preventing
+          concurrency. The keys will be new generated if and only if
+          the file with the keys does not exist.
+        */
+        status = createKeys();
+        if (status != SGX_SUCCESS) {
+            return status;
+        }
+        int ret;
+        ocall_save_public_key(&ret, (uint8_t *) &keys.publicKey, sizeof(sgx_ec256_public_t));
+        if (ret < 0) {
+          return SGX_ERROR_UNEXPECTED;
+        }
+        //the keys and the counter do not change, so they are sealed only once
+        status = saveData();
+        if (status != SGX_SUCCESS) {
+          return status;
+        }
+    }
+    keysLoaded = 1;
+    return SGX_SUCCESS;
+}
+
+/*Runs a monotonic counter operation and retries it while the service is busy*/
+sgx_status_t retryBusy(int operation, uint32_t *mcValue) {
+
+    do {
+        if (operation == CREATE_COUNTER) {
+            status = sgx_create_monotonic_counter(&keys.mc, mcValue);
+        } else if (operation == INCREMENT_COUNTER) {
+            status = sgx_increment_monotonic_counter(&keys.mc, mcValue);
+        } else {
+            status = sgx_read_monotonic_counter(&keys.mc, mcValue);
+        }
+        if (status == SGX_ERROR_BUSY) {
+            ocall_sleep(10); //if the service is busy we wait 10 seconds before retrying
+        }
+    } while(status == SGX_ERROR_BUSY);
+    return status;
+}
+
+/*Time of the app in microseconds, only used for the timing of the phases*/
+uint64_t now() {
+
+    uint64_t time = 0;
+    ocall_get_time(&time);
+    return time;
 }
 
 /*Generates the lucky number*/
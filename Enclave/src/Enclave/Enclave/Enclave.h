@@ -53,8 +53,29 @@ typedef struct secretData {
 
 secretData keys;
 
+int sessionOpen = 0; //the PSE session is kept open between proofs
+int keysLoaded = 0; //the keys stay unsealed in the enclave
+int prepared = 0; //the counter was incremented for the next proof
+uint32_t mcValueOld; //counter value after the preparation
+
+const int CREATE_COUNTER = 0;
+const int INCREMENT_COUNTER = 1;
+const int READ_COUNTER = 2;
+
 sgx_status_t ecall_get_proof(struct blockHeader*, uint32_t, uint8_t*);
 
+sgx_status_t ecall_prepare_proof();
+
+sgx_status_t ecall_get_timing(struct proofTiming*, uint32_t);
+
+sgx_status_t openSession();
+
+sgx_status_t ensureKeys();
+
+sgx_status_t retryBusy(int, uint32_t*);
+
+uint64_t now();
+
 sgx_status_t getLuckyNumber(double*);
 
 sgx_status_t wait(unsigned int);
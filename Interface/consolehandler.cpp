@@ -20,7 +20,7 @@ void ConsoleHandler::OnKeyPressed(char cCurrent)
   {
     if (strString == "quit")
     {
-        client.closeDb();
+        client.shutdown();
         QCoreApplication::exit(0);
     }
     else if (strString == "mine")
@@ -49,6 +49,18 @@ void ConsoleHandler::OnKeyPressed(char cCurrent)
         client.executePrintMempool();
         strString.clear();
 
+    }
+    else if (strString == "print txindex")
+    {
+        client.executePrintTxIndex();
+        strString.clear();
+
+    }
+    else if (strString == "print proofs")
+    {
+        client.executePrintProofStats();
+        strString.clear();
+
     }
     else if (strString == "print keys")
     {
@@ -68,6 +80,41 @@ void ConsoleHandler::OnKeyPressed(char cCurrent)
         strString.clear();
 
     }
+    else if (strString == "start load")
+    {
+        client.startLoadGenerator();
+        strString.clear();
+    }
+    else if (strString == "stop load")
+    {
+        client.stopLoadGenerator();
+        strString.clear();
+    }
+    else if (strString == "print load")
+    {
+        client.executePrintLoad();
+        strString.clear();
+    }
+    else if (strString == "print validation")
+    {
+        client.executePrintValidation();
+        strString.clear();
+    }
+    else if (strString == "print queues")
+    {
+        client.executePrintQueues();
+        strString.clear();
+    }
+    else if (strString == "print peers")
+    {
+        client.executePrintPeers();
+        strString.clear();
+    }
+    else if (strString == "print trace")
+    {
+        client.executePrintTrace();
+        strString.clear();
+    }
     else if (strString == "print balance")
     {
         client.executeBalancePrinting(getPublicBkey());
@@ -111,6 +158,67 @@ void ConsoleHandler::OnKeyPressed(char cCurrent)
         client.executeHistoryPrinting();
         strString.clear();
     }
+    else if (strString.startsWith("export snapshot", Qt::CaseInsensitive))
+    {
+        QStringList paramsList = strString.split(" ");
+        if (paramsList.length() < 3 || paramsList.length() > 4)
+        {
+            cout << "Error: command \"export snapshot <file> <height>\" needs a file and an optional height" << endl;
+            cout << "Use this sample: export snapshot snapshot.txt 400" << endl;
+            strString.clear();
+            return;
+        }
+        int height = (paramsList.length() == 4) ? paramsList.at(3).toInt() : 0;
+        if (!client.executeExportSnapshot(paramsList.at(2).toUtf8().constData(), height))
+        {
+            cout << "exporting the snapshot failed" << endl;
+        }
+        strString.clear();
+    }
+    else if (strString.startsWith("log level", Qt::CaseInsensitive))
+    {
+        QStringList paramsList = strString.split(" ");
+        if (paramsList.length() != 3 || !Log::setLevel(paramsList.at(2).toLower().toStdString()))
+        {
+            cout << "Error: command \"log level <level>\" needs one of error, warning, info or debug" << endl;
+            cout << "Use this sample: log level debug" << endl;
+        }
+        strString.clear();
+    }
+    else if (strString.startsWith("export trace", Qt::CaseInsensitive))
+    {
+        QStringList paramsList = strString.split(" ");
+        if (paramsList.length() != 3)
+        {
+            cout << "Error: command \"export trace <file>\" needs 3 params to function" << endl;
+            cout << "Use this sample: export trace trace.json" << endl;
+            strString.clear();
+            return;
+        }
+        if (!client.executeExportTrace(paramsList.at(2).toUtf8().constData()))
+        {
+            cout << "exporting the trace failed" << endl;
+        }
+        strString.clear();
+    }
+    else if (strString.startsWith("import snapshot", Qt::CaseInsensitive))
+    {
+        QStringList paramsList = strString.split(" ");
+        if (paramsList.length() != 3 && paramsList.length() != 4)
+        {
+            cout << "Error: command \"import snapshot <file> <state hash>\" needs a file and the state hash of the snapshot" << endl;
+            cout << "the state hash can be left out, if snapshot_state_hash is set in the config" << endl;
+            cout << "Use this sample: import snapshot snapshot.txt 3f786850e387550fdab836ed7e6dc881de23001b" << endl;
+            strString.clear();
+            return;
+        }
+        string trustedState = paramsList.length() == 4 ? paramsList.at(3).toUtf8().constData() : "";
+        if (!client.executeImportSnapshot(paramsList.at(2).toUtf8().constData(), trustedState))
+        {
+            cout << "importing the snapshot failed" << endl;
+        }
+        strString.clear();
+    }
     else if (strString.contains("transaction", Qt::CaseInsensitive)) //TODO: define command
     {
         QString params = seperateParametersFromConsoleInput(strString);
@@ -0,0 +1,310 @@
+#include "addressbook.h"
+#include <algorithm>
+
+AddressBook::AddressBook()
+    :path(ADDRESS_BOOK_PATH)
+{
+}
+
+/**
+ * @brief AddressBook::load
+ * replaces the book with the saved peers. a missing file is an empty book
+ * @param path of the book, it is saved there again
+ * @return false if the file could not be read
+ */
+bool AddressBook::load(const string &path)
+{
+    this->path = path;
+    records.clear();
+    ifstream in(path.c_str());
+    if (!in.is_open())
+    {
+        return false;
+    }
+    string line;
+    while (getline(in, line))
+    {
+        vector<string> fields = split(line, ',');
+        //port 0 counts the invalid blocks of incoming peers without a known server
+        if (fields.size() < 9 || fields.at(0).empty() || toInt(fields.at(1)) < 0)
+        {
+            continue;
+        }
+        PeerRecord &record = get(fields.at(0), toInt(fields.at(1)));
+        record.lastSeen = toInt(fields.at(2));
+        record.failures = toInt(fields.at(3));
+        record.rttMs = toDouble(fields.at(4));
+        record.blockLatencyMs = toDouble(fields.at(5));
+        record.invalidBlocks = toInt(fields.at(6));
+        record.uptime = toInt(fields.at(7));
+        record.bannedUntil = toInt(fields.at(8));
+    }
+    return true;
+}
+
+/**
+ * @brief AddressBook::save
+ * writes the book to a temporary file and replaces the old one with it
+ * @return true if successful
+ */
+bool AddressBook::save()
+{
+    string temporary = path + ".tmp";
+    ofstream out(temporary.c_str(), ios::out | ios::trunc);
+    if (!out.is_open())
+    {
+        cout << "couldn't open address book " << temporary << endl;
+        return false;
+    }
+    for (auto it = records.begin(); it != records.end(); ++it)
+    {
+        const PeerRecord &record = it->second;
+        out << record.address.ip << "," << record.address.port << "," << record.lastSeen << ","
+            << record.failures << "," << record.rttMs << "," << record.blockLatencyMs << ","
+            << record.invalidBlocks << "," << record.uptime << "," << record.bannedUntil << "\n";
+    }
+    out.close();
+    return !out.fail() && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+/**
+ * @brief AddressBook::add
+ * adds an announced address or marks it as seen
+ * @return true if it was not known
+ */
+bool AddressBook::add(const string &ip, int port)
+{
+    if (ip.empty() || port <= 0 || port > 65535)
+    {
+        return false;
+    }
+    bool known = find(ip, port) != nullptr;
+    get(ip, port).lastSeen = Clock::instance().now();
+    return !known;
+}
+
+void AddressBook::connected(const string &ip, int port)
+{
+    PeerRecord &record = get(ip, port);
+    record.lastConnected = Clock::instance().now();
+    record.lastSeen = record.lastConnected;
+    record.failures = 0;
+}
+
+void AddressBook::disconnected(const string &ip, int port)
+{
+    PeerRecord *record = find(ip, port);
+    if (record && record->lastConnected > 0)
+    {
+        record->uptime += Clock::instance().now() - record->lastConnected;
+        record->lastConnected = 0;
+    }
+}
+
+void AddressBook::attempted(const string &ip, int port)
+{
+    get(ip, port).lastAttempt = Clock::instance().now();
+}
+
+void AddressBook::failed(const string &ip, int port)
+{
+    get(ip, port).failures++;
+}
+
+void AddressBook::addRoundTrip(const string &ip, int port, int ms)
+{
+    PeerRecord &record = get(ip, port);
+    record.rttMs = (record.rttMs == 0) ? ms : record.rttMs * 0.8 + ms * 0.2;
+}
+
+void AddressBook::addBlockLatency(const string &ip, int port, int ms)
+{
+    PeerRecord &record = get(ip, port);
+    record.blockLatencyMs = (record.blockLatencyMs == 0) ? ms : record.blockLatencyMs * 0.8 + ms * 0.2;
+}
+
+/**
+ * @brief AddressBook::addInvalidBlock
+ * @return true if the peer is banned now
+ */
+bool AddressBook::addInvalidBlock(const string &ip, int port)
+{
+    PeerRecord &record = get(ip, port);
+    record.invalidBlocks++;
+    if (record.invalidBlocks % MAX_INVALID_BLOCKS == 0)
+    {
+        record.bannedUntil = Clock::instance().now() + BAN_TIME;
+        cout << "banning peer " << ip << ":" << port << " for " << BAN_TIME << " s" << endl;
+        return true;
+    }
+    return false;
+}
+
+bool AddressBook::isBanned(const string &ip, int port)
+{
+    PeerRecord *record = find(ip, port);
+    return record && record->bannedUntil > Clock::instance().now();
+}
+
+double AddressBook::getScore(const string &ip, int port)
+{
+    PeerRecord *record = find(ip, port);
+    return record ? score(*record, Clock::instance().now()) : score(PeerRecord(), Clock::instance().now());
+}
+
+/**
+ * @brief AddressBook::selectOutbound
+ * the best scored addresses, that are not connected, not banned and
+ * were not tried too recently after failures
+ * @param count of addresses
+ * @param connected the addresses of the current peers
+ */
+vector<PeerAddress> AddressBook::selectOutbound(unsigned int count, const vector<PeerAddress> &connected)
+{
+    time_t now = Clock::instance().now();
+    vector<pair<double, PeerAddress> > candidates;
+    for (auto it = records.begin(); it != records.end(); ++it)
+    {
+        const PeerRecord &record = it->second;
+        bool isConnected = false;
+        for (unsigned int i = 0; i < connected.size(); i++)
+        {
+            isConnected |= (connected.at(i).ip == record.address.ip && connected.at(i).port == record.address.port);
+        }
+        if (isConnected || record.address.port <= 0 || record.bannedUntil > now
+                || record.lastAttempt + (time_t) RETRY_TIME * (record.failures + 1) > now)
+        {
+            continue;
+        }
+        candidates.push_back(make_pair(score(record, now), record.address));
+    }
+    sort(candidates.begin(), candidates.end(),
+         [](const pair<double, PeerAddress> &a, const pair<double, PeerAddress> &b) { return a.first > b.first; });
+    vector<PeerAddress> selected;
+    for (unsigned int i = 0; i < candidates.size() && selected.size() < count; i++)
+    {
+        selected.push_back(candidates.at(i).second);
+    }
+    return selected;
+}
+
+/**
+ * @brief AddressBook::getGossip
+ * @param count of addresses
+ * @return the best scored addresses, that were seen recently and are not banned
+ */
+vector<PeerAddress> AddressBook::getGossip(unsigned int count)
+{
+    time_t now = Clock::instance().now();
+    vector<pair<double, PeerAddress> > candidates;
+    for (auto it = records.begin(); it != records.end(); ++it)
+    {
+        const PeerRecord &record = it->second;
+        if (record.address.port > 0 && record.lastSeen + GOSSIP_AGE >= now && record.bannedUntil <= now)
+        {
+            candidates.push_back(make_pair(score(record, now), record.address));
+        }
+    }
+    sort(candidates.begin(), candidates.end(),
+         [](const pair<double, PeerAddress> &a, const pair<double, PeerAddress> &b) { return a.first > b.first; });
+    vector<PeerAddress> gossip;
+    for (unsigned int i = 0; i < candidates.size() && gossip.size() < count; i++)
+    {
+        gossip.push_back(candidates.at(i).second);
+    }
+    return gossip;
+}
+
+unsigned int AddressBook::size() const
+{
+    return records.size();
+}
+
+/**
+ * @brief AddressBook::print
+ * prints every peer with its stats and score
+ */
+void AddressBook::print()
+{
+    time_t now = Clock::instance().now();
+    cout << records.size() << " addresses" << endl;
+    for (auto it = records.begin(); it != records.end(); ++it)
+    {
+        const PeerRecord &record = it->second;
+        long uptime = record.uptime + (record.lastConnected > 0 ? now - record.lastConnected : 0);
+        cout << record.address.ip << ":" << record.address.port
+             << (record.lastConnected > 0 ? " connected" : "")
+             << (record.bannedUntil > now ? " banned" : "")
+             << ", score " << (int) score(record, now)
+             << ", rtt " << (int) record.rttMs << " ms"
+             << ", block latency " << (int) record.blockLatencyMs << " ms"
+             << ", invalid blocks " << record.invalidBlocks
+             << ", failures " << record.failures
+             << ", uptime " << uptime << " s" << endl;
+    }
+}
+
+PeerRecord* AddressBook::find(const string &ip, int port)
+{
+    auto it = records.find(key(ip, port));
+    return (it == records.end()) ? nullptr : &it->second;
+}
+
+PeerRecord& AddressBook::get(const string &ip, int port)
+{
+    PeerRecord *record = find(ip, port);
+    if (record)
+    {
+        return *record;
+    }
+    if (records.size() >= MAX_ADDRESSES)
+    {
+        evictOldest();
+    }
+    PeerRecord created = PeerRecord();
+    created.address.ip = ip;
+    created.address.port = port;
+    return records[key(ip, port)] = created;
+}
+
+/**
+ * @brief AddressBook::score
+ * starts at 100, ping and block latency cost up to 100 each, failures up
+ * to 50 and every invalid block 30. up to 50 are added for 5 hours uptime
+ */
+double AddressBook::score(const PeerRecord &record, time_t now) const
+{
+    long uptime = record.uptime + (record.lastConnected > 0 ? now - record.lastConnected : 0);
+    return 100
+            - min(record.rttMs, 2000.0) / 20
+            - min(record.blockLatencyMs, 10000.0) / 100
+            - 10 * min(record.failures, 5)
+            - 30 * record.invalidBlocks
+            + min(uptime / 360, 50L);
+}
+
+/**
+ * @brief AddressBook::evictOldest
+ * removes the address, that was not seen for the longest time and is neither connected nor banned
+ */
+void AddressBook::evictOldest()
+{
+    time_t now = Clock::instance().now();
+    auto oldest = records.end();
+    for (auto it = records.begin(); it != records.end(); ++it)
+    {
+        if (it->second.lastConnected == 0 && it->second.bannedUntil <= now && (oldest == records.end() || it->second.lastSeen < oldest->second.lastSeen))
+        {
+            oldest = it;
+        }
+    }
+    if (oldest != records.end())
+    {
+        records.erase(oldest);
+    }
+}
+
+string AddressBook::key(const string &ip, int port) const
+{
+    return ip + "," + to_string(port);
+}
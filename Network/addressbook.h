@@ -0,0 +1,82 @@
+#ifndef ADDRESSBOOK_H
+#define ADDRESSBOOK_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <time.h>
+#include "../clock.h"
+#include "../helperfunctions.h"
+
+using namespace std;
+using namespace HelperFunctions;
+
+const string ADDRESS_BOOK_PATH = "../config/peers.csv";
+
+struct PeerAddress {
+    string ip;
+    int port;                   //of its server, 0 for an incoming peer, that did not tell it
+};
+
+struct PeerRecord {
+    PeerAddress address;
+    time_t lastSeen;            //announced by a datagram or a peer
+    time_t lastAttempt;         //own connection attempt
+    time_t lastConnected;       //0 while it is not connected
+    int failures;               //attempts since the last connection
+    double rttMs;               //moving average of ping to pong
+    double blockLatencyMs;      //moving average of block request to response
+    int invalidBlocks;
+    long uptime;                //seconds connected
+    time_t bannedUntil;
+};
+
+/**
+ * remembers the peers of the node across restarts and scores them.
+ * the score prefers peers with a short ping and block latency and a long
+ * uptime, failed connections and invalid blocks lower it. a peer, that sends
+ * too many invalid blocks, is banned for a while.
+ * new connections are made to the best scored addresses and the worst
+ * connected peers are evicted first.
+ * the book is saved as one line per peer: ip,port,lastSeen,failures,rtt,latency,invalid,uptime,bannedUntil
+ */
+class AddressBook
+{
+public:
+    AddressBook();
+    bool load(const string &path = ADDRESS_BOOK_PATH);
+    bool save();
+    bool add(const string &ip, int port);
+    void connected(const string &ip, int port);
+    void disconnected(const string &ip, int port);
+    void attempted(const string &ip, int port);
+    void failed(const string &ip, int port);
+    void addRoundTrip(const string &ip, int port, int ms);
+    void addBlockLatency(const string &ip, int port, int ms);
+    bool addInvalidBlock(const string &ip, int port);
+    bool isBanned(const string &ip, int port);
+    double getScore(const string &ip, int port);
+    vector<PeerAddress> selectOutbound(unsigned int count, const vector<PeerAddress> &connected);
+    vector<PeerAddress> getGossip(unsigned int count);
+    unsigned int size() const;
+    void print();
+
+    static const unsigned int MAX_ADDRESSES = 2000;
+    static const int MAX_INVALID_BLOCKS = 3;
+    static const int BAN_TIME = 3600;           //in seconds
+    static const int RETRY_TIME = 60;           //times the failures since the last connection
+    static const int GOSSIP_AGE = 3 * 3600;     //only addresses seen more recently are passed on
+
+private:
+    PeerRecord* find(const string &ip, int port);
+    PeerRecord& get(const string &ip, int port);
+    double score(const PeerRecord &record, time_t now) const;
+    void evictOldest();
+    string key(const string &ip, int port) const;
+    map<string, PeerRecord> records;
+    string path;
+};
+
+#endif // ADDRESSBOOK_H
@@ -1,18 +1,22 @@
 #include "client.h"
 
+static Gauge &inboundPeers = Metrics::instance().gauge("poluck_peers", "connected peers", "direction=\"in\"");
+static Gauge &outboundPeers = Metrics::instance().gauge("poluck_peers", "connected peers", "direction=\"out\"");
+
 Client::Client(const shared_ptr<recursive_mutex> &dbMutex, const shared_ptr<recursive_mutex>& netMutex,
                const shared_ptr<mutex> &pubMutex, const shared_ptr<vector<string>> &pk,
                const shared_ptr<mutex>& testMutex, const shared_ptr<vector<string>> &testpk)
     :networkMutex(netMutex),
     myChain(dbMutex, shared_ptr<vector<Transaction>> (new vector<Transaction>),
             shared_ptr<recursive_mutex> (new recursive_mutex)),
-    pkMutex(pubMutex), publicKeys(pk), testModeMutex(testMutex), testModePublicKeys(testpk), miner(nullptr), transaction(nullptr)
+    miningScheduler(myChain), loadGenerator(myChain, this), validator(myChain, netMutex), admission(myChain), pkMutex(pubMutex), publicKeys(pk),
+    testModeMutex(testMutex), testModePublicKeys(testpk), transaction(nullptr), server(this), metricsServer(this)
 {
+    Log::load();
     qRegisterMetaType<Block>("Block");
     peerManager = new PeerManager(this);
     peerManager->setServerPort(server.serverPort());
     peerManager->startBroadcasting();
-    threadStopped = true;
     transactionThreadStopped = true;
     createKeypair();
 
@@ -23,22 +27,39 @@ Client::Client(const shared_ptr<recursive_mutex> &dbMutex, const shared_ptr<recu
 
     QObject::connect(this, SIGNAL(sendBlockSignal(Block*)),this, SLOT(sendBlock(Block*)));
     QObject::connect(this, SIGNAL(sendTransactionSignal(QString)),this, SLOT(sendTransaction(QString)));
+    //the scheduler calls these on the miner thread, the signals are queued
+    miningScheduler.onBlockFound = [this](const Block &block) { emit sendBlockSignal(new Block(block)); };
+    miningScheduler.onLuckyNumber = [this](double ln) { emit updateLNSignal(ln); };
+    miningScheduler.onStopped = [this]() { emit startMiningSignal(); };
+    //blocks above an imported snapshot are only accepted after its headers are checked
+    myChain.addEventListener([this](ChainEvent event, const string &)
+    {
+        if (event == CHAIN_BASE_CHECKED)
+        {
+            QMetaObject::invokeMethod(this, "getChainFromNetwork", Qt::QueuedConnection);
+        }
+    });
 
-
-    QTimer::singleShot(4*1000,this, SLOT(getChainFromNetwork()));
+    legacySyncRequested = false;
+    //the chain is requested, when a peer with a luckier chain connects
     //QTimer::singleShot(4*1000,this, SLOT(getTestingNetworkParticipants()));
 
+    validator.start([this]() { QMetaObject::invokeMethod(this, "processValidationResults", Qt::QueuedConnection); });
+    admission.start(Config::instance().getInt("admission_threads", max((int) thread::hardware_concurrency() - 1, 1)));
+    //the server, the peer manager and the load generator are children and move with the client
+    networkThread.setObjectName("network");
+    networkThread.start();
+    moveToThread(&networkThread);
 }
 
 Client::~Client()
 {
     transactionThreadRun = false;
-    threadRun = false;
-    if (miner->joinable())
-    {
-        miner->join();
-    }
-    if(transaction->joinable())
+    miningScheduler.stop();
+    stopNetworkThread();
+    validator.stop();
+    admission.stop();
+    if(transaction != nullptr && transaction->joinable())
     {
         transaction->join();
     }
@@ -113,6 +134,108 @@ void Client::stopTransactionThread()
     emit stopTransactionSignal();
 }
 
+/**
+ * @brief Client::startLoadGenerator
+ * sends transactions of generated keys to the own node over the network
+ * and measures, how long they take until they are final
+ * @return false if the generator is already running or can't fund its keys
+ */
+bool Client::startLoadGenerator()
+{
+    if (loadGenerator.isRunning())
+    {
+        cout << "the load generator is already running" << endl;
+        return false;
+    }
+    bool started = false;
+    QMetaObject::invokeMethod(&loadGenerator, "start", networkCall(), Q_RETURN_ARG(bool, started),
+                              Q_ARG(quint16, server.serverPort()));
+    return started;
+}
+
+/**
+ * @brief Client::stopLoadGenerator
+ * ends the run early and prints its report
+ */
+void Client::stopLoadGenerator()
+{
+    QMetaObject::invokeMethod(&loadGenerator, "stop", networkCall());
+}
+
+/**
+ * @brief Client::executePrintLoad
+ * prints the report of the current or last load run
+ */
+void Client::executePrintLoad()
+{
+    QMetaObject::invokeMethod(&loadGenerator, "printReport", networkCall());
+}
+
+/**
+ * @brief Client::executePrintValidation
+ * prints how many messages the validation worker handled and how long they waited
+ * and how many received transactions were admitted
+ */
+void Client::executePrintValidation()
+{
+    validator.printStats();
+    admission.printStats();
+}
+
+/**
+ * @brief Client::executePrintTrace
+ * prints the p50 and p99 duration of every stage of the traced blocks
+ */
+void Client::executePrintTrace()
+{
+    Trace::instance().printSummary();
+}
+
+/**
+ * @brief Client::executeExportTrace
+ * writes the traced spans for chrome://tracing or perfetto
+ * @param file path of the json file
+ * @return true if successful
+ */
+bool Client::executeExportTrace(string file)
+{
+    return Trace::instance().exportChrome(file);
+}
+
+/**
+ * @brief Client::executePrintQueues
+ * prints the send queues of every peer
+ */
+void Client::executePrintQueues()
+{
+    QMetaObject::invokeMethod(this, "printSendQueues", networkCall());
+}
+
+void Client::printSendQueues()
+{
+    QList<Connection *> connections = peers.values();
+    cout << connections.size() << " peers" << endl;
+    foreach (Connection *connection, connections)
+    {
+        connection->printSendStats();
+    }
+}
+
+/**
+ * @brief Client::executePrintPeers
+ * prints the address book with the stats and scores of the peers
+ */
+void Client::executePrintPeers()
+{
+    QMetaObject::invokeMethod(this, "printAddressBook", networkCall());
+}
+
+void Client::printAddressBook()
+{
+    cout << countPeers(true) << " outgoing and " << countPeers(false) << " incoming peers" << endl;
+    peerManager->getAddressBook().print();
+}
+
 /**
  * @brief Client::handleTransactionCommandWithParams
  * splits the received string
@@ -122,7 +245,7 @@ void Client::stopTransactionThread()
  */
 void Client::handleTransactionCommandWithParams(const QString &message)
 {
-    cout << "sending transaction" << endl;
+    LOG(LOG_DEBUG) << "sending transaction" << endl;
     QStringList paramsList = message.split(",");
 
     // local execution
@@ -137,99 +260,19 @@ void Client::handleTransactionCommandWithParams(const QString &message)
     QString transactionString = QString::fromStdString(getPublicBkey()) + "," + paramsList.at(0) +
             "," + QString::fromStdString(hash) + "," + paramsList.at(1) + "," + QString::number(intTime);
 
-    QList<Connection *> connections = peers.values();
-    foreach (Connection *connection, connections)
-    {
-        connection->sendTransaction(transactionString);
-    }
+    //sent on the network thread
+    emit sendTransactionSignal(transactionString);
 }
 /**
- * @brief Client::handleBlockCommand
- * executes a local block creation
- * gets the latest block and splits its components
- * creates a string with the block components
- * sends the string to all connected peers
+ * @brief Client::startMiningThread
+ * starts the miner. it builds blocks on the tip and sends its lucky blocks
+ * to all connected peers
  */
-void Client::handleBlockCommand()
-{
-    setlocale(LC_NUMERIC, "en_US.UTF-8");
-    time_t oldTime = myChain.getLatestBlock().getTimestamp();
-    Block prevBlock = myChain.getLatestBlock();
-    Block* newBlock = myChain.buildNewBlock(getPublicBkey(), prevBlock);
-    int numOfRunsWithSameIndex = 0;
-    int previousIndex;
-    while (threadRun)
-    {
-        previousIndex = newBlock->getIndex();
-        //check if the time is up. If so create new Block
-        if (time(0) > oldTime + ROUND_TIME)
-        {
-            prevBlock = myChain.getLatestBlock();
-            newBlock = myChain.buildNewBlock(getPublicBkey(), prevBlock);
-            oldTime = myChain.getLatestBlock().getTimestamp();
-            cout << "creating new Block with index " << newBlock->getIndex() << endl;
-
-        }
-        //avoid getting stuck with wrong chain
-        if (previousIndex == newBlock->getIndex())
-        {
-            numOfRunsWithSameIndex++;
-            if (numOfRunsWithSameIndex >= 5)
-            {
-                executeverifyBlockchain();
-                numOfRunsWithSameIndex = 0;
-            }
-        }
-        else
-        {
-            numOfRunsWithSameIndex = 0;
-        }
-
-        myChain.ProofOfLuck(*newBlock);
-	cout << "hash from the new block: " << newBlock->getHash() <<endl;
-        int forkID = 0;
-        emit updateLNSignal(newBlock->getLn());
-        if (myChain.isLuckierBlock(*newBlock))
-        {
-
-            int requestedBlock = myChain.handleBlock(*newBlock, &forkID);
-            if (requestedBlock > 0)
-            {
-                myChain.handleBlock(prevBlock, &forkID);
-            }
-            if (requestedBlock == 0)
-            {
-                Block* sendingBlock = new Block(*newBlock);
-                //memcpy(sendingBlock, newBlock, sizeof(Block));
-
-                emit sendBlockSignal(sendingBlock);
-            }
-        }
-        else
-        {
-            cout << "not lucky " << newBlock->getLn() << endl;
-        }
-
-    }
-    cout << "thread terminated" << endl;
-    threadStopped = true;
-    emit startMiningSignal();
-}
-
 void Client::startMiningThread()
 {
-    if (threadStopped)
+    if (miningScheduler.start(getPublicBkey()))
     {
-        if (miner != nullptr)
-        {
-            miner->join();
-            delete miner;
-
-        }
-        threadRun = true;
         cout << "starting the miner thread" << endl;
-        miner = new std::thread(&Client::handleBlockCommand, this);
-        threadStopped = false;
     } else {
         cout << "thread is already running" << endl;
     }
@@ -237,43 +280,197 @@ void Client::startMiningThread()
 
 void Client::stopMiningThread()
 {
-      threadRun = false;
+      miningScheduler.stop();
       emit stopMiningSignal();
 }
 
 
 /**
  * @brief Client::handleReceivedBlock
- * handle Block received from the network
- * TODO: appendBlock needs to be replaced by handleBlock
- * @param receivedBlock to append
+ * passes the block received from the network to the validation worker
+ * @param receivedBlockStruct block and fork of the sender
  */
 void Client::handleReceivedBlock(forkBlock receivedBlockStruct)
 {
-//    int forkID = 0;
-    Block* receivedBlock = receivedBlockStruct.block;
-    int forkID = receivedBlockStruct.forkID;
-    Connection *connection = qobject_cast<Connection *>(sender());
-    cout << "starting receive procedure with block " << receivedBlock->getIndex() << endl;
+    TraceSpan span("submit block", receivedBlockStruct.block->getIndex());
+    ValidationJob job = ValidationJob();
+    job.type = VALIDATE_BLOCK;
+    job.connection = qobject_cast<Connection *>(sender());
+    job.block = receivedBlockStruct.block;
+    job.forkID = receivedBlockStruct.forkID;
+    LOG(LOG_DEBUG) << "starting receive procedure with block " << job.block->getIndex() << endl;
+    if (!validator.submit(job))
+    {
+        LOG(LOG_WARNING) << "the validation queue is full, the block is dropped" << endl;
+    }
+}
+
+/**
+ * @brief Client::handleReceivedCompactBlock
+ * the worker parses the compact block and rebuilds it from the mempool
+ * @param message compact block in the format of the wire protocol
+ */
+void Client::handleReceivedCompactBlock(string message)
+{
+    ValidationJob job = ValidationJob();
+    job.type = VALIDATE_COMPACT_BLOCK;
+    job.connection = qobject_cast<Connection *>(sender());
+    job.block = nullptr;
+    job.message = message;
+    if (!validator.submit(job))
+    {
+        LOG(LOG_WARNING) << "the validation queue is full, the compact block is dropped" << endl;
+    }
+}
+
+/**
+ * @brief Client::handleReceivedBlockTransactions
+ * passes the missing transactions of a compact block to the worker
+ * @param response hash, index and the transactions
+ */
+void Client::handleReceivedBlockTransactions(string response)
+{
+    auto pending = pendingCompactBlocks.find(split(response, ',').at(0));
+    if (pending == pendingCompactBlocks.end())
+    {
+        return;
+    }
+    ValidationJob job = ValidationJob();
+    job.type = VALIDATE_COMPACT_BLOCK;
+    job.connection = qobject_cast<Connection *>(sender());
+    job.block = nullptr;
+    job.compact = pending->second.compact;
+    job.forkID = pending->second.forkID;
+    job.message = response;
+    pendingCompactBlocks.erase(pending);
+    if (!validator.submit(job))
+    {
+        LOG(LOG_WARNING) << "the validation queue is full, the compact block is dropped" << endl;
+    }
+}
 
-    networkMutex->lock();
-    int requestedBlock = myChain.handleBlock(*receivedBlock, &forkID);
-    networkMutex->unlock();
-//    cout << "requestedBlock return: " << requestedBlock << " forkID: " << forkID << endl;
-    if (requestedBlock > 0)
+/**
+ * @brief Client::sendBlockTransactionsResponse
+ * the worker reads the requested transactions, they are sent with the results
+ * @param request hash, index and positions of the transactions
+ */
+void Client::sendBlockTransactionsResponse(string request)
+{
+    ValidationJob job = ValidationJob();
+    job.type = ANSWER_BLOCK_TRANSACTIONS;
+    job.connection = qobject_cast<Connection *>(sender());
+    job.block = nullptr;
+    job.message = request;
+    if (!validator.submit(job))
     {
+        LOG(LOG_WARNING) << "the validation queue is full, the transaction request is dropped" << endl;
+    }
+}
 
-        cout << "request chain from network" << endl;
-        connection->sendBlockRequest(receivedBlock->getIndex() - 1, forkID);
+/**
+ * @brief Client::completeCompactBlock
+ * asks the sender of a compact block for the transactions, that are not in
+ * the mempool. if they did not help either, the whole block is requested
+ * @param result of the worker
+ * @param connection sender of the compact block, null if it left
+ */
+void Client::completeCompactBlock(const ValidationResult &result, Connection *connection)
+{
+    if (!result.fallback && connection)
+    {
+        if (pendingCompactBlocks.size() >= MAX_PENDING_COMPACT_BLOCKS)
+        {
+            pendingCompactBlocks.erase(pendingCompactBlocks.begin());
+        }
+        PendingCompactBlock pending = {result.compact, result.forkID};
+        pendingCompactBlocks[result.compact->getHash()] = pending;
+        connection->sendBlockTransactionsRequest(QString::fromStdString(result.compact->getMissingRequest()));
+        return;
     }
-    else if (requestedBlock == -2) //invalid Block received, the sending peer should check his database
+    LOG(LOG_DEBUG) << "could not rebuild the compact block " << result.blockIndex << ", requesting the whole block" << endl;
+    if (!connection || connection->getPrunedHeight() >= result.blockIndex)
     {
-        connection->sendCheckBlockchain();
+        connection = findPeerWithBlock(result.blockIndex);
     }
-    else
+    if (connection)
     {
-        if (requestedBlock == 0)
+        connection->sendBlockRequest(result.blockIndex, result.forkID);
+    }
+}
+
+/**
+ * @brief Client::processValidationResults
+ * requests the missing blocks, answers the block requests
+ * and updates the gui after the worker validated the messages
+ */
+void Client::processValidationResults()
+{
+    vector<ValidationResult> results = validator.takeResults();
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        ValidationResult &result = results.at(i);
+        //the peer may have left while the worker was busy
+        Connection *connection = isPeer(result.connection) ? result.connection : nullptr;
+        if (result.type == ANSWER_BLOCK_REQUEST)
+        {
+            if (connection && result.prunedHeight > 0)
+            {
+                //an older peer doesn't know the message, it gets no answer
+                if (connection->peerSupports(Connection::FeaturePrunedHeight))
+                {
+                    connection->sendPrunedHeight(result.prunedHeight);
+                }
+            }
+            else if (connection)
+            {
+                connection->sendBlockResponse(QString::fromStdString(result.message));
+            }
+        }
+        else if (result.type == ANSWER_BLOCK_TRANSACTIONS)
+        {
+            if (connection)
+            {
+                connection->sendBlockTransactions(QString::fromStdString(result.message));
+            }
+        }
+        else if (result.type == VALIDATE_COMPACT_BLOCK && (result.fallback || !result.compact->isComplete()))
+        {
+            completeCompactBlock(result, connection);
+        }
+        else if (result.requestedBlock > 0)
+        {
+            LOG(LOG_INFO) << "request chain from network" << endl;
+            if (!connection || connection->getPrunedHeight() >= result.blockIndex - 1)
+            {
+                connection = findPeerWithBlock(result.blockIndex - 1);
+            }
+            if (connection)
+            {
+                connection->sendBlockRequest(result.blockIndex - 1, result.forkID);
+            }
+            else
+            {
+                cout << "no peer stores the transactions of block " << result.blockIndex - 1 << endl;
+            }
+        }
+        else if (result.requestedBlock == -2) //invalid Block received, the sending peer should check his database
+        {
+            string ip;
+            int port;
+            if (connection && getBanAddress(connection, ip, port)
+                    && peerManager->getAddressBook().addInvalidBlock(ip, port))
+            {
+                connection->abort();
+            }
+            else if (connection)
+            {
+                connection->sendCheckBlockchain();
+            }
+        }
+        else if (result.requestedBlock == 0)
+        {
             emit printChainSignal();
+        }
     }
 }
 
@@ -296,7 +493,8 @@ void Client::handleReceivedPublicKey(string receivedPublicKey)
 
 /**
  * @brief Client::addReceivedTransaction
- * creates a new transaction
+ * passes a received transaction to the admission, it reaches the mempool,
+ * if the signature is right and the sender can pay it
  * @param sender of the transaction
  * @param receiver of the transaction
  * @param hash of the transaction
@@ -305,8 +503,29 @@ void Client::handleReceivedPublicKey(string receivedPublicKey)
 void Client::addReceivedTransaction(string sender, string receiver, string hash, int value, int intTime)
 {
     time_t timestamp = intTime;
-    cout << "transaction received" << endl;
-    myChain.newTransaction(sender,receiver,hash,value, timestamp);
+    LOG(LOG_DEBUG) << "transaction received" << endl;
+    admission.submit(Transaction(sender, receiver, value, hash, timestamp));
+}
+
+/**
+ * @brief Client::addReceivedTransactions
+ * parses a batch of transactions and passes them to the admission at once
+ * @param batch sender,receiver,hash,value,timestamp; of every transaction
+ */
+void Client::addReceivedTransactions(string batch)
+{
+    vector<string> entries = split(batch, ';');
+    vector<Transaction> transactions;
+    for (unsigned int i = 0; i < entries.size(); i++)
+    {
+        vector<string> fields = split(entries.at(i), ',');
+        if (fields.size() >= 5)
+        {
+            transactions.push_back(Transaction(fields.at(0), fields.at(1), toInt(fields.at(3)), fields.at(2), toInt(fields.at(4))));
+        }
+    }
+    LOG(LOG_DEBUG) << transactions.size() << " transactions received" << endl;
+    admission.submit(transactions);
 }
 /**
  * @brief Client::executeProofOfLuck
@@ -331,7 +550,7 @@ int Client::executeBalancePrinting(string pk)
 
 QString Client::executePrintChain(bool detailed)
 {
-    return myChain.printChain(detailed);
+    return QString::fromStdString(myChain.printChain(detailed));
 }
 
 vector<string> Client::getAllParticipants()
@@ -350,6 +569,26 @@ void Client::executePrintMempool()
     myChain.printMempool();
 }
 
+/**
+ * @brief Client::executePrintProofStats
+ * prints how many proofs were wasted on replaced previous blocks
+ * and how fast the miner reacts to a new tip
+ */
+void Client::executePrintProofStats()
+{
+    myChain.printProofStats();
+    miningScheduler.printStats();
+}
+
+/**
+ * @brief Client::executePrintTxIndex
+ * prints the statistics of the transaction index
+ */
+void Client::executePrintTxIndex()
+{
+    myChain.printTxIndex();
+}
+
 void Client::executePrintKeys()
 {
     vector<string> knownPublicKeys = getPublicKeys();
@@ -376,6 +615,37 @@ int Client::executeGetLatestBlockIndex()
     return myChain.getLatestBlockIndex();
 }
 
+/**
+ * @brief Client::executeExportSnapshot
+ * exports the chain state for the bootstrap of a new node
+ * @param file path of the snapshot
+ * @param height of the snapshot. 0 for the latest block
+ * @return true if successful
+ */
+bool Client::executeExportSnapshot(string file, int height)
+{
+    return myChain.exportSnapshot(file, height);
+}
+
+/**
+ * @brief Client::executeImportSnapshot
+ * replaces the local chain with a snapshot. the blocks
+ * after the snapshot are requested from the network,
+ * once its headers are verified
+ * @param file path of the snapshot
+ * @param trustedState state hash published with the snapshot, snapshot_state_hash of the config if empty
+ * @return true if successful
+ */
+bool Client::executeImportSnapshot(string file, string trustedState)
+{
+    if (!myChain.importSnapshot(file, trustedState))
+    {
+        return false;
+    }
+    emit printChainSignal();
+    return true;
+}
+
 /**
  * @brief Client::address
  * returns ip addreses
@@ -419,13 +689,20 @@ bool Client::hasConnection(const QHostAddress &senderIp, int senderPort) const
  */
 void Client::newConnection(Connection *connection)
 {
-    cout << "Network: Connected to a peer." << endl;
+    LOG(LOG_INFO) << "Network: Connected to a peer." << endl;
+    connection->setLocalStatus(myChain.getLatestBlockIndex(),
+                               QString::fromStdString(myChain.getLatestBlock().getHash()),
+                               myChain.getChainLuck(), server.serverPort());
     connect(connection, SIGNAL(error(QAbstractSocket::SocketError)),
             this, SLOT(connectionError(QAbstractSocket::SocketError)));
     connect(connection, SIGNAL(disconnected()), this, SLOT(disconnected()));
     connect(connection, SIGNAL(readyForUse()), this, SLOT(readyForUse()));
     connect(connection, SIGNAL(addReceivedTransaction(string,string,string,int,int)), this, SLOT(addReceivedTransaction(string,string,string,int,int)));
+    connect(connection, SIGNAL(addReceivedTransactions(string)), this, SLOT(addReceivedTransactions(string)));
     connect(connection, SIGNAL(handleReceivedBlock(forkBlock)), this, SLOT(handleReceivedBlock(forkBlock)));
+    connect(connection, SIGNAL(handleReceivedCompactBlock(string)), this, SLOT(handleReceivedCompactBlock(string)));
+    connect(connection, SIGNAL(handleReceivedBlockTransactions(string)), this, SLOT(handleReceivedBlockTransactions(string)));
+    connect(connection, SIGNAL(sendBlockTransactionsResponse(string)), this, SLOT(sendBlockTransactionsResponse(string)));
     connect(connection, SIGNAL(sendBlockResponseWithBlock(int, int)), this, SLOT(sendBlockResponseWithBlock(int, int)));
 
     connect(connection, SIGNAL(handlePublicKey(string)),this, SLOT(handleReceivedPublicKey(string)));
@@ -433,6 +710,11 @@ void Client::newConnection(Connection *connection)
     connect(connection, SIGNAL(addPublicKeyFromTestNetwork(string)), this, SLOT(addPublicKeyFromTestNetwork(string)));
     connect(connection, SIGNAL(sendAllKnownParticipants()), this, SLOT(sendAllKnownTestParticipants()));
     connect(connection, SIGNAL(checkDatabase()), this, SLOT(checkDatabase())); // TODO: INVALID BLOCK CHECKING
+    connect(connection, SIGNAL(blockRequestPruned(int, int)), this, SLOT(requestPrunedBlock(int, int)));
+    connect(connection, SIGNAL(roundTripMeasured(int)), this, SLOT(measuredRoundTrip(int)));
+    connect(connection, SIGNAL(blockLatencyMeasured(int)), this, SLOT(measuredBlockLatency(int)));
+    connect(connection, SIGNAL(addressesRequested()), this, SLOT(sendAddresses()));
+    connect(connection, SIGNAL(addressesReceived(string)), this, SLOT(addReceivedAddresses(string)));
 }
 /**
  * @brief Client::readyForUse
@@ -445,14 +727,256 @@ void Client::readyForUse()
     {
         return;
     }
+    string ip;
+    int port;
+    bool known = getServerAddress(connection, ip, port);
+    AddressBook &book = peerManager->getAddressBook();
+    //the invalid blocks of incoming peers without a server port are counted for the ip
+    bool banned = (known && book.isBanned(ip, port))
+            || (!connection->isOutbound() && !ip.empty() && book.isBanned(ip, 0));
+    if (banned)
+    {
+        LOG(LOG_INFO) << "rejecting banned peer " << ip << ":" << port << endl;
+        connection->abort();
+        return;
+    }
     peers.insert(connection->peerAddress(), connection);
+    updatePeerGauges();
+    if (known)
+    {
+        peerManager->addAddress(ip, port);
+        book.connected(ip, port);
+    }
+    evictWorstPeer(connection->isOutbound());
+    if (!isPeer(connection))
+    {
+        return;
+    }
+    if (myChain.getBaseHeight() > 0 && connection->peerSupports(Connection::FeaturePrunedHeight))
+    {
+        connection->sendPrunedHeight(myChain.getBaseHeight());
+    }
+    if (connection->peerSupports(Connection::FeatureAddressGossip))
+    {
+        connection->sendAddressRequest();
+    }
+    syncWithPeer(connection);
     QString peer = connection->address();
     if (!peer.isEmpty())
     {
-        cout << "public key for this new address" << connection->publicKeyToAddress << endl;
+        LOG(LOG_DEBUG) << "public key for this new address" << connection->publicKeyToAddress << endl;
         emit newPeer(peer);
     }
 }
+/**
+ * @brief Client::getServerAddress
+ * the address of a peer in the book is the one of its server
+ * @return false if an incoming peer did not tell its server port
+ */
+bool Client::getServerAddress(Connection *connection, string &ip, int &port) const
+{
+    port = connection->getServerPort();
+    ip = connection->isOutbound() ? connection->peerName().toStdString()
+                                  : connection->peerAddress().toString().toStdString();
+    return port > 0 && !ip.empty();
+}
+
+/**
+ * @brief Client::getBanAddress
+ * the invalid blocks of a peer are counted for its server address,
+ * those of an incoming peer without a server port for its ip with port 0
+ * @return false if the address of the peer is unknown
+ */
+bool Client::getBanAddress(Connection *connection, string &ip, int &port) const
+{
+    if (getServerAddress(connection, ip, port))
+    {
+        return true;
+    }
+    port = 0;
+    return !connection->isOutbound() && !ip.empty();
+}
+
+/**
+ * @brief Client::evictWorstPeer
+ * disconnects the worst scored peer of a direction, while there are more than configured
+ * @param outbound direction of the peers
+ */
+void Client::evictWorstPeer(bool outbound)
+{
+    int limit = outbound ? Config::instance().getInt("max_outbound", 8)
+                         : Config::instance().getInt("max_inbound", 32);
+    AddressBook &book = peerManager->getAddressBook();
+    while (countPeers(outbound) > limit)
+    {
+        Connection *worst = nullptr;
+        double worstScore = 0;
+        foreach (Connection *connection, peers.values())
+        {
+            string ip;
+            int port;
+            if (connection->isOutbound() != outbound)
+            {
+                continue;
+            }
+            //peers without a server port can not be scored and are evicted first
+            double score = getServerAddress(connection, ip, port) ? book.getScore(ip, port) : -1000;
+            if (!worst || score < worstScore)
+            {
+                worst = connection;
+                worstScore = score;
+            }
+        }
+        LOG(LOG_INFO) << "evicting peer " << qPrintable(worst->peerAddress().toString()) << ", score " << worstScore << endl;
+        removeConnection(worst);
+        worst->abort();
+    }
+}
+
+/**
+ * @brief Client::countPeers
+ * @param outbound true for the peers connected by this node
+ */
+int Client::countPeers(bool outbound) const
+{
+    int count = 0;
+    foreach (Connection *connection, peers.values())
+    {
+        count += (connection->isOutbound() == outbound) ? 1 : 0;
+    }
+    return count;
+}
+
+void Client::updatePeerGauges()
+{
+    outboundPeers.set(countPeers(true));
+    inboundPeers.set(countPeers(false));
+}
+
+/**
+ * @brief Client::getPeerAddresses
+ * @return the server addresses of the peers, that told them
+ */
+vector<PeerAddress> Client::getPeerAddresses() const
+{
+    vector<PeerAddress> addresses;
+    foreach (Connection *connection, peers.values())
+    {
+        PeerAddress address;
+        if (getServerAddress(connection, address.ip, address.port))
+        {
+            addresses.push_back(address);
+        }
+    }
+    return addresses;
+}
+
+void Client::measuredRoundTrip(int ms)
+{
+    Connection *connection = qobject_cast<Connection *>(sender());
+    string ip;
+    int port;
+    if (isPeer(connection) && getServerAddress(connection, ip, port))
+    {
+        peerManager->getAddressBook().addRoundTrip(ip, port, ms);
+    }
+}
+
+void Client::measuredBlockLatency(int ms)
+{
+    Connection *connection = qobject_cast<Connection *>(sender());
+    string ip;
+    int port;
+    if (isPeer(connection) && getServerAddress(connection, ip, port))
+    {
+        peerManager->getAddressBook().addBlockLatency(ip, port, ms);
+    }
+}
+
+/**
+ * @brief Client::sendAddresses
+ * answers the address request of a peer with the best addresses seen recently: ip,port;
+ */
+void Client::sendAddresses()
+{
+    Connection *connection = qobject_cast<Connection *>(sender());
+    if (!isPeer(connection))
+    {
+        return;
+    }
+    vector<PeerAddress> gossip = peerManager->getAddressBook().getGossip(MAX_GOSSIP_ADDRESSES);
+    QString params;
+    for (unsigned int i = 0; i < gossip.size(); i++)
+    {
+        params += QString::fromStdString(gossip.at(i).ip) + "," + QString::number(gossip.at(i).port) + ";";
+    }
+    connection->sendAddresses(params);
+}
+
+/**
+ * @brief Client::addReceivedAddresses
+ * adds the addresses of a peer to the book and connects to them, if outgoing peers are missing
+ * @param addresses ip,port; of every address
+ */
+void Client::addReceivedAddresses(string addresses)
+{
+    if (!isPeer(qobject_cast<Connection *>(sender())))
+    {
+        return;
+    }
+    vector<string> entries = split(addresses, ';');
+    bool added = false;
+    for (unsigned int i = 0; i < entries.size() && i < MAX_GOSSIP_ADDRESSES; i++)
+    {
+        vector<string> fields = split(entries.at(i), ',');
+        if (fields.size() == 2)
+        {
+            added |= peerManager->addAddress(fields.at(0), toInt(fields.at(1)));
+        }
+    }
+    if (added)
+    {
+        peerManager->maintainConnections();
+    }
+}
+
+/**
+ * @brief Client::isAhead
+ * @return true if the peer had a luckier chain or a longer one with the same luck, when it connected
+ */
+bool Client::isAhead(Connection *connection)
+{
+    double luck = myChain.getChainLuck();
+    return connection->getPeerLuck() > luck
+            || (connection->getPeerLuck() == luck && connection->getPeerHeight() > myChain.getLatestBlockIndex());
+}
+
+/**
+ * @brief Client::syncWithPeer
+ * requests the latest block of a new peer, that is ahead. the missing blocks
+ * before it are requested, when it is validated.
+ * the chain of older peers is unknown, only the first of them is asked
+ * @param connection to the new peer
+ */
+void Client::syncWithPeer(Connection *connection)
+{
+    if (connection->getPeerVersion() == 0)
+    {
+        if (legacySyncRequested)
+        {
+            return;
+        }
+        legacySyncRequested = true;
+    }
+    else if (!isAhead(connection))
+    {
+        return;
+    }
+    LOG(LOG_INFO) << "requesting the chain of " << qPrintable(connection->address()) << " at height "
+         << connection->getPeerHeight() << endl;
+    connection->sendBlockRequest();
+}
+
 /**
  * @brief Client::disconnected
  * received the disconnected signal and removes the connection
@@ -471,7 +995,16 @@ void Client::disconnected()
 void Client::connectionError(QAbstractSocket::SocketError /* socketError */)
 {
     if (Connection *connection = qobject_cast<Connection *>(sender()))
+    {
+        //an outgoing connection, that never got ready, failed
+        string ip;
+        int port;
+        if (connection->isOutbound() && !isPeer(connection) && getServerAddress(connection, ip, port))
+        {
+            peerManager->getAddressBook().failed(ip, port);
+        }
         removeConnection(connection);
+    }
 }
 /**
  * @brief Client::removeConnection
@@ -480,8 +1013,16 @@ void Client::connectionError(QAbstractSocket::SocketError /* socketError */)
  */
 void Client::removeConnection(Connection *connection)
 {
-    if (peers.contains(connection->peerAddress())) {
-        peers.remove(connection->peerAddress());
+    if (isPeer(connection)) {
+        //other peers may share the ip
+        peers.remove(connection->peerAddress(), connection);
+        updatePeerGauges();
+        string ip;
+        int port;
+        if (getServerAddress(connection, ip, port))
+        {
+            peerManager->getAddressBook().disconnected(ip, port);
+        }
         QString peer = connection->address();
         if (!peer.isEmpty())
         {
@@ -493,6 +1034,50 @@ void Client::removeConnection(Connection *connection)
     connection->deleteLater();
 }
 
+bool Client::isPeer(Connection *connection) const
+{
+    return connection && peers.values().contains(connection);
+}
+
+/**
+ * @brief Client::findPeerWithBlock
+ * searches a peer, that did not prune the transactions of a block
+ * @param blockID index of the needed block
+ * @return the connection or nullptr if every peer pruned it
+ */
+Connection* Client::findPeerWithBlock(int blockID)
+{
+    QList<Connection *> connections = peers.values();
+    foreach (Connection *connection, connections)
+    {
+        if (connection->getPrunedHeight() < blockID)
+        {
+            return connection;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Client::requestPrunedBlock
+ * a peer answered a block request with PRUNED,
+ * the block is requested from a peer, that still stores it
+ * @param blockID index of the block
+ * @param forkID id of the fork, the block belongs to
+ */
+void Client::requestPrunedBlock(int blockID, int forkID)
+{
+    Connection *connection = findPeerWithBlock(blockID);
+    if (connection)
+    {
+        connection->sendBlockRequest(blockID, forkID);
+    }
+    else
+    {
+        cout << "no peer stores the transactions of block " << blockID << endl;
+    }
+}
+
 vector<string> Client::getPublicKeys() const
 {
     //vector<string>* temp = (vector<string>*) malloc(sizeof(publicKeys));
@@ -524,24 +1109,34 @@ vector<Transaction> Client::getMyTransactions()
 
 void Client::addToList()
 {
-    QList<Connection *> connections = peers.values();
-    cout << "addtolist." << endl;
-
-    foreach (Connection *connection, connections)
-    {
-        connection->sendPublicKeyForTestModeAdd();
-    }
-
+    LOG(LOG_DEBUG) << "addtolist." << endl;
+    QMetaObject::invokeMethod(this, "sendTestModeKey", Qt::QueuedConnection, Q_ARG(bool, true));
 }
 
 void Client::removeFromList()
 {
-    QList<Connection *> connections = peers.values();
-    cout << "removefromlist." << endl;
+    LOG(LOG_DEBUG) << "removefromlist." << endl;
+    QMetaObject::invokeMethod(this, "sendTestModeKey", Qt::QueuedConnection, Q_ARG(bool, false));
+}
 
+/**
+ * @brief Client::sendTestModeKey
+ * tells the peers, that the own key takes part in the test transactions or not
+ * @param add true to add the key, false to remove it
+ */
+void Client::sendTestModeKey(bool add)
+{
+    QList<Connection *> connections = peers.values();
     foreach (Connection *connection, connections)
     {
-        connection->sendPublicKeyForTestModeRemove();
+        if (add)
+        {
+            connection->sendPublicKeyForTestModeAdd();
+        }
+        else
+        {
+            connection->sendPublicKeyForTestModeRemove();
+        }
     }
 }
 void Client::checkDatabase()
@@ -549,46 +1144,76 @@ void Client::checkDatabase()
     myChain.checkDatabase();
 }
 
+/**
+ * @brief Client::sendBlockResponseWithBlock
+ * the worker reads the requested block, it is sent with the results
+ * @param requestedBlockId 0 for the latest block
+ */
 void Client::sendBlockResponseWithBlock(int requestedBlockId, int forkID)
 {
-    Connection *senderConnection = qobject_cast<Connection*>(sender());
-    
-    Block requestedBlock = (!requestedBlockId) ? myChain.getLatestBlock() : myChain.getBlock(requestedBlockId, 0);
-
-    QString blockAsQString = HelperFunctions::parseBlockToQString(requestedBlock, forkID);
-
-    senderConnection->sendBlockResponse(blockAsQString);
-
+    ValidationJob job = ValidationJob();
+    job.type = ANSWER_BLOCK_REQUEST;
+    job.connection = qobject_cast<Connection*>(sender());
+    job.block = nullptr;
+    job.blockID = requestedBlockId;
+    job.forkID = forkID;
+    if (!validator.submit(job))
+    {
+        LOG(LOG_WARNING) << "the validation queue is full, the block request is dropped" << endl;
+    }
 }
 
+/**
+ * @brief Client::sendBlock
+ * sends an own block to all peers. the peers, that support it, get the compact
+ * block and rebuild the transactions from their mempool
+ * @param latestBlock is deleted afterwards
+ */
 void Client::sendBlock(Block* latestBlock)
 {
+    TraceSpan span("relay block", latestBlock->getIndex());
     QList<Connection *> connections = peers.values();
-    cout << "This Block is send: " << latestBlock->getIndex() << endl;
-    QString blockAsQString = HelperFunctions::parseBlockToQString(*latestBlock, 0);
-    cout << qPrintable(blockAsQString) << endl;
+    LOG(LOG_INFO) << "This Block is send: " << latestBlock->getIndex() << endl;
+    QString blockAsQString = QString::fromStdString(HelperFunctions::parseBlockToString(*latestBlock, 0));
+    LOG(LOG_DEBUG) << qPrintable(blockAsQString) << endl;
+    bool compactBlocks = Config::instance().getBool("compact_blocks", true);
+    QString compactAsQString;
     //networkMutex->lock();
 
     foreach (Connection *connection, connections)
     {
-	
-        connection->sendBlock(blockAsQString);
-
+        if (compactBlocks && connection->supportsCompactBlocks())
+        {
+            if (compactAsQString.isEmpty())
+            {
+                compactAsQString = QString::fromStdString(CompactBlock(*latestBlock).toString(0));
+                LOG(LOG_DEBUG) << "compact block: " << compactAsQString.size() << " of " << blockAsQString.size() << " bytes" << endl;
+            }
+            connection->sendCompactBlock(compactAsQString);
+        }
+        else
+        {
+            connection->sendBlock(blockAsQString);
+        }
     }
 
     emit printChainSignal();
-    cout << "deleting" << endl;
+    LOG(LOG_DEBUG) << "deleting" << endl;
     delete latestBlock;
-    cout << "deleted" << endl;
+    LOG(LOG_DEBUG) << "deleted" << endl;
 }
 
-
+/**
+ * @brief Client::sendTransaction
+ * relays a transaction to every peer, the peers, that support it, get it in the next batch
+ * @param newTransaction sender,receiver,hash,value,timestamp
+ */
 void Client::sendTransaction(QString newTransaction)
 {
     QList<Connection *> connections = peers.values();
     foreach (Connection *connection, connections)
     {
-        connection->sendTransaction(newTransaction);
+        connection->relayTransaction(newTransaction);
     }
 }
 
@@ -630,15 +1255,31 @@ void Client::sendAllKnownTestParticipants()
 
 /**
  * @brief
- * sends a BlockRequest to the first known connection
- *
+ * sends a BlockRequest to the peer with the luckiest chain, that is ahead,
+ * or to the first older peer, that does not tell its chain
  */
 void Client::getChainFromNetwork()
 {
     QList<Connection *> connections = peers.values();
-    if (connections.size() > 0)
+    Connection *best = nullptr;
+    foreach (Connection *connection, connections)
+    {
+        if (connection->getPeerVersion() > 0 && isAhead(connection)
+                && (!best || connection->getPeerLuck() > best->getPeerLuck()))
+        {
+            best = connection;
+        }
+    }
+    foreach (Connection *connection, connections)
+    {
+        if (!best && connection->getPeerVersion() == 0)
+        {
+            best = connection;
+        }
+    }
+    if (best)
     {
-        connections.at(0)->sendBlockRequest();
+        best->sendBlockRequest();
     }
 }
 
@@ -661,12 +1302,37 @@ void Client::requestPublicKeysFromNetwork()
     }
 }
 
+/**
+ * @brief Client::closeDb
+ * waits for the pending block writes before closing the database
+ * @return true if successful
+ */
 bool Client::closeDb() 
 {
+    myChain.flush();
     return myChain.closeDb();
 }
 
 
+/**
+ * @brief Client::shutdown
+ * stops the load generator, the network thread, the validation worker,
+ * the test transactions and the miner and closes the database after the miner finished its last block
+ * @return true if the database was closed
+ */
+bool Client::shutdown()
+{
+    stopLoadGenerator();
+    stopNetworkThread();
+    validator.stop();
+    admission.stop();
+    transactionThreadRun = false;
+    miningScheduler.stop();
+    miningScheduler.wait();
+    return closeDb();
+}
+
+
 /**
  * @brief
  * creates a QStringList by reading a local file
@@ -696,3 +1362,33 @@ QStringList Client::readPublicKeysFromFile(const QString location)
     }
     return QStringList();
 }
+
+/**
+ * @brief Client::networkCall
+ * calls from other threads wait, until the network thread ran them
+ */
+Qt::ConnectionType Client::networkCall() const
+{
+    return QThread::currentThread() == thread() ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
+}
+
+/**
+ * @brief Client::leaveNetworkThread
+ * runs on the network thread and moves the client with its sockets
+ * back to the main thread, before the network thread ends
+ */
+void Client::leaveNetworkThread()
+{
+    moveToThread(QCoreApplication::instance()->thread());
+    networkThread.quit();
+}
+
+void Client::stopNetworkThread()
+{
+    if (!networkThread.isRunning())
+    {
+        return;
+    }
+    QMetaObject::invokeMethod(this, "leaveNetworkThread", networkCall());
+    networkThread.wait();
+}
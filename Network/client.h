@@ -7,20 +7,33 @@
 #include <QtNetwork>
 #include "connection.h"
 #include "peermanager.h"
+#include "addressbook.h"     //peermanager.h includes this header before the book
 #include "server.h"
+#include "metricsserver.h"
 #include "memory"
 #include <thread>
 #include "../sodiumpp/crypt.h"
 #include "../Chain/transactions.hpp"
 #include "../Chain/blockchain.hpp"
+#include "../Chain/miningscheduler.hpp"
+#include "loadgenerator.h"
+#include "validationworker.h"
+#include "transactionadmission.h"
 #include "../Chain/block.hpp"
 #include "../sodiumpp/crypt.h"
 #include <mutex>
+#include <QThread>
 #include "helperfunctions.h"
 
 class PeerManager;
 using namespace HelperFunctions;
 
+/**
+ * the client and its server, peers and load generator live on the network
+ * thread. received blocks and block requests are passed to the validation
+ * worker and transactions to the admission, so the sockets are not blocked by the database.
+ * the public methods may be called from the gui or console thread
+ */
 class Client : public QObject
 {
     Q_OBJECT
@@ -33,11 +46,20 @@ public:
     ~Client();
     void handleTransactionCommandWithParams(const QString &message);
     void startTest();//const string &public_key
-    void handleBlockCommand();
     void startMiningThread();
     void stopMiningThread();
     void startTransactionThread();
     void stopTransactionThread();
+    bool startLoadGenerator();
+    void stopLoadGenerator();
+    void executePrintLoad();
+    void executePrintValidation();
+    void executePrintQueues();
+    void executePrintPeers();
+    void executePrintTrace();
+    bool executeExportTrace(string file);
+    int countPeers(bool outbound) const;
+    vector<PeerAddress> getPeerAddresses() const;
     QString address() const;
     bool hasConnection(const QHostAddress &senderIp, int senderPort = -1) const;
     QStringList readPublicKeysFromFile(const QString location);
@@ -46,11 +68,16 @@ public:
     QString executePrintChain(bool detailed);
     vector<string> getAllParticipants();
     void executePrintMempool();
+    void executePrintTxIndex();
+    void executePrintProofStats();
     void executePrintKeys();
     bool executeverifyBlockchain();
     void executeHistoryPrinting();
     int executeGetLatestBlockIndex();
+    bool executeExportSnapshot(string file, int height);
+    bool executeImportSnapshot(string file, string trustedState);
     bool closeDb();
+    bool shutdown();
     vector<string> getPublicKeys() const;
     void setPublicKeys(const vector<string> &value);
     vector<Transaction> getMyTransactions();
@@ -74,7 +101,11 @@ signals:
 private slots:
     void newConnection(Connection *connection);
     void addReceivedTransaction(string,string,string,int,int);
+    void addReceivedTransactions(string batch);
     void handleReceivedBlock(forkBlock receivedBlockStruct);
+    void handleReceivedCompactBlock(string message);
+    void handleReceivedBlockTransactions(string response);
+    void sendBlockTransactionsResponse(string request);
     void handleReceivedPublicKey(string receivedPublicKey);
     void connectionError(QAbstractSocket::SocketError socketError);
     void disconnected();
@@ -90,26 +121,58 @@ private slots:
     void addPublicKeyFromTestNetwork(string);
     void sendAllKnownTestParticipants();
     void checkDatabase();
+    void requestPrunedBlock(int blockID, int forkID);
+    void processValidationResults();
+    void sendTestModeKey(bool add);
+    void printSendQueues();
+    void printAddressBook();
+    void measuredRoundTrip(int ms);
+    void measuredBlockLatency(int ms);
+    void sendAddresses();
+    void addReceivedAddresses(string addresses);
+    void leaveNetworkThread();
 
 private:
     void removeConnection(Connection *connection);
-    bool threadRun;
-    bool threadStopped;
+    bool isPeer(Connection *connection) const;
+    Qt::ConnectionType networkCall() const;
+    void stopNetworkThread();
+    Connection* findPeerWithBlock(int blockID);
+    bool isAhead(Connection *connection);
+    void syncWithPeer(Connection *connection);
+    bool getServerAddress(Connection *connection, string &ip, int &port) const;
+    bool getBanAddress(Connection *connection, string &ip, int &port) const;
+    void evictWorstPeer(bool outbound);
+    void updatePeerGauges();
+    void completeCompactBlock(const ValidationResult &result, Connection *connection);
+    struct PendingCompactBlock {
+        shared_ptr<CompactBlock> compact;
+        int forkID;
+    };
     bool transactionThreadRun;
     bool transactionThreadStopped;
     shared_ptr<recursive_mutex> networkMutex;
     Blockchain myChain;
+    MiningScheduler miningScheduler;
+    LoadGenerator loadGenerator;
+    ValidationWorker validator;
+    TransactionAdmission admission;
     shared_ptr<mutex> pkMutex;
     shared_ptr<vector<string>> publicKeys;
     shared_ptr<mutex> testModeMutex;
     shared_ptr<vector<string>> testModePublicKeys;
-    std::thread *miner;
     std::thread *transaction;
     PeerManager *peerManager;
     Server server;
+    MetricsServer metricsServer;
     bool hasCurrentBlockchain;
     int expectedBlockID;
+    bool legacySyncRequested;   //older peers do not tell their chain, only the first is asked
     QMultiHash<QHostAddress, Connection *> peers;
+    map<string, PendingCompactBlock> pendingCompactBlocks;    //waiting for the missing transactions, by block hash
+    const unsigned int MAX_PENDING_COMPACT_BLOCKS = 16;
+    const unsigned int MAX_GOSSIP_ADDRESSES = 100;
+    QThread networkThread;
 };
 
 #endif
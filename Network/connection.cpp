@@ -4,24 +4,98 @@
 static const int TransferTimeout = 30 * 1000;
 static const int PongTimeout = 60 * 1000;
 static const int PingInterval = 5 * 1000;
+static const char *SendPriorityNames[] = {"new block", "block response", "transaction", "control"};
+//in the order of DataType
+static const char *DataTypeNames[] = {"message", "ping", "pong", "greeting", "publickey_response", "publickey_request",
+                                      "publickey_add", "publickey_remove", "test_network_participants_request", "block",
+                                      "transaction", "tx_batch", "block_request", "block_response", "check_blockchain",
+                                      "pruned", "compact_block", "get_block_tx", "block_tx", "get_addr", "addr",
+                                      "compressed", "frame", "frame_end", "undefined"};
+static Counter &wireBytesIn = Metrics::instance().counter("poluck_network_wire_bytes_total",
+                                                          "bytes on the sockets after compression", "direction=\"in\"");
+static Counter &wireBytesOut = Metrics::instance().counter("poluck_network_wire_bytes_total",
+                                                           "bytes on the sockets after compression", "direction=\"out\"");
+
+struct MessageCounters {
+    Counter *messages;
+    Counter *bytes;         //of the uncompressed payload
+};
+
+/**
+* @brief messageCounters
+* @param type of the message
+* @param received true for the messages of the peers
+* @return the counters of the type and direction
+*/
+static const MessageCounters& messageCounters(Connection::DataType type, bool received)
+{
+static const vector<MessageCounters> counters = []()
+{
+    vector<MessageCounters> created;
+    for (int direction = 0; direction < 2; direction++) {
+        for (int i = 0; i <= Connection::Undefined; i++) {
+            string labels = string("direction=\"") + (direction ? "in" : "out") + "\",type=\"" + DataTypeNames[i] + "\"";
+            MessageCounters typeCounters;
+            typeCounters.messages = &Metrics::instance().counter("poluck_network_messages_total",
+                                                                 "messages by type", labels);
+            typeCounters.bytes = &Metrics::instance().counter("poluck_network_bytes_total",
+                                                              "uncompressed payload bytes by message type", labels);
+            created.push_back(typeCounters);
+        }
+    }
+    return created;
+}();
+return counters.at((received ? Connection::Undefined + 1 : 0) + type);
+}
 
 Connection::Connection(QObject *parent)
-: QTcpSocket(parent)
+: QTcpSocket(parent), pingTimer(this), relayTimer(this), relayRandom(random_device()())
 {
 //    qDebug() << Q_FUNC_INFO;
-greetingMessage = tr("undefined");
+compression = Config::instance().getBool("compression", true);
+localFeatures = FeatureFrames;
+if (Config::instance().getBool("compact_blocks", true))
+    localFeatures |= FeatureCompactBlocks;
+if (compression)
+    localFeatures |= FeatureCompression;
+localFeatures |= FeatureAddressGossip | FeatureTransactionBatch | FeaturePrunedHeight;
+peerVersion = 0;
+peerFeatures = 0;
+peerHeight = -1;
+peerLuck = 0;
+peerListenPort = 0;
+outbound = false;
+blockRequestPending = false;
+requestedBlockID = 0;
+requestedForkID = 0;
+setLocalStatus(0, "", 0);
 cliAddress = tr("unknown");
 state = WaitingForGreeting;
 currentDataType = Undefined;
 numBytesForCurrentDataType = -1;
 transferTimerId = 0;
 forkID = 0;
+prunedHeight = 0;
 isGreetingMessageSent = false;
+queuedBytes = 0;
+maxQueuedBytes = 0;
+sendBudget = Config::instance().getInt("send_budget_kb", 4096) * 1024;
+sendQueueFullSignaled = false;
+memset(sendStats, 0, sizeof(sendStats));
+maxMessageSize = Config::instance().getInt("max_message_mb", 32) * 1024 * 1024;
+memset(compressionStats, 0, sizeof(compressionStats));
+memset(&decompressionStats, 0, sizeof(decompressionStats));
+relayWindow = Config::instance().getInt("relay_window_ms", 100);
+relayBatches = 0;
+relayTransactions = 0;
+relayTimer.setSingleShot(true);
 pingTimer.setInterval(PingInterval);
 
 QObject::connect(this, SIGNAL(readyRead()), this, SLOT(processReadyRead()));
 QObject::connect(this, SIGNAL(disconnected()), &pingTimer, SLOT(stop()));
 QObject::connect(&pingTimer, SIGNAL(timeout()), this, SLOT(sendPing()));
+QObject::connect(this, SIGNAL(bytesWritten(qint64)), this, SLOT(flushSendQueue()));
+QObject::connect(&relayTimer, SIGNAL(timeout()), this, SLOT(sendTransactionBatch()));
 QObject::connect(this, SIGNAL(connected()),
                  this, SLOT(sendGreetingMessage()));
 
@@ -55,7 +129,47 @@ bool Connection::sendTransaction(const QString &params)
 {
 QByteArray data;
 data = "TRANSACTION " + QByteArray::number(params.toUtf8().size()) + SeparatorToken + params.toUtf8();
-return write(data) == data.size();
+return enqueue(data, SendTransaction);
+}
+/**
+* @brief Connection::relayTransaction
+* collects the transactions for the peer and sends them together, when the window ends.
+* the window is between a half and one and a half of relay_window_ms, so the peers
+* do not send their batches at the same time. older peers get every transaction on its own
+* @param params to the corresponding transaction
+* @return false if the peer is not connected or the transaction could not be queued
+*/
+bool Connection::relayTransaction(const QString &params)
+{
+if (relayWindow <= 0 || !peerSupports(FeatureTransactionBatch))
+    return sendTransaction(params);
+if (QAbstractSocket::state() != QAbstractSocket::ConnectedState)
+    return false;
+relayBatch.append(params);
+if (relayBatch.size() >= MaxBatchTransactions) {
+    relayTimer.stop();
+    sendTransactionBatch();
+} else if (!relayTimer.isActive()) {
+    uniform_int_distribution<int> window(relayWindow / 2, relayWindow + relayWindow / 2);
+    relayTimer.start(window(relayRandom));
+}
+return true;
+}
+/**
+* @brief Connection::sendTransactionBatch
+* sends the collected transactions in one message: transaction;transaction;
+*/
+void Connection::sendTransactionBatch()
+{
+if (relayBatch.isEmpty())
+    return;
+QByteArray params = (relayBatch.join(";") + ";").toUtf8();
+relayBatches++;
+relayTransactions += relayBatch.size();
+relayBatch.clear();
+QByteArray data;
+data = "TX_BATCH " + QByteArray::number(params.size()) + SeparatorToken + params;
+enqueue(data, SendTransaction);
 }
 /**
 * @brief Connection::sendBlock
@@ -67,7 +181,358 @@ bool Connection::sendBlock(const QString &params)
 {
 QByteArray data;
 data = "BLOCK " + QByteArray::number(params.toUtf8().size()) + SeparatorToken + params.toUtf8();
-return write(data) == data.size();
+return enqueue(data, SendNewBlock);
+}
+
+/**
+* @brief Connection::sendCompactBlock
+* sends a block, in which the transactions of the mempool are replaced by short ids
+* @param params to the corresponding compact block
+* @return true if sending was successful
+*/
+bool Connection::sendCompactBlock(const QString &params)
+{
+QByteArray data;
+data = "COMPACT_BLOCK " + QByteArray::number(params.toUtf8().size()) + SeparatorToken + params.toUtf8();
+return enqueue(data, SendNewBlock);
+}
+
+/**
+* @brief Connection::sendBlockTransactionsRequest
+* requests the transactions of a compact block, that are not in the mempool
+* @param params hash, index and positions of the transactions
+* @return true if sending was successful
+*/
+bool Connection::sendBlockTransactionsRequest(const QString &params)
+{
+QByteArray data;
+data = "GET_BLOCK_TX " + QByteArray::number(params.toUtf8().size()) + SeparatorToken + params.toUtf8();
+return enqueue(data, SendBlockResponse);
+}
+
+/**
+* @brief Connection::sendBlockTransactions
+* answers the request for the transactions of a compact block
+* @param params hash, index and the transactions
+* @return true if sending was successful
+*/
+bool Connection::sendBlockTransactions(const QString &params)
+{
+QByteArray data;
+data = "BLOCK_TX " + QByteArray::number(params.toUtf8().size()) + SeparatorToken + params.toUtf8();
+return enqueue(data, SendBlockResponse);
+}
+
+/**
+* @brief Connection::setLocalStatus
+* sets the greeting to the version, the features and the tip of the own chain
+* @param height index of the latest block
+* @param tipHash hash of the latest block
+* @param luck sum of the lucky numbers of the main chain
+* @param listenPort of the own server, the peer can pass it on
+*/
+void Connection::setLocalStatus(int height, const QString &tipHash, double luck, int listenPort)
+{
+greetingMessage = QString(GreetingMagic) + QString::number(ProtocolVersion) + "," + QString::number(localFeatures) + ","
+        + QString::number(height) + "," + tipHash + "," + QString::number(luck, 'g', 17) + ","
+        + QString::number(listenPort) + ",";
+}
+
+/**
+* @brief Connection::parseGreeting
+* reads the status of the peer. older peers send a plain text and have version 0 without features
+* @param greeting of the peer
+*/
+void Connection::parseGreeting(const QString &greeting)
+{
+if (!greeting.startsWith(GreetingMagic))
+    return;
+QStringList paramsList = greeting.mid(QString(GreetingMagic).size()).split(",");
+if (paramsList.size() < 5)
+    return;
+//newer versions keep these fields and only add features
+peerVersion = paramsList.at(0).toInt();
+peerFeatures = paramsList.at(1).toInt();
+peerHeight = paramsList.at(2).toInt();
+peerTipHash = paramsList.at(3);
+peerLuck = paramsList.at(4).toDouble();
+if (paramsList.size() >= 6 && !outbound)
+    peerListenPort = paramsList.at(5).toInt();
+}
+
+/**
+* @brief Connection::supportsCompactBlocks
+* @return true if the peer announced compact blocks in its greeting
+*/
+bool Connection::supportsCompactBlocks() const
+{
+return peerSupports(FeatureCompactBlocks);
+}
+
+bool Connection::peerSupports(int feature) const
+{
+return (peerFeatures & feature) != 0;
+}
+
+int Connection::getPeerVersion() const
+{
+return peerVersion;
+}
+
+int Connection::getPeerHeight() const
+{
+return peerHeight;
+}
+
+QString Connection::getPeerTipHash() const
+{
+return peerTipHash;
+}
+
+double Connection::getPeerLuck() const
+{
+return peerLuck;
+}
+
+/**
+* @brief Connection::getServerPort
+* @return the port of the server of the peer, 0 if an incoming peer did not tell it
+*/
+int Connection::getServerPort() const
+{
+return peerListenPort;
+}
+
+/**
+* @brief Connection::setOutbound
+* marks the connection as made by this node
+* @param serverPort the connection is made to
+*/
+void Connection::setOutbound(int serverPort)
+{
+outbound = true;
+peerListenPort = serverPort;
+}
+
+bool Connection::isOutbound() const
+{
+return outbound;
+}
+
+/**
+* @brief Connection::sendAddressRequest
+* asks the peer for the addresses it knows
+* @return true if sending was successful
+*/
+bool Connection::sendAddressRequest()
+{
+return enqueue("GET_ADDR 1 a", SendControl);
+}
+
+/**
+* @brief Connection::sendAddresses
+* @param params ip,port; of every address
+* @return true if sending was successful
+*/
+bool Connection::sendAddresses(const QString &params)
+{
+QByteArray data;
+data = "ADDR " + QByteArray::number(params.toUtf8().size()) + SeparatorToken + params.toUtf8();
+return enqueue(data, SendControl);
+}
+
+/**
+* @brief Connection::isSendQueueFull
+* @return true from three quarters of the budget until the queue is half empty again
+*/
+bool Connection::isSendQueueFull() const
+{
+return sendQueueFullSignaled;
+}
+
+int Connection::getQueuedBytes() const
+{
+return queuedBytes;
+}
+
+/**
+* @brief Connection::printSendStats
+* prints the queued bytes and how long the messages of every class waited
+*/
+void Connection::printSendStats() const
+{
+cout << qPrintable(cliAddress) << ": " << queuedBytes << " bytes queued, max " << maxQueuedBytes
+     << ", budget " << sendBudget << (sendQueueFullSignaled ? ", full" : "") << endl;
+for (int i = 0; i < SendPriorities; i++)
+{
+    const SendStats &stats = sendStats[i];
+    cout << "  " << SendPriorityNames[i] << ": " << sendQueues[i].size() << " queued, "
+         << stats.messages << " sent (" << stats.bytes << " bytes), " << stats.dropped << " dropped";
+    if (stats.messages > 0)
+    {
+        cout << ", wait avg " << stats.totalWaitUs / stats.messages << " us, max " << stats.maxWaitUs << " us";
+    }
+    cout << endl;
+}
+if (relayBatches > 0)
+{
+    cout << "  transaction batches: " << relayBatches << " with " << relayTransactions << " transactions, "
+         << relayBatch.size() << " waiting" << endl;
+}
+for (int i = 0; i < 3; i++)
+{
+    const CompressionStats &stats = (i < 2) ? compressionStats[i] : decompressionStats;
+    if (stats.messages == 0)
+        continue;
+    cout << "  " << ((i == 0) ? "compressed fast" : (i == 1) ? "compressed dense" : "decompressed") << ": "
+         << stats.messages << " messages, " << stats.bytesIn << " -> " << stats.bytesOut << " bytes ("
+         << (i < 2 ? stats.bytesOut * 100 / max(1L, stats.bytesIn) : stats.bytesIn * 100 / max(1L, stats.bytesOut))
+         << " %), " << stats.cpuUs << " us" << endl;
+}
+}
+
+/**
+* @brief Connection::compress
+* compresses the message, if the peer supports it and it gets smaller.
+* block responses are compressed densely, the other messages fast
+* @param message the whole message
+* @param priority class of the message
+* @return the message to be sent
+*/
+QByteArray Connection::compress(const QByteArray &message, SendPriority priority)
+{
+if (!compression || message.size() < MinCompressSize || !peerSupports(FeatureCompression))
+    return message;
+
+bool dense = (priority == SendBlockResponse);
+CompressionStats &stats = compressionStats[dense ? 1 : 0];
+chrono::steady_clock::time_point started = chrono::steady_clock::now();
+QByteArray compressed = qCompress(message, dense ? 9 : 1);
+compressed = "COMPRESSED " + QByteArray::number(compressed.size()) + SeparatorToken + compressed;
+stats.messages++;
+stats.bytesIn += message.size();
+stats.cpuUs += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+if (compressed.size() >= message.size()) {
+    stats.bytesOut += message.size();
+    return message;
+}
+stats.bytesOut += compressed.size();
+return compressed;
+}
+
+/**
+* @brief Connection::enqueue
+* compresses and queues a message by its class. messages larger than a frame
+* are split, so the frames of other classes are sent in between.
+* whole transaction messages are dropped, if the peer does not read fast enough
+* to stay within the budget, a message is never dropped after its first frame
+* was written. a peer, that falls that far behind on blocks, is disconnected
+* @param message the whole message
+* @param priority class of the message
+* @return false if the message was dropped
+*/
+bool Connection::enqueue(const QByteArray &message, SendPriority priority)
+{
+//the member state of the greeting hides the socket state
+if (QAbstractSocket::state() != QAbstractSocket::ConnectedState)
+    return false;
+
+QByteArray data = compress(message, priority);
+
+//the oldest transactions make room first
+QQueue<OutboundMessage> &transactions = sendQueues[SendTransaction];
+for (auto it = transactions.begin(); queuedBytes + data.size() > sendBudget && priority != SendTransaction
+     && it != transactions.end();)
+{
+    if (it->started) {
+        ++it;
+        continue;
+    }
+    queuedBytes -= it->bytes;
+    sendStats[SendTransaction].dropped++;
+    it = transactions.erase(it);
+}
+if (queuedBytes + data.size() > sendBudget && queuedBytes > 0)
+{
+    sendStats[priority].dropped++;
+    if (priority != SendTransaction && priority != SendControl)
+    {
+        LOG(LOG_WARNING) << "peer " << qPrintable(cliAddress) << " is too far behind, disconnecting" << endl;
+        abort();
+    }
+    return false;
+}
+
+OutboundMessage outbound;
+outbound.bytes = 0;
+outbound.started = false;
+outbound.queued = chrono::steady_clock::now();
+if (data.size() <= FrameSize || !peerSupports(FeatureFrames)) {
+    outbound.frames.append(data);
+}
+for (int offset = 0; data.size() > FrameSize && peerSupports(FeatureFrames) && offset < data.size(); offset += FrameSize) {
+    QByteArray part = QByteArray::number(priority) + data.mid(offset, FrameSize);
+    outbound.frames.append(((offset + FrameSize >= data.size()) ? "FRAME_END " : "FRAME ")
+                           + QByteArray::number(part.size()) + SeparatorToken + part);
+}
+for (int i = 0; i < outbound.frames.size(); i++) {
+    outbound.bytes += outbound.frames.at(i).size();
+}
+sendQueues[priority].enqueue(outbound);
+queuedBytes += outbound.bytes;
+int typeEnd = message.indexOf(SeparatorToken);
+int lengthEnd = message.indexOf(SeparatorToken, typeEnd + 1);
+const MessageCounters &sent = messageCounters(dataTypeFromHeader(message.left(typeEnd + 1)), false);
+sent.messages->inc();
+sent.bytes->inc(lengthEnd < 0 ? 0 : message.size() - lengthEnd - 1);
+maxQueuedBytes = max(maxQueuedBytes, queuedBytes);
+if (!sendQueueFullSignaled && queuedBytes >= sendBudget / 4 * 3)
+{
+    sendQueueFullSignaled = true;
+    emit sendQueueFull();
+}
+flushSendQueue();
+return true;
+}
+
+/**
+* @brief Connection::flushSendQueue
+* hands the queued frames to the socket by priority, while it buffers less than the watermark.
+* the frames of a message follow each other within its class, other classes may come in between
+*/
+void Connection::flushSendQueue()
+{
+while (queuedBytes > 0 && bytesToWrite() < SocketWatermark)
+{
+    int priority = SendNewBlock;
+    while (sendQueues[priority].isEmpty())
+        priority++;
+    OutboundMessage &message = sendQueues[priority].head();
+    SendStats &stats = sendStats[priority];
+    if (!message.started) {
+        long waited = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - message.queued).count();
+        message.started = true;
+        stats.messages++;
+        stats.totalWaitUs += waited;
+        stats.maxWaitUs = max(stats.maxWaitUs, waited);
+    }
+    QByteArray frame = message.frames.takeFirst();
+    message.bytes -= frame.size();
+    queuedBytes -= frame.size();
+    if (message.frames.isEmpty())
+        sendQueues[priority].dequeue();
+
+    stats.bytes += frame.size();
+    wireBytesOut.inc(frame.size());
+    if (write(frame) != frame.size()) {
+        abort();
+        return;
+    }
+}
+if (sendQueueFullSignaled && queuedBytes <= sendBudget / 2) {
+    sendQueueFullSignaled = false;
+    emit sendQueueDrained();
+}
 }
 
 /**
@@ -81,12 +546,18 @@ bool Connection::sendBlockRequest(int blockID, int forkID)
 QByteArray data;
 QString idAsQString = QString::number(blockID) + "," + QString::number(forkID);
 data = "BLOCK_REQUEST " + QByteArray::number(idAsQString.toUtf8().size()) + SeparatorToken + idAsQString.toUtf8();
-return write(data) == data.size();
+requestedBlockID = blockID;
+requestedForkID = forkID;
+if (!blockRequestPending) {
+    blockRequestPending = true;
+    blockRequestTime.start();
+}
+return enqueue(data, SendBlockResponse);
 }
 bool Connection::sendTestingNetworkParticipantsRequest()
 {
     QByteArray data = "TEST_NETWORK_PARTICIPANTS_REQUEST ";
-    return write(data) == data.size();
+    return enqueue(data, SendControl);
 }
 
 /**
@@ -98,7 +569,7 @@ bool Connection::sendBlockResponse(const QString &params)
 {
     QByteArray data;
     data = "BLOCK_RESPONSE " + QByteArray::number(params.toUtf8().size()) + SeparatorToken + params.toUtf8();
-    return write(data) == data.size();
+    return enqueue(data, SendBlockResponse);
 }
 
 bool Connection::sendPublicKeyRequest()
@@ -106,14 +577,33 @@ bool Connection::sendPublicKeyRequest()
     QByteArray data;
     QByteArray pbkey = QString::fromStdString(getPublicBkey()).toUtf8();
     data = "PUBLICKEY_REQUEST " + QByteArray::number(pbkey.size()) + SeparatorToken + pbkey;
-    return write(data) == data.size();
+    return enqueue(data, SendControl);
 }
 bool Connection::sendCheckBlockchain()
 {
     QByteArray data;
     QByteArray defaultMessage = QString::fromStdString("default").toUtf8();
     data = "CHECK_BLOCKCHAIN "+ QByteArray::number(defaultMessage.size()) + SeparatorToken + defaultMessage;
-    return write(data) == data.size();
+    return enqueue(data, SendBlockResponse);
+}
+
+/**
+* @brief Connection::sendPrunedHeight
+* tells the peer, that only the headers up to a block are stored
+* @param height of the last block without transactions
+* @return true if sending was successful
+*/
+bool Connection::sendPrunedHeight(int height)
+{
+    QByteArray data;
+    QByteArray heightAsByteArray = QByteArray::number(height);
+    data = "PRUNED " + QByteArray::number(heightAsByteArray.size()) + SeparatorToken + heightAsByteArray;
+    return enqueue(data, SendBlockResponse);
+}
+
+int Connection::getPrunedHeight() const
+{
+    return prunedHeight;
 }
 
 bool Connection::sendPublicKeyResponse()
@@ -121,7 +611,7 @@ bool Connection::sendPublicKeyResponse()
     QByteArray data;
     QByteArray pbkey = QString::fromStdString(getPublicBkey()).toUtf8();
     data = "PUBLICKEY_RESPONSE " + QByteArray::number(pbkey.size()) + SeparatorToken + pbkey;
-    return write(data) == data.size();
+    return enqueue(data, SendControl);
 }
 
 bool Connection::sendPublicKeyForTestModeRemove()
@@ -129,7 +619,7 @@ bool Connection::sendPublicKeyForTestModeRemove()
     QByteArray data;
     QByteArray pbkey = QString::fromStdString(getPublicBkey()).toUtf8();
     data = "PUBLICKEY_REMOVE " + QByteArray::number(pbkey.size()) + SeparatorToken + pbkey;
-    return write(data) == data.size();
+    return enqueue(data, SendControl);
 }
 
 bool Connection::sendPublicKeyForTestModeAdd(string pbkey)
@@ -137,7 +627,7 @@ bool Connection::sendPublicKeyForTestModeAdd(string pbkey)
     QByteArray data;
     QByteArray pbkeyAsByteArray = QString::fromStdString(pbkey).toUtf8();
     data = "PUBLICKEY_ADD " + QByteArray::number(pbkeyAsByteArray.size()) + SeparatorToken + pbkeyAsByteArray;
-    return write(data) == data.size();
+    return enqueue(data, SendControl);
 }
 
 void Connection::timerEvent(QTimerEvent *timerEvent)
@@ -177,6 +667,7 @@ if (state == ReadingGreeting) {
     }
 
     cliAddress = peerAddress().toString() + ':' + QString::number(peerPort());
+    parseGreeting(QString::fromUtf8(buffer));
     currentDataType = Undefined;
     numBytesForCurrentDataType = 0;
     buffer.clear();
@@ -214,7 +705,8 @@ if (pongTime.elapsed() > PongTimeout) {
     return;
 }
 
-write("PING 1 p");
+pingTime.start();
+enqueue("PING 1 p", SendControl);
 }
 
 void Connection::sendGreetingMessage()
@@ -275,6 +767,65 @@ int number = buffer.toInt();
 buffer.clear();
 return number;
 }
+/**
+* @brief Connection::dataTypeFromHeader
+* @param header type of the message with the separator
+* @return Undefined for an unknown type
+*/
+Connection::DataType Connection::dataTypeFromHeader(const QByteArray &header)
+{
+if (header == "PING ") {
+    return Ping;
+} else if (header == "PONG ") {
+    return Pong;
+} else if (header == "MESSAGE ") {
+    return PlainText;
+} else if (header == "GREETING ") {
+    return Greeting;
+} else if (header == "BLOCK ") {
+    return ReceivedBlock;
+} else if (header == "TRANSACTION ") {
+    return ReceivedTransaction;
+} else if (header == "TX_BATCH ") {
+    return TransactionBatch;
+} else if (header == "BLOCK_REQUEST ") {
+    return BlockRequest;
+} else if (header == "CHECK_BLOCKCHAIN ") {
+    return CheckBlockchain;
+} else if (header == "PRUNED ") {
+    return Pruned;
+} else if (header == "BLOCK_RESPONSE ") {
+    return BlockResponse;
+} else if (header == "COMPACT_BLOCK ") {
+    return ReceivedCompactBlock;
+} else if (header == "GET_BLOCK_TX ") {
+    return BlockTransactionsRequest;
+} else if (header == "BLOCK_TX ") {
+    return BlockTransactionsResponse;
+} else if (header == "GET_ADDR ") {
+    return AddressRequest;
+} else if (header == "ADDR ") {
+    return Addresses;
+} else if (header == "COMPRESSED ") {
+    return Compressed;
+} else if (header == "FRAME ") {
+    return Frame;
+} else if (header == "FRAME_END ") {
+    return FrameEnd;
+} else if (header == "PUBLICKEY_REQUEST ") {
+    return PublicKeyRequest;
+} else if (header == "PUBLICKEY_RESPONSE ") {
+    return PublicKeyResponse;
+} else if (header == "PUBLICKEY_ADD ") {
+    return PublicKeyForTestModeAdd;
+} else if (header == "TEST_NETWORK_PARTICIPANTS_REQUEST ") {
+    return TestNetworkParticipantsRequest;
+} else if (header == "PUBLICKEY_REMOVE ") {
+    return PublicKeyForTestModeRemove;
+}
+return Undefined;
+}
+
 /**
 * @brief Connection::readProtocolHeader
 * sets the currentDataType
@@ -294,42 +845,15 @@ if (readDataIntoBuffer() <= 0) {
     return false;
 }
 
-if (buffer == "PING ") {
-    currentDataType = Ping;
-} else if (buffer == "PONG ") {
-    currentDataType = Pong;
-} else if (buffer == "MESSAGE ") {
-    currentDataType = PlainText;
-} else if (buffer == "GREETING ") {
-    currentDataType = Greeting;
-} else if (buffer == "BLOCK ") {
-    currentDataType = ReceivedBlock;
-} else if (buffer == "TRANSACTION ") {
-    currentDataType = ReceivedTransaction;
-} else if (buffer == "BLOCK_REQUEST ") {
-    currentDataType = BlockRequest;
-} else if (buffer == "CHECK_BLOCKCHAIN ") {
-    currentDataType = CheckBlockchain;
-} else if (buffer == "BLOCK_RESPONSE ") {
-    currentDataType = BlockResponse;
-} else if (buffer == "PUBLICKEY_REQUEST ") {
-    currentDataType = PublicKeyRequest;
-} else if (buffer == "PUBLICKEY_RESPONSE ") {
-    currentDataType = PublicKeyResponse;
-} else if (buffer == "PUBLICKEY_ADD ") {
-    currentDataType = PublicKeyForTestModeAdd;    
-} else if (buffer == "TEST_NETWORK_PARTICIPANTS_REQUEST ") {
-    currentDataType = TestNetworkParticipantsRequest;
-} else if (buffer == "PUBLICKEY_REMOVE ") {
-    currentDataType = PublicKeyForTestModeRemove;
-} else {
-    currentDataType = Undefined;
+currentDataType = dataTypeFromHeader(buffer);
+if (currentDataType == Undefined) {
     abort();
     return false;
 }
 
 buffer.clear();
 numBytesForCurrentDataType = dataLengthForCurrentDataType();
+messageStarted = chrono::steady_clock::now();
 return true;
 }
 /**
@@ -369,22 +893,123 @@ if (buffer.size() != numBytesForCurrentDataType) {
     abort();
     return;
 }
+wireBytesIn.inc(buffer.size());
+
+processPayload(true);
+currentDataType = Undefined;
+numBytesForCurrentDataType = 0;
+buffer.clear();
+}
+
+/**
+* @brief Connection::parseBlock
+* traces the time from the header of the message to its end, for frames of the last frame, and the parsing
+* @param payload block in the format of the wire protocol
+* @return the parsed block and its fork
+*/
+forkBlock Connection::parseBlock(const QByteArray &payload)
+{
+chrono::steady_clock::time_point parseStart = chrono::steady_clock::now();
+forkBlock received = HelperFunctions::parseStringToBlock(QString::fromUtf8(payload).toStdString());
+int index = received.block ? received.block->getIndex() : -1;
+Trace::instance().record("read block", index, messageStarted, parseStart);
+Trace::instance().record("parse block", index, parseStart, chrono::steady_clock::now());
+return received;
+}
 
+/**
+* @brief Connection::processMessage
+* handles a message, that was compressed or sent in frames
+* @param message the whole message with its header
+* @param outer false for the content of a compressed message
+*/
+void Connection::processMessage(const QByteArray &message, bool outer)
+{
+int typeEnd = message.indexOf(SeparatorToken);
+int lengthEnd = message.indexOf(SeparatorToken, typeEnd + 1);
+if (typeEnd < 0 || lengthEnd < 0) {
+    abort();
+    return;
+}
+currentDataType = dataTypeFromHeader(message.left(typeEnd + 1));
+buffer = message.mid(lengthEnd + 1);
+if (currentDataType == Undefined || currentDataType == Frame || currentDataType == FrameEnd
+        || buffer.size() != message.mid(typeEnd + 1, lengthEnd - typeEnd - 1).toInt()) {
+    abort();
+    return;
+}
+processPayload(outer);
+}
+
+/**
+* @brief Connection::processPayload
+* checks the currentDataType and emits corresponding signals for the payload in the buffer
+* @param outer false for the content of a compressed message, that must not be compressed again
+*/
+void Connection::processPayload(bool outer)
+{
+//compressed messages and frames are counted by the type of their content
+if (currentDataType != Compressed && currentDataType != Frame && currentDataType != FrameEnd) {
+    const MessageCounters &received = messageCounters(currentDataType, true);
+    received.messages->inc();
+    received.bytes->inc(buffer.size());
+}
 switch (currentDataType) {
+case Compressed:
+    {
+        //qCompress stores the size in the first 4 bytes, big endian
+        const unsigned char *size = (const unsigned char *) buffer.constData();
+        if (!outer || buffer.size() < 4
+                || ((quint32) size[0] << 24 | size[1] << 16 | size[2] << 8 | size[3]) > (quint32) maxMessageSize) {
+            abort();
+            return;
+        }
+        chrono::steady_clock::time_point started = chrono::steady_clock::now();
+        QByteArray message = qUncompress(buffer);
+        CompressionStats &stats = decompressionStats;
+        stats.messages++;
+        stats.bytesIn += buffer.size();
+        stats.bytesOut += message.size();
+        stats.cpuUs += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+        if (message.isEmpty()) {
+            abort();
+            return;
+        }
+        processMessage(message, false);
+    }
+    break;
+case Frame:
+case FrameEnd:
+    {
+        //frames of different classes may interleave, the first byte tells the class
+        int priority = buffer.isEmpty() ? -1 : buffer.at(0) - '0';
+        if (!outer || priority < 0 || priority >= SendPriorities
+                || frameBuffers[priority].size() + buffer.size() > maxMessageSize) {
+            abort();
+            return;
+        }
+        frameBuffers[priority].append(buffer.constData() + 1, buffer.size() - 1);
+        if (currentDataType == FrameEnd) {
+            QByteArray message = frameBuffers[priority];
+            frameBuffers[priority].clear();
+            processMessage(message, true);
+        }
+    }
+    break;
 case PlainText:
     cout <<  qPrintable(buffer) << endl; //TESTING <- dont delete
     break;
 case Ping:
-    write("PONG 1 p");
+    enqueue("PONG 1 p", SendControl);
     break;
 case Pong:
     pongTime.restart();
+    if (pingTime.isValid())
+        emit roundTripMeasured(pingTime.elapsed());
     break;
 case ReceivedBlock:
     {
-        QString paramsFromBuffer = QString::fromUtf8(buffer);
-
-        emit handleReceivedBlock(HelperFunctions::parseQStringToBlock(paramsFromBuffer));
+        emit handleReceivedBlock(parseBlock(buffer));
     }
     break;
 case ReceivedTransaction:
@@ -398,6 +1023,12 @@ case ReceivedTransaction:
                                             paramsList.at(4).toInt());
     }
     break;
+case TransactionBatch:
+    {
+        //the client parses and submits the whole batch at once
+        emit addReceivedTransactions(QString::fromUtf8(buffer).toStdString());
+    }
+    break;
 case Greeting:
     {
     //        cout <<  qPrintable(buffer) << endl;
@@ -408,6 +1039,16 @@ case CheckBlockchain:
         emit checkDatabase();
     }
     break;
+case Pruned:
+    {
+        prunedHeight = buffer.toInt();
+        //the request is answered, another peer has to send the block
+        if (blockRequestPending && requestedBlockID > 0 && requestedBlockID <= prunedHeight) {
+            blockRequestPending = false;
+            emit blockRequestPruned(requestedBlockID, requestedForkID);
+        }
+    }
+    break;
 case BlockRequest:
     {
         QString blockIDAndForkIDFromBuffer = QString::fromUtf8(buffer);
@@ -420,9 +1061,38 @@ case BlockRequest:
 case BlockResponse:
     {
 //        cout << qPrintable(buffer) << endl;
-        QString paramsFromBuffer = QString::fromUtf8(buffer);
+        if (blockRequestPending) {
+            blockRequestPending = false;
+            emit blockLatencyMeasured(blockRequestTime.elapsed());
+        }
 
-        emit handleReceivedBlock(HelperFunctions::parseQStringToBlock(paramsFromBuffer));
+        emit handleReceivedBlock(parseBlock(buffer));
+    }
+    break;
+case AddressRequest:
+    {
+        emit addressesRequested();
+    }
+    break;
+case Addresses:
+    {
+        emit addressesReceived(QString::fromUtf8(buffer).toStdString());
+    }
+    break;
+case ReceivedCompactBlock:
+    {
+        //parsed by the validation worker
+        emit handleReceivedCompactBlock(QString::fromUtf8(buffer).toStdString());
+    }
+    break;
+case BlockTransactionsRequest:
+    {
+        emit sendBlockTransactionsResponse(QString::fromUtf8(buffer).toStdString());
+    }
+    break;
+case BlockTransactionsResponse:
+    {
+        emit handleReceivedBlockTransactions(QString::fromUtf8(buffer).toStdString());
     }
     break;
 case PublicKeyRequest:
@@ -460,7 +1130,4 @@ case TestNetworkParticipantsRequest:
 default:
     break;
 }
-    currentDataType = Undefined;
-    numBytesForCurrentDataType = 0;
-    buffer.clear();
 }
@@ -2,7 +2,10 @@
 #define CONNECTION_H
 
 #include <vector>
+#include <chrono>
+#include <random>
 #include <QHostAddress>
+#include <QQueue>
 #include <QString>
 #include <QTcpSocket>
 #include <QTime>
@@ -13,12 +16,19 @@
 #include "../Chain/transactions.hpp"
 #include "../Interface/console.h"
 #include "helperfunctions.h"
+#include "../trace.h"
 
 using namespace std;
 using namespace HelperFunctions;
 
 static const int MaxBufferSize = 1024000;
 static const char SeparatorToken = ' ';
+static const char GreetingMagic[] = "POLUCK/";
+static const int ProtocolVersion = 1;
+static const int SocketWatermark = 256 * 1024;  //bytes handed to the socket, the rest waits in the send queues
+static const int FrameSize = 256 * 1024;
+static const int MinCompressSize = 512;         //smaller messages are sent as they are
+static const int MaxBatchTransactions = 1000;   //a fuller batch is sent before its window ends
 
 class Connection : public QTcpSocket
 {
@@ -42,18 +52,78 @@ public:
         TestNetworkParticipantsRequest,
         ReceivedBlock,
         ReceivedTransaction,
+        TransactionBatch,
         BlockRequest,
         BlockResponse,
         CheckBlockchain,
+        Pruned,
+        ReceivedCompactBlock,
+        BlockTransactionsRequest,
+        BlockTransactionsResponse,
+        AddressRequest,
+        Addresses,
+        Compressed,
+        Frame,
+        FrameEnd,
         Undefined
     };
+    //announced in the greeting, unknown bits are ignored
+    enum Feature {
+        FeatureBinaryWire = 1,      //reserved, this version only speaks the text format
+        FeatureCompression = 2,
+        FeatureCompactBlocks = 4,
+        FeatureFrames = 8,          //messages larger than a frame are split
+        FeatureAddressGossip = 16,
+        FeatureTransactionBatch = 32,
+        FeaturePrunedHeight = 64    //answers block requests below its base with PRUNED
+    };
+    //the lower classes are sent first
+    enum SendPriority {
+        SendNewBlock,
+        SendBlockResponse,  //and the other messages of the synchronization
+        SendTransaction,
+        SendControl,        //keys and pings
+        SendPriorities
+    };
+    struct SendStats {
+        long messages;
+        long bytes;
+        long dropped;
+        long totalWaitUs;   //time in the send queue
+        long maxWaitUs;
+    };
+    struct CompressionStats {
+        long messages;
+        long bytesIn;
+        long bytesOut;
+        long cpuUs;
+    };
 
     Connection(QObject *parent = 0);
 
     QString address() const;
     void setGreetingMessage(const QString &message);
+    void setLocalStatus(int height, const QString &tipHash, double luck, int listenPort = 0);
+    int getPeerVersion() const;
+    int getPeerHeight() const;
+    QString getPeerTipHash() const;
+    double getPeerLuck() const;
+    int getServerPort() const;
+    void setOutbound(int serverPort);
+    bool isOutbound() const;
+    bool sendAddressRequest();
+    bool sendAddresses(const QString &params);
     bool sendBlock(const QString &params);
+    bool sendCompactBlock(const QString &params);
+    bool sendBlockTransactionsRequest(const QString &params);
+    bool sendBlockTransactions(const QString &params);
+    bool supportsCompactBlocks() const;
+    bool peerSupports(int feature) const;
+    bool isSendQueueFull() const;
+    int getQueuedBytes() const;
+    void printSendStats() const;
     bool sendTransaction(const QString &params);
+    bool relayTransaction(const QString &params);
     bool sendBlockRequest(int blockID = 0, int forkID = 0);
     bool sendTestingNetworkParticipantsRequest();
     bool sendBlockResponse(const QString &params);
@@ -61,19 +131,32 @@ public:
     bool sendPublicKeyResponse();
     bool sendPublicKeyForTestModeRemove();
     bool sendCheckBlockchain();
+    bool sendPrunedHeight(int height);
+    int getPrunedHeight() const;
     bool sendPublicKeyForTestModeAdd(string pbkey = getPublicBkey());
     string publicKeyToAddress;
 
 signals:
     void readyForUse();
     void addReceivedTransaction(string,string, string, int, int);
+    void addReceivedTransactions(string);
     void handleReceivedBlock(forkBlock);
+    void handleReceivedCompactBlock(string);
+    void handleReceivedBlockTransactions(string);
+    void sendBlockTransactionsResponse(string request);
     void sendBlockResponseWithBlock(int requestedBlockId, int forkID);
     void removePublicKeyFromTestNetwork(string);
     void addPublicKeyFromTestNetwork(string);
     void handlePublicKey(string);
     void sendAllKnownParticipants();
     void checkDatabase();
+    void blockRequestPruned(int blockID, int forkID);  //the peer only stores the header of the requested block
+    void sendQueueFull();       //the producers should wait for sendQueueDrained
+    void roundTripMeasured(int ms);
+    void blockLatencyMeasured(int ms);     //from a block request to its response
+    void addressesRequested();
+    void addressesReceived(string);
+    void sendQueueDrained();
 
 protected:
     void timerEvent(QTimerEvent *timerEvent) override;
@@ -82,6 +165,8 @@ private slots:
     void processReadyRead();
     void sendPing();
     void sendGreetingMessage();
+    void flushSendQueue();
+    void sendTransactionBatch();
 
 
 private:
@@ -89,19 +174,64 @@ private:
     int dataLengthForCurrentDataType();
     bool readProtocolHeader();
     bool hasEnoughData();
+    QByteArray compress(const QByteArray &message, SendPriority priority);
+    bool enqueue(const QByteArray &message, SendPriority priority);
+    static DataType dataTypeFromHeader(const QByteArray &header);
     void processData();
+    void parseGreeting(const QString &greeting);
+    void processMessage(const QByteArray &message, bool outer);
+    void processPayload(bool outer);
+    forkBlock parseBlock(const QByteArray &payload);
     int forkID;
+    int prunedHeight;   //the peer only stores the headers up to this block
     QString greetingMessage;
+    int localFeatures;
+    int peerVersion;            //0 for peers, that do not send their status
+    int peerFeatures;
+    int peerHeight;             //when it connected
+    QString peerTipHash;
+    double peerLuck;            //sum of the lucky numbers of its main chain
+    int peerListenPort;         //of the server of the peer
+    bool outbound;              //connected by this node
+    QTime pingTime;
+    QTime blockRequestTime;
+    bool blockRequestPending;
+    int requestedBlockID;       //of the last block request
+    int requestedForkID;
     QString cliAddress;
 
     QTimer pingTimer;
+    QTimer relayTimer;
+    QStringList relayBatch;     //transactions waiting for the end of the window
+    int relayWindow;            //in ms, 0 sends every transaction right away
+    mt19937 relayRandom;
+    long relayBatches;
+    long relayTransactions;
     QTime pongTime;
     QByteArray buffer;
     ConnectionState state;
     DataType currentDataType;
     int numBytesForCurrentDataType;
     int transferTimerId;
+    chrono::steady_clock::time_point messageStarted;    //when the header of the current message was read
     bool isGreetingMessageSent;
+    struct OutboundMessage {
+        QList<QByteArray> frames;   //the whole message, or its frames for peers that support them
+        int bytes;                  //of the frames, that were not written yet
+        bool started;               //a frame was written, the rest has to follow
+        chrono::steady_clock::time_point queued;
+    };
+    QQueue<OutboundMessage> sendQueues[SendPriorities];
+    SendStats sendStats[SendPriorities];
+    int queuedBytes;
+    int maxQueuedBytes;
+    int sendBudget;             //bytes in the send queues, before transactions are dropped
+    bool sendQueueFullSignaled;
+    bool compression;
+    CompressionStats compressionStats[2];  //fast and dense
+    CompressionStats decompressionStats;
+    QByteArray frameBuffers[SendPriorities];
+    int maxMessageSize;         //after joining the frames or decompressing
     Block createBlockFromString(QString);
 };
 
@@ -0,0 +1,610 @@
+#include "loadgenerator.h"
+#include <iomanip>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+    :buckets((64 - 2) * SUB_BUCKETS, 0), count(0), sum(0), maximum(0)
+{
+
+}
+
+void LatencyHistogram::add(long latency)
+{
+    latency = max(latency, 0L);
+    buckets.at(bucketOf(latency))++;
+    count++;
+    sum += latency;
+    maximum = max(maximum, latency);
+}
+
+long LatencyHistogram::getCount() const
+{
+    return count;
+}
+
+/**
+ * @brief LatencyHistogram::percentile
+ * @param p between 0 and 1
+ * @return upper bound of the bucket, that contains the percentile
+ */
+long LatencyHistogram::percentile(double p) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    long rank = max(1L, (long) ceil(p * count));
+    long seen = 0;
+    for (unsigned int i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets.at(i);
+        if (seen >= rank)
+        {
+            return min(lowerBound(i + 1) - 1, maximum);
+        }
+    }
+    return maximum;
+}
+
+/**
+ * @brief LatencyHistogram::printRow
+ * prints the count, mean, p50, p90, p99 and max in milliseconds
+ */
+void LatencyHistogram::printRow(const string &name) const
+{
+    cout << left << setw(10) << name << right << setw(8) << count << fixed << setprecision(1)
+         << setw(10) << (count ? sum / 1000.0 / count : 0.0)
+         << setw(10) << percentile(0.5) / 1000.0
+         << setw(10) << percentile(0.9) / 1000.0
+         << setw(10) << percentile(0.99) / 1000.0
+         << setw(10) << maximum / 1000.0 << endl;
+}
+
+/**
+ * @brief LatencyHistogram::printBuckets
+ * prints the number of latencies per power of two
+ */
+void LatencyHistogram::printBuckets(const string &name) const
+{
+    if (count == 0)
+    {
+        return;
+    }
+    cout << name << ":" << endl;
+    for (unsigned int octave = 0; octave < buckets.size() / SUB_BUCKETS; octave++)
+    {
+        long inOctave = 0;
+        for (int i = 0; i < SUB_BUCKETS; i++)
+        {
+            inOctave += buckets.at(octave * SUB_BUCKETS + i);
+        }
+        if (inOctave == 0)
+        {
+            continue;
+        }
+        long from = octave == 0 ? 0 : lowerBound(octave * SUB_BUCKETS);
+        long to = lowerBound((octave + 1) * SUB_BUCKETS);
+        cout << fixed << setprecision(3) << setw(12) << from / 1000.0 << " - " << setw(12) << to / 1000.0 << " ms"
+             << setw(8) << inOctave << " " << string(max(1L, inOctave * 50 / count), '#') << endl;
+    }
+}
+
+int LatencyHistogram::bucketOf(long latency)
+{
+    if (latency < SUB_BUCKETS)
+    {
+        return latency;
+    }
+    int exponent = 63 - __builtin_clzll(latency);
+    return (exponent - 2) * SUB_BUCKETS + ((latency >> (exponent - 3)) & (SUB_BUCKETS - 1));
+}
+
+long LatencyHistogram::lowerBound(int bucket)
+{
+    if (bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    int exponent = bucket / SUB_BUCKETS + 2;
+    return (long) (SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - 3);
+}
+
+LoadGenerator::LoadGenerator(Blockchain &chain, QObject *parent)
+    :QObject(parent), chain(chain), connection(nullptr), listenerID(-1), phase(LOAD_IDLE),
+      nextTransaction(0), fundingOpen(0), lastSent(0), lastFinal(0), sendTimer(this), drainTimer(this),
+      rate(0), poisson(false), duration(0), keyCount(0), funding(0), confirmations(1), planned(0), submitted(0),
+      sendErrors(0), dropped(0), reorganized(0), unconfirmed(0)
+{
+    sendTimer.setSingleShot(true);
+    sendTimer.setTimerType(Qt::PreciseTimer);
+    drainTimer.setSingleShot(true);
+    connect(&sendTimer, SIGNAL(timeout()), this, SLOT(sendDue()));
+    connect(&drainTimer, SIGNAL(timeout()), this, SLOT(finish()));
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    if (listenerID >= 0)
+    {
+        chain.removeEventListener(listenerID);
+    }
+}
+
+/**
+ * @brief LoadGenerator::start
+ * connects to the own server and funds the keys.
+ * the load starts, when all funding transactions are included
+ * @param port of the own server
+ * @return false if a run is active
+ */
+bool LoadGenerator::start(quint16 port)
+{
+    if (phase != LOAD_IDLE)
+    {
+        return false;
+    }
+    Config &config = Config::instance();
+    rate = stod(config.get("load_rate", to_string(DEFAULT_RATE)));
+    poisson = config.get("load_arrivals", "constant") == "poisson";
+    duration = config.getInt("load_duration", DEFAULT_DURATION);
+    keyCount = max(2, config.getInt("load_keys", DEFAULT_KEYS));
+    funding = config.getInt("load_funding", DEFAULT_FUNDING);
+    confirmations = max(1, config.getInt("load_confirmations", DEFAULT_CONFIRMATIONS));
+    drainTimer.setInterval(config.getInt("load_drain", DEFAULT_DRAIN_TIME) * 1000);
+    random.seed(config.get("load_seed").empty() ? random_device()() : stoull(config.get("load_seed")));
+    if (rate <= 0 || duration <= 0)
+    {
+        cout << "load_rate and load_duration have to be positive" << endl;
+        return false;
+    }
+    if (chain.getBalance(getPublicBkey()) < keyCount * funding)
+    {
+        cout << "the node key needs " << keyCount * funding << " coins to fund " << keyCount << " keys" << endl;
+        return false;
+    }
+
+    transactions.clear();
+    transactionsByHash.clear();
+    open.clear();
+    nextTransaction = 0;
+    lastSent = lastFinal = 0;
+    planned = submitted = sendErrors = dropped = reorganized = unconfirmed = 0;
+    sendDelay = mempoolLatency = includedLatency = finalLatency = LatencyHistogram();
+    createKeys();
+
+    listenerID = chain.addEventListener([this](ChainEvent event, const string &hash)
+    {
+        TrackedEvent tracked = {event, hash, chrono::steady_clock::now()};
+        lock_guard<mutex> lock(eventMutex);
+        events.push_back(tracked);
+        if (events.size() == 1)
+        {
+            QMetaObject::invokeMethod(this, "processEvents", Qt::QueuedConnection);
+        }
+    });
+    phase = LOAD_CONNECTING;
+    connection = new Connection(this);
+    connection->setGreetingMessage("load generator");
+    connect(connection, SIGNAL(readyForUse()), this, SLOT(connected()));
+    connect(connection, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(connectionError(QAbstractSocket::SocketError)));
+    connect(connection, SIGNAL(handleReceivedBlock(forkBlock)), this, SLOT(discardBlock(forkBlock)));
+    connect(connection, SIGNAL(sendQueueDrained()), this, SLOT(sendDue()));
+    connection->connectToHost(QHostAddress::LocalHost, port);
+    return true;
+}
+
+/**
+ * @brief LoadGenerator::stop
+ * ends the run and prints the report of the transactions sent so far
+ */
+void LoadGenerator::stop()
+{
+    if (phase != LOAD_IDLE)
+    {
+        finish();
+    }
+}
+
+bool LoadGenerator::isRunning() const
+{
+    return phase != LOAD_IDLE;
+}
+
+void LoadGenerator::connected()
+{
+    if (phase != LOAD_CONNECTING)
+    {
+        return;
+    }
+    fund();
+}
+
+void LoadGenerator::connectionError(QAbstractSocket::SocketError)
+{
+    if (phase == LOAD_IDLE)
+    {
+        return;
+    }
+    cout << "load generator lost the connection: " << connection->errorString().toStdString() << endl;
+    finish();
+}
+
+/**
+ * @brief LoadGenerator::discardBlock
+ * the node sends its blocks to the generator like to any peer.
+ * they are tracked through the chain instead
+ */
+void LoadGenerator::discardBlock(forkBlock block)
+{
+    delete block.block;
+}
+
+/**
+ * @brief LoadGenerator::createKeys
+ * derives the keypairs from the seed, so a run can be repeated with the same keys
+ */
+void LoadGenerator::createKeys()
+{
+    keys.clear();
+    uint64_t seed = random();
+    for (int i = 0; i < keyCount; i++)
+    {
+        Keypair keypair;
+        unsigned char publicKey[crypto_sign_PUBLICKEYBYTES];
+        unsigned char keySeed[crypto_sign_SEEDBYTES];
+        string seedString = to_string(seed) + ":" + to_string(i);
+        keypair.secretKey.resize(crypto_sign_SECRETKEYBYTES);
+        crypto_hash_sha256(keySeed, (const unsigned char*)seedString.data(), seedString.size());
+        crypto_sign_seed_keypair(publicKey, keypair.secretKey.data(), keySeed);
+        keypair.publicKey = base64_encode(publicKey, crypto_sign_PUBLICKEYBYTES);
+        keys.push_back(keypair);
+    }
+}
+
+/**
+ * @brief LoadGenerator::fund
+ * sends the funding of every key from the node key
+ */
+void LoadGenerator::fund()
+{
+    Keypair node;
+    node.publicKey = getPublicBkey();
+    node.secretKey.resize(crypto_sign_SECRETKEYBYTES);
+    getPrivateUkey(node.secretKey.data(), crypto_sign_SECRETKEYBYTES);
+    time_t timestamp = Clock::instance().now();
+    for (int i = 0; i < keyCount; i++)
+    {
+        addTransaction(node, keys.at(i).publicKey, funding, timestamp, 0, true);
+    }
+    phase = LOAD_FUNDING;
+    phaseStart = chrono::steady_clock::now();
+    fundingOpen = keyCount;
+    cout << "funding " << keyCount << " keys with " << funding << " coins, waiting for the next block" << endl;
+    for (unsigned int i = 0; i < transactions.size(); i++)
+    {
+        submit(i);
+    }
+    nextTransaction = transactions.size();
+    if (sendErrors > 0)
+    {
+        cout << "the funding transactions could not be sent" << endl;
+        finish();
+    }
+}
+
+/**
+ * @brief LoadGenerator::generate
+ * plans and signs all transactions of the run.
+ * every key sends 1 coin to the other keys in turn, so the
+ * transactions of one second differ in the sender or recipient
+ */
+void LoadGenerator::generate()
+{
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    exponential_distribution<double> gap(rate);
+    time_t startTime = Clock::instance().now();
+    double offset = 0;
+    for (long i = 0; offset < duration; i++)
+    {
+        const Keypair &sender = keys.at(i % keyCount);
+        int step = 1 + (i / keyCount) % (keyCount - 1);
+        const string &recipient = keys.at((i % keyCount + step) % keyCount).publicKey;
+        addTransaction(sender, recipient, 1, startTime + (time_t) offset, (long) (offset * 1000000), false);
+        planned++;
+        offset = poisson ? offset + gap(random) : (i + 1) / rate;
+    }
+    cout << "signed " << planned << " transactions in "
+         << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count() << " ms" << endl;
+}
+
+void LoadGenerator::addTransaction(const Keypair &sender, const string &recipient, int value, time_t timestamp, long sendTime, bool isFunding)
+{
+    LoadTransaction transaction;
+    transaction.hash = signMsg(recipient, sender.publicKey, value, timestamp, sender.secretKey.data());
+    //the signature is deterministic, a repeated transaction gets another value
+    while (transactionsByHash.count(transaction.hash))
+    {
+        value++;
+        transaction.hash = signMsg(recipient, sender.publicKey, value, timestamp, sender.secretKey.data());
+    }
+    transaction.message = QString::fromStdString(sender.publicKey) + "," + QString::fromStdString(recipient) + ","
+            + QString::fromStdString(transaction.hash) + "," + QString::number(value) + "," + QString::number(timestamp);
+    transaction.stage = TX_PLANNED;
+    transaction.planned = sendTime;
+    transaction.block = -1;
+    transaction.funding = isFunding;
+    transaction.reorganized = false;
+    transactionsByHash[transaction.hash] = transactions.size();
+    transactions.push_back(transaction);
+}
+
+/**
+ * @brief LoadGenerator::startSending
+ * signs the load after the funding and sends the first transactions
+ */
+void LoadGenerator::startSending()
+{
+    generate();
+    phase = LOAD_SENDING;
+    phaseStart = chrono::steady_clock::now();
+    cout << "sending " << planned << " transactions at " << rate << " per second ("
+         << (poisson ? "poisson" : "constant") << ") for " << duration << " s" << endl;
+    sendDue();
+}
+
+/**
+ * @brief LoadGenerator::sendDue
+ * sends all transactions, whose time has come, and waits for the next one
+ */
+void LoadGenerator::sendDue()
+{
+    if (phase != LOAD_SENDING)
+    {
+        return;
+    }
+    long now = sinceStart(chrono::steady_clock::now());
+    while (nextTransaction < transactions.size() && transactions.at(nextTransaction).planned <= now)
+    {
+        //the node does not read fast enough, sendQueueDrained continues and the delay is measured
+        if (connection->isSendQueueFull())
+        {
+            return;
+        }
+        submit(nextTransaction);
+        nextTransaction++;
+    }
+    if (nextTransaction < transactions.size())
+    {
+        long wait = transactions.at(nextTransaction).planned - sinceStart(chrono::steady_clock::now());
+        sendTimer.start(max(0L, (wait + 999) / 1000));
+        return;
+    }
+    phase = LOAD_DRAINING;
+    cout << "all transactions sent, waiting for them to be final" << endl;
+    drainTimer.start();
+    if (open.empty())
+    {
+        finish();
+    }
+}
+
+void LoadGenerator::submit(size_t index)
+{
+    LoadTransaction &transaction = transactions.at(index);
+    long now = sinceStart(chrono::steady_clock::now());
+    if (connection->QAbstractSocket::state() != QAbstractSocket::ConnectedState || !connection->sendTransaction(transaction.message))
+    {
+        transaction.stage = TX_FAILED;
+        sendErrors++;
+        return;
+    }
+    transaction.stage = TX_SUBMITTED;
+    open.push_back(index);
+    if (!transaction.funding)
+    {
+        submitted++;
+        lastSent = now;
+        sendDelay.add(now - transaction.planned);
+    }
+}
+
+/**
+ * @brief LoadGenerator::processEvents
+ * handles the events, that the chain queued since the last call
+ */
+void LoadGenerator::processEvents()
+{
+    deque<TrackedEvent> current;
+    eventMutex.lock();
+    current.swap(events);
+    eventMutex.unlock();
+    for (unsigned int i = 0; i < current.size() && phase != LOAD_IDLE; i++)
+    {
+        handleEvent(current.at(i));
+    }
+}
+
+void LoadGenerator::handleEvent(const TrackedEvent &event)
+{
+    if (event.event == CHAIN_TIP_CHANGED)
+    {
+        checkBlocks(event.time);
+        return;
+    }
+    unordered_map<string, size_t>::iterator found = transactionsByHash.find(event.hash);
+    if (found == transactionsByHash.end())
+    {
+        return;
+    }
+    LoadTransaction &transaction = transactions.at(found->second);
+    if (event.event == CHAIN_TRANSACTION_ADDED && transaction.stage == TX_SUBMITTED)
+    {
+        transaction.stage = TX_MEMPOOL;
+        if (!transaction.funding)
+        {
+            mempoolLatency.add(sinceStart(event.time) - transaction.planned);
+        }
+    }
+    //a transaction of the chain is dropped from the mempool as well
+    else if (event.event == CHAIN_TRANSACTION_DROPPED && (transaction.stage == TX_SUBMITTED || transaction.stage == TX_MEMPOOL)
+             && chain.getTransactionBlock(transaction.hash) < 0)
+    {
+        transaction.stage = TX_FAILED;
+        if (transaction.funding)
+        {
+            cout << "a funding transaction was dropped, the node key has not enough coins" << endl;
+            finish();
+            return;
+        }
+        dropped++;
+    }
+}
+
+/**
+ * @brief LoadGenerator::checkBlocks
+ * looks up the open transactions after a new tip.
+ * included transactions are final after the configured number of blocks
+ * and wait again, if a reorganization removed their block
+ * @param time when the tip changed
+ */
+void LoadGenerator::checkBlocks(chrono::steady_clock::time_point time)
+{
+    int tip = chain.getLatestBlockIndex();
+    vector<size_t> stillOpen;
+    for (unsigned int i = 0; i < open.size(); i++)
+    {
+        LoadTransaction &transaction = transactions.at(open.at(i));
+        if (transaction.stage == TX_FAILED)
+        {
+            continue;
+        }
+        int block = chain.getTransactionBlock(transaction.hash);
+        if (transaction.stage == TX_INCLUDED && block < 0)
+        {
+            transaction.stage = TX_MEMPOOL;
+            transaction.reorganized = true;
+            reorganized++;
+        }
+        else if (transaction.stage != TX_INCLUDED && block >= 0)
+        {
+            setIncluded(transaction, block, time);
+        }
+        transaction.block = block;
+        if (transaction.stage == TX_INCLUDED && !transaction.funding && tip - block + 1 >= confirmations)
+        {
+            transaction.stage = TX_FINAL;
+            lastFinal = sinceStart(time);
+            finalLatency.add(lastFinal - transaction.planned);
+        }
+        if (transaction.stage != TX_FINAL && !(transaction.funding && transaction.stage == TX_INCLUDED))
+        {
+            stillOpen.push_back(open.at(i));
+        }
+    }
+    open.swap(stillOpen);
+
+    if (phase == LOAD_FUNDING && fundingOpen == 0)
+    {
+        startSending();
+    }
+    else if (phase == LOAD_DRAINING && open.empty())
+    {
+        finish();
+    }
+}
+
+void LoadGenerator::setIncluded(LoadTransaction &transaction, int block, chrono::steady_clock::time_point time)
+{
+    transaction.stage = TX_INCLUDED;
+    transaction.block = block;
+    if (transaction.funding)
+    {
+        fundingOpen--;
+        return;
+    }
+    //only the first inclusion is counted
+    if (!transaction.reorganized)
+    {
+        includedLatency.add(sinceStart(time) - transaction.planned);
+    }
+}
+
+/**
+ * @brief LoadGenerator::finish
+ * stops the listener and the connection and prints the report
+ */
+void LoadGenerator::finish()
+{
+    if (phase == LOAD_IDLE)
+    {
+        return;
+    }
+    bool measured = phase == LOAD_SENDING || phase == LOAD_DRAINING;
+    phase = LOAD_IDLE;
+    sendTimer.stop();
+    drainTimer.stop();
+    chain.removeEventListener(listenerID);
+    listenerID = -1;
+    eventMutex.lock();
+    events.clear();
+    eventMutex.unlock();
+    for (unsigned int i = 0; i < open.size(); i++)
+    {
+        if (!transactions.at(open.at(i)).funding && transactions.at(open.at(i)).stage != TX_FAILED)
+        {
+            unconfirmed++;
+        }
+    }
+    open.clear();
+    if (connection)
+    {
+        connection->disconnect(this);
+        connection->abort();
+        connection->deleteLater();
+        connection = nullptr;
+    }
+    if (measured)
+    {
+        printReport();
+    }
+    else
+    {
+        cout << "load generator stopped before the keys were funded" << endl;
+    }
+    emit finished();
+}
+
+/**
+ * @brief LoadGenerator::printReport
+ * prints the throughput, the errors and the latencies of the stages
+ */
+void LoadGenerator::printReport()
+{
+    ios_base::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    long finalCount = finalLatency.getCount();
+    cout << "load: " << planned << " planned, " << submitted << " sent, " << sendErrors << " send errors, "
+         << dropped << " dropped, " << reorganized << " reorganized, " << unconfirmed << " not final" << endl;
+    cout << fixed << setprecision(2) << "throughput: " << rate << " tx/s offered ("
+         << (poisson ? "poisson" : "constant") << "), "
+         << (lastSent > 0 ? submitted * 1000000.0 / lastSent : 0.0) << " tx/s sent, "
+         << (lastFinal > 0 ? finalCount * 1000000.0 / lastFinal : 0.0) << " tx/s final" << endl;
+    cout << "latency after the planned send time in ms, final after " << confirmations << " blocks:" << endl;
+    cout << left << setw(10) << "stage" << right << setw(8) << "count" << setw(10) << "mean" << setw(10) << "p50"
+         << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "max" << endl;
+    sendDelay.printRow("send");
+    mempoolLatency.printRow("mempool");
+    includedLatency.printRow("included");
+    finalLatency.printRow("final");
+    mempoolLatency.printBuckets("mempool");
+    includedLatency.printBuckets("included");
+    finalLatency.printBuckets("final");
+    cout.flags(flags);
+    cout.precision(precision);
+}
+
+long LoadGenerator::sinceStart(chrono::steady_clock::time_point time) const
+{
+    return chrono::duration_cast<chrono::microseconds>(time - phaseStart).count();
+}
@@ -0,0 +1,165 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QtNetwork>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include "connection.h"
+#include "../Chain/blockchain.hpp"
+
+using namespace std;
+
+/**
+ * latencies in microseconds.
+ * every power of two is split into 8 buckets, so a percentile
+ * is at most 12.5% above the real value
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    void add(long latency);
+    long getCount() const;
+    long percentile(double p) const;
+    void printRow(const string &name) const;
+    void printBuckets(const string &name) const;
+
+private:
+    static int bucketOf(long latency);
+    static long lowerBound(int bucket);
+    vector<long> buckets;
+    long count;
+    long sum;
+    long maximum;
+    static const int SUB_BUCKETS = 8;
+};
+
+/**
+ * open loop transaction load for the own node.
+ * synthetic keypairs are funded by the node key first, afterwards the
+ * signed transactions between them are generated before the run and sent at a
+ * constant or poisson rate over a connection to the own server, like a peer
+ * would send them. the next transaction is sent at its planned time, even if
+ * the node did not answer the earlier ones. the latencies are counted from
+ * the planned time, so a slow node or generator shows up as latency.
+ * the stages are tracked by the events of the chain:
+ * submitted -> in the mempool -> included in a block of the main chain -> final
+ * config keys: load_rate, load_arrivals (constant or poisson), load_duration,
+ * load_keys, load_funding, load_confirmations, load_drain and load_seed
+ */
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    LoadGenerator(Blockchain &chain, QObject *parent = 0);
+    ~LoadGenerator();
+    Q_INVOKABLE bool start(quint16 port);
+    Q_INVOKABLE void stop();
+    bool isRunning() const;
+    Q_INVOKABLE void printReport();
+
+signals:
+    void finished();
+
+private slots:
+    void connected();
+    void connectionError(QAbstractSocket::SocketError socketError);
+    void discardBlock(forkBlock block);
+    void sendDue();
+    void processEvents();
+    void finish();
+
+private:
+    enum Phase {
+        LOAD_IDLE,
+        LOAD_CONNECTING,
+        LOAD_FUNDING,
+        LOAD_SENDING,
+        LOAD_DRAINING
+    };
+    enum Stage {
+        TX_PLANNED,
+        TX_SUBMITTED,
+        TX_MEMPOOL,
+        TX_INCLUDED,
+        TX_FINAL,
+        TX_FAILED
+    };
+    struct Keypair {
+        string publicKey;
+        vector<unsigned char> secretKey;
+    };
+    struct LoadTransaction {
+        QString message;        //in the format of the wire protocol
+        string hash;
+        Stage stage;
+        long planned;           //send time in microseconds after the start of the phase
+        int block;
+        bool funding;
+        bool reorganized;       //its block was replaced once
+    };
+    struct TrackedEvent {
+        ChainEvent event;
+        string hash;
+        chrono::steady_clock::time_point time;
+    };
+    void createKeys();
+    void fund();
+    void generate();
+    void addTransaction(const Keypair &sender, const string &recipient, int value, time_t timestamp, long sendTime, bool isFunding);
+    void submit(size_t index);
+    void handleEvent(const TrackedEvent &event);
+    void checkBlocks(chrono::steady_clock::time_point time);
+    void setIncluded(LoadTransaction &transaction, int block, chrono::steady_clock::time_point time);
+    void startSending();
+    long sinceStart(chrono::steady_clock::time_point time) const;
+    Blockchain &chain;
+    Connection *connection;
+    int listenerID;
+    Phase phase;
+    vector<Keypair> keys;
+    vector<LoadTransaction> transactions;
+    unordered_map<string, size_t> transactionsByHash;
+    vector<size_t> open;                //submitted, but neither final nor failed
+    size_t nextTransaction;
+    int fundingOpen;
+    chrono::steady_clock::time_point phaseStart;
+    long lastSent;
+    long lastFinal;
+    QTimer sendTimer;
+    QTimer drainTimer;
+    mutex eventMutex;
+    deque<TrackedEvent> events;         //filled by the chain on any thread
+    mt19937_64 random;
+    double rate;
+    bool poisson;
+    int duration;
+    int keyCount;
+    int funding;
+    int confirmations;
+    long planned;
+    long submitted;
+    long sendErrors;
+    long dropped;
+    long reorganized;
+    long unconfirmed;
+    LatencyHistogram sendDelay;
+    LatencyHistogram mempoolLatency;
+    LatencyHistogram includedLatency;
+    LatencyHistogram finalLatency;
+    const int DEFAULT_RATE = 10;                //transactions per second
+    const int DEFAULT_DURATION = 60;            //seconds
+    const int DEFAULT_KEYS = 100;
+    const int DEFAULT_FUNDING = 100;            //coins per key
+    const int DEFAULT_CONFIRMATIONS = 6;
+    const int DEFAULT_DRAIN_TIME = 120;         //seconds to wait for the last transactions
+};
+
+#endif // LOADGENERATOR_H
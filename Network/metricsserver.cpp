@@ -0,0 +1,58 @@
+#include "metricsserver.h"
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QTcpServer(parent)
+{
+    int port = Config::instance().getInt("metrics_port", 9464);
+    if (port > 0 && !listen(QHostAddress::LocalHost, port))
+    {
+        cout << "couldn't serve the metrics on port " << port << ": " << qPrintable(errorString()) << endl;
+    }
+}
+
+void MetricsServer::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+    QObject::connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+}
+
+/**
+ * @brief MetricsServer::readRequest
+ * answers, when the headers of the request are complete, and closes the connection
+ */
+void MetricsServer::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket)
+        return;
+    QByteArray request = socket->peek(MaxRequestSize);
+    if (!request.contains("\r\n\r\n") && !request.contains("\n\n"))
+    {
+        if (request.size() >= MaxRequestSize)
+            socket->abort();
+        return;
+    }
+    socket->readAll();
+    QList<QByteArray> requestLine = request.left(request.indexOf('\n')).trimmed().split(' ');
+    QByteArray status = "200 OK";
+    QByteArray body;
+    if (requestLine.size() < 2 || requestLine.at(0) != "GET")
+    {
+        status = "405 Method Not Allowed";
+    }
+    else if (requestLine.at(1) != "/metrics" && requestLine.at(1) != "/")
+    {
+        status = "404 Not Found";
+    }
+    else
+    {
+        body = QByteArray::fromStdString(Metrics::instance().render());
+    }
+    socket->write("HTTP/1.0 " + status + "\r\n"
+                  + "Content-Type: text/plain; version=0.0.4\r\n"
+                  + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  + "Connection: close\r\n\r\n" + body);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,32 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtNetwork>
+#include "../metrics.h"
+#include "../config.h"
+
+/**
+ * serves the metrics in the text format of prometheus on localhost,
+ * GET /metrics on metrics_port (default 9464, 0 turns it off).
+ * it runs on the thread of its parent and answers every request at once
+ */
+class MetricsServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    MetricsServer(QObject *parent = 0);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private slots:
+    void readRequest();
+
+private:
+    static const int MaxRequestSize = 8192;
+};
+
+#endif // METRICSSERVER_H
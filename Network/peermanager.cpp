@@ -2,9 +2,11 @@
 
 static const qint32 BroadcastInterval = 2000;
 static const unsigned broadcastPort = 45000;
+static const qint32 ConnectInterval = 10000;
+static const int SaveEveryTicks = 6;
 
 PeerManager::PeerManager(Client *client)
-    : QObject(client)
+    : QObject(client), broadcastSocket(this), broadcastTimer(this), connectTimer(this)
 {
 //    qDebug() << Q_FUNC_INFO;
     this->client = client;
@@ -23,6 +25,8 @@ PeerManager::PeerManager(Client *client)
 
     updateAddresses(); // TODO: change Addresses handling
     serverPort = 0;
+    connectTicks = 0;
+    addressBook.load();
 
     broadcastSocket.bind(QHostAddress::Any, broadcastPort, QUdpSocket::ShareAddress
                          | QUdpSocket::ReuseAddressHint);
@@ -32,6 +36,15 @@ PeerManager::PeerManager(Client *client)
     broadcastTimer.setInterval(BroadcastInterval);
     connect(&broadcastTimer, SIGNAL(timeout()),
             this, SLOT(sendBroadcastDatagram()));
+
+    connectTimer.setInterval(ConnectInterval);
+    connect(&connectTimer, SIGNAL(timeout()),
+            this, SLOT(checkConnections()));
+}
+
+PeerManager::~PeerManager()
+{
+    addressBook.save();
 }
 
 void PeerManager::setServerPort(int port)
@@ -59,6 +72,60 @@ void PeerManager::startBroadcasting()
 {
 //    qDebug() << Q_FUNC_INFO;
     broadcastTimer.start();
+    connectTimer.start();
+    QTimer::singleShot(0, this, SLOT(maintainConnections()));
+}
+
+AddressBook& PeerManager::getAddressBook()
+{
+    return addressBook;
+}
+
+/**
+ * @brief PeerManager::addAddress
+ * adds the address of a server to the book, unless it is invalid or the own one
+ * @return true if the address was not known
+ */
+bool PeerManager::addAddress(const string &ip, int port)
+{
+    QHostAddress hostAddress(QString::fromStdString(ip));
+    if (hostAddress.isNull() || (port == serverPort && (hostAddress.isLoopback() || isLocalHostAddress(hostAddress))))
+    {
+        return false;
+    }
+    return addressBook.add(ip, port);
+}
+
+void PeerManager::checkConnections()
+{
+    if (++connectTicks % SaveEveryTicks == 0)
+    {
+        addressBook.save();
+    }
+    maintainConnections();
+}
+
+/**
+ * @brief PeerManager::maintainConnections
+ * connects to the best scored addresses of the book, until the client
+ * has as many outgoing peers as configured
+ */
+void PeerManager::maintainConnections()
+{
+    int missing = Config::instance().getInt("max_outbound", 8) - client->countPeers(true);
+    if (missing <= 0)
+    {
+        return;
+    }
+    vector<PeerAddress> selected = addressBook.selectOutbound(missing, client->getPeerAddresses());
+    for (unsigned int i = 0; i < selected.size(); i++)
+    {
+        addressBook.attempted(selected.at(i).ip, selected.at(i).port);
+        Connection *connection = new Connection(this);
+        connection->setOutbound(selected.at(i).port);
+        emit newConnection(connection);
+        connection->connectToHost(QHostAddress(QString::fromStdString(selected.at(i).ip)), selected.at(i).port);
+    }
 }
 
 bool PeerManager::isLocalHostAddress(const QHostAddress &address)
@@ -112,10 +179,10 @@ void PeerManager::readBroadcastDatagram()
         {
             continue;
         }
-        if (!client->hasConnection(senderIp)) {
-            Connection *connection = new Connection(this);
-            emit newConnection(connection);
-            connection->connectToHost(senderIp, senderServerPort);
+        //the book decides, to which of the announced peers it connects
+        if (addAddress(senderIp.toString().toStdString(), senderServerPort))
+        {
+            maintainConnections();
         }
     }
 }
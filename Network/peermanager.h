@@ -9,6 +9,7 @@
 #include <QtNetwork>
 #include "client.h"
 #include "connection.h"
+#include "addressbook.h"
 
 class Client;
 class Connection;
@@ -19,6 +20,7 @@ class PeerManager : public QObject
 
 public:
     PeerManager(Client *client);
+    ~PeerManager();
 
     void setServerPort(int port);
     void startBroadcasting();
@@ -26,13 +28,19 @@ public:
     QByteArray getAddress() const;
     QList<QHostAddress> getBroadcastAddresses() const;
     QList<QHostAddress> getIPAddresses() const;
+    AddressBook& getAddressBook();
+    bool addAddress(const string &ip, int port);
 
 signals:
     void newConnection(Connection *connection);
 
+public slots:
+    void maintainConnections();
+
 private slots:
     void sendBroadcastDatagram();
     void readBroadcastDatagram();
+    void checkConnections();
 
 private:
     void updateAddresses();
@@ -42,6 +50,9 @@ private:
     QList<QHostAddress> ipAddresses;
     QUdpSocket broadcastSocket;
     QTimer broadcastTimer;
+    QTimer connectTimer;
+    AddressBook addressBook;
+    int connectTicks;
     QByteArray address;
     int serverPort;
 };
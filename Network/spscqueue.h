@@ -0,0 +1,78 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * bounded lock free queue for exactly one producer and one consumer thread.
+ * the producer only writes the tail and the consumer only the head, one slot
+ * stays empty to tell a full queue from an empty one.
+ * head and tail are on their own cache lines, so the threads do not
+ * invalidate each other on every push and pop
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        :ring(capacity + 1), head(0), tail(0)
+    {
+    }
+
+    /**
+     * only called by the producer
+     * @return false if the queue is full, the value is not moved then
+     */
+    bool push(T &value)
+    {
+        size_t current = tail.load(memory_order_relaxed);
+        size_t next = (current + 1) % ring.size();
+        if (next == head.load(memory_order_acquire))
+        {
+            return false;
+        }
+        ring[current] = move(value);
+        tail.store(next);
+        return true;
+    }
+
+    /**
+     * only called by the consumer
+     * @return false if the queue is empty
+     */
+    bool pop(T &value)
+    {
+        size_t current = head.load(memory_order_relaxed);
+        if (current == tail.load())
+        {
+            return false;
+        }
+        value = move(ring[current]);
+        ring[current] = T();
+        head.store((current + 1) % ring.size(), memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(memory_order_acquire) == tail.load();
+    }
+
+    size_t size() const
+    {
+        size_t first = head.load(memory_order_acquire);
+        size_t last = tail.load(memory_order_acquire);
+        return (last + ring.size() - first) % ring.size();
+    }
+
+private:
+    vector<T> ring;                     //not named slots, Qt defines that as a keyword
+    alignas(64) atomic<size_t> head;    //next slot to read
+    alignas(64) atomic<size_t> tail;    //next slot to write
+};
+
+#endif // SPSCQUEUE_H
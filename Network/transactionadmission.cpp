@@ -0,0 +1,287 @@
+#include "transactionadmission.h"
+
+TransactionAdmission::TransactionAdmission(Blockchain &chain)
+    :chain(chain), running(false), stats()
+{
+    listenerID = chain.addEventListener([this](ChainEvent event, const string &hash)
+    {
+        if (event == CHAIN_TRANSACTION_ADDED)
+        {
+            return;
+        }
+        lock_guard<mutex> lock(filterMutex);
+        if (event == CHAIN_TIP_CHANGED)
+        {
+            //the senders may have received coins
+            unfunded.clear();
+            unfundedOrder.clear();
+        }
+        else if (event == CHAIN_TRANSACTION_DROPPED)
+        {
+            admitted.erase(hash);
+        }
+    });
+}
+
+TransactionAdmission::~TransactionAdmission()
+{
+    stop();
+    chain.removeEventListener(listenerID);
+}
+
+/**
+ * @brief TransactionAdmission::start
+ * starts the threads, that check the signatures
+ * @param threads at least one is started
+ */
+void TransactionAdmission::start(unsigned int threads)
+{
+    if (running)
+    {
+        return;
+    }
+    running = true;
+    for (unsigned int i = 0; i < max(threads, 1u); i++)
+    {
+        workers.push_back(thread(&TransactionAdmission::run, this));
+    }
+}
+
+/**
+ * @brief TransactionAdmission::stop
+ * waits for the threads, the queued transactions are not checked
+ */
+void TransactionAdmission::stop()
+{
+    if (!running)
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(queueMutex);
+        running = false;
+        wake.notify_all();
+    }
+    for (unsigned int i = 0; i < workers.size(); i++)
+    {
+        if (workers.at(i).joinable())
+        {
+            workers.at(i).join();
+        }
+    }
+    workers.clear();
+}
+
+/**
+ * @brief TransactionAdmission::submit
+ * filters a known transaction and queues it for the signature check
+ * @param transaction received from a peer
+ * @return false if it was filtered or the queue is full
+ */
+bool TransactionAdmission::submit(const Transaction &transaction)
+{
+    return submit(vector<Transaction>(1, transaction)) == 1;
+}
+
+/**
+ * @brief TransactionAdmission::submit
+ * filters the known transactions of a batch and queues the others. the filter
+ * and the queue are locked once for the whole batch
+ * @param transactions received from a peer
+ * @return the number of queued transactions
+ */
+unsigned int TransactionAdmission::submit(const vector<Transaction> &transactions)
+{
+    vector<const Transaction*> fresh;
+    long duplicates = 0;
+    long cached = 0;
+    {
+        lock_guard<mutex> lock(filterMutex);
+        for (unsigned int i = 0; i < transactions.size(); i++)
+        {
+            const string &hash = transactions.at(i).getHash();
+            string key = contentKey(transactions.at(i));
+            if (pending.count(key) || admitted.count(hash))
+            {
+                duplicates++;
+            }
+            else if (rejected.count(key) || unfunded.count(hash))
+            {
+                cached++;
+            }
+            else if (!hash.empty())
+            {
+                pending.insert(key);
+                fresh.push_back(&transactions.at(i));
+            }
+        }
+    }
+    unsigned int queued = 0;
+    size_t depth;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        for (; queued < fresh.size() && queue.size() < QUEUE_SIZE; queued++)
+        {
+            queue.push_back(*fresh.at(queued));
+        }
+        depth = queue.size();
+        if (queued > 1)
+        {
+            wake.notify_all();
+        }
+        else if (queued == 1)
+        {
+            wake.notify_one();
+        }
+    }
+    if (queued < fresh.size())
+    {
+        lock_guard<mutex> lock(filterMutex);
+        for (unsigned int i = queued; i < fresh.size(); i++)
+        {
+            pending.erase(contentKey(*fresh.at(i)));
+        }
+    }
+    lock_guard<mutex> lock(statsMutex);
+    stats.received += transactions.size();
+    stats.duplicates += duplicates;
+    stats.cachedRejects += cached;
+    stats.dropped += fresh.size() - queued;
+    stats.maxDepth = max(stats.maxDepth, depth);
+    return queued;
+}
+
+void TransactionAdmission::run()
+{
+    while (true)
+    {
+        Transaction transaction;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            wake.wait(lock, [this]() { return !queue.empty() || !running; });
+            if (!running)
+            {
+                return;
+            }
+            transaction = queue.front();
+            queue.pop_front();
+        }
+        admit(transaction);
+    }
+}
+
+/**
+ * @brief TransactionAdmission::admit
+ * checks the signature without a lock, the balance check and the insert lock the mempool
+ * @param transaction from the queue
+ */
+void TransactionAdmission::admit(const Transaction &transaction)
+{
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    bool validSignature = verifySignature(transaction.getHash(), transaction.getSender(), transaction.getRecipient(),
+                                          transaction.getValue(), transaction.getTimestamp());
+    long verifyUs = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+    AdmissionResult result = ADMIT_INVALID_VALUE;
+    if (validSignature)
+    {
+        result = chain.admitTransaction(transaction);
+    }
+    const string &hash = transaction.getHash();
+    string key = contentKey(transaction);
+    {
+        lock_guard<mutex> lock(filterMutex);
+        pending.erase(key);
+        if (!validSignature)
+        {
+            remember(rejected, rejectedOrder, key);
+        }
+        else if (result == ADMIT_NO_FUNDS)
+        {
+            remember(unfunded, unfundedOrder, hash);
+        }
+        else
+        {
+            //a transaction of the chain or the mempool is filtered like an admitted one
+            remember(admitted, admittedOrder, hash);
+        }
+    }
+    lock_guard<mutex> lock(statsMutex);
+    stats.verified++;
+    stats.verifyUs += verifyUs;
+    if (!validSignature)
+    {
+        stats.badSignatures++;
+    }
+    else if (result == ADMITTED)
+    {
+        stats.admitted++;
+    }
+    else if (result == ADMIT_NO_FUNDS)
+    {
+        stats.noFunds++;
+    }
+    else if (result == ADMIT_DUPLICATE)
+    {
+        stats.duplicates++;
+    }
+    else
+    {
+        stats.otherRejects++;
+    }
+}
+
+void TransactionAdmission::remember(unordered_set<string> &hashes, deque<string> &order, const string &hash)
+{
+    if (!hashes.insert(hash).second)
+    {
+        return;
+    }
+    order.push_back(hash);
+    if (order.size() > MAX_REMEMBERED)
+    {
+        hashes.erase(order.front());
+        order.pop_front();
+    }
+}
+
+/**
+ * @brief TransactionAdmission::contentKey
+ * the signature only covers the content together with the hash, a peer can
+ * send any content with the hash of a valid transaction
+ * @return sender, recipient, value, timestamp and hash of the transaction
+ */
+string TransactionAdmission::contentKey(const Transaction &transaction)
+{
+    return transaction.getSender() + "," + transaction.getRecipient() + "," + to_string(transaction.getValue())
+            + "," + to_string(transaction.getTimestamp()) + "," + transaction.getHash();
+}
+
+AdmissionStats TransactionAdmission::getStats()
+{
+    lock_guard<mutex> lock(statsMutex);
+    return stats;
+}
+
+/**
+ * @brief TransactionAdmission::printStats
+ * prints how many received transactions were admitted and why the others were not
+ */
+void TransactionAdmission::printStats()
+{
+    AdmissionStats current = getStats();
+    size_t queued;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queued = queue.size();
+    }
+    cout << "received transactions: " << current.received << ", admitted: " << current.admitted << endl;
+    cout << "filtered duplicates: " << current.duplicates << ", rejected before: " << current.cachedRejects << endl;
+    cout << "rejected, bad signature: " << current.badSignatures << ", balance too low: " << current.noFunds
+         << ", no value or in the chain: " << current.otherRejects << endl;
+    cout << "dropped, queue full: " << current.dropped << endl;
+    cout << "admission threads: " << workers.size() << ", queued now: " << queued << ", max: " << current.maxDepth << endl;
+    if (current.verified > 0)
+    {
+        cout << "signature check: avg " << current.verifyUs / current.verified << " us" << endl;
+    }
+}
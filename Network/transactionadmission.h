@@ -0,0 +1,77 @@
+#ifndef TRANSACTIONADMISSION_H
+#define TRANSACTIONADMISSION_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unordered_set>
+#include <condition_variable>
+#include "../Chain/blockchain.hpp"
+
+using namespace std;
+
+struct AdmissionStats {
+    long received;
+    long duplicates;            //queued, checked or admitted before
+    long cachedRejects;         //rejected before, filtered without a check
+    long badSignatures;
+    long noFunds;
+    long otherRejects;          //no value or already in the chain
+    long admitted;
+    long dropped;               //the queue was full
+    size_t maxDepth;
+    long verified;
+    long verifyUs;              //signature checks of all threads
+};
+
+/**
+ * checks the transactions of the peers before they reach the mempool:
+ * duplicate filter -> signature check -> balance check at the tip -> insert.
+ * the filter runs on the network thread, the signatures are checked by a pool
+ * of threads and the balance is checked and the transaction inserted in one step
+ * under the mempool lock, so two threads can not overspend a sender.
+ * rejected transactions are remembered, a bad signature for good and a missing
+ * balance until the tip changes. a bad signature is remembered with the whole
+ * content, so a forged copy does not block the transaction with the same hash
+ */
+class TransactionAdmission
+{
+public:
+    TransactionAdmission(Blockchain &chain);
+    ~TransactionAdmission();
+    void start(unsigned int threads);
+    void stop();
+    bool submit(const Transaction &transaction);
+    unsigned int submit(const vector<Transaction> &transactions);
+    AdmissionStats getStats();
+    void printStats();
+
+private:
+    void run();
+    void admit(const Transaction &transaction);
+    void remember(unordered_set<string> &hashes, deque<string> &order, const string &hash);
+    static string contentKey(const Transaction &transaction);
+    Blockchain &chain;
+    vector<thread> workers;
+    atomic<bool> running;
+    mutex queueMutex;
+    condition_variable wake;
+    deque<Transaction> queue;
+    mutex filterMutex;
+    unordered_set<string> pending;          //content keys of the queued or checked transactions
+    unordered_set<string> admitted;
+    deque<string> admittedOrder;
+    unordered_set<string> rejected;         //content keys of bad signatures
+    deque<string> rejectedOrder;
+    unordered_set<string> unfunded;         //cleared, when the tip changes
+    deque<string> unfundedOrder;
+    int listenerID;
+    mutex statsMutex;
+    AdmissionStats stats;
+    static const unsigned int QUEUE_SIZE = 8192;
+    static const unsigned int MAX_REMEMBERED = 20000;     //per filter, the oldest hash is forgotten first
+};
+
+#endif // TRANSACTIONADMISSION_H
@@ -0,0 +1,322 @@
+#include "validationworker.h"
+
+/**
+ * @brief validationSeconds
+ * @param type of the job
+ * @return the histogram of the time spent on the jobs of the type
+ */
+static Histogram& validationSeconds(ValidationType type)
+{
+    static Histogram *histograms[] = {
+        &Metrics::instance().histogram("poluck_validation_seconds", "time of the validation worker per job",
+                                       Metrics::secondBuckets(), "job=\"block\""),
+        &Metrics::instance().histogram("poluck_validation_seconds", "time of the validation worker per job",
+                                       Metrics::secondBuckets(), "job=\"compact_block\""),
+        &Metrics::instance().histogram("poluck_validation_seconds", "time of the validation worker per job",
+                                       Metrics::secondBuckets(), "job=\"block_request\""),
+        &Metrics::instance().histogram("poluck_validation_seconds", "time of the validation worker per job",
+                                       Metrics::secondBuckets(), "job=\"block_transactions\"")
+    };
+    return *histograms[type];
+}
+
+ValidationWorker::ValidationWorker(Blockchain &chain, const shared_ptr<recursive_mutex> &networkMutex)
+    :chain(chain), networkMutex(networkMutex), jobs(QUEUE_SIZE), results(QUEUE_SIZE), running(false),
+      sleeping(false), resultsAnnounced(false), stats()
+{
+}
+
+ValidationWorker::~ValidationWorker()
+{
+    stop();
+    ValidationJob job;
+    while (jobs.pop(job))
+    {
+        delete job.block;
+    }
+}
+
+/**
+ * @brief ValidationWorker::start
+ * starts the worker thread
+ * @param resultsReady called on the worker thread, when the first result
+ *        is waiting since the last takeResults
+ */
+void ValidationWorker::start(const function<void()> &resultsReady)
+{
+    if (running)
+    {
+        return;
+    }
+    this->resultsReady = resultsReady;
+    running = true;
+    worker = thread(&ValidationWorker::run, this);
+}
+
+/**
+ * @brief ValidationWorker::stop
+ * waits until the current job is finished. the jobs in the queue are not validated
+ */
+void ValidationWorker::stop()
+{
+    if (!running)
+    {
+        return;
+    }
+    running = false;
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+/**
+ * @brief ValidationWorker::submit
+ * only called by the network thread
+ * @param job the worker takes over the block of the job
+ * @return false if the queue is full, the block is deleted then
+ */
+bool ValidationWorker::submit(ValidationJob &job)
+{
+    job.queued = chrono::steady_clock::now();
+    Block *block = job.block;
+    if (!jobs.push(job))
+    {
+        delete block;
+        lock_guard<mutex> lock(statsMutex);
+        stats.dropped++;
+        return false;
+    }
+    size_t depth = jobs.size();
+    if (sleeping)
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+    lock_guard<mutex> lock(statsMutex);
+    stats.maxDepth = max(stats.maxDepth, depth);
+    return true;
+}
+
+/**
+ * @brief ValidationWorker::takeResults
+ * only called by the network thread
+ * @return the results in the order of the jobs
+ */
+vector<ValidationResult> ValidationWorker::takeResults()
+{
+    //reset first, a result pushed during the loop is announced again
+    resultsAnnounced = false;
+    vector<ValidationResult> taken;
+    ValidationResult result;
+    while (results.pop(result))
+    {
+        taken.push_back(result);
+    }
+    return taken;
+}
+
+void ValidationWorker::run()
+{
+    ValidationJob job;
+    while (running)
+    {
+        if (!jobs.pop(job))
+        {
+            //the network thread checks the flag after its push, so either it wakes us or we see the job
+            sleeping = true;
+            unique_lock<mutex> lock(wakeMutex);
+            wake.wait_for(lock, IDLE_CHECK, [this]() { return !jobs.empty() || !running; });
+            sleeping = false;
+            continue;
+        }
+        chrono::steady_clock::time_point started = chrono::steady_clock::now();
+        if (job.type == VALIDATE_BLOCK)
+        {
+            Trace::instance().record("validation queue", job.block->getIndex(), job.queued, started);
+        }
+        process(job);
+        chrono::steady_clock::time_point finished = chrono::steady_clock::now();
+        validationSeconds(job.type).observe(chrono::duration<double>(finished - started).count());
+        long waited = chrono::duration_cast<chrono::microseconds>(started - job.queued).count();
+        lock_guard<mutex> lock(statsMutex);
+        stats.totalWaitUs += waited;
+        stats.maxWaitUs = max(stats.maxWaitUs, waited);
+        stats.busyUs += chrono::duration_cast<chrono::microseconds>(finished - started).count();
+    }
+}
+
+void ValidationWorker::process(ValidationJob &job)
+{
+    ValidationResult result = ValidationResult();
+    result.type = job.type;
+    result.connection = job.connection;
+    switch (job.type)
+    {
+    case VALIDATE_BLOCK:
+    {
+        result.forkID = job.forkID;
+        result.blockIndex = job.block->getIndex();
+        networkMutex->lock();
+        result.requestedBlock = chain.handleBlock(*job.block, &result.forkID);
+        networkMutex->unlock();
+        delete job.block;
+        job.block = nullptr;
+        {
+            lock_guard<mutex> lock(statsMutex);
+            stats.blocks++;
+        }
+        pushResult(result);
+        break;
+    }
+    case VALIDATE_COMPACT_BLOCK:
+    {
+        if (!job.compact)
+        {
+            job.compact = make_shared<CompactBlock>();
+            if (!CompactBlock::fromString(job.message, *job.compact, job.forkID))
+            {
+                LOG(LOG_WARNING) << "received an invalid compact block" << endl;
+                break;
+            }
+            job.message.clear();
+        }
+        CompactBlock &compact = *job.compact;
+        result.compact = job.compact;
+        result.forkID = job.forkID;
+        result.blockIndex = compact.getIndex();
+        Block block;
+        bool missing = false;
+        //the second time the sender answered with the missing transactions
+        if (!job.message.empty() && !compact.addTransactions(job.message))
+        {
+            result.fallback = true;
+        }
+        else if (!compact.isComplete() && chain.fillFromMempool(compact) > 0)
+        {
+            missing = true;
+        }
+        else if (!compact.getBlock(block))
+        {
+            result.fallback = true;
+        }
+        else
+        {
+            networkMutex->lock();
+            result.requestedBlock = chain.handleBlock(block, &result.forkID);
+            networkMutex->unlock();
+        }
+        {
+            lock_guard<mutex> lock(statsMutex);
+            if (result.fallback)
+            {
+                stats.compactFallbacks++;
+            }
+            else if (missing)
+            {
+                stats.compactMissing++;
+            }
+            else
+            {
+                stats.blocks++;
+                stats.compactBlocks += job.message.empty() ? 1 : 0;
+            }
+        }
+        pushResult(result);
+        break;
+    }
+    case ANSWER_BLOCK_REQUEST:
+    {
+        if (job.blockID != 0 && job.blockID <= chain.getBaseHeight())
+        {
+            //the peer asks somebody else after this
+            LOG(LOG_DEBUG) << "only the header of block " << job.blockID << " is stored" << endl;
+            result.prunedHeight = chain.getBaseHeight();
+        }
+        else
+        {
+            Block requestedBlock = (!job.blockID) ? chain.getLatestBlock() : chain.getBlock(job.blockID, 0);
+            result.message = parseBlockToString(requestedBlock, job.forkID);
+        }
+        {
+            lock_guard<mutex> lock(statsMutex);
+            stats.blockRequests++;
+        }
+        pushResult(result);
+        break;
+    }
+    case ANSWER_BLOCK_TRANSACTIONS:
+    {
+        string hash;
+        int index;
+        vector<int> positions;
+        if (!CompactBlock::parseMissingRequest(job.message, hash, index, positions))
+        {
+            break;
+        }
+        //an unknown block is answered without transactions, the peer requests the whole block then
+        Block requestedBlock;
+        requestedBlock.setIndex(index);
+        if (index > chain.getBaseHeight() && index <= chain.getLatestBlockIndex())
+        {
+            requestedBlock = chain.getBlock(index, 0);
+        }
+        result.message = CompactBlock::transactionsResponse(requestedBlock, hash, positions);
+        {
+            lock_guard<mutex> lock(statsMutex);
+            stats.blockRequests++;
+        }
+        pushResult(result);
+        break;
+    }
+    }
+}
+
+void ValidationWorker::pushResult(ValidationResult &result)
+{
+    //the network thread empties the queue on every announcement
+    while (!results.push(result))
+    {
+        if (!running)
+        {
+            return;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    if (!resultsAnnounced.exchange(true) && resultsReady)
+    {
+        resultsReady();
+    }
+}
+
+ValidationStats ValidationWorker::getStats()
+{
+    lock_guard<mutex> lock(statsMutex);
+    return stats;
+}
+
+/**
+ * @brief ValidationWorker::printStats
+ * prints the validated messages and how long they waited for the worker
+ */
+void ValidationWorker::printStats()
+{
+    ValidationStats current = getStats();
+    long jobsDone = current.blocks + current.blockRequests;
+    cout << "validated blocks: " << current.blocks << endl;
+    cout << "answered block requests: " << current.blockRequests << endl;
+    cout << "compact blocks rebuilt from the mempool: " << current.compactBlocks
+         << ", with missing transactions: " << current.compactMissing
+         << ", whole block requested: " << current.compactFallbacks << endl;
+    cout << "dropped, queue full: " << current.dropped << endl;
+    cout << "queued now: " << jobs.size() << ", max: " << current.maxDepth << endl;
+    if (jobsDone > 0)
+    {
+        cout << "wait in queue: avg " << current.totalWaitUs / jobsDone << " us, max " << current.maxWaitUs << " us" << endl;
+        cout << "validation time: avg " << current.busyUs / jobsDone << " us, total " << current.busyUs / 1000 << " ms" << endl;
+    }
+}
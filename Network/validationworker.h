@@ -0,0 +1,103 @@
+#ifndef VALIDATIONWORKER_H
+#define VALIDATIONWORKER_H
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include "spscqueue.h"
+#include "../Chain/blockchain.hpp"
+#include "../trace.h"
+
+using namespace std;
+
+class Connection;
+
+enum ValidationType {
+    VALIDATE_BLOCK,
+    VALIDATE_COMPACT_BLOCK,
+    ANSWER_BLOCK_REQUEST,
+    ANSWER_BLOCK_TRANSACTIONS
+};
+
+struct ValidationJob {
+    ValidationType type;
+    Connection *connection;     //sender, only used again on the network thread
+    Block *block;               //owned by the job
+    int forkID;
+    int blockID;                //requested block, 0 for the latest
+    shared_ptr<CompactBlock> compact;   //null until the worker parsed the message
+    string message;             //compact block, missing transactions or the request for them
+    chrono::steady_clock::time_point queued;
+};
+
+struct ValidationResult {
+    ValidationType type;
+    Connection *connection;
+    int blockIndex;             //of the validated block
+    int requestedBlock;         //return value of handleBlock
+    int forkID;
+    int prunedHeight;           //only the header of the requested block is stored, if above 0
+    string message;             //the requested block or transactions in the format of the wire protocol
+    shared_ptr<CompactBlock> compact;
+    bool fallback;              //the compact block could not be rebuilt, the whole block is requested
+};
+
+struct ValidationStats {
+    long blocks;
+    long blockRequests;
+    long compactBlocks;         //rebuilt without asking the sender
+    long compactMissing;        //transactions were missing in the mempool
+    long compactFallbacks;
+    long dropped;               //the queue was full
+    size_t maxDepth;
+    long totalWaitUs;           //time in the queue
+    long maxWaitUs;
+    long busyUs;                //time spent validating
+};
+
+/**
+ * validates the received messages on its own thread, so the event loop of the
+ * sockets keeps reading, answering pings and sending while a block is checked.
+ * the network thread is the only producer of jobs and the worker the only
+ * producer of results, both go through lock free queues.
+ * the worker sleeps while there is no job, the network thread is told about
+ * new results once, until it took them
+ */
+class ValidationWorker
+{
+public:
+    ValidationWorker(Blockchain &chain, const shared_ptr<recursive_mutex> &networkMutex);
+    ~ValidationWorker();
+    void start(const function<void()> &resultsReady);
+    void stop();
+    bool submit(ValidationJob &job);
+    vector<ValidationResult> takeResults();
+    ValidationStats getStats();
+    void printStats();
+
+private:
+    void run();
+    void process(ValidationJob &job);
+    void pushResult(ValidationResult &result);
+    Blockchain &chain;
+    shared_ptr<recursive_mutex> networkMutex;
+    SpscQueue<ValidationJob> jobs;
+    SpscQueue<ValidationResult> results;
+    function<void()> resultsReady;
+    thread worker;
+    atomic<bool> running;
+    atomic<bool> sleeping;
+    atomic<bool> resultsAnnounced;
+    mutex wakeMutex;
+    condition_variable wake;
+    mutex statsMutex;
+    ValidationStats stats;
+    static const int QUEUE_SIZE = 4096;
+    const chrono::milliseconds IDLE_CHECK = chrono::milliseconds(100);
+};
+
+#endif // VALIDATIONWORKER_H
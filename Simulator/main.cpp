@@ -0,0 +1,91 @@
+#include "simulator.hpp"
+#include <cstring>
+
+static void printUsage()
+{
+    cout << "usage: simulator [--nodes n] [--duration s] [--latency ms] [--jitter ms] [--bandwidth bytes/s]" << endl
+         << "                 [--loss p] [--tx-rate tx/s] [--max-wait ms] [--tx-threshold n] [--seed n]" << endl
+         << "                 [--dir path] [--verbose]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    SimulationConfig config;
+    config.nodes = 4;
+    config.duration = 3600;
+    config.latency = 100;
+    config.jitter = 20;
+    config.bandwidth = 1000000;
+    config.loss = 0;
+    config.transactionRate = 0.2;
+    config.maxWaitingTime = 30000;
+    config.transactionThreshold = 10;
+    config.seed = 1;
+    config.directory = "simulation";
+    config.verbose = false;
+
+    //stoi and the others throw on a value, that is not a number or out of range
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string option = argv[i];
+            if (option == "--verbose")
+            {
+                config.verbose = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+            {
+                printUsage();
+                return 1;
+            }
+            string value = argv[++i];
+            if (option == "--nodes")
+                config.nodes = stoi(value);
+            else if (option == "--duration")
+                config.duration = stoi(value);
+            else if (option == "--latency")
+                config.latency = stoi(value);
+            else if (option == "--jitter")
+                config.jitter = stoi(value);
+            else if (option == "--bandwidth")
+                config.bandwidth = stol(value);
+            else if (option == "--loss")
+                config.loss = stod(value);
+            else if (option == "--tx-rate")
+                config.transactionRate = stod(value);
+            else if (option == "--max-wait")
+                config.maxWaitingTime = stoi(value);
+            else if (option == "--tx-threshold")
+                config.transactionThreshold = stoi(value);
+            else if (option == "--seed")
+                config.seed = stoull(value);
+            else if (option == "--dir")
+                config.directory = value;
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+    }
+    catch (const exception &)
+    {
+        printUsage();
+        return 1;
+    }
+    if (config.nodes < 1 || config.duration < 1 || config.bandwidth < 1)
+    {
+        printUsage();
+        return 1;
+    }
+
+    Simulator simulator(config);
+    if (!simulator.run())
+    {
+        return 1;
+    }
+    simulator.printReport();
+    return 0;
+}
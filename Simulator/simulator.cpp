@@ -0,0 +1,606 @@
+#include "simulator.hpp"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+Simulator::Simulator(const SimulationConfig &config)
+    :config(config), sequence(0), virtualTime(0), mining(false), random(config.seed), reorganizations(0),
+      acceptedTips(0), cancelledProofs(0), blocksInFlight(0), convergedAt(-1), messages(0), droppedMessages(0), bytes(0)
+{
+    Clock::instance().setSource([this]() { return now(); });
+    //the nodes draw their lucky numbers without waiting, the periods pass on the virtual clock
+    Config::instance().set("proof_provider", "software");
+    Config::instance().set("proof_max_wait_ms", "0");
+    Config::instance().set("proof_seed", to_string(config.seed));
+    Config::instance().set("mining_tx_threshold", to_string(config.transactionThreshold));
+    //the databases are removed before the next run, a crash may leave them corrupt
+    Config::instance().set("db_sync", "0");
+    Log::load();
+}
+
+Simulator::~Simulator()
+{
+    for (unsigned int i = 0; i < nodes.size(); i++)
+    {
+        nodes.at(i).miner.reset();
+        nodes.at(i).chain->closeDb();
+    }
+    nodes.clear();
+    Clock::instance().setSource(nullptr);
+}
+
+bool Simulator::EventOrder::operator()(const Event &a, const Event &b) const
+{
+    if (a.time != b.time)
+    {
+        return a.time > b.time;
+    }
+    return a.sequence > b.sequence;
+}
+
+/**
+ * @brief Simulator::now
+ * @return the virtual time in milliseconds since the epoch
+ */
+long long Simulator::now()
+{
+    return EPOCH * 1000LL + virtualTime;
+}
+
+/**
+ * @brief Simulator::run
+ * mines for the configured duration. afterwards the messages on the way
+ * are still delivered, until the nodes agree on the tip and no block is on the way
+ * @return false if the nodes could not be created
+ */
+bool Simulator::run()
+{
+    //the nodes change the number format of cout
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    if (!config.verbose)
+    {
+        cout.setstate(ios::failbit);
+    }
+    if (!createNodes())
+    {
+        cout.clear();
+        return false;
+    }
+    mining = true;
+    for (int i = 0; i < config.nodes; i++)
+    {
+        nodes.at(i).miner->begin(nodes.at(i).key);
+        step(i);
+    }
+    if (config.transactionRate > 0)
+    {
+        createTransaction();
+    }
+
+    long end = config.duration * 1000L;
+    while (true)
+    {
+        if (mining && (events.empty() || events.top().time > end))
+        {
+            virtualTime = end;
+            stopMining();
+        }
+        if (!mining && blocksInFlight == 0 && isConverged())
+        {
+            convergedAt = virtualTime;
+            break;
+        }
+        if (events.empty() || events.top().time > end + MAX_SETTLE_TIME)
+        {
+            break;
+        }
+        Event event = events.top();
+        events.pop();
+        virtualTime = event.time;
+        switch (event.type)
+        {
+        case PROOF_READY:
+            finishProof(event);
+            break;
+        case ROUND_END:
+            endRound(event);
+            break;
+        case NEW_TRANSACTION:
+            createTransaction();
+            break;
+        case BLOCK_ARRIVAL:
+            receiveBlock(event);
+            break;
+        case BLOCK_REQUEST:
+            answerBlockRequest(event);
+            break;
+        case TRANSACTION_ARRIVAL:
+            receiveTransaction(event);
+            break;
+        }
+    }
+    cout.clear();
+    cout.flags(flags);
+    cout.precision(precision);
+    return true;
+}
+
+/**
+ * @brief Simulator::createNodes
+ * every node gets a new database with the genesis block.
+ * the first node mines for the key of this process, which pays the transactions
+ */
+bool Simulator::createNodes()
+{
+    mkdir(config.directory.c_str(), 0755);
+    createKeypair();
+    faucet = getPublicBkey();
+    if (faucet.empty())
+    {
+        cerr << "the keys of the node are missing in " << PUBLIC_KEY_PATH << endl;
+        return false;
+    }
+    links.assign(config.nodes, vector<Link>(config.nodes, Link()));
+    nodes.resize(config.nodes);
+    for (int i = 0; i < config.nodes; i++)
+    {
+        string path = config.directory + "/node" + to_string(i) + ".db";
+        remove(path.c_str());
+        Node &node = nodes.at(i);
+        node.chain.reset(new Blockchain(shared_ptr<recursive_mutex>(new recursive_mutex),
+                                        shared_ptr<vector<Transaction> >(new vector<Transaction>),
+                                        shared_ptr<recursive_mutex>(new recursive_mutex), path));
+        node.key = i == 0 ? faucet : "node" + to_string(i);
+        node.miner.reset(new MiningScheduler(*node.chain));
+        node.miner->requestProof = [this, i](const Block &block, function<void(const ProofResult&)> callback)
+        {
+            return requestProof(i, block, callback);
+        };
+        node.miner->onBlockFound = [this, i](const Block &block) { blockFound(i, block); };
+        node.proofID = 0;
+        node.roundEnd = -1;
+        node.tip = node.chain->getLatestBlock().getHash();
+    }
+    return true;
+}
+
+void Simulator::schedule(Event &event)
+{
+    event.sequence = sequence++;
+    events.push(event);
+}
+
+/**
+ * @brief Simulator::send
+ * queues the message on the link. it is sent after the previous messages
+ * and arrives after the latency and a random jitter, or is dropped
+ * @param size of the message in bytes
+ */
+void Simulator::send(int from, int to, Event &event, size_t size)
+{
+    Link &link = links.at(from).at(to);
+    messages++;
+    bytes += size;
+    long sent = max(virtualTime, link.busyUntil) + (long)(size * 1000 / config.bandwidth);
+    link.busyUntil = sent;
+    if (uniform_real_distribution<double>(0, 1)(random) < config.loss)
+    {
+        droppedMessages++;
+        return;
+    }
+    long jitter = config.jitter > 0 ? uniform_int_distribution<int>(0, config.jitter)(random) : 0;
+    event.time = max(sent + config.latency + jitter, link.lastArrival);
+    link.lastArrival = event.time;
+    event.node = to;
+    event.from = from;
+    if (event.type == BLOCK_ARRIVAL || event.type == BLOCK_REQUEST)
+    {
+        blocksInFlight++;
+    }
+    schedule(event);
+}
+
+/**
+ * @brief Simulator::requestProof
+ * proves the block of the miner. the lucky number is drawn at once and handed
+ * over after its waiting period on the virtual clock. a running proof is cancelled
+ * @param callback of the miner
+ * @return token of the request
+ */
+shared_ptr<ProofCancel> Simulator::requestProof(int index, const Block &block, function<void(const ProofResult&)> callback)
+{
+    Node &node = nodes.at(index);
+    if (node.proof)
+    {
+        cancelledProofs++;
+        node.proof->cancel();
+    }
+    node.proof.reset(new ProofCancel());
+    node.proofCallback = callback;
+    node.proofResult = ProofResult();
+    node.proofResult.valid = true;
+    ProofProvider::instance().addProof(block.getMerkleHash(), block.getPreviousHash(),
+                                       &node.proofResult.luckyNumber, &node.proofResult.certificate);
+    Event ready = Event();
+    ready.type = PROOF_READY;
+    ready.node = index;
+    ready.id = ++node.proofID;
+    ready.time = virtualTime + lround(config.maxWaitingTime - node.proofResult.luckyNumber * config.maxWaitingTime);
+    schedule(ready);
+    return node.proof;
+}
+
+/**
+ * @brief Simulator::finishProof
+ * hands the result of the running proof over to the miner
+ */
+void Simulator::finishProof(const Event &event)
+{
+    Node &node = nodes.at(event.node);
+    if (!mining || !node.proof || event.id != node.proofID)
+    {
+        return;
+    }
+    node.proof.reset();
+    node.proofCallback(node.proofResult);
+    step(event.node);
+}
+
+/**
+ * @brief Simulator::endRound
+ * wakes the miner up, unless its round was moved since
+ */
+void Simulator::endRound(const Event &event)
+{
+    if (event.time == nodes.at(event.node).roundEnd)
+    {
+        step(event.node);
+    }
+}
+
+/**
+ * @brief Simulator::step
+ * the miner of the node handles the events of its chain, like its thread would
+ * after waking up. the end of its round is scheduled, if it has changed
+ */
+void Simulator::step(int index)
+{
+    if (!mining)
+    {
+        return;
+    }
+    Node &node = nodes.at(index);
+    node.miner->processEvents();
+    long roundEnd = node.miner->getRoundEnd() - EPOCH * 1000LL;
+    if (roundEnd > virtualTime && roundEnd != node.roundEnd)
+    {
+        node.roundEnd = roundEnd;
+        Event event = Event();
+        event.type = ROUND_END;
+        event.node = index;
+        event.time = roundEnd;
+        schedule(event);
+    }
+}
+
+/**
+ * @brief Simulator::blockFound
+ * the miner appended its block, it is sent to all other nodes
+ */
+void Simulator::blockFound(int index, const Block &block)
+{
+    ProducedBlock producedBlock = { index, virtualTime };
+    produced[block.getHash()] = producedBlock;
+    size_t size = HelperFunctions::parseBlockToString(block, 0).size();
+    for (int i = 0; i < config.nodes; i++)
+    {
+        if (i != index)
+        {
+            Event arrival = Event();
+            arrival.type = BLOCK_ARRIVAL;
+            arrival.block = block;
+            send(index, i, arrival, size);
+        }
+    }
+    acceptTip(index);
+}
+
+/**
+ * @brief Simulator::stopMining
+ * stops the miners at the end of the duration, the running proofs are dropped
+ */
+void Simulator::stopMining()
+{
+    for (int i = 0; i < config.nodes; i++)
+    {
+        nodes.at(i).miner->stop();
+        nodes.at(i).miner->processEvents();
+        nodes.at(i).proof.reset();
+    }
+    mining = false;
+}
+
+/**
+ * @brief Simulator::createTransaction
+ * a random node sends coins of the faucet to another node.
+ * the next transaction follows after an exponential distributed time
+ */
+void Simulator::createTransaction()
+{
+    if (!mining)
+    {
+        return;
+    }
+    if (virtualTime > 0)
+    {
+        int index = uniform_int_distribution<int>(0, config.nodes - 1)(random);
+        string recipient = nodes.at(uniform_int_distribution<int>(0, config.nodes - 1)(random)).key;
+        int value = uniform_int_distribution<int>(1, 5)(random);
+        string hash = signMsg(recipient, faucet, value);
+        if (transactionsCreated.find(hash) == transactionsCreated.end())
+        {
+            time_t timestamp = Clock::instance().now();
+            Transaction transaction(faucet, recipient, value, hash, timestamp);
+            transactionsCreated[hash] = virtualTime;
+            addTransaction(index, transaction);
+            string message = faucet + "," + recipient + "," + hash + "," + to_string(value) + "," + to_string(timestamp);
+            for (int i = 0; i < config.nodes; i++)
+            {
+                if (i != index)
+                {
+                    Event arrival = Event();
+                    arrival.type = TRANSACTION_ARRIVAL;
+                    arrival.transaction = transaction;
+                    send(index, i, arrival, message.size());
+                }
+            }
+        }
+    }
+    Event next = Event();
+    next.type = NEW_TRANSACTION;
+    next.time = virtualTime + lround(exponential_distribution<double>(config.transactionRate)(random) * 1000);
+    schedule(next);
+}
+
+/**
+ * @brief Simulator::receiveBlock
+ * handles the block like the client. missing previous blocks
+ * are requested from the sender
+ */
+void Simulator::receiveBlock(const Event &event)
+{
+    blocksInFlight--;
+    Node &node = nodes.at(event.node);
+    Block block = event.block;
+    int forkID = event.forkID;
+    int requestedBlock = node.chain->handleBlock(block, &forkID);
+    if (requestedBlock > 0)
+    {
+        Event request = Event();
+        request.type = BLOCK_REQUEST;
+        request.requestedBlock = requestedBlock;
+        request.forkID = forkID;
+        send(event.node, event.from, request, 2 * sizeof(int));
+    }
+    else if (requestedBlock == 0)
+    {
+        acceptTip(event.node);
+    }
+    step(event.node);
+}
+
+void Simulator::answerBlockRequest(const Event &event)
+{
+    blocksInFlight--;
+    Event response = Event();
+    response.type = BLOCK_ARRIVAL;
+    response.block = nodes.at(event.node).chain->getBlock(event.requestedBlock, 0);
+    response.forkID = event.forkID;
+    send(event.node, event.from, response, HelperFunctions::parseBlockToString(response.block, event.forkID).size());
+}
+
+void Simulator::receiveTransaction(const Event &event)
+{
+    map<string, long>::iterator created = transactionsCreated.find(event.transaction.getHash());
+    if (created != transactionsCreated.end())
+    {
+        transactionPropagation.push_back(virtualTime - created->second);
+    }
+    addTransaction(event.node, event.transaction);
+}
+
+/**
+ * @brief Simulator::addTransaction
+ * adds the transaction to the mempool. enough new transactions
+ * start an idle miner before the round ends
+ */
+void Simulator::addTransaction(int index, const Transaction &transaction)
+{
+    Node &node = nodes.at(index);
+    node.chain->newTransaction(transaction.getSender(), transaction.getRecipient(), transaction.getHash(),
+                               transaction.getValue(), transaction.getTimestamp());
+    step(index);
+}
+
+/**
+ * @brief Simulator::acceptTip
+ * records the blocks, that joined the main chain of the node
+ */
+void Simulator::acceptTip(int index)
+{
+    Node &node = nodes.at(index);
+    Block tip = node.chain->getLatestBlock();
+    if (tip.getHash() == node.tip)
+    {
+        return;
+    }
+    acceptedTips++;
+    if (tip.getPreviousHash() != node.tip)
+    {
+        reorganizations++;
+    }
+    for (int i = tip.getIndex(); i > 1; i--)
+    {
+        Block block = i == tip.getIndex() ? tip : node.chain->getBlock(i, 0);
+        if (block.getHash() == node.tip)
+        {
+            break;
+        }
+        vector<long> &arrivals = blockArrivals[block.getHash()];
+        if (arrivals.empty())
+        {
+            arrivals.assign(config.nodes, -1);
+        }
+        if (arrivals.at(index) >= 0)
+        {
+            break;
+        }
+        arrivals.at(index) = virtualTime;
+    }
+    node.tip = tip.getHash();
+}
+
+/**
+ * @brief Simulator::isConverged
+ * @return true if all nodes have the same tip
+ */
+bool Simulator::isConverged()
+{
+    string tip = nodes.at(0).chain->getLatestBlock().getHash();
+    for (unsigned int i = 1; i < nodes.size(); i++)
+    {
+        if (nodes.at(i).chain->getLatestBlock().getHash() != tip)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Simulator::percentiles
+ * @return p50, p90 and p99 of the values, empty if there are none
+ */
+vector<long> Simulator::percentiles(vector<long> values)
+{
+    vector<long> result;
+    if (values.empty())
+    {
+        return result;
+    }
+    sort(values.begin(), values.end());
+    double ranks[] = { 0.5, 0.9, 0.99 };
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        result.push_back(values.at(min(values.size() - 1, (size_t)ceil(ranks[i] * values.size()) - 1)));
+    }
+    return result;
+}
+
+static void printPercentiles(const string &name, const vector<long> &values, const vector<long> &result)
+{
+    cout << name;
+    if (result.empty())
+    {
+        cout << "-" << endl;
+        return;
+    }
+    cout << "p50 " << result.at(0) << " p90 " << result.at(1) << " p99 " << result.at(2)
+         << " (" << values.size() << " samples)" << endl;
+}
+
+/**
+ * @brief Simulator::printReport
+ * the orphans are counted against the main chain of the first node
+ */
+void Simulator::printReport()
+{
+    Blockchain &chain = *nodes.at(0).chain;
+    int height = chain.getLatestBlockIndex();
+    set<string> mainChain;
+    int confirmed = 0;
+    vector<long> confirmation;
+    for (int i = 2; i <= height; i++)
+    {
+        Block block = chain.getBlock(i, 0);
+        mainChain.insert(block.getHash());
+        map<string, ProducedBlock>::iterator producedBlock = produced.find(block.getHash());
+        vector<Transaction> transactions = block.getTransaction();
+        for (unsigned int t = 0; t < transactions.size(); t++)
+        {
+            map<string, long>::iterator created = transactionsCreated.find(transactions.at(t).getHash());
+            if (created != transactionsCreated.end() && producedBlock != produced.end())
+            {
+                confirmed++;
+                confirmation.push_back(producedBlock->second.time - created->second);
+            }
+        }
+    }
+
+    int orphans = 0;
+    vector<long> propagation;
+    vector<long> convergence;
+    for (map<string, ProducedBlock>::iterator block = produced.begin(); block != produced.end(); block++)
+    {
+        if (mainChain.find(block->first) == mainChain.end())
+        {
+            orphans++;
+            continue;
+        }
+        vector<long> &arrivals = blockArrivals[block->first];
+        long last = 0;
+        bool everywhere = true;
+        for (int i = 0; i < config.nodes; i++)
+        {
+            if (i == block->second.node)
+            {
+                continue;
+            }
+            if (arrivals.empty() || arrivals.at(i) < 0)
+            {
+                everywhere = false;
+                continue;
+            }
+            propagation.push_back(arrivals.at(i) - block->second.time);
+            last = max(last, arrivals.at(i) - block->second.time);
+        }
+        if (everywhere)
+        {
+            convergence.push_back(last);
+        }
+    }
+
+    int producedBlocks = produced.size();
+    int notLucky = 0;
+    for (int i = 0; i < config.nodes; i++)
+    {
+        notLucky += nodes.at(i).miner->getStats().notLucky;
+    }
+    cout << "simulated " << config.duration << " s with " << config.nodes << " nodes, seed " << config.seed << endl;
+    cout << "blocks produced:            " << producedBlocks << endl;
+    cout << "main chain height:          " << height << endl;
+    cout << "orphan rate:                " << (producedBlocks ? 100.0 * orphans / producedBlocks : 0) << "% ("
+         << orphans << " orphans)" << endl;
+    cout << "fork rate:                  " << (acceptedTips ? 100.0 * reorganizations / acceptedTips : 0) << "% ("
+         << reorganizations << " reorganizations of " << acceptedTips << " new tips)" << endl;
+    cout << "unlucky and cancelled:      " << notLucky << " proofs not luckier, " << cancelledProofs << " cancelled" << endl;
+    if (convergedAt >= 0)
+    {
+        cout << "converged:                  " << convergedAt - config.duration * 1000L
+             << " ms after mining stopped" << endl;
+    }
+    else
+    {
+        cout << "converged:                  no" << endl;
+    }
+    printPercentiles("block propagation ms:       ", propagation, percentiles(propagation));
+    printPercentiles("block convergence ms:       ", convergence, percentiles(convergence));
+    printPercentiles("transaction propagation ms: ", transactionPropagation, percentiles(transactionPropagation));
+    printPercentiles("confirmation ms:            ", confirmation, percentiles(confirmation));
+    cout << "transactions:               " << transactionsCreated.size() << " created, " << confirmed << " confirmed, "
+         << (double)confirmed / config.duration << " tx/s" << endl;
+    cout << "messages:                   " << messages << " sent, " << droppedMessages << " dropped, "
+         << bytes << " bytes" << endl;
+}
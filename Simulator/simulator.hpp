@@ -0,0 +1,135 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <queue>
+#include <memory>
+#include <random>
+#include <cstdint>
+#include "../Chain/blockchain.hpp"
+#include "../Chain/miningscheduler.hpp"
+
+using namespace std;
+
+struct SimulationConfig {
+    int nodes;
+    int duration;               //mining time in seconds
+    int latency;                //in milliseconds
+    int jitter;                 //max additional latency in milliseconds
+    long bandwidth;             //in bytes per second per link
+    double loss;                //probability, that a message is dropped
+    double transactionRate;     //new transactions per second
+    int maxWaitingTime;         //waiting period of the proof in milliseconds
+    int transactionThreshold;   //transactions, that start an idle miner early
+    uint64_t seed;
+    string directory;           //databases of the nodes
+    bool verbose;               //keeps the output of the nodes
+};
+
+/**
+ * runs several nodes in one process on a virtual clock.
+ * the nodes are connected by simulated links with latency, bandwidth and loss.
+ * every node mines with a MiningScheduler without its thread, the simulator
+ * proves its blocks and hands over the events, so the waiting periods of the
+ * proofs and the rounds are fast forwarded. the lucky numbers come from the
+ * software proof provider, so a run is repeated exactly with the same seed
+ */
+class Simulator
+{
+public:
+    Simulator(const SimulationConfig &config);
+    ~Simulator();
+    bool run();
+    void printReport();
+
+private:
+    enum EventType {
+        PROOF_READY,
+        ROUND_END,
+        NEW_TRANSACTION,
+        BLOCK_ARRIVAL,
+        BLOCK_REQUEST,
+        TRANSACTION_ARRIVAL
+    };
+    struct Event {
+        long time;                  //virtual time in milliseconds
+        unsigned long sequence;     //keeps the order of events at the same time
+        EventType type;
+        int node;
+        int from;
+        unsigned long id;           //proof of the node
+        int forkID;
+        int requestedBlock;
+        Block block;
+        Transaction transaction;
+    };
+    struct EventOrder {
+        bool operator()(const Event &a, const Event &b) const;
+    };
+    struct Node {
+        unique_ptr<Blockchain> chain;
+        unique_ptr<MiningScheduler> miner;  //removes its listener before the chain is destroyed
+        string key;
+        shared_ptr<ProofCancel> proof;      //running proof
+        function<void(const ProofResult&)> proofCallback;
+        ProofResult proofResult;
+        unsigned long proofID;
+        long roundEnd;                      //scheduled end of the round
+        string tip;
+    };
+    struct Link {
+        long busyUntil;             //the link sends one message at a time
+        long lastArrival;           //messages arrive in order
+    };
+    struct ProducedBlock {
+        int node;
+        long time;
+    };
+
+    void schedule(Event &event);
+    void send(int from, int to, Event &event, size_t size);
+    bool createNodes();
+    shared_ptr<ProofCancel> requestProof(int node, const Block &block, function<void(const ProofResult&)> callback);
+    void finishProof(const Event &event);
+    void endRound(const Event &event);
+    void step(int node);
+    void blockFound(int node, const Block &block);
+    void stopMining();
+    void createTransaction();
+    void receiveBlock(const Event &event);
+    void answerBlockRequest(const Event &event);
+    void receiveTransaction(const Event &event);
+    void addTransaction(int node, const Transaction &transaction);
+    void acceptTip(int node);
+    bool isConverged();
+    long long now();
+    static vector<long> percentiles(vector<long> values);
+
+    SimulationConfig config;
+    vector<Node> nodes;
+    vector<vector<Link> > links;
+    priority_queue<Event, vector<Event>, EventOrder> events;
+    unsigned long sequence;
+    long virtualTime;                   //in milliseconds since the start
+    bool mining;
+    mt19937_64 random;
+    string faucet;                      //public key, that pays the transactions
+    map<string, ProducedBlock> produced;
+    map<string, vector<long> > blockArrivals;   //per block, the time it joined the main chain of each node
+    map<string, long> transactionsCreated;
+    vector<long> transactionPropagation;
+    int reorganizations;
+    int acceptedTips;
+    int cancelledProofs;
+    int blocksInFlight;                 //blocks and block requests on the links
+    long convergedAt;                   //-1 until the nodes agree after mining stopped
+    long messages;
+    long droppedMessages;
+    long bytes;
+    const time_t EPOCH = 1600000000;    //virtual start time, after the genesis block
+    const long MAX_SETTLE_TIME = 600000; //time to converge after mining stopped, in milliseconds
+};
+
+#endif // SIMULATOR_H
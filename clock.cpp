@@ -0,0 +1,47 @@
+#include "clock.h"
+#include <chrono>
+
+Clock::Clock()
+{
+
+}
+
+Clock& Clock::instance()
+{
+    static Clock clock;
+    return clock;
+}
+
+/**
+ * @brief Clock::now
+ * @return the current time in seconds since the epoch
+ */
+time_t Clock::now()
+{
+    return nowMs() / 1000;
+}
+
+/**
+ * @brief Clock::nowMs
+ * @return the current time in milliseconds since the epoch
+ */
+long long Clock::nowMs()
+{
+    lock_guard<mutex> lock(clockMutex);
+    if (source)
+    {
+        return source();
+    }
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Clock::setSource
+ * replaces the system time
+ * @param source returns the time in milliseconds, empty for the system time
+ */
+void Clock::setSource(const function<long long()> &source)
+{
+    lock_guard<mutex> lock(clockMutex);
+    this->source = source;
+}
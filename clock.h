@@ -0,0 +1,28 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+#include <ctime>
+#include <mutex>
+#include <functional>
+
+using namespace std;
+
+/**
+ * wall clock of the node.
+ * it is the system time, unless another source is set, e.g. the
+ * virtual clock of the simulator, that fast forwards the rounds
+ */
+class Clock
+{
+public:
+    static Clock& instance();
+    time_t now();
+    long long nowMs();
+    void setSource(const function<long long()> &source);
+
+private:
+    Clock();
+    function<long long()> source;
+    mutex clockMutex;
+};
+
+#endif // CLOCK_H
@@ -0,0 +1,100 @@
+#include "config.h"
+
+Config::Config()
+{
+    load();
+}
+
+Config& Config::instance()
+{
+    static Config config;
+    return config;
+}
+
+/**
+ * @brief Config::load
+ * reads the config file. values that were set before are overwritten
+ * @param path of the config file
+ * @return true if the file could be read
+ */
+bool Config::load(const string &path)
+{
+    ifstream file(path.c_str());
+    if (!file.is_open())
+    {
+        return false;
+    }
+    lock_guard<mutex> lock(configMutex);
+    string line;
+    while (getline(file, line))
+    {
+        line = trim(line);
+        size_t separator = line.find('=');
+        if (line.empty() || line.at(0) == '#' || separator == string::npos)
+        {
+            continue;
+        }
+        values[trim(line.substr(0, separator))] = trim(line.substr(separator + 1));
+    }
+    return true;
+}
+
+string Config::get(const string &key, const string &defaultValue)
+{
+    lock_guard<mutex> lock(configMutex);
+    map<string, string>::iterator value = values.find(key);
+    if (value == values.end())
+    {
+        return defaultValue;
+    }
+    return value->second;
+}
+
+int Config::getInt(const string &key, int defaultValue)
+{
+    string value = get(key);
+    if (value.empty())
+    {
+        return defaultValue;
+    }
+    try
+    {
+        return stoi(value);
+    }
+    catch (const exception &)
+    {
+        cout << "config value " << key << " = " << value << " is not a number" << endl;
+        return defaultValue;
+    }
+}
+
+bool Config::getBool(const string &key, bool defaultValue)
+{
+    string value = get(key);
+    if (value.empty())
+    {
+        return defaultValue;
+    }
+    return value == "1" || value == "true" || value == "yes" || value == "on";
+}
+
+/**
+ * @brief Config::set
+ * overrides a value for this run, e.g. from the command line
+ */
+void Config::set(const string &key, const string &value)
+{
+    lock_guard<mutex> lock(configMutex);
+    values[key] = value;
+}
+
+string Config::trim(const string &value)
+{
+    size_t start = value.find_first_not_of(" \t\r\n");
+    if (start == string::npos)
+    {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t\r\n");
+    return value.substr(start, end - start + 1);
+}
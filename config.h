@@ -0,0 +1,35 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+#include <string>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+const string CONFIG_PATH = "../config/node.conf";
+
+/**
+ * node settings from the config file.
+ * every line has the format key = value, lines starting with # are ignored.
+ * a missing file or key falls back to the default of the caller
+ */
+class Config
+{
+public:
+    static Config& instance();
+    bool load(const string &path = CONFIG_PATH);
+    string get(const string &key, const string &defaultValue = "");
+    int getInt(const string &key, int defaultValue);
+    bool getBool(const string &key, bool defaultValue);
+    void set(const string &key, const string &value);
+
+private:
+    Config();
+    string trim(const string &value);
+    map<string, string> values;
+    mutex configMutex;
+};
+
+#endif // CONFIG_H
@@ -1,7 +1,16 @@
 #include "helperfunctions.h"
-
-
-QString HelperFunctions::parseBlockToQString(Block block, int forkID)
+#include <climits>
+#include <cstdlib>
+
+
+/**
+ * @brief HelperFunctions::parseBlockToString
+ * serializes a block for the network
+ * @param block to be sent
+ * @param forkID of the requesting peer
+ * @return comma separated fields of the block
+ */
+string HelperFunctions::parseBlockToString(Block block, int forkID)
 {
     string blockAsString = "";
     blockAsString += block.getPreviousHash() + ","
@@ -39,32 +48,38 @@ QString HelperFunctions::parseBlockToQString(Block block, int forkID)
     blockAsString += block.getCertificate() + ",";
     blockAsString += to_string(forkID) + ",";
 
-    return QString::fromStdString(blockAsString);
+    return blockAsString;
 }
 
-HelperFunctions::forkBlock HelperFunctions::parseQStringToBlock(QString block)
+/**
+ * @brief HelperFunctions::parseStringToBlock
+ * creates a block from the format of parseBlockToString
+ * @param block comma separated fields of the block
+ * @return the new block, that has to be deleted by the caller, and the fork id
+ */
+HelperFunctions::forkBlock HelperFunctions::parseStringToBlock(const string &block)
 {
-    QStringList paramsList = block.split(",");
+    vector<string> paramsList = split(block, ',');
     vector<Transaction> transactionFromString = {};
-    QStringList tempTransList = paramsList.at(2).split(";");
+    vector<string> tempTransList = split(paramsList.at(2), ';');
 
-    for (int i = 0; tempTransList.size() - 1 > i; i++)
+    for (int i = 0; (int) tempTransList.size() - 1 > i; i++)
     {
-        QStringList transAsString = tempTransList.at(i).split("_");
+        vector<string> transAsString = split(tempTransList.at(i), '_');
 
-        Transaction temp = Transaction(transAsString.at(0).toStdString(),
-                                       transAsString.at(1).toStdString(),
-                                       transAsString.at(2).toDouble(),
-                                       transAsString.at(3).toStdString(),
-                                       transAsString.at(4).toInt());
+        Transaction temp = Transaction(transAsString.at(0),
+                                       transAsString.at(1),
+                                       toDouble(transAsString.at(2)),
+                                       transAsString.at(3),
+                                       toInt(transAsString.at(4)));
 
         vector<string> inputsFromString = {};
         if (transAsString.size() >= 6)
         {
-            QStringList inputsAsString = transAsString.at(5).split("-");
-            for (int j = 0; inputsAsString.size() - 1 > j; j++)
+            vector<string> inputsAsString = split(transAsString.at(5), '-');
+            for (int j = 0; (int) inputsAsString.size() - 1 > j; j++)
             {
-                inputsFromString.push_back(inputsAsString.at(j).toStdString());
+                inputsFromString.push_back(inputsAsString.at(j));
             }
         }
         temp.setInput(inputsFromString);
@@ -74,23 +89,23 @@ HelperFunctions::forkBlock HelperFunctions::parseQStringToBlock(QString block)
 
     //prev,merkle, vector,index
     Block* receivedBlock = new Block();
-    receivedBlock->setPreviousHash(paramsList.at(0).toStdString());
-    receivedBlock->setMerkleHash(paramsList.at(1).toStdString());
+    receivedBlock->setPreviousHash(paramsList.at(0));
+    receivedBlock->setMerkleHash(paramsList.at(1));
 
     receivedBlock->setTransaction(transactionFromString);
-    receivedBlock->setHash(paramsList.at(3).toStdString());
+    receivedBlock->setHash(paramsList.at(3));
     double ln;
     vector<unsigned char> ln_copy;
-    ln_copy = base64_decode(paramsList.at(5).toStdString());
+    ln_copy = base64_decode(paramsList.at(5));
     memcpy(&ln, ln_copy.data(), sizeof(double));
     receivedBlock->setLn(ln);
     time_t time;
     forkBlock retVal;
 
     try {
-        time = paramsList.at(6).toInt();
-        receivedBlock->setIndex((paramsList.at(4)).toInt());
-        retVal.forkID = paramsList.at(8).toInt();
+        time = toInt(paramsList.at(6));
+        receivedBlock->setIndex(toInt(paramsList.at(4)));
+        retVal.forkID = toInt(paramsList.at(8));
 
     }
     catch (...)
@@ -101,9 +116,57 @@ HelperFunctions::forkBlock HelperFunctions::parseQStringToBlock(QString block)
         cout << endl << "*************caught an invalid sent Block**************" << endl << endl;
     }
     receivedBlock->setTimestamp(time);
-    receivedBlock->setCertificate(paramsList.at(7).toStdString());
+    receivedBlock->setCertificate(paramsList.at(7));
     retVal.block = receivedBlock;
     //cout << "****RECEIVED BLOCK*********" << endl;
     //cout << receivedBlock->print();
     return retVal;
 }
+
+/**
+ * @brief HelperFunctions::split
+ * splits the text at every separator, empty parts are kept
+ */
+vector<string> HelperFunctions::split(const string &text, char separator)
+{
+    vector<string> parts;
+    size_t start = 0;
+    size_t end;
+    while ((end = text.find(separator, start)) != string::npos)
+    {
+        parts.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    parts.push_back(text.substr(start));
+    return parts;
+}
+
+/**
+ * @brief HelperFunctions::toInt
+ * @return the number or 0, if the whole text is not a number
+ */
+int HelperFunctions::toInt(const string &number)
+{
+    char *end;
+    long value = strtol(number.c_str(), &end, 10);
+    if (number.empty() || *end != '\0' || value > INT_MAX || value < INT_MIN)
+    {
+        return 0;
+    }
+    return value;
+}
+
+/**
+ * @brief HelperFunctions::toDouble
+ * @return the number or 0, if the whole text is not a number
+ */
+double HelperFunctions::toDouble(const string &number)
+{
+    char *end;
+    double value = strtod(number.c_str(), &end);
+    if (number.empty() || *end != '\0')
+    {
+        return 0;
+    }
+    return value;
+}
@@ -1,8 +1,8 @@
 #ifndef HELPERFUNCTIONS_H
 #define HELPERFUNCTIONS_H
 #include "Chain/block.hpp"
-#include <QString>
-#include <QDataStream>
+#include <string>
+#include <vector>
 
 
 namespace HelperFunctions
@@ -12,8 +12,11 @@ namespace HelperFunctions
         Block* block;
     };
 
-    QString parseBlockToQString(Block block, int forkID);
-    forkBlock parseQStringToBlock(QString block);
+    string parseBlockToString(Block block, int forkID);
+    forkBlock parseStringToBlock(const string &block);
+    vector<string> split(const string &text, char separator);
+    int toInt(const string &number);
+    double toDouble(const string &number);
     const int ROUND_TIME = 30;  //in seconds
     struct Utxo_help {
         string hash;
@@ -0,0 +1,42 @@
+#include "log.h"
+#include "config.h"
+
+atomic<int> Log::current(LOG_INFO);
+
+void Log::setLevel(LogLevel level)
+{
+    current.store(level, memory_order_relaxed);
+}
+
+/**
+ * @brief Log::setLevel
+ * @param name error, warning, info or debug
+ * @return false for an unknown level, the level is not changed then
+ */
+bool Log::setLevel(const string &name)
+{
+    const char *names[] = {"error", "warning", "info", "debug"};
+    for (int level = LOG_ERROR; level <= LOG_DEBUG; level++)
+    {
+        if (name == names[level])
+        {
+            setLevel((LogLevel) level);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Log::load
+ * sets the level from the config
+ */
+void Log::load()
+{
+    string level = Config::instance().get("log_level", "info");
+    if (!setLevel(level))
+    {
+        cout << "unknown log_level " << level << ", using info" << endl;
+        setLevel(LOG_INFO);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef LOG_H
+#define LOG_H
+#include <atomic>
+#include <string>
+#include <iostream>
+
+using namespace std;
+
+enum LogLevel {
+    LOG_ERROR,
+    LOG_WARNING,
+    LOG_INFO,
+    LOG_DEBUG
+};
+
+/**
+ * level of the messages of the node, log_level in the config (error, warning,
+ * info or debug, default info). a disabled message costs one comparison,
+ * its arguments are not evaluated
+ */
+class Log
+{
+public:
+    static bool isEnabled(LogLevel level)
+    {
+        return level <= current.load(memory_order_relaxed);
+    }
+    static void setLevel(LogLevel level);
+    static bool setLevel(const string &name);
+    static void load();
+
+private:
+    static atomic<int> current;
+};
+
+//LOG(LOG_DEBUG) << "appending block " << index << endl;
+#define LOG(level) if (!Log::isEnabled(level)) {} else cout
+
+#endif // LOG_H
@@ -0,0 +1,201 @@
+#include "metrics.h"
+
+Counter::Counter()
+    :value(0)
+{
+}
+
+void Counter::inc(long amount)
+{
+    value.fetch_add(amount, memory_order_relaxed);
+}
+
+long Counter::get() const
+{
+    return value.load(memory_order_relaxed);
+}
+
+Gauge::Gauge()
+    :value(0)
+{
+}
+
+void Gauge::set(long value)
+{
+    this->value.store(value, memory_order_relaxed);
+}
+
+void Gauge::add(long amount)
+{
+    value.fetch_add(amount, memory_order_relaxed);
+}
+
+long Gauge::get() const
+{
+    return value.load(memory_order_relaxed);
+}
+
+Histogram::Histogram(const vector<double> &bounds)
+    :bounds(bounds), buckets(new atomic<long>[bounds.size() + 1]), count(0), sum(0)
+{
+    for (unsigned int i = 0; i <= bounds.size(); i++)
+    {
+        buckets[i] = 0;
+    }
+}
+
+/**
+ * @brief Histogram::observe
+ * @param value in the unit of the bounds
+ */
+void Histogram::observe(double value)
+{
+    unsigned int bucket = 0;
+    while (bucket < bounds.size() && value > bounds.at(bucket))
+    {
+        bucket++;
+    }
+    buckets[bucket].fetch_add(1, memory_order_relaxed);
+    count.fetch_add(1, memory_order_relaxed);
+    double current = sum.load(memory_order_relaxed);
+    while (!sum.compare_exchange_weak(current, current + value, memory_order_relaxed))
+    {
+    }
+}
+
+/**
+ * @brief Histogram::render
+ * writes the cumulative buckets, the sum and the count
+ * @param labels of the histogram without the braces, may be empty
+ */
+void Histogram::render(ostream &out, const string &name, const string &labels) const
+{
+    string prefix = labels.empty() ? "{" : "{" + labels + ",";
+    long cumulative = 0;
+    for (unsigned int i = 0; i <= bounds.size(); i++)
+    {
+        cumulative += buckets[i].load(memory_order_relaxed);
+        out << name << "_bucket" << prefix << "le=\"";
+        if (i < bounds.size())
+        {
+            out << bounds.at(i);
+        }
+        else
+        {
+            out << "+Inf";
+        }
+        out << "\"} " << cumulative << "\n";
+    }
+    string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << suffix << " " << sum.load(memory_order_relaxed) << "\n";
+    out << name << "_count" << suffix << " " << count.load(memory_order_relaxed) << "\n";
+}
+
+Metrics::Metrics()
+{
+}
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+/**
+ * @brief Metrics::counter
+ * registers a counter or returns the registered one
+ * @param name of the metric, e.g. poluck_blocks_validated_total
+ * @param help text of the metric
+ * @param labels without the braces, e.g. type="select"
+ * @return the counter, it lives as long as the process
+ */
+Counter& Metrics::counter(const string &name, const string &help, const string &labels)
+{
+    lock_guard<mutex> lock(registryMutex);
+    unique_ptr<Counter> &counter = family(name, help, "counter").counters[labels];
+    if (!counter)
+    {
+        counter.reset(new Counter());
+    }
+    return *counter;
+}
+
+Gauge& Metrics::gauge(const string &name, const string &help, const string &labels)
+{
+    lock_guard<mutex> lock(registryMutex);
+    unique_ptr<Gauge> &gauge = family(name, help, "gauge").gauges[labels];
+    if (!gauge)
+    {
+        gauge.reset(new Gauge());
+    }
+    return *gauge;
+}
+
+/**
+ * @brief Metrics::histogram
+ * registers a histogram or returns the registered one, the bounds of the first registration are kept
+ * @param bounds ascending upper bounds of the buckets
+ */
+Histogram& Metrics::histogram(const string &name, const string &help, const vector<double> &bounds,
+                              const string &labels)
+{
+    lock_guard<mutex> lock(registryMutex);
+    unique_ptr<Histogram> &histogram = family(name, help, "histogram").histograms[labels];
+    if (!histogram)
+    {
+        histogram.reset(new Histogram(bounds));
+    }
+    return *histogram;
+}
+
+/**
+ * @brief Metrics::render
+ * @return every metric in the text format of prometheus
+ */
+string Metrics::render()
+{
+    ostringstream out;
+    lock_guard<mutex> lock(registryMutex);
+    for (auto it = families.begin(); it != families.end(); ++it)
+    {
+        const string &name = it->first;
+        const Family &family = it->second;
+        out << "# HELP " << name << " " << family.help << "\n";
+        out << "# TYPE " << name << " " << family.type << "\n";
+        for (auto counter = family.counters.begin(); counter != family.counters.end(); ++counter)
+        {
+            out << name << (counter->first.empty() ? "" : "{" + counter->first + "}") << " "
+                << counter->second->get() << "\n";
+        }
+        for (auto gauge = family.gauges.begin(); gauge != family.gauges.end(); ++gauge)
+        {
+            out << name << (gauge->first.empty() ? "" : "{" + gauge->first + "}") << " "
+                << gauge->second->get() << "\n";
+        }
+        for (auto histogram = family.histograms.begin(); histogram != family.histograms.end(); ++histogram)
+        {
+            histogram->second->render(out, name, histogram->first);
+        }
+    }
+    return out.str();
+}
+
+/**
+ * @brief Metrics::secondBuckets
+ * @return bounds from 100 us to 10 s for durations in seconds
+ */
+vector<double> Metrics::secondBuckets()
+{
+    return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+}
+
+Metrics::Family& Metrics::family(const string &name, const string &help, const string &type)
+{
+    Family &family = families[name];
+    if (family.type.empty())
+    {
+        family.help = help;
+        family.type = type;
+    }
+    return family;
+}
@@ -0,0 +1,85 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+
+using namespace std;
+
+class Counter
+{
+public:
+    Counter();
+    void inc(long amount = 1);
+    long get() const;
+
+private:
+    atomic<long> value;
+};
+
+class Gauge
+{
+public:
+    Gauge();
+    void set(long value);
+    void add(long amount);
+    long get() const;
+
+private:
+    atomic<long> value;
+};
+
+/**
+ * counts the observations in fixed buckets. the bounds are the upper
+ * bounds of the buckets, the last bucket takes everything above them
+ */
+class Histogram
+{
+public:
+    Histogram(const vector<double> &bounds);
+    void observe(double value);
+    void render(ostream &out, const string &name, const string &labels) const;
+
+private:
+    vector<double> bounds;
+    unique_ptr<atomic<long>[]> buckets;
+    atomic<long> count;
+    atomic<double> sum;
+};
+
+/**
+ * counters, gauges and histograms of the node, served in the text format of
+ * prometheus. a metric is registered once and its reference kept by the caller,
+ * the updates are atomic and take no lock. the registry is process wide,
+ * the nodes of the simulator add up
+ */
+class Metrics
+{
+public:
+    static Metrics& instance();
+    Counter& counter(const string &name, const string &help, const string &labels = "");
+    Gauge& gauge(const string &name, const string &help, const string &labels = "");
+    Histogram& histogram(const string &name, const string &help, const vector<double> &bounds,
+                         const string &labels = "");
+    string render();
+    static vector<double> secondBuckets();
+
+private:
+    Metrics();
+    struct Family {
+        string help;
+        string type;
+        map<string, unique_ptr<Counter> > counters;     //by labels
+        map<string, unique_ptr<Gauge> > gauges;
+        map<string, unique_ptr<Histogram> > histograms;
+    };
+    Family& family(const string &name, const string &help, const string &type);
+    mutex registryMutex;
+    map<string, Family> families;
+};
+
+#endif // METRICS_H
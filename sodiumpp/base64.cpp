@@ -11,9 +11,10 @@ std::string base64_encode(unsigned char const* buf, unsigned int bufLen) {
     {
         size_t index = i*3;
         unsigned char b3[3];
-        b3[0] = buf[index+0];
-        b3[1] = buf[index+1];
-        b3[2] = buf[index+2];
+        //the last group is padded with zeros, not with the bytes behind the buffer
+        b3[0] = index+0 < bufLen ? buf[index+0] : 0;
+        b3[1] = index+1 < bufLen ? buf[index+1] : 0;
+        b3[2] = index+2 < bufLen ? buf[index+2] : 0;
 
         ret.push_back(to_base64[ ((b3[0] & 0xfc) >> 2) ]);
         ret.push_back(to_base64[ ((b3[0] & 0x03) << 4) + ((b3[1] & 0xf0) >> 4) ]);
@@ -24,6 +25,14 @@ std::string base64_encode(unsigned char const* buf, unsigned int bufLen) {
     return ret;
 }
 
+//a short last group is padded with zeros, characters outside the table are invalid like the others in it
+static unsigned char decode_char(const std::string& encoded_string, size_t index) {
+    if (index >= encoded_string.size())
+        return 0;
+    unsigned char c = encoded_string[index];
+    return c < sizeof(from_base64) ? from_base64[c] : 255;
+}
+
 std::vector<unsigned char> base64_decode(std::string encoded_string) {
     size_t encoded_size = encoded_string.size();
     std::vector<unsigned char> ret;
@@ -32,10 +41,10 @@ std::vector<unsigned char> base64_decode(std::string encoded_string) {
     for (size_t i=0; i<encoded_size; i += 4)
     {
         unsigned char b4[4];
-        b4[0] = from_base64[encoded_string[i+0]];
-        b4[1] = from_base64[encoded_string[i+1]];
-        b4[2] = from_base64[encoded_string[i+2]];
-        b4[3] = from_base64[encoded_string[i+3]];
+        b4[0] = decode_char(encoded_string, i+0);
+        b4[1] = decode_char(encoded_string, i+1);
+        b4[2] = decode_char(encoded_string, i+2);
+        b4[3] = decode_char(encoded_string, i+3);
 
         unsigned char b3[3];
         b3[0] = ((b4[0] & 0x3f) << 2) + ((b4[1] & 0x30) >> 4);
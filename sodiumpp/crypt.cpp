@@ -102,12 +102,29 @@ void getPrivateUkey(unsigned char* ukey, int len)
  * @return base64 string of the signature, which will be uses as a hash
  */
 string signMsg(string rec, string send, int val)
+{
+    unsigned char sk[crypto_sign_SECRETKEYBYTES];
+    getPrivateUkey(sk, crypto_sign_SECRETKEYBYTES);
+    return signMsg(rec, send, val, Clock::instance().now(), sk);
+}
+
+/**
+ * @brief sign_msg
+ * signs a transaction with the given private key, e.g. of a generated keypair
+ * @param rec receiver of the transaction
+ * @param send sender of the Tx, the public key of sk
+ * @param val value if the Transaction
+ * @param timestamp of the transaction
+ * @param sk private key, crypto_sign_SECRETKEYBYTES long
+ * @return base64 string of the signature, which will be uses as a hash
+ */
+string signMsg(string rec, string send, int val, time_t timestamp, const unsigned char* sk)
 {
     SHA1 transHash;
     transHash.update(rec);
     transHash.update(send);
     transHash.update(to_string(val));
-    transHash.update(to_string(time(0)));
+    transHash.update(to_string(timestamp));
     string orig_msg = transHash.final();
     unsigned long long MESSAGE_LEN = orig_msg.length();
     unsigned char msg[MESSAGE_LEN];
@@ -116,8 +133,6 @@ string signMsg(string rec, string send, int val)
     }
     unsigned char signed_message[crypto_sign_BYTES + MESSAGE_LEN];
     unsigned long long signed_message_len;
-    unsigned char sk[crypto_sign_SECRETKEYBYTES];
-    getPrivateUkey(sk, crypto_sign_SECRETKEYBYTES);
     crypto_sign(signed_message, &signed_message_len,
         msg, MESSAGE_LEN, sk);
     return base64_encode(signed_message, signed_message_len);
@@ -35,6 +35,7 @@
 #include <ctime>
 #include <sodiumpp/base64.h>
 #include "libs/sha1.hpp"
+#include "../clock.h"
 using namespace sodiumpp;
 using namespace std;
 
@@ -49,5 +50,6 @@ string getPrivateBkey();
 unsigned char* msgBaseToUchar(string msg, unsigned char* signed_message, int* len);
 void printKey();
 string signMsg(string rec, string send, int val);
+string signMsg(string rec, string send, int val, time_t timestamp, const unsigned char* sk);
 bool verifySignature(string msg, string pk, string rec, int val, time_t timestamp);
 #endif
@@ -0,0 +1,150 @@
+#include "trace.h"
+
+Trace::Trace()
+    :started(chrono::steady_clock::now()), next(0), wrapped(false)
+{
+    enabled = Config::instance().getBool("trace", true);
+    events.resize(max(Config::instance().getInt("trace_events", 65536), 1));
+}
+
+Trace& Trace::instance()
+{
+    static Trace trace;
+    return trace;
+}
+
+bool Trace::isEnabled() const
+{
+    return enabled;
+}
+
+/**
+ * @brief Trace::record
+ * adds a span to the ring buffer, the oldest span is overwritten, when it is full
+ * @param stage name of the span, it has to live as long as the node
+ * @param block index of the block, -1 if unknown
+ */
+void Trace::record(const char *stage, int block, chrono::steady_clock::time_point start,
+                   chrono::steady_clock::time_point end)
+{
+    if (!enabled)
+    {
+        return;
+    }
+    TraceEvent event;
+    event.stage = stage;
+    event.block = block;
+    event.startUs = sinceStart(start);
+    event.durationUs = chrono::duration_cast<chrono::microseconds>(end - start).count();
+    lock_guard<mutex> lock(traceMutex);
+    event.thread = threadNumber();
+    events.at(next) = event;
+    next = (next + 1) % events.size();
+    wrapped |= (next == 0);
+}
+
+/**
+ * @brief Trace::exportChrome
+ * writes the spans in the ring buffer as complete events of the chrome trace format
+ * @param path of the json file
+ * @return true if successful
+ */
+bool Trace::exportChrome(const string &path)
+{
+    ofstream out(path.c_str(), ios::out | ios::trunc);
+    if (!out.is_open())
+    {
+        cout << "couldn't open trace file " << path << endl;
+        return false;
+    }
+    lock_guard<mutex> lock(traceMutex);
+    size_t count = wrapped ? events.size() : next;
+    size_t first = wrapped ? next : 0;
+    out << "{\"traceEvents\":[";
+    for (size_t i = 0; i < count; i++)
+    {
+        const TraceEvent &event = events.at((first + i) % events.size());
+        out << (i ? ",\n" : "\n")
+            << "{\"name\":\"" << event.stage << "\",\"cat\":\"block\",\"ph\":\"X\",\"ts\":" << event.startUs
+            << ",\"dur\":" << event.durationUs << ",\"pid\":1,\"tid\":" << event.thread
+            << ",\"args\":{\"block\":" << event.block << "}}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.close();
+    cout << count << " spans written to " << path << endl;
+    return !out.fail();
+}
+
+/**
+ * @brief Trace::printSummary
+ * prints the count, p50, p99 and maximum duration of every stage in the ring buffer
+ */
+void Trace::printSummary()
+{
+    map<string, vector<long> > durations;
+    {
+        lock_guard<mutex> lock(traceMutex);
+        size_t count = wrapped ? events.size() : next;
+        for (size_t i = 0; i < count; i++)
+        {
+            durations[events.at(i).stage].push_back(events.at(i).durationUs);
+        }
+    }
+    if (durations.empty())
+    {
+        cout << "no spans recorded" << (enabled ? "" : ", tracing is turned off") << endl;
+        return;
+    }
+    cout << "stage                  count      p50 us      p99 us      max us" << endl;
+    for (auto it = durations.begin(); it != durations.end(); ++it)
+    {
+        vector<long> &stage = it->second;
+        sort(stage.begin(), stage.end());
+        long p50 = stage.at((stage.size() - 1) * 50 / 100);
+        long p99 = stage.at((stage.size() - 1) * 99 / 100);
+        cout << it->first << string(max(1, 22 - (int) it->first.size()), ' ')
+             << right << setw(6) << stage.size() << setw(12) << p50 << setw(12) << p99
+             << setw(12) << stage.back() << left << endl;
+    }
+}
+
+long Trace::sinceStart(chrono::steady_clock::time_point time) const
+{
+    return chrono::duration_cast<chrono::microseconds>(time - started).count();
+}
+
+/**
+ * @brief Trace::threadNumber
+ * @return a small number for the calling thread, in the order of their first span
+ */
+int Trace::threadNumber()
+{
+    auto found = threads.find(this_thread::get_id());
+    if (found == threads.end())
+    {
+        found = threads.emplace(this_thread::get_id(), threads.size() + 1).first;
+    }
+    return found->second;
+}
+
+TraceSpan::TraceSpan(const char *stage, int block)
+    :stage(stage), block(block), active(Trace::instance().isEnabled())
+{
+    if (active)
+    {
+        start = chrono::steady_clock::now();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (active)
+    {
+        Trace::instance().record(stage, block, start, chrono::steady_clock::now());
+    }
+}
+
+void TraceSpan::setBlock(int block)
+{
+    this->block = block;
+}
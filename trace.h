@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include "config.h"
+
+using namespace std;
+
+struct TraceEvent {
+    const char *stage;          //a literal, the name of the span
+    int block;                  //index of the block, -1 if unknown
+    long startUs;               //monotonic, since the start of the node
+    long durationUs;
+    int thread;
+};
+
+/**
+ * spans of the way of a block through the node, from reading it on the
+ * socket to relaying it, in a ring buffer of the last trace_events spans.
+ * the timestamps are monotonic. the buffer can be exported in the trace event
+ * format of chrome (chrome://tracing or perfetto), nested spans of a thread
+ * are shown inside each other. trace = false in the config turns it off
+ */
+class Trace
+{
+public:
+    static Trace& instance();
+    bool isEnabled() const;
+    void record(const char *stage, int block, chrono::steady_clock::time_point start,
+                chrono::steady_clock::time_point end);
+    bool exportChrome(const string &path);
+    void printSummary();
+
+private:
+    Trace();
+    long sinceStart(chrono::steady_clock::time_point time) const;
+    int threadNumber();
+    atomic<bool> enabled;
+    chrono::steady_clock::time_point started;
+    mutex traceMutex;
+    vector<TraceEvent> events;
+    size_t next;                //position of the next event
+    bool wrapped;
+    map<thread::id, int> threads;
+};
+
+/**
+ * records a span from its construction to its destruction
+ */
+class TraceSpan
+{
+public:
+    TraceSpan(const char *stage, int block = -1);
+    ~TraceSpan();
+    void setBlock(int block);
+
+private:
+    const char *stage;
+    int block;
+    bool active;
+    chrono::steady_clock::time_point start;
+};
+
+#endif // TRACE_H